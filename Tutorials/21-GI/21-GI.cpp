@@ -1,5 +1,6 @@
 #pragma once
 #include "21-GI.hpp"
+#include <fstream>
 
 void CppDirectXRayTracing21::Application::InitDXR(HWND winHandle, uint32_t winWidth, uint32_t winHeight)
 {
@@ -28,221 +29,238 @@ void CppDirectXRayTracing21::Application::InitDXR(HWND winHandle, uint32_t winWi
     d3d_call(CreateDXGIFactory1(IID_PPV_ARGS(&pDxgiFactory)));
     mpDevice = mContext->createDevice(pDxgiFactory);
     mpCmdQueue = mContext->createCommandQueue(mpDevice);
+    mAllocator = std::make_unique<D3D12MemoryAllocator>(mpDevice);
+    mAccelerateStruct->SetMemoryAllocator(mAllocator.get());
+    mUploader = std::make_unique<D3D12CopyQueueUploader>(mpDevice, mAllocator.get());
+    mAccelerateStruct->SetUploader(mUploader.get());
+    mProfiler = std::make_unique<Profiler>();
+    mGpuProfiler = std::make_unique<D3D12GpuProfiler>(mpDevice, mAllocator.get(), mpCmdQueue, mProfiler.get(), kFramesInFlight);
     mpSwapChain = mContext->createDxgiSwapChain(pDxgiFactory, mHwnd, winWidth, winHeight, DXGI_FORMAT_R8G8B8A8_UNORM, mpCmdQueue);
+    mFramePacer = std::make_unique<D3D12FramePacer>(mpDevice, mpSwapChain, mProfiler.get(), kFramesInFlight, kMaxFrameLatency);
 
     // Create a RTV descriptor heap
     mRtvHeap.pHeap = mContext->createDescriptorHeap(mpDevice, kRtvHeapSize, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, false);
 
-    // Create the per-frame objects
+    // Create the per-back-buffer objects. The command allocators belong to the frames in flight
     for (uint32_t i = 0; i < mContext->kDefaultSwapChainBuffers; i++)
     {
-        d3d_call(mpDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&mFrameObjects[i].pCmdAllocator)));
         d3d_call(mpSwapChain->GetBuffer(i, IID_PPV_ARGS(&mFrameObjects[i].pSwapChainBuffer)));
         mFrameObjects[i].rtvHandle = mContext->createRTV(mpDevice, mFrameObjects[i].pSwapChainBuffer, mRtvHeap.pHeap, mRtvHeap.usedEntries, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+        mStateTracker.registerResource(mFrameObjects[i].pSwapChainBuffer, D3D12_RESOURCE_STATE_PRESENT);
     }
 
-    // Create the command-list
-    d3d_call(mpDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, mFrameObjects[0].pCmdAllocator, nullptr, IID_PPV_ARGS(&mpCmdList)));
+    // Create the command-list. It stays open on the first frame's allocator, the load-time work is submitted with the first frame
+    d3d_call(mpDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, mFramePacer->getInitialAllocator(), nullptr, IID_PPV_ARGS(&mpCmdList)));
 
     // Create a fence and the event
     d3d_call(mpDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mpFence)));
     mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 }
 
-void CppDirectXRayTracing21::Application::CreateAccelerationStructures()
+bool CppDirectXRayTracing21::Application::CreateAccelerationStructures()
 {
-    AccelerationStructureBuffers blas[kDefaultNumDesc];
+    AccelerationStructureBuffers blas[kMeshLodNum];
 
-    blas[0] = mAccelerateStruct->createCubeBottomLevelAS(mpDevice, mpCmdList);
-    blas[1] = mAccelerateStruct->createPrimitiveBottomLevelAS(mpDevice, mpCmdList);
-   
-    mBottomLevelAS[0] = blas[0].pResult;
-    mBottomLevelAS[1] = blas[1].pResult;
+    // The scene is mapped from the binary cache when it was built from the current parameters, otherwise it's generated
+    // and the cache is written for the next launch. The uploads copy out of the mapping, it's closed once they're scheduled
+    {
+        ProfileScope profileScope(mProfiler.get(), "LoadScene");
+        uint64_t sourceKey = D3D12AccelerationStructures::GetSceneSourceKey();
+        SceneCacheReader sceneCache;
+        Primitives::ArrayView<PrimitiveCB> materials;
+        if (sceneCache.Open("Scene.cache", sourceKey))
+        {
+            materials = sceneCache.GetArray<PrimitiveCB>(SceneCacheSection::Materials);
+        }
+
+        if (materials.empty() == false && mAccelerateStruct->loadGeometry(sceneCache, static_cast<uint32_t>(materials.size())))
+        {
+            mMaterials.assign(materials.begin(), materials.end());
+        }
+        else
+        {
+            // The file can't be replaced while it's mapped
+            sceneCache.Close();
+            mMaterials = GetDefaultMaterials();
+
+            // The LOD chains are simplified on a pool of their own, it's gone once the scene is written.
+            // A scene that failed to generate isn't cached, the next launch tries again
+            SceneCacheWriter writer;
+            bool generated = false;
+            {
+                ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+                generated = mAccelerateStruct->generateGeometry(writer, &pool);
+            }
+            if (generated == false)
+            {
+                return false;
+            }
+            writer.AddSection(SceneCacheSection::Materials, mMaterials);
+            writer.Write("Scene.cache", sourceKey);
+
+            // The meshes are only optimized, and measured, when the scene is generated
+            std::ofstream localityReport("MeshLocality.csv", std::ios::trunc);
+            localityReport << mAccelerateStruct->getMeshLocalityReport();
+        }
+    }
 
+    // The geometry is copied on the copy queue. The direct queue waits for it and moves the buffers out of COMMON before the builds
+    mUploader->flush();
+    mUploader->waitOnQueue(mpCmdQueue);
+    mUploader->recordFinalTransitions(mStateTracker);
+    mStateTracker.flush(mpCmdList);
+
+    // One bottom-level AS per level of every mesh, the levels past the end of a chain reference the coarsest one.
+    // The analytic spheres have a single procedural one
+    for (int mesh = 0; mesh < kDefaultNumDesc; mesh++)
+    {
+        for (int lod = 0; lod < kLodCount; lod++)
+        {
+            int meshLod = D3D12AccelerationStructures::GetMeshLod(mesh, lod);
+            if (lod < mAccelerateStruct->GetMeshLodCount(mesh))
+            {
+                blas[meshLod] = mAccelerateStruct->createMeshBottomLevelAS(mpDevice, mpCmdList, meshLod);
+                mBottomLevelAS[meshLod] = blas[meshLod].pResult;
+            }
+            else
+            {
+                mBottomLevelAS[meshLod] = mBottomLevelAS[meshLod - 1];
+            }
+        }
+    }
+
+    // The instances reference the level of detail picked from the camera
+    mAccelerateStruct->selectLods(mScenecbData.cameraPosition, kCameraTanHalfFov);
     AccelerationStructureBuffers topLevelBuffers = mAccelerateStruct->createTopLevelAS(mpDevice, mpCmdList, mBottomLevelAS, mTlasSize);
     
-    // The tutorial doesn't have any resource lifetime management, so we flush and sync here. This is not required by the DXR spec - you can submit the list whenever you like as long as you take care of the resources lifetime.
-    mFenceValue = mContext->submitCommandList(mpCmdList, mpCmdQueue, mpFence, mFenceValue);
-    mpFence->SetEventOnCompletion(mFenceValue, mFenceEvent);
-    WaitForSingleObject(mFenceEvent, INFINITE);
-    uint32_t bufferIndex = mpSwapChain->GetCurrentBackBufferIndex();
-    mpCmdList->Reset(mFrameObjects[0].pCmdAllocator, nullptr);
+    // The builds are submitted with the first frame, nothing waits for them. The scratch and instance buffers
+    // are kept alive until that frame completed
+    for (const AccelerationStructureBuffers& buffers : blas)
+    {
+        if (buffers.pScratch)
+        {
+            mPendingResources.push_back(buffers.pScratch);
+        }
+    }
+    mPendingResources.push_back(topLevelBuffers.pInstanceDesc);
 
-    // Store the AS buffers. The rest of the buffers will be released once we exit the function
+    // Store the AS buffers
     mpTopLevelAS = topLevelBuffers.pResult;
+    mpTopLevelScratch = topLevelBuffers.pScratch;
+    return true;
 }
 
 void CppDirectXRayTracing21::Application::CreateRtPipelineState()
 {
-    // Need 10 subobjects:
-    //  1 for the DXIL library
-    //  1 for hit-group
-    //  2 for RayGen root-signature (root-signature and the subobject association)
-    //  New for tutorial 16: 2 for hit-program root signature and subobject association
-    //                        2 for miss shader root-singature
-    //  Deleted: 2 for the root-signature shared between miss and hit shaders (signature and association)
-    //  2 for shader config (shared between all programs. 1 for the config, 1 for association)
-    //  1 for pipeline config
-    //  1 for the global root signature
-    
-    std::array<D3D12_STATE_SUBOBJECT, kNumSubobjects> subobjects;
-    uint32_t index = 0;
-
-    // Create the DXIL library
-    DxilLibrary dxilLib = mRtpipe->createDxilLibrary();
-    subobjects[index++] = dxilLib.stateSubobject; // 0 Library
-
-    HitProgram hitProgram(nullptr, mRtpipe->kClosestHitShader, mRtpipe->kHitGroup);
-    subobjects[index++] = hitProgram.subObject; // 1 Hit Group
-
-    // Create the ray-gen root-signature and association
-    LocalRootSignature rgsRootSignature(mpDevice, mRtpipe->createRayGenRootDesc().desc);
-    subobjects[index] = rgsRootSignature.subobject; // 2 RayGen Root Sig
-
-    uint32_t rgsRootIndex = index++; // 2
-    ExportAssociation rgsRootAssociation(&mRtpipe->kRayGenShader, 1, &(subobjects[rgsRootIndex]));
-    subobjects[index++] = rgsRootAssociation.subobject; // 3 Associate Root Sig to RGS
-
-    // tutorial 16: 
-    // Create the  hit root-signature and association
-    LocalRootSignature hitRootSignature(mpDevice, mRtpipe->createHitRootDesc().desc);
-    subobjects[index] = hitRootSignature.subobject;
-
-    int hitRootIndex = index++; // 4
-    ExportAssociation hitRootAssociation(&mRtpipe->kClosestHitShader, 1, &(subobjects[hitRootIndex]));// 5 Associate Hit Root Sig to Hit Group
-    subobjects[index++] = hitRootAssociation.subobject; // 6 Associate Hit Root Sig to Hit Group
-
-    // Create the miss root-signature and association
-    //D3D12_ROOT_SIGNATURE_DESC emptyDesc = {};
-    //emptyDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
-    LocalRootSignature missRootSignature(mpDevice, mRtpipe->CreateMissRootDesc().desc);
-    subobjects[index] = missRootSignature.subobject; // 6 Miss Root Sig
-
-    int missRootIndex = index++;  // 6
-    const WCHAR* missRootExport[] = { mRtpipe->kMissShader, mRtpipe->kShadowMiss };
-    ExportAssociation missRootAssociation(missRootExport, arraysize(missRootExport), &(subobjects[missRootIndex]));
-    //ExportAssociation missRootAssociation(&mRtpipe->kMissShader, 1, &(subobjects[missRootIndex]));
-    subobjects[index++] = missRootAssociation.subobject; // 7 Associate Miss Root Sig to Miss Shader
-
-    // Bind the payload size to the programs
-    ShaderConfig shaderConfig(sizeof(float) * 2, sizeof(float) * (4+2));
-    subobjects[index] = shaderConfig.subobject; // 8 Shader Config
-
-    uint32_t shaderConfigIndex = index++; // 8
-    const WCHAR* shaderExports[] = { mRtpipe->kMissShader, mRtpipe->kClosestHitShader, mRtpipe->kRayGenShader,mRtpipe->kShadowMiss };
-    ExportAssociation configAssociation(shaderExports, arraysize(shaderExports), &(subobjects[shaderConfigIndex]));
-    subobjects[index++] = configAssociation.subobject; // 9 Associate Shader Config to Miss, CHS, RGS
-
-    // Create the pipeline config
-    PipelineConfig config(kMaxTraceRecursionDepth);
-    subobjects[index++] = config.subobject; // 10
-
-    // Create the global root signature and store the empty signature
-    GlobalRootSignature root(mpDevice, {});
-    mpEmptyRootSig = root.pRootSig;
-    subobjects[index++] = root.subobject; // 11
-
-    // Create the state
-    D3D12_STATE_OBJECT_DESC desc;
-    desc.NumSubobjects = index; 
-    desc.pSubobjects = subobjects.data();
-    desc.Type = D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE;
-
-    d3d_call(mpDevice->CreateStateObject(&desc, IID_PPV_ARGS(&mpPipelineState)));
+    // Create the global root signature, it holds the per-frame scene constant buffer.
+    // It is shared by every pipeline the reloader builds, so the command list binding stays valid across swaps
+    GlobalRootSignature root(mpDevice, mRtpipe->createGlobalRootDesc().desc);
+    mpGlobalRootSig = root.pRootSig;
+
+    // Shadow and AO rays are traced inline when the device supports RayQuery
+    mRtpipe->setInlineVisibility(D3D12RTPipeline::supportsRaytracingTier1_1(mpDevice));
+
+    // The libraries are compiled and linked on worker threads while the scene is being created,
+    // onLoad() only waits for the result before building the shader table
+    mPipelineReloader = std::make_unique<D3D12PipelineReloader>(mpDevice, mRtpipe.get(), mpGlobalRootSig, kMaxTraceRecursionDepth, L"Data");
+    mPipelineReloader->requestBuild();
 }
 
-void CppDirectXRayTracing21::Application::CreateShaderTable()
+bool CppDirectXRayTracing21::Application::CreateShaderTable()
 {
     /** The shader-table layout is as follows:
-        Entry 0 - Ray-gen program
-        Entry 1 - Miss program
-        Entry 2 - Hit program
-        Entry 3 - Hit program
-
-        All entries in the shader-table must have the same size, so we will choose it base on the largest required entry.
-        The ray-gen program requires the largest entry - sizeof(program identifier) + 8 bytes for a descriptor-table.
-        The entry size must be aligned up to D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT
+        Ray-gen section   - Ray-gen program
+        Miss section      - Miss program, shadow miss program (only without inline visibility)
+        Hit-group section - Triangle hit program, shared by the triangle meshes, then the sphere hit program of the analytic spheres.
+                            Both point at the hit groups of the active shading mode
+
+        Every section is sized to its own largest record: sizeof(program identifier) + the local root arguments,
+        aligned up to D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT. The misses don't have local root arguments, so
+        their records only hold the identifier.
     */
+    mShaderTable = std::make_unique<D3D12ShaderTable>(mUploader.get(), &mStateTracker);
+    ShaderTableBuilder& builder = mShaderTable->getBuilder();
 
-    // Calculate the size and create the buffer
-    mShaderTableEntrySize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
-    mShaderTableEntrySize += 8; // The ray-gen's descriptor table
-    mShaderTableEntrySize = align_to(D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT, mShaderTableEntrySize);
-
-    // It is enough to set (3+1) for now, if geometry increases, the size need to be increased as well.
-    uint32_t shaderTableSize = mShaderTableEntrySize * (3 + 1); 
-
-    // For simplicity, we create the shader-table on the upload heap. You can also create it on the default heap
-    mpShaderTable = mAccelerateStruct->createBuffer(mpDevice, shaderTableSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
-
-    // Map the buffer
-    uint8_t* pData;
-    d3d_call(mpShaderTable->Map(0, nullptr, (void**)&pData));
-
-    MAKE_SMART_COM_PTR(ID3D12StateObjectProperties);
-    ID3D12StateObjectPropertiesPtr pRtsoProps;
-    mpPipelineState->QueryInterface(IID_PPV_ARGS(&pRtsoProps));
+    RayGenRootArguments rayGenArgs;
+    rayGenArgs.table = mSrvUavHeap->getGpuHandle(mRayGenTable);
+    builder.AddRecord(ShaderTableSection::RayGen, mRtpipe->kRayGenShader, rayGenArgs);
 
-    // Entry 0 - ray-gen program ID and descriptor data
-    memcpy(pData, pRtsoProps->GetShaderIdentifier(mRtpipe->kRayGenShader), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-    uint64_t heapStart = mpSrvUavHeap->GetGPUDescriptorHandleForHeapStart().ptr;
-    *(uint64_t*)(pData + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES) = heapStart;
-
-    // Entry 1 - miss program
-    pData += mShaderTableEntrySize;
-    memcpy(pData, pRtsoProps->GetShaderIdentifier(mRtpipe->kMissShader), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-    // Entry 2 - miss program
-    pData += mShaderTableEntrySize;
-    memcpy(pData, pRtsoProps->GetShaderIdentifier(mRtpipe->kShadowMiss), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-
-    // Entry 3-? hit program
-    for (uint32_t i = 0; i < kInstancesNum; i++)
+    // The order of the miss records is the miss index passed to TraceRay(). Inline visibility rays don't use a miss shader
+    builder.AddRecord(ShaderTableSection::Miss, mRtpipe->kMissShader);
+    if (mRtpipe->getInlineVisibility() == false)
     {
-        pData += mShaderTableEntrySize; 
-        memcpy(pData, pRtsoProps->GetShaderIdentifier(mRtpipe->kHitGroup), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+        builder.AddRecord(ShaderTableSection::Miss, mRtpipe->kShadowMiss);
+    }
 
-        heapStart = mpSrvUavHeap->GetGPUDescriptorHandleForHeapStart().ptr;
-        *(uint64_t*)(pData + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES) = heapStart;
+    // The descriptor tables hold the bindless geometry and material buffers. The order of the hit records is the
+    // InstanceContributionToHitGroupIndex of the TLAS instances
+    HitRootArguments hitArgs;
+    hitArgs.sceneTable = mSrvUavHeap->getGpuHandle(mHitTable);
+    hitArgs.indexBuffers = mSrvUavHeap->getGpuHandle(mIndexBufferTable);
+    hitArgs.vertexBuffers = mSrvUavHeap->getGpuHandle(mVertexBufferTable);
+    mHitGroupRecord = builder.AddRecord(ShaderTableSection::HitGroup, mRtpipe->getHitGroupExport(mShadingMode), hitArgs);
+    mSphereHitGroupRecord = builder.AddRecord(ShaderTableSection::HitGroup, mRtpipe->getSphereHitGroupExport(mShadingMode), hitArgs);
 
-        uint8_t* pCbDesc = pData + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(uint64_t);
-        //assert(((uint64_t)pCbDesc % 8) == 0); // Root descriptor must be stored at an 8-byte aligned address
-        *(D3D12_GPU_VIRTUAL_ADDRESS*)pCbDesc = mPrimitiveCB[i]->GetGPUVirtualAddress();
+    if (mShaderTable->build(mpPipelineState) == false)
+    {
+        return false;
     }
-
-    // Unmap
-    mpShaderTable->Unmap(0, nullptr);
+    mUploader->flush();
+    mUploader->waitOnQueue(mpCmdQueue);
+    mUploader->recordFinalTransitions(mStateTracker);
+    mStateTracker.flush(mpCmdList);
+    return true;
 }
 
-void CppDirectXRayTracing21::Application::CreateGeometryBuffers(D3D12_CPU_DESCRIPTOR_HANDLE& srvHandle)
+void CppDirectXRayTracing21::Application::CreateGeometryBuffers()
 {
-    D3D12_SHADER_RESOURCE_VIEW_DESC indexsrvDesc = {};
-    D3D12_SHADER_RESOURCE_VIEW_DESC vertexsrvDesc = {};
-
-    indexsrvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-    indexsrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    indexsrvDesc.Format = DXGI_FORMAT_R32_TYPELESS; //todo: check r32 typeless
-    indexsrvDesc.Buffer.NumElements = static_cast<int>(mAccelerateStruct->GetIndexCount() * 2 / 4);
-    indexsrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
-    indexsrvDesc.Buffer.StructureByteStride = 0;
-
-    srvHandle.ptr += mpDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    D3D12_CPU_DESCRIPTOR_HANDLE indexsrvHandle = srvHandle;
-    mpDevice->CreateShaderResourceView(mAccelerateStruct->GetSphereIndexBuffer(), &indexsrvDesc, indexsrvHandle);
-
-    //Create vertex srv
-    vertexsrvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-    vertexsrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    vertexsrvDesc.Format = DXGI_FORMAT_UNKNOWN;
-    vertexsrvDesc.Buffer.NumElements = mAccelerateStruct->GetVertexCount();
-    vertexsrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
-    vertexsrvDesc.Buffer.StructureByteStride = sizeof(Primitives::Vertex);
-
-    srvHandle.ptr += mpDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    D3D12_CPU_DESCRIPTOR_HANDLE vertexsrvHandle = srvHandle;
-    mpDevice->CreateShaderResourceView(mAccelerateStruct->GetSphereVertexBuffer(), &vertexsrvDesc, vertexsrvHandle);
+    // Instance and material buffers follow the TLAS in the hit table
+    D3D12_SHADER_RESOURCE_VIEW_DESC structuredsrvDesc = {};
+    structuredsrvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+    structuredsrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    structuredsrvDesc.Format = DXGI_FORMAT_UNKNOWN;
+    structuredsrvDesc.Buffer.NumElements = kInstancesNum * kLodCount;
+    structuredsrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
+
+    structuredsrvDesc.Buffer.StructureByteStride = sizeof(InstanceData);
+    mpDevice->CreateShaderResourceView(mpInstanceBuffer, &structuredsrvDesc, mSrvUavHeap->getCpuHandle(mHitTable, 1));
+
+    structuredsrvDesc.Buffer.NumElements = static_cast<uint32_t>(mMaterials.size());
+    structuredsrvDesc.Buffer.StructureByteStride = sizeof(PrimitiveCB);
+    mpDevice->CreateShaderResourceView(mpMaterialBuffer, &structuredsrvDesc, mSrvUavHeap->getCpuHandle(mHitTable, 2));
+
+    // Index buffers, one raw view per mesh level over its 16 or 32-bit indices, padded to whole words. The arrays live in the dynamic region so meshes can be streamed in and out
+    mIndexBufferTable = mSrvUavHeap->allocate(kMeshLodNum);
+    for (int mesh = 0; mesh < kMeshLodNum; mesh++)
+    {
+        D3D12_SHADER_RESOURCE_VIEW_DESC indexsrvDesc = {};
+        indexsrvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+        indexsrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        indexsrvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+        indexsrvDesc.Buffer.NumElements = static_cast<int>(Primitives::GetIndexBufferSize(mAccelerateStruct->GetMeshIndexCount(mesh), mAccelerateStruct->GetMeshIndexFormat(mesh)) / 4);
+        indexsrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+        indexsrvDesc.Buffer.StructureByteStride = 0;
+
+        mpDevice->CreateShaderResourceView(mAccelerateStruct->GetIndexBuffer(mesh), &indexsrvDesc, mSrvUavHeap->getCpuHandle(mIndexBufferTable, mesh));
+    }
+
+    // Packed vertex attributes, the positions are only read by the BLAS build
+    mVertexBufferTable = mSrvUavHeap->allocate(kMeshLodNum);
+    for (int mesh = 0; mesh < kMeshLodNum; mesh++)
+    {
+        D3D12_SHADER_RESOURCE_VIEW_DESC vertexsrvDesc = {};
+        vertexsrvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+        vertexsrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        vertexsrvDesc.Format = DXGI_FORMAT_UNKNOWN;
+        vertexsrvDesc.Buffer.NumElements = mAccelerateStruct->GetMeshVertexCount(mesh);
+        vertexsrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
+        vertexsrvDesc.Buffer.StructureByteStride = sizeof(Primitives::PackedVertexAttributes);
+
+        mpDevice->CreateShaderResourceView(mAccelerateStruct->GetAttributeBuffer(mesh), &vertexsrvDesc, mSrvUavHeap->getCpuHandle(mVertexBufferTable, mesh));
+    }
 }
 
-void CppDirectXRayTracing21::Application::CreateSceneConstantBuffers(D3D12_CPU_DESCRIPTOR_HANDLE& srvHandle)
+void CppDirectXRayTracing21::Application::CreateSceneConstantBuffers()
 {
 
     {
@@ -256,25 +274,15 @@ void CppDirectXRayTracing21::Application::CreateSceneConstantBuffers(D3D12_CPU_D
         mScenecbData.aoSamples = 0;
     }
 
-    mSceneCB = mAccelerateStruct->createBuffer(mpDevice, sizeof(SceneCB), D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
-    uint8_t* pData;
-    d3d_call(mSceneCB->Map(0, nullptr, (void**)&pData));
-    memcpy(pData, &mScenecbData, sizeof(mScenecbData));
-    mSceneCB->Unmap(0, nullptr);
-
-    D3D12_CONSTANT_BUFFER_VIEW_DESC scenecbsrvDesc = {};
-    scenecbsrvDesc.BufferLocation = mSceneCB->GetGPUVirtualAddress();
-    scenecbsrvDesc.SizeInBytes = (sizeof(SceneCB) + 255) & ~255;
-
-    srvHandle.ptr += mpDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    D3D12_CPU_DESCRIPTOR_HANDLE scenecbsrvHandle = srvHandle;
-    mpDevice->CreateConstantBufferView(&scenecbsrvDesc, scenecbsrvHandle);
+    // The scene constants change every frame. Instead of mapping a single buffer the GPU may still be reading,
+    // every frame in flight writes into its own region of a persistently mapped ring.
+    mUploadRing = std::make_unique<D3D12UploadRing>(mAllocator.get(), kFramesInFlight, kUploadRingBytesPerFrame);
 }
 
-void CppDirectXRayTracing21::Application::CreatePrimitiveConstantBuffers()
+std::vector<CppDirectXRayTracing21::PrimitiveCB> CppDirectXRayTracing21::Application::GetDefaultMaterials()
 {
-    // Primitive buffer per instance
-    PrimitiveCB pcb[kInstancesNum];
+    // Material per instance
+    std::vector<PrimitiveCB> pcb(kInstancesNum, PrimitiveCB());
     {
         pcb[0].matDiffuse = glm::vec3(1.0f, 1.0f, 1.0f);
         pcb[0].matRoughness = 0.1f;
@@ -298,20 +306,37 @@ void CppDirectXRayTracing21::Application::CreatePrimitiveConstantBuffers()
         pcb[3].matRoughness = 0.1f;
         pcb[3].matSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
     }
+    return pcb;
+}
 
+bool CppDirectXRayTracing21::Application::CreateInstanceBuffers()
+{
+    // Geometry and material of every instance level. The hit shader looks them up with InstanceID(), the TLAS picks the
+    // record of the selected level so switching levels doesn't touch this buffer
+    InstanceData instances[kInstancesNum * kLodCount];
     for (int i = 0; i < kInstancesNum; i++)
     {
-        const uint32_t bufferSize = sizeof(PrimitiveCB);
-        mPrimitiveCB[i] = mAccelerateStruct->createBuffer(mpDevice, bufferSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
-        uint8_t* pData;
-        d3d_call(mPrimitiveCB[i]->Map(0, nullptr, (void**)&pData));
-        memcpy(pData, &pcb[i], sizeof(pcb));
-        mPrimitiveCB[i]->Unmap(0, nullptr);
+        for (int lod = 0; lod < kLodCount; lod++)
+        {
+            int meshLod = D3D12AccelerationStructures::GetMeshLod(mAccelerateStruct->GetInstanceMesh(i), lod);
+            InstanceData& instance = instances[D3D12AccelerationStructures::GetInstanceRecord(i, lod)];
+            instance.vertexBufferIndex = meshLod;
+            instance.indexBufferIndex = meshLod;
+            instance.materialIndex = mAccelerateStruct->GetInstanceMaterial(i);
+            instance.indexStride = Primitives::GetIndexSize(mAccelerateStruct->GetMeshIndexFormat(meshLod));
+        }
     }
+
+    // Both buffers are static, they are copied into the default heap
+    mpInstanceBuffer = mUploader->createBufferWithData(instances, sizeof(instances), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    mpMaterialBuffer = mUploader->createBufferWithData(mMaterials.data(), sizeof(PrimitiveCB) * mMaterials.size(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    return mpInstanceBuffer != nullptr && mpMaterialBuffer != nullptr;
 }
 
-void CppDirectXRayTracing21::Application::UpdateConstantBuffers()
+bool CppDirectXRayTracing21::Application::UpdateConstantBuffers()
 {
+    ProfileScope profileScope(mProfiler.get(), "UpdateConstantBuffers");
+
     mScenecbData.frameindex += 1.0f;
 
     // Rotate Light
@@ -340,11 +365,26 @@ void CppDirectXRayTracing21::Application::UpdateConstantBuffers()
     else
         mScenecbData.ggxshadingMode = false;
     
-    // Rewrite scene buffer.
-    uint8_t* pData;
-    d3d_call(mSceneCB->Map(0, nullptr, (void**)&pData));
-    memcpy(pData, &mScenecbData, sizeof(mScenecbData));
-    mSceneCB->Unmap(0, nullptr);
+    // Write the scene buffer into this frame's region of the upload ring. It fails when not even an overflow buffer could be
+    // created, which was reported. The address of a previous frame can't be kept, its region is recycled while this frame runs
+    mSceneCBAddress = mUploadRing->push(mScenecbData);
+    return mSceneCBAddress != 0;
+}
+
+void CppDirectXRayTracing21::Application::UpdatePipelineState()
+{
+    // Swap in a pipeline rebuilt from edited shaders. The swap happens between two frames, the frames still in
+    // flight keep the old pipeline alive
+    mPipelineReloader->poll();
+    ID3D12StateObjectPtr pPipelineState;
+    if (mPipelineReloader->takePipeline(pPipelineState))
+    {
+        mRetiredPipelines.push_back({ mFenceValue, mpPipelineState });
+        mpPipelineState = pPipelineState;
+
+        // The new pipeline has the same exports but new shader identifiers
+        mShaderTable->setPipeline(mpPipelineState);
+    }
 }
 
 void CppDirectXRayTracing21::Application::CreateShaderResources()
@@ -360,59 +400,88 @@ void CppDirectXRayTracing21::Application::CreateShaderResources()
     resDesc.MipLevels = 1;
     resDesc.SampleDesc.Count = 1;
     resDesc.Width = mSwapChainSize.x;
-    d3d_call(mpDevice->CreateCommittedResource(&kDefaultHeapProps, D3D12_HEAP_FLAG_NONE, &resDesc, D3D12_RESOURCE_STATE_COPY_SOURCE, nullptr, IID_PPV_ARGS(&mpOutputResource))); // Starting as copy-source to simplify onFrameRender()
+    d3d_call(mpDevice->CreateCommittedResource(&kDefaultHeapProps, D3D12_HEAP_FLAG_NONE, &resDesc, D3D12_RESOURCE_STATE_COPY_SOURCE, nullptr, IID_PPV_ARGS(&mpOutputResource)));
+    mStateTracker.registerResource(mpOutputResource, D3D12_RESOURCE_STATE_COPY_SOURCE);
 
-    // Create an SRV/UAV/VertexSRV/IndexSRV descriptor heap. 
-    // Need 5 entries - 1 SRV for the scene, 1 UAV for the output, 1 SRV for VertexBuffer, 1 SRV for IndexBuffer, 1 constant buffer
-    mpSrvUavHeap = mContext->createDescriptorHeap(mpDevice, 5, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
+    // Create the SRV/UAV descriptor heap. Every descriptor table is its own allocation, the root signatures only
+    // describe the order of the descriptors inside a table
+    mSrvUavHeap = std::make_unique<D3D12DescriptorHeap>(mpDevice, kFramesInFlight);
+    mRayGenTable = mSrvUavHeap->allocatePersistent(2);
+    mHitTable = mSrvUavHeap->allocatePersistent(3);
 
-    // Create the UAV. Based on the root signature we created it should be the first entry
+    // Create the UAV, the first entry of the ray-gen table
     D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
     uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-    mpDevice->CreateUnorderedAccessView(mpOutputResource, nullptr, &uavDesc, mpSrvUavHeap->GetCPUDescriptorHandleForHeapStart());
+    mpDevice->CreateUnorderedAccessView(mpOutputResource, nullptr, &uavDesc, mSrvUavHeap->getCpuHandle(mRayGenTable, 0));
 
-    // Create the TLAS SRV right after the UAV. Note that we are using a different SRV desc here
+    // Create the TLAS SRV. Note that we are using a different SRV desc here. Both tables start with it
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     srvDesc.RaytracingAccelerationStructure.Location = mpTopLevelAS->GetGPUVirtualAddress();
-    D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = mpSrvUavHeap->GetCPUDescriptorHandleForHeapStart();
-    srvHandle.ptr += mpDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    mpDevice->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
+    mpDevice->CreateShaderResourceView(nullptr, &srvDesc, mSrvUavHeap->getCpuHandle(mRayGenTable, 1));
+    mpDevice->CreateShaderResourceView(nullptr, &srvDesc, mSrvUavHeap->getCpuHandle(mHitTable, 0));
    
-    // Create index and vertex srv
-    CreateGeometryBuffers(srvHandle);
-
-    // Create primitive cb and scene cb
-    CreateSceneConstantBuffers(srvHandle);
+    // Create the instance, material, index and vertex srv
+    CreateGeometryBuffers();
 }
 
 uint32_t CppDirectXRayTracing21::Application::beginFrame()
 {
+    ProfileScope profileScope(mProfiler.get(), "beginFrame");
+
+    // Wait for the swap chain and for the GPU to release this frame's allocator, the slot's rings are free after that
+    mFramePacer->beginFrame(mpCmdList, mpFence);
+
     // Bind the descriptor heaps
-    ID3D12DescriptorHeap* heaps[] = { mpSrvUavHeap };
+    ID3D12DescriptorHeap* heaps[] = { mSrvUavHeap->getHeap() };
     mpCmdList->SetDescriptorHeaps(arraysize(heaps), heaps);
+
+    // Recycle the transient descriptors and the frees of the frames the GPU finished
+    mSrvUavHeap->beginFrame(mpFence, mFenceEvent);
+
+    // Make sure the GPU is done with the upload ring region we are about to overwrite
+    mUploadRing->beginFrame(mpFence, mFenceEvent);
+
+    // Release the staging memory of the uploads that completed
+    mUploader->poll();
+
+    // Collect the timestamps of the frames the GPU finished
+    mGpuProfiler->beginFrame(mpFence);
+
+    // Release the pipelines replaced by a hot-reload once no frame in flight uses them
+    uint64_t completedValue = mpFence->GetCompletedValue();
+    while (mRetiredPipelines.empty() == false && mRetiredPipelines.front().first <= completedValue)
+    {
+        mRetiredPipelines.erase(mRetiredPipelines.begin());
+    }
+    while (mRetiredResources.empty() == false && mRetiredResources.front().first <= completedValue)
+    {
+        mRetiredResources.erase(mRetiredResources.begin());
+    }
     return mpSwapChain->GetCurrentBackBufferIndex();
 }
 
 void CppDirectXRayTracing21::Application::endFrame(uint32_t rtvIndex)
 {
-    mContext->resourceBarrier(mpCmdList, mFrameObjects[rtvIndex].pSwapChainBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-    mFenceValue = mContext->submitCommandList(mpCmdList, mpCmdQueue, mpFence, mFenceValue);
-    mpSwapChain->Present(0, 0);
-
-    // Prepare the command list for the next frame
-    uint32_t bufferIndex = mpSwapChain->GetCurrentBackBufferIndex();
+    ProfileScope profileScope(mProfiler.get(), "endFrame");
 
-    // Make sure we have the new back-buffer is ready
-    if (mFenceValue > mContext->kDefaultSwapChainBuffers)
+    mStateTracker.transition(mFrameObjects[rtvIndex].pSwapChainBuffer, D3D12_RESOURCE_STATE_PRESENT);
+    mStateTracker.flush(mpCmdList);
+    mGpuProfiler->resolve(mpCmdList);
+    mFenceValue = mContext->submitCommandList(mpCmdList, mpCmdQueue, mpFence, mFenceValue);
+    mUploadRing->endFrame(mFenceValue);
+    mSrvUavHeap->endFrame(mFenceValue);
+    mGpuProfiler->endFrame(mFenceValue);
+    mFramePacer->endFrame(mFenceValue);
+    for (ID3D12ResourcePtr& pResource : mPendingResources)
     {
-        mpFence->SetEventOnCompletion(mFenceValue - mContext->kDefaultSwapChainBuffers + 1, mFenceEvent);
-        WaitForSingleObject(mFenceEvent, INFINITE);
+        mRetiredResources.push_back({ mFenceValue, pResource });
     }
+    mPendingResources.clear();
 
-    mFrameObjects[bufferIndex].pCmdAllocator->Reset();
-    mpCmdList->Reset(mFrameObjects[bufferIndex].pCmdAllocator, nullptr);
+    // The next frame waits in beginFrame(), not here
+    mpSwapChain->Present(0, 0);
 }
 
 
@@ -423,18 +492,43 @@ void CppDirectXRayTracing21::Application::onLoad(HWND winHandle, uint32_t winWid
 {
     InitDXR(winHandle, winWidth, winHeight); 
 
-    // Create geometry bottom/top level structure.
-    CreateAccelerationStructures();
-
-    // Create pipeline
+    // Start compiling the pipeline, it builds on worker threads while the scene is created
     CreateRtPipelineState();
 
+    // Create scene cb. The camera is placed first, the TLAS picks the level of detail of every instance from it
+    CreateSceneConstantBuffers();
+
+    // Create geometry bottom/top level structure. Without a scene, or when its buffers can't be uploaded, there is nothing
+    // to render and the message loop quits right away
+    if (CreateAccelerationStructures() == false)
+    {
+        PostQuitMessage(0);
+        return;
+    }
+
+    // Create the per-instance geometry and material buffers
+    if (CreateInstanceBuffers() == false)
+    {
+        PostQuitMessage(0);
+        return;
+    }
+
     // Create shader buffers
     CreateShaderResources();
 
-    CreatePrimitiveConstantBuffers();
-
-    CreateShaderTable();
+    // The shader table needs the shader identifiers of the pipeline. The reloader already showed the compiler errors
+    mpPipelineState = mPipelineReloader->waitForPipeline();
+    if (mpPipelineState == nullptr)
+    {
+        msgBox("Failed to create the ray-tracing pipeline.");
+        PostQuitMessage(0);
+        return;
+    }
+    if (CreateShaderTable() == false)
+    {
+        PostQuitMessage(0);
+        return;
+    }
 }
 
 
@@ -442,44 +536,65 @@ void CppDirectXRayTracing21::Application::onFrameRender()
 {
     uint32_t rtvIndex = beginFrame();
 
-    UpdateConstantBuffers();
-
-    // Let's raytrace
-    mContext->resourceBarrier(mpCmdList, mpOutputResource, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    D3D12_DISPATCH_RAYS_DESC raytraceDesc = {};
-    raytraceDesc.Width = mSwapChainSize.x;
-    raytraceDesc.Height = mSwapChainSize.y;
-    raytraceDesc.Depth = 1;
-
-    // RayGen is the first entry in the shader-table
-    raytraceDesc.RayGenerationShaderRecord.StartAddress = mpShaderTable->GetGPUVirtualAddress() + 0 * mShaderTableEntrySize;
-    raytraceDesc.RayGenerationShaderRecord.SizeInBytes = mShaderTableEntrySize;
-
-    // Miss is the second entry in the shader-table
-    size_t missOffset = 1 * mShaderTableEntrySize;
-    raytraceDesc.MissShaderTable.StartAddress = mpShaderTable->GetGPUVirtualAddress() + missOffset;
-    raytraceDesc.MissShaderTable.StrideInBytes = mShaderTableEntrySize;
-    raytraceDesc.MissShaderTable.SizeInBytes = mShaderTableEntrySize * 2;   // Only a s single miss-entry
-
-    // Hit is the fourth entry in the shader-table
-    size_t hitOffset = 3 * mShaderTableEntrySize;
-    raytraceDesc.HitGroupTable.StartAddress = mpShaderTable->GetGPUVirtualAddress() + hitOffset;
-    raytraceDesc.HitGroupTable.StrideInBytes = mShaderTableEntrySize;
-    raytraceDesc.HitGroupTable.SizeInBytes = mShaderTableEntrySize * kInstancesNum;
-
-    // Bind the empty root signature
-    mpCmdList->SetComputeRootSignature(mpEmptyRootSig);
-
-    // Dispatch
-    mpCmdList->SetPipelineState1(mpPipelineState.GetInterfacePtr());
-    mpCmdList->DispatchRays(&raytraceDesc);
-
-    // Copy the results to the back-buffer
-    mContext->resourceBarrier(mpCmdList, mpOutputResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
-    mContext->resourceBarrier(mpCmdList, mFrameObjects[rtvIndex].pSwapChainBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST);
+    bool constantsUploaded = UpdateConstantBuffers();
+
+    // Rebuild the TLAS when an instance switched its level of detail. Its instance descs go into this frame's upload region
+    if (mAccelerateStruct->selectLods(mScenecbData.cameraPosition, kCameraTanHalfFov))
+    {
+        UploadAllocation instanceDescs = mUploadRing->allocate(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * kInstancesNum, D3D12_RAYTRACING_INSTANCE_DESCS_BYTE_ALIGNMENT);
+        if (instanceDescs.pCpuAddress)
+        {
+            mAccelerateStruct->rebuildTopLevelAS(mpCmdList, mBottomLevelAS, mpTopLevelAS, mpTopLevelScratch,
+                                                 reinterpret_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(instanceDescs.pCpuAddress), instanceDescs.gpuAddress);
+        }
+    }
+
+    UpdatePipelineState();
+
+    // Switch the hit groups when a key toggled the shading mode. The shaders are specialized, they don't branch on it
+    ShadingMode shadingMode = SelectShadingMode(aoSamples, ggxShadingMode);
+    if (shadingMode != mShadingMode)
+    {
+        mShadingMode = shadingMode;
+        mShaderTable->getBuilder().SetExportName(ShaderTableSection::HitGroup, mHitGroupRecord, mRtpipe->getHitGroupExport(mShadingMode));
+        mShaderTable->getBuilder().SetExportName(ShaderTableSection::HitGroup, mSphereHitGroupRecord, mRtpipe->getSphereHitGroupExport(mShadingMode));
+    }
+
+    // Patch the records whose export or local root arguments changed, then let the table describe its sections
+    mShaderTable->update(mpCmdList, mUploadRing.get());
+    D3D12_DISPATCH_RAYS_DESC raytraceDesc = mShaderTable->getDispatchRaysDesc(mSwapChainSize.x, mSwapChainSize.y);
+
+    // Without scene constants the frame isn't traced, the back buffer gets the previous image
+    if (constantsUploaded)
+    {
+        // Bind the global root signature and this frame's scene constants
+        mpCmdList->SetComputeRootSignature(mpGlobalRootSig);
+        mpCmdList->SetComputeRootConstantBufferView(0, mSceneCBAddress);
+
+        // Dispatch
+        mpCmdList->SetPipelineState1(mpPipelineState.GetInterfacePtr());
+        mStateTracker.uavAccess(mpOutputResource);
+        mStateTracker.flush(mpCmdList);
+        uint32_t gpuScope = mGpuProfiler->beginScope(mpCmdList, "DispatchRays");
+        mpCmdList->DispatchRays(&raytraceDesc);
+        mGpuProfiler->endScope(mpCmdList, gpuScope);
+    }
+
+    // Copy the results to the back-buffer, both transitions go into one barrier call
+    mStateTracker.transition(mpOutputResource, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    mStateTracker.transition(mFrameObjects[rtvIndex].pSwapChainBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    mStateTracker.flush(mpCmdList);
+    uint32_t gpuScope = mGpuProfiler->beginScope(mpCmdList, "CopyToBackBuffer");
     mpCmdList->CopyResource(mFrameObjects[rtvIndex].pSwapChainBuffer, mpOutputResource);
+    mGpuProfiler->endScope(mpCmdList, gpuScope);
 
     endFrame(rtvIndex);
+
+    // The statistics cover the last frames only, the file is simply re-written
+    if (++mProfiledFrames % kProfileCsvInterval == 0)
+    {
+        mProfiler->WriteStatisticsCsv("Profile.csv");
+    }
 }
 
 void CppDirectXRayTracing21::Application::onShutdown()
@@ -489,6 +604,11 @@ void CppDirectXRayTracing21::Application::onShutdown()
     mpCmdQueue->Signal(mpFence, mFenceValue);
     mpFence->SetEventOnCompletion(mFenceValue, mFenceEvent);
     WaitForSingleObject(mFenceEvent, INFINITE);
+
+    // Every frame completed, read the last timestamps and write the capture
+    mGpuProfiler->beginFrame(mpFence);
+    mProfiler->WriteStatisticsCsv("Profile.csv");
+    mProfiler->WriteChromeTrace("Profile.json");
 }
 
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd)
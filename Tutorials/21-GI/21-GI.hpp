@@ -2,13 +2,20 @@
 #include "RTX/D3D12GraphicsContext.hpp"
 #include "RTX/D3D12AccelerationStructures.hpp"
 #include "RTX/D3D12RTPipeline.hpp"
+#include "RTX/D3D12MemoryAllocator.hpp"
+#include "RTX/D3D12UploadRing.hpp"
+#include "RTX/D3D12CopyQueueUploader.hpp"
+#include "RTX/D3D12DescriptorHeap.hpp"
+#include "RTX/D3D12ShaderTable.hpp"
+#include "RTX/D3D12PipelineReloader.hpp"
+#include "RTX/D3D12GpuProfiler.hpp"
+#include "RTX/D3D12FramePacer.hpp"
+#include "RTX/D3D12ResourceStateTracker.hpp"
 
 #include "RTX/Structs/FrameObject.hpp"
-#include "RTX/Structs/HitProgram.hpp"
-#include "RTX/Structs/ExportAssociation.hpp"
-#include "RTX/Structs/ShaderConfig.hpp"
-#include "RTX/Structs/PipelineConfig.hpp"
 #include "RTX/Structs/PrimitiveCB.hpp"
+#include "RTX/Structs/InstanceData.hpp"
+#include "RTX/Structs/LocalRootArguments.hpp"
 #include "RTX/Structs/SceneCB.hpp"
 
 namespace CppDirectXRayTracing21 {
@@ -20,16 +27,20 @@ namespace CppDirectXRayTracing21 {
         void onShutdown() override;
 
         void InitDXR(HWND winHandle, uint32_t winWidth, uint32_t winHeight);
-        void CreateAccelerationStructures();
+        // Returns false when the scene couldn't be loaded or generated, nothing was built then
+        bool CreateAccelerationStructures();
         void CreateRtPipelineState();
-        void CreateShaderTable();
+        bool CreateShaderTable();
         void CreateShaderResources();
 
-        void CreateGeometryBuffers(D3D12_CPU_DESCRIPTOR_HANDLE& srvHandle);
-        void CreateSceneConstantBuffers(D3D12_CPU_DESCRIPTOR_HANDLE& srvHandle);
-        void CreatePrimitiveConstantBuffers();
+        void CreateGeometryBuffers();
+        void CreateSceneConstantBuffers();
+        bool CreateInstanceBuffers();
 
-        void UpdateConstantBuffers();
+        static std::vector<PrimitiveCB> GetDefaultMaterials();
+
+        bool UpdateConstantBuffers();
+        void UpdatePipelineState();
 
         uint32_t beginFrame();
         void endFrame(uint32_t rtvIndex);
@@ -37,8 +48,13 @@ namespace CppDirectXRayTracing21 {
     private:
         static const uint32_t kRtvHeapSize = 3;
         static const uint32_t kSrvUavHeapSize = 2;
-        static const uint32_t kNumSubobjects = 12;
         static const uint32_t kMaxTraceRecursionDepth = 20;
+        static const uint64_t kUploadRingBytesPerFrame = 64 * 1024;
+        static const uint32_t kProfileCsvInterval = 1024;
+        static const uint32_t kFramesInFlight = 2;
+        static const uint32_t kMaxFrameLatency = 2;
+        // rayGen() spans [-1, 1] vertically at unit distance, a 90 degree field of view
+        static constexpr float kCameraTanHalfFov = 1.0f;
 
         std::unique_ptr<D3D12GraphicsContext> mContext;
         std::vector<FrameObject> mFrameObjects;
@@ -52,29 +68,73 @@ namespace CppDirectXRayTracing21 {
         ID3D12FencePtr mpFence;
         HANDLE mFenceEvent;
         uint64_t mFenceValue = 0;    
+
+        // Command allocators per frame in flight, waits on the swap chain latency and on the frame's fence
+        std::unique_ptr<D3D12FramePacer> mFramePacer;
+
+        // Resources used by commands that weren't submitted yet, and the ones waiting for their frame to complete
+        std::vector<ID3D12ResourcePtr> mPendingResources;
+        std::vector<std::pair<uint64_t, ID3D12ResourcePtr>> mRetiredResources;
+
+        // States of the output and the back buffers, the barriers are batched before each dispatch and copy
+        D3D12ResourceStateTracker mStateTracker;
+
+        // Heap sub-allocator for every buffer we create
+        std::unique_ptr<D3D12MemoryAllocator> mAllocator;
+
+        // Copies static data into default-heap buffers on the copy queue
+        std::unique_ptr<D3D12CopyQueueUploader> mUploader;
+
+        // CPU and GPU scopes on one timeline, the statistics CSV is re-written every kProfileCsvInterval frames
+        std::unique_ptr<Profiler> mProfiler;
+        std::unique_ptr<D3D12GpuProfiler> mGpuProfiler;
+        uint32_t mProfiledFrames = 0;
         
         // Acceleration Structure
         std::unique_ptr<D3D12AccelerationStructures> mAccelerateStruct;
-        ID3D12ResourcePtr mpTopLevelAS, mBottomLevelAS[kDefaultNumDesc];
+        ID3D12ResourcePtr mpTopLevelAS, mBottomLevelAS[kMeshLodNum];
+        // Kept for the rebuilds when an instance switches its level of detail
+        ID3D12ResourcePtr mpTopLevelScratch;
         
         uint64_t mTlasSize = 0;
 
         // Pipeline state
         std::unique_ptr<D3D12RTPipeline> mRtpipe;
         ID3D12StateObjectPtr mpPipelineState;
-        ID3D12RootSignaturePtr mpEmptyRootSig;
+        ID3D12RootSignaturePtr mpGlobalRootSig;
+
+        // Builds the pipeline in the background and rebuilds it when a shader source changes
+        std::unique_ptr<D3D12PipelineReloader> mPipelineReloader;
+
+        // Replaced pipelines, released once the GPU passed the fence value of the last frame that used them
+        std::vector<std::pair<uint64_t, ID3D12StateObjectPtr>> mRetiredPipelines;
 
         // Shader table
-        ID3D12ResourcePtr mpShaderTable;
-        uint32_t mShaderTableEntrySize = 0;
+        std::unique_ptr<D3D12ShaderTable> mShaderTable;
+        uint32_t mHitGroupRecord = 0;
+        uint32_t mSphereHitGroupRecord = 0;
+
+        // Selects the hit group, each one is compiled for a single shading mode
+        ShadingMode mShadingMode = ShadingMode::LambertGI;
 
         // Shader Resource
         ID3D12ResourcePtr mpOutputResource;
-        ID3D12DescriptorHeapPtr mpSrvUavHeap;
+        std::unique_ptr<D3D12DescriptorHeap> mSrvUavHeap;
+
+        // Descriptor tables, in the order of the root signature ranges
+        DescriptorHandle mRayGenTable;       // gOutput, gRtScene
+        DescriptorHandle mHitTable;          // gRtScene, gInstances, gMaterials
+        DescriptorHandle mIndexBufferTable;  // gIndexBuffers[]
+        DescriptorHandle mVertexBufferTable; // gVertexBuffers[]
 
         // Constant BUffers
-        ID3D12ResourcePtr mSceneCB;
-        ID3D12ResourcePtr mPrimitiveCB[kInstancesNum];
+        std::unique_ptr<D3D12UploadRing> mUploadRing;
+        D3D12_GPU_VIRTUAL_ADDRESS mSceneCBAddress = 0; // In this frame's ring region, 0 when it couldn't be allocated
+
+        // Bindless geometry, one InstanceData per TLAS instance. The materials come from the scene cache or the defaults
+        ID3D12ResourcePtr mpInstanceBuffer;
+        ID3D12ResourcePtr mpMaterialBuffer;
+        std::vector<PrimitiveCB> mMaterials;
 
         SceneCB mScenecbData;
     };
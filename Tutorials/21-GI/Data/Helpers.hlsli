@@ -6,29 +6,83 @@
 #ifndef __HELPER_HLSL__
 #define __HELPER_HLSL__
 
+// Shading permutations, the application compiles one library per mode. Matches ShaderPermutations.hpp
+#define SHADING_MODE_AO         0
+#define SHADING_MODE_LAMBERT_GI 1
+#define SHADING_MODE_GGX_GI     2
+
+#ifndef SHADING_MODE
+#define SHADING_MODE SHADING_MODE_LAMBERT_GI
+#endif
+
+// Visibility rays use RayQuery instead of TraceRay(), needs lib_6_5
+#ifndef INLINE_VISIBILITY
+#define INLINE_VISIBILITY 0
+#endif
+
+// Packed vertex attributes and the analytic spheres, shared with the application
+#include "VertexPacking.hlsli"
+#include "SphereIntersection.hlsli"
+
 static float M_PI = 3.1415f;
 static float gt_min = 0.01f;
 static float gt_max = 1000.0f;
 
+// Packed payloads, 8 and 4 bytes. Matches PayloadPacking.hpp, the shader config is sized from the C++ structs
 struct RayPayload
 {
-    float4 color;
-    uint recursionDepth;
-    uint seed;
+    uint radiance;      // RGB9E5
+    uint depthAndSeed;  // Recursion depth in the top 8 bits, random seed in the low 24 bits
 };
 
 struct ShadowPayload
 {
-    bool hit;
+    uint visible;       // Cleared by the caller, only the miss shader sets it
 };
 
-struct Vertex
+// Shared exponent format of DXGI_FORMAT_R9G9B9E5_SHAREDEXP, see EXT_texture_shared_exponent
+uint PackRGB9E5(float3 rgb)
 {
-    float3 Position;
-    float3 Normal;
-    float3 Tangent;
-    float2 TexCoord;
-};
+    float3 c = clamp(rgb, 0.0f, 65408.0f);
+    float maxComponent = max(c.x, max(c.y, c.z));
+
+    // The lower bound keeps log2() finite for black
+    int exponent = max(-16, int(floor(log2(max(maxComponent, 1e-30f))))) + 1 + 15;
+    float scale = exp2(float(exponent - 15 - 9));
+
+    // Rounding may carry the largest mantissa over 9 bits
+    if (floor(maxComponent / scale + 0.5f) >= 512.0f)
+    {
+        scale *= 2.0f;
+        exponent++;
+    }
+    exponent = min(exponent, 31);
+
+    uint3 m = uint3(floor(c / scale + 0.5f));
+    return m.x | (m.y << 9) | (m.z << 18) | (uint(exponent) << 27);
+}
+
+float3 UnpackRGB9E5(uint packed)
+{
+    float scale = exp2(float(int(packed >> 27) - 15 - 9));
+    return float3(packed & 0x1FF, (packed >> 9) & 0x1FF, (packed >> 18) & 0x1FF) * scale;
+}
+
+// nextRand() only reads the low 24 bits of the seed, keeping 24 bits doesn't change the random sequence
+uint PackDepthAndSeed(uint depth, uint seed)
+{
+    return (min(depth, 255) << 24) | (seed & 0x00FFFFFF);
+}
+
+uint UnpackDepth(uint depthAndSeed)
+{
+    return depthAndSeed >> 24;
+}
+
+uint UnpackSeed(uint depthAndSeed)
+{
+    return depthAndSeed & 0x00FFFFFF;
+}
 
 cbuffer SceneCB : register(b0)
 {
@@ -39,20 +93,35 @@ cbuffer SceneCB : register(b0)
     float3 lightPosition			: packoffset(c2);
     uint aoSamples                  : packoffset(c2.w);
     float3 lightIntensity		    : packoffset(c3);
-    bool ggxshadingMode             : packoffset(c3.w);
+    bool ggxshadingMode             : packoffset(c3.w); // Unused, the shading mode is compiled in
 };
 
-cbuffer PrimitiveCB : register(b1)
+// Per-instance record, indexed by InstanceID(). Matches InstanceData.hpp
+struct InstanceData
 {
-    float3 matDiffuse		: packoffset(c0);
-    float  matRoughness    : packoffset(c0.w);
-    float3 matSpecular		: packoffset(c1);
-}
+    uint vertexBufferIndex;
+    uint indexBufferIndex;
+    uint materialIndex;
+    uint indexStride;       // 2 or 4 bytes
+};
 
-RaytracingAccelerationStructure gRtScene : register(t0);
-RWTexture2D<float4>             gOutput	 : register(u0);
-ByteAddressBuffer               Indices	 : register(t1);
-StructuredBuffer<Vertex>        Vertices : register(t2);
+// Matches PrimitiveCB.hpp
+struct Material
+{
+    float3 diffuse;
+    float  roughness;
+    float3 specular;
+    float  padding;
+};
+
+RaytracingAccelerationStructure gRtScene       : register(t0);
+RWTexture2D<float4>             gOutput	       : register(u0);
+StructuredBuffer<InstanceData>  gInstances     : register(t1);
+StructuredBuffer<Material>      gMaterials     : register(t2);
+
+// Bindless geometry, one entry per mesh
+ByteAddressBuffer               gIndexBuffers[]  : register(t0, space1);
+StructuredBuffer<PackedVertexAttributes> gVertexBuffers[] : register(t0, space2); // Attribute streams, see VertexPacking.hlsli
 
 // Retrieve hit world position.
 float3 HitWorldPosition()
@@ -93,6 +162,19 @@ uint3 Load3x16BitIndices(ByteAddressBuffer Indices, uint offsetBytes)
     return indices;
 }
 
+// Load the three indices of a triangle from the instance's index buffer.
+uint3 LoadTriangleIndices(InstanceData instance, uint primitiveIndex)
+{
+    ByteAddressBuffer indexBuffer = gIndexBuffers[NonUniformResourceIndex(instance.indexBufferIndex)];
+    uint offsetBytes = primitiveIndex * 3 * instance.indexStride;
+
+    if (instance.indexStride == 4)
+    {
+        return indexBuffer.Load3(offsetBytes);
+    }
+    return Load3x16BitIndices(indexBuffer, offsetBytes);
+}
+
 // Cosine weighted hemisphere sampling
 // From: http://intro-to-dxr.cwyman.org/
 float3 GetPerpendicularVector(float3 u)
@@ -150,9 +232,8 @@ inline float3 ShootIndirectRay(float3 origin, float3 direction, float tmin, floa
     ray.TMax = tmax;
 
     RayPayload pay;
-    pay.color = float4(0.0f, 0.0f, 0.0f, 1.0f);
-    pay.recursionDepth = depth + 1;
-    pay.seed = seed;
+    pay.radiance = 0;
+    pay.depthAndSeed = PackDepthAndSeed(depth + 1, seed);
 
     TraceRay(
         gRtScene,
@@ -165,7 +246,7 @@ inline float3 ShootIndirectRay(float3 origin, float3 direction, float tmin, floa
         pay
     );
 
-    return pay.color.xyz;
+    return UnpackRGB9E5(pay.radiance);
 }
 
 
@@ -178,21 +259,43 @@ inline float ShootShadowRay(float3 origin, float3 direction, float tmin, float t
     ray.TMin = tmin;
     ray.TMax = tmax;
 
+#if INLINE_VISIBILITY
+    // Traversed inline, no shader is scheduled for the ray. The triangles are opaque and committed by the traversal,
+    // the analytic spheres are handed back as candidates and intersected here. The first committed hit ends the search
+    RayQuery<RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER> query;
+    query.TraceRayInline(gRtScene, RAY_FLAG_NONE, 0xFF, ray);
+    while (query.Proceed())
+    {
+        if (query.CandidateType() == CANDIDATE_PROCEDURAL_PRIMITIVE)
+        {
+            float t = IntersectSphere(query.CandidateObjectRayOrigin(), query.CandidateObjectRayDirection(), float3(0, 0, 0), 1.0f, query.RayTMin(), query.CommittedRayT());
+            if (t >= 0.0f)
+            {
+                query.CommitProceduralPrimitiveHit(t);
+            }
+        }
+    }
+
+    return (query.CommittedStatus() == COMMITTED_NOTHING) ? 1.0f : 0.0f;
+#else
     ShadowPayload pay;
-    pay.hit = true;
+    pay.visible = 0;
 
+    // Shadow rays only need the miss shader to clear the payload, so the closest-hit is skipped and
+    // the hit records of the shader table are reused. The spheres still run their intersection shader
     TraceRay(
         gRtScene,
-        RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH,
+        RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
         0xFF,
-        4,
-        0,
-        1,
+        0, // hitgroup index
+        0, // geom multiplier
+        1, // miss index
         ray,
         pay
     );
 
-    return (pay.hit == false) ? 1.0f : 0.0f;
+    return float(pay.visible);
+#endif
 }
 
 #endif
@@ -16,6 +16,7 @@ float3 LambertianDirect(float3 position, float3 normal, float3 diffuse, inout ui
 
     float ao = 1.0f;
 
+#if SHADING_MODE == SHADING_MODE_AO
     if (aoSamples > 0)
     {
         float ambient_occlusion = 0.0f;
@@ -28,6 +29,7 @@ float3 LambertianDirect(float3 position, float3 normal, float3 diffuse, inout ui
 
         ao = ambient_occlusion / float(aoSamples);
     }
+#endif
 
     return ((NdotL * ray_color * (diffuse / 3.14f)) / sample_probability) * ao;
 }
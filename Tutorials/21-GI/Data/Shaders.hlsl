@@ -24,8 +24,8 @@ void rayGen()
     ray.TMax = 100000;
 
     RayPayload payload;
-	payload.recursionDepth = 0;
-	payload.seed = random_seed;
+	payload.radiance = 0;
+	payload.depthAndSeed = PackDepthAndSeed(0, random_seed);
 	TraceRay(gRtScene,
 		0 /*rayFlags*/,
 		0xFF,
@@ -36,14 +36,13 @@ void rayGen()
 		payload);
 
 	// The final output of each pixel.
-    gOutput[launchIndex.xy] = payload.color;
+    gOutput[launchIndex.xy] = float4(UnpackRGB9E5(payload.radiance), 1.0f);
 }
 
 [shader("miss")]
 void miss(inout RayPayload payload)
 {
-	payload.color = float4(backgroundColor, 1.0f);
-	//payload.color = float4(0,0,0, 1.0f);
+	payload.radiance = PackRGB9E5(backgroundColor);
 }
 
 float3 HitAttribute(float3 vertexAttribute[3], BuiltInTriangleIntersectionAttributes attr)
@@ -53,6 +52,48 @@ float3 HitAttribute(float3 vertexAttribute[3], BuiltInTriangleIntersectionAttrib
 		attr.barycentrics.y * (vertexAttribute[2] - vertexAttribute[0]);
 }
 
+// Shades a hit of either hit group and writes the radiance to the payload
+void ShadeHit(inout RayPayload payload, float3 hitPosition, float3 hitNormal, Material material)
+{
+	// The seed and depth are only unpacked once, the shading works on the locals
+	uint seed = UnpackSeed(payload.depthAndSeed);
+	uint recursionDepth = UnpackDepth(payload.depthAndSeed);
+
+	float3 matDiffuse = material.diffuse;
+	float3 matSpecular = material.specular;
+	float matRoughness = material.roughness;
+
+	float3 view_dir = normalize(cameraPosition - hitPosition);
+	
+	float3 color = float3(0, 0, 0);
+	 
+#if SHADING_MODE == SHADING_MODE_AO
+	// Lambertian with ao, direct lighting only
+	color = LambertianDirect(hitPosition, hitNormal, matDiffuse, seed);
+#else
+	// Direct lighting
+#if SHADING_MODE == SHADING_MODE_GGX_GI
+	color = ggxDirect(seed, hitPosition, lightPosition, lightIntensity, hitNormal, view_dir, matDiffuse, matSpecular, matRoughness);
+#else
+	color = LambertianDirect(hitPosition, hitNormal, matDiffuse, seed);
+#endif
+
+	// Indirect lighting. The depth is per-ray, it stays a runtime test
+	if (recursionDepth < MaxRecursionDepth)
+	{
+#if SHADING_MODE == SHADING_MODE_GGX_GI
+		color += ggxIndirect(seed, hitPosition, lightPosition, lightIntensity, hitNormal, view_dir, matDiffuse, matSpecular, matRoughness, recursionDepth);
+#else
+		color += LambertianIndirect(hitPosition, hitNormal, matDiffuse, seed, recursionDepth);
+#endif
+		recursionDepth++;
+	}
+#endif
+
+	// The callers only read the radiance back
+	payload.radiance = PackRGB9E5(color);
+}
+
 [shader("closesthit")]
 void chs(inout RayPayload payload, in BuiltInTriangleIntersectionAttributes attribs)
 {
@@ -61,68 +102,46 @@ void chs(inout RayPayload payload, in BuiltInTriangleIntersectionAttributes attr
 	//-----------------------
 	float3 hitPosition = HitWorldPosition();
 
-	// Get the base index of the triangle's first 16 bit index.
-	uint indexSizeInBytes = 2;
-	uint indicesPerTriangle = 3;
-	uint triangleIndexStride = indicesPerTriangle * indexSizeInBytes;
-	uint baseIndex = PrimitiveIndex() * triangleIndexStride;
-
-	// Load up 3 16 bit indices for the triangle.
-	const uint3 indices = Load3x16BitIndices(Indices, baseIndex);
+	// Fetch the instance's geometry and material from the bindless tables
+	InstanceData instance = gInstances[InstanceID()];
+	const uint3 indices = LoadTriangleIndices(instance, PrimitiveIndex());
 
 	// Retrieve corresponding vertex normals for the triangle vertices.
+	StructuredBuffer<PackedVertexAttributes> vertices = gVertexBuffers[NonUniformResourceIndex(instance.vertexBufferIndex)];
 	float3 vertexNormals[3] = {
-		Vertices[indices[0]].Normal,
-		Vertices[indices[1]].Normal,
-		Vertices[indices[2]].Normal
+		DecodeNormal(vertices[indices[0]]),
+		DecodeNormal(vertices[indices[1]]),
+		DecodeNormal(vertices[indices[2]])
 	};
-	float3 hitNormal = (InstanceID() == 0) ? float3(0, 1, 0) : HitAttribute(vertexNormals, attribs);
+	float3 hitNormal = normalize(mul((float3x3)ObjectToWorld3x4(), HitAttribute(vertexNormals, attribs)));
 
-	float3 view_dir = normalize(cameraPosition - hitPosition);
-	
-	float3 color = float3(0, 0, 0);
-	 
-	// Lambertian with ao
-	if(aoSamples>0)
-	{ 
-		color = LambertianDirect(hitPosition, hitNormal, matDiffuse, payload.seed);
-	}
-	else // full GI
+	ShadeHit(payload, hitPosition, hitNormal, gMaterials[instance.materialIndex]);
+}
+
+// The sphere instances place and scale a unit sphere at the origin of their procedural BLAS, whose single AABB bounds it.
+// The object-space ray isn't normalized, so the t of the hit is the same as along the world-space ray
+[shader("intersection")]
+void sphereIntersection()
+{
+	float t = IntersectSphere(ObjectRayOrigin(), ObjectRayDirection(), float3(0, 0, 0), 1.0f, RayTMin(), RayTCurrent());
+	if (t >= 0.0f)
 	{
-		// Direct lighting
-		if (ggxshadingMode)
-		{
-			color = ggxDirect(payload.seed, hitPosition, lightPosition, lightIntensity, hitNormal, view_dir, matDiffuse, matSpecular, matRoughness);
-		}
-		else {
-			color = LambertianDirect(hitPosition, hitNormal, matDiffuse, payload.seed);
-		}
-
-		// Indirect lighting
-		if (payload.recursionDepth < MaxRecursionDepth)
-		{
-			float3 indirect = float3(0, 0, 0);
-			// GGX
-			if (ggxshadingMode)
-			{
-				indirect = ggxIndirect(payload.seed, hitPosition, lightPosition, lightIntensity, hitNormal, view_dir, matDiffuse, matSpecular, matRoughness, payload.recursionDepth);
-			}
-			else {
-				// Lambertian
-				indirect = LambertianIndirect(hitPosition, hitNormal, matDiffuse, payload.seed, payload.recursionDepth);
-			}
-
-			color += indirect;
-			payload.recursionDepth++;
-		}
+		SphereAttributes attribs;
+		attribs.normal = SphereNormal(ObjectRayOrigin() + t * ObjectRayDirection(), float3(0, 0, 0), 1.0f);
+		ReportHit(t, 0, attribs);
 	}
-	
-	
-	payload.color = float4(color, 1.0f);
+}
+
+[shader("closesthit")]
+void chsSphere(inout RayPayload payload, in SphereAttributes attribs)
+{
+	// The exact normal of the sphere, there are no facets to interpolate across. The instance only has a material
+	float3 hitNormal = normalize(mul((float3x3)ObjectToWorld3x4(), attribs.normal));
+	ShadeHit(payload, HitWorldPosition(), hitNormal, gMaterials[gInstances[InstanceID()].materialIndex]);
 }
 
 [shader("miss")]
 void shadowMiss(inout ShadowPayload payload)
 {
-	payload.hit = false;
+	payload.visible = 1;
 }
\ No newline at end of file
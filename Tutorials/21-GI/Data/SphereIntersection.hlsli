@@ -0,0 +1,80 @@
+/*
+ * ----------------------------------------
+ * SPHERE INTERSECTION
+ * ----------------------------------------
+ * Analytic ray/sphere intersection of the procedural spheres, shared by the intersection shader, the inline visibility
+ * rays and the application (Primitives/SphereIntersection.hpp).
+ * Only the common subset of HLSL and C++ is used below, the C++ side maps the few intrinsics it needs to glm.
+ */
+#ifndef __SPHERE_INTERSECTION_HLSLI__
+#define __SPHERE_INTERSECTION_HLSLI__
+
+#ifdef __cplusplus
+#include <cmath>
+#include <Externals/GLM/glm/glm.hpp>
+
+namespace Primitives
+{
+namespace SphereIntersection
+{
+	using float3 = glm::vec3;
+	using std::sqrt;
+	using glm::dot;
+#endif
+
+// Reported by the intersection shader, 12 bytes. The shader config's attribute size covers it
+struct SphereAttributes
+{
+    float3 normal;  // Object space, unit length
+};
+
+// Returned when the ray misses, the ray interval never starts below 0
+static const float kSphereMiss = -1.0f;
+
+// Distance along the ray to the nearest hit in [tMin, tMax], kSphereMiss otherwise. The direction doesn't have to be
+// normalized, an object-space ray keeps the t of the world-space one. A ray starting inside the sphere hits its far side.
+// The discriminant comes from the distance between the center and the ray's closest point, and the near root from the
+// product of the roots, which avoids the cancellations of the textbook formula for distant and grazing rays.
+// See "Precision Improvements for Ray/Sphere Intersection", Ray Tracing Gems, chapter 7
+inline float IntersectSphere(float3 origin, float3 direction, float3 center, float radius, float tMin, float tMax)
+{
+    float3 f = origin - center;
+    float a = dot(direction, direction);
+    float b = -dot(f, direction);
+    float3 l = f + (b / a) * direction;
+    float discriminant = a * (radius * radius - dot(l, l));
+    if (discriminant < 0.0f)
+    {
+        return kSphereMiss;
+    }
+
+    // q is only 0 for a ray grazing the sphere at its origin, both roots are the origin then
+    float c = dot(f, f) - radius * radius;
+    float q = b + ((b >= 0.0f) ? sqrt(discriminant) : -sqrt(discriminant));
+    float t0 = (q != 0.0f) ? c / q : 0.0f;
+    float t1 = q / a;
+    float tNear = (t0 < t1) ? t0 : t1;
+    float tFar = (t0 < t1) ? t1 : t0;
+    if (tNear >= tMin && tNear <= tMax)
+    {
+        return tNear;
+    }
+    if (tFar >= tMin && tFar <= tMax)
+    {
+        return tFar;
+    }
+    return kSphereMiss;
+}
+
+// Outward normal at a point of the sphere
+inline float3 SphereNormal(float3 position, float3 center, float radius)
+{
+    return (position - center) / radius;
+}
+
+#ifdef __cplusplus
+};
+};
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * ----------------------------------------
+ * VERTEX PACKING
+ * ----------------------------------------
+ * Compressed vertex attributes, shared by the shaders and by the application (Primitives/PackedVertex.hpp).
+ * Positions live in their own float3 stream which is only read by the BLAS build. The hit shaders read the
+ * 12 byte attribute stream: octahedral normal and tangent as two snorm16 each, texcoord as two halves.
+ * Only the common subset of HLSL and C++ is used below, the C++ side maps the few intrinsics it needs to glm.
+ */
+#ifndef __VERTEX_PACKING_HLSLI__
+#define __VERTEX_PACKING_HLSLI__
+
+#ifdef __cplusplus
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <Externals/GLM/glm/glm.hpp>
+#include <Externals/GLM/glm/gtc/packing.hpp>
+
+namespace Primitives
+{
+namespace VertexPacking
+{
+	using uint = uint32_t;
+	using float2 = glm::vec2;
+	using float3 = glm::vec3;
+	using std::abs;
+	using std::max;
+	using glm::normalize;
+
+	inline float f16tof32(uint value)
+	{
+		return glm::unpackHalf1x16(static_cast<uint16_t>(value & 0xFFFF));
+	}
+#endif
+
+struct PackedVertexAttributes
+{
+    uint normal;    // Octahedral, x in the low and y in the high snorm16
+    uint tangent;   // Octahedral, x in the low and y in the high snorm16
+    uint texcoord;  // Two halves, u in the low bits
+};
+
+// Two sign-extended snorm16, -32768 maps to -1 like -32767
+inline float2 UnpackSnorm16x2(uint packed)
+{
+    float x = float(int(packed << 16) >> 16) / 32767.0f;
+    float y = float(int(packed) >> 16) / 32767.0f;
+    return float2(max(x, -1.0f), max(y, -1.0f));
+}
+
+// Octahedral mapping of the unit sphere onto [-1, 1]^2, the lower hemisphere is folded over the diagonals.
+// See "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al. 2014
+inline float3 DecodeOctahedral(uint packed)
+{
+    float2 e = UnpackSnorm16x2(packed);
+    float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.x += (n.x >= 0.0f) ? -t : t;
+    n.y += (n.y >= 0.0f) ? -t : t;
+    return normalize(n);
+}
+
+inline float3 DecodeNormal(PackedVertexAttributes attributes)
+{
+    return DecodeOctahedral(attributes.normal);
+}
+
+inline float3 DecodeTangent(PackedVertexAttributes attributes)
+{
+    return DecodeOctahedral(attributes.tangent);
+}
+
+inline float2 DecodeTexCoord(PackedVertexAttributes attributes)
+{
+    return float2(f16tof32(attributes.texcoord), f16tof32(attributes.texcoord >> 16));
+}
+
+#ifdef __cplusplus
+};
+};
+#endif
+
+#endif
@@ -1,6 +1,6 @@
 #pragma once
 #include <vector>
-#include "Vertex.hpp"
+#include "MeshView.hpp"
 
 namespace Primitives
 {
@@ -12,8 +12,15 @@ namespace Primitives
 
 		void Init(float size, bool uvHorizontalFlip = false, bool uvVerticalFlip = false, float uTileFactor = 1, float vTileFactor = 1);
 		void Transform(glm::mat4 transform);
-		std::vector <Vertex> GetVertices();
-		std::vector <uint16_t> GetIndices();
+
+		// Views into the primitive's storage, no copy is made
+		ArrayView<Vertex> GetVertices() const { return mVertices; }
+		ArrayView<uint16_t> GetIndices() const { return mIndices; }
+		MeshView GetView() const { return { mVertices, mIndices }; }
+
+		// Moves the storage out, the primitive is empty afterwards
+		std::vector<Vertex> TakeVertices() { return std::move(mVertices); }
+		std::vector<uint16_t> TakeIndices() { return std::move(mIndices); }
 	
 	private:
 		void CalculateTangentSpace();
@@ -0,0 +1,1232 @@
+#pragma once
+#include "MeshImporter.hpp"
+#include "TangentSpace.hpp"
+#include "../RTX/MappedFile.hpp"
+#include "../RTX/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+using CppDirectXRayTracing21::ParallelFor;
+using CppDirectXRayTracing21::ThreadPool;
+
+namespace
+{
+    const uint32_t kInvalid = UINT32_MAX;
+
+    // The file is cut into a few chunks per worker, small files stay in one chunk
+    const size_t kMinChunkSize = 256 * 1024;
+
+    // The merge of the chunks' vertices runs one task per shard, picked by the top bits of the key hash
+    const uint32_t kShardBits = 6;
+    const uint32_t kShardCount = 1u << kShardBits;
+
+    //
+    // OBJ text
+    //
+
+    enum class ObjLine
+    {
+        Other,
+        Position,
+        Texcoord,
+        Normal,
+        Face
+    };
+
+    bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    bool IsDigit(char c)
+    {
+        return uint8_t(c - '0') < 10;
+    }
+
+    const char* SkipBlanks(const char* p, const char* pEnd)
+    {
+        while (p < pEnd && IsBlank(*p))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    // pLine points past the leading blanks, the keyword is skipped when the line is recognized
+    ObjLine ClassifyLine(const char*& pLine, const char* pLineEnd)
+    {
+        size_t length = pLineEnd - pLine;
+        if (length >= 2 && pLine[0] == 'v')
+        {
+            if (IsBlank(pLine[1]))
+            {
+                pLine += 1;
+                return ObjLine::Position;
+            }
+            if (length >= 3 && IsBlank(pLine[2]))
+            {
+                pLine += 2;
+                return (pLine[-1] == 't') ? ObjLine::Texcoord : (pLine[-1] == 'n') ? ObjLine::Normal : ObjLine::Other;
+            }
+        }
+        else if (length >= 2 && pLine[0] == 'f' && IsBlank(pLine[1]))
+        {
+            pLine += 1;
+            return ObjLine::Face;
+        }
+        return ObjLine::Other;
+    }
+
+    template<typename F>
+    void ForEachLine(const char* pBegin, const char* pEnd, F&& f)
+    {
+        for (const char* p = pBegin; p < pEnd;)
+        {
+            const char* pLineEnd = static_cast<const char*>(memchr(p, '\n', pEnd - p));
+            pLineEnd = pLineEnd ? pLineEnd : pEnd;
+            f(p, pLineEnd);
+            p = pLineEnd + 1;
+        }
+    }
+
+    const double kPow10[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // Decimal to float without the locale lookups of strtof. The significand keeps 19 digits and is scaled by an exact
+    // power of ten in double, the result is within an ulp of strtof for anything an exporter writes.
+    // nullptr if there is no number or it runs into other characters.
+    const char* ParseFloat(const char* p, const char* pEnd, float& value)
+    {
+        p = SkipBlanks(p, pEnd);
+        bool negative = false;
+        if (p < pEnd && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            p++;
+        }
+
+        uint64_t significand = 0;
+        int digitCount = 0;
+        int exponent = 0;
+        bool anyDigit = false;
+        for (; p < pEnd && IsDigit(*p); p++)
+        {
+            if (digitCount < 19)
+            {
+                significand = significand * 10 + uint64_t(*p - '0');
+                digitCount += (significand != 0) ? 1 : 0;
+            }
+            else
+            {
+                exponent++;
+            }
+            anyDigit = true;
+        }
+        if (p < pEnd && *p == '.')
+        {
+            for (p++; p < pEnd && IsDigit(*p); p++)
+            {
+                if (digitCount < 19)
+                {
+                    significand = significand * 10 + uint64_t(*p - '0');
+                    digitCount += (significand != 0) ? 1 : 0;
+                    exponent--;
+                }
+                anyDigit = true;
+            }
+        }
+        if (anyDigit == false)
+        {
+            return nullptr;
+        }
+
+        if (p < pEnd && (*p == 'e' || *p == 'E'))
+        {
+            const char* pExponent = p + 1;
+            bool negativeExponent = false;
+            if (pExponent < pEnd && (*pExponent == '-' || *pExponent == '+'))
+            {
+                negativeExponent = (*pExponent == '-');
+                pExponent++;
+            }
+            int exponentValue = 0;
+            bool anyExponentDigit = false;
+            for (; pExponent < pEnd && IsDigit(*pExponent); pExponent++)
+            {
+                exponentValue = std::min(exponentValue * 10 + (*pExponent - '0'), 100000);
+                anyExponentDigit = true;
+            }
+            if (anyExponentDigit)
+            {
+                exponent += negativeExponent ? -exponentValue : exponentValue;
+                p = pExponent;
+            }
+        }
+        if (p < pEnd && IsBlank(*p) == false)
+        {
+            return nullptr;
+        }
+
+        double result = double(significand);
+        if (significand == 0)
+        {
+            result = 0.0;
+        }
+        else if (exponent >= 0 && exponent <= 22)
+        {
+            result *= kPow10[exponent];
+        }
+        else if (exponent < 0 && exponent >= -22)
+        {
+            result /= kPow10[-exponent];
+        }
+        else
+        {
+            result *= std::pow(10.0, double(exponent));
+        }
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    const char* ParseIndex(const char* p, const char* pEnd, int64_t& value)
+    {
+        bool negative = false;
+        if (p < pEnd && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            p++;
+        }
+        if (p == pEnd || IsDigit(*p) == false)
+        {
+            return nullptr;
+        }
+
+        value = 0;
+        for (; p < pEnd && IsDigit(*p); p++)
+        {
+            value = std::min<int64_t>(value * 10 + (*p - '0'), int64_t(1) << 40);
+        }
+        value = negative ? -value : value;
+        return p;
+    }
+
+    // OBJ indices are 1-based, negative ones count back from the last element defined before the face
+    bool ResolveIndex(int64_t index, uint32_t definedCount, uint32_t totalCount, uint32_t& result)
+    {
+        int64_t resolved = (index > 0) ? index - 1 : int64_t(definedCount) + index;
+        if (index == 0 || resolved < 0 || resolved >= int64_t(totalCount))
+        {
+            return false;
+        }
+        result = static_cast<uint32_t>(resolved);
+        return true;
+    }
+
+    struct VertexKey
+    {
+        uint32_t position;
+        uint32_t texcoord; // kInvalid when the face gives none
+        uint32_t normal;   // kInvalid when the face gives none
+
+        bool operator==(const VertexKey& other) const
+        {
+            return position == other.position && texcoord == other.texcoord && normal == other.normal;
+        }
+    };
+
+    uint32_t HashKey(const VertexKey& key)
+    {
+        uint64_t hash = (key.position * 0x9E3779B185EBCA87ull) ^ (key.texcoord * 0xC2B2AE3D27D4EB4Full) ^ (key.normal * 0x165667B19E3779F9ull);
+        hash ^= hash >> 29;
+        hash *= 0x9E3779B185EBCA87ull;
+        return static_cast<uint32_t>(hash >> 32);
+    }
+
+    // Open addressing with linear probing, from a key to a value that is never kInvalid.
+    // The slot is picked by the low bits of the hash, the shards by the high ones.
+    class VertexKeyMap
+    {
+    public:
+        explicit VertexKeyMap(size_t expectedCount)
+        {
+            size_t capacity = 64;
+            while (capacity < expectedCount * 2)
+            {
+                capacity *= 2;
+            }
+            mSlots.assign(capacity, Slot{ {}, kInvalid });
+        }
+
+        // The value already stored for the key, or the given one after storing it
+        uint32_t Insert(const VertexKey& key, uint32_t hash, uint32_t value)
+        {
+            if ((mCount + 1) * 2 > mSlots.size())
+            {
+                Grow();
+            }
+
+            size_t mask = mSlots.size() - 1;
+            for (size_t i = hash & mask;; i = (i + 1) & mask)
+            {
+                if (mSlots[i].value == kInvalid)
+                {
+                    mSlots[i] = { key, value };
+                    mCount++;
+                    return value;
+                }
+                if (mSlots[i].key == key)
+                {
+                    return mSlots[i].value;
+                }
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            VertexKey key;
+            uint32_t value;
+        };
+
+        void Grow()
+        {
+            std::vector<Slot> slots(mSlots.size() * 2, Slot{ {}, kInvalid });
+            size_t mask = slots.size() - 1;
+            for (const Slot& slot : mSlots)
+            {
+                if (slot.value != kInvalid)
+                {
+                    size_t i = HashKey(slot.key) & mask;
+                    while (slots[i].value != kInvalid)
+                    {
+                        i = (i + 1) & mask;
+                    }
+                    slots[i] = slot;
+                }
+            }
+            mSlots.swap(slots);
+        }
+
+        std::vector<Slot> mSlots;
+        size_t mCount = 0;
+    };
+
+    struct ObjChunk
+    {
+        const char* pBegin = nullptr;
+        const char* pEnd = nullptr;
+
+        // Counted by the first pass, the prefix sums turn them into the absolute numbers of the chunk's first elements
+        uint32_t positionCount = 0;
+        uint32_t texcoordCount = 0;
+        uint32_t normalCount = 0;
+        uint32_t lineCount = 0;
+        uint32_t firstPosition = 0;
+        uint32_t firstTexcoord = 0;
+        uint32_t firstNormal = 0;
+        uint32_t firstLine = 0;
+
+        // Filled by the parse. The keys are unique within the chunk and in the order of their first use.
+        std::vector<VertexKey> keys;
+        std::vector<uint32_t> hashes;
+        std::vector<uint32_t> corners;      // Chunk key of every triangle corner
+        std::vector<uint32_t> shardKeys;    // The chunk keys grouped by shard, in order within a shard
+        uint32_t shardStarts[kShardCount + 1] = {};
+        std::string error;
+
+        // Offsets into the global key, triangle and vertex numbering
+        uint32_t firstKey = 0;
+        uint32_t firstTriangle = 0;
+        uint32_t ownerCount = 0;
+        uint32_t firstVertex = 0;
+    };
+
+    std::vector<ObjChunk> SplitLines(const char* pData, size_t size, ThreadPool* pPool)
+    {
+        uint32_t threadCount = pPool ? pPool->GetThreadCount() : 1;
+        size_t chunkSize = std::max(kMinChunkSize, size / (size_t(threadCount) * 4));
+
+        std::vector<ObjChunk> chunks;
+        const char* pEnd = pData + size;
+        for (const char* p = pData; p < pEnd;)
+        {
+            const char* pChunkEnd = pEnd;
+            if (size_t(pEnd - p) > chunkSize)
+            {
+                const char* pNewLine = static_cast<const char*>(memchr(p + chunkSize, '\n', pEnd - (p + chunkSize)));
+                pChunkEnd = pNewLine ? pNewLine + 1 : pEnd;
+            }
+            chunks.emplace_back();
+            chunks.back().pBegin = p;
+            chunks.back().pEnd = pChunkEnd;
+            p = pChunkEnd;
+        }
+        return chunks;
+    }
+
+    void CountObjChunk(ObjChunk& chunk)
+    {
+        ForEachLine(chunk.pBegin, chunk.pEnd, [&](const char* pLine, const char* pLineEnd)
+        {
+            pLine = SkipBlanks(pLine, pLineEnd);
+            switch (ClassifyLine(pLine, pLineEnd))
+            {
+            case ObjLine::Position: chunk.positionCount++; break;
+            case ObjLine::Texcoord: chunk.texcoordCount++; break;
+            case ObjLine::Normal: chunk.normalCount++; break;
+            default: break;
+            }
+            chunk.lineCount++;
+        });
+    }
+
+    struct ObjAttributes
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texcoords;
+        std::vector<glm::vec3> normals;
+    };
+
+    // Stores the chunk's attributes at their absolute positions and builds its keys and triangles
+    void ParseObjChunk(ObjChunk& chunk, ObjAttributes& attributes)
+    {
+        uint32_t positionCount = chunk.firstPosition;
+        uint32_t texcoordCount = chunk.firstTexcoord;
+        uint32_t normalCount = chunk.firstNormal;
+        uint32_t totalPositions = static_cast<uint32_t>(attributes.positions.size());
+        uint32_t totalTexcoords = static_cast<uint32_t>(attributes.texcoords.size());
+        uint32_t totalNormals = static_cast<uint32_t>(attributes.normals.size());
+
+        // Exported meshes take over 100 bytes of text per unique vertex, the map grows when that's too few
+        VertexKeyMap map((chunk.pEnd - chunk.pBegin) / 128);
+        std::vector<uint32_t> polygon;
+        uint32_t line = chunk.firstLine;
+
+        ForEachLine(chunk.pBegin, chunk.pEnd, [&](const char* pLine, const char* pLineEnd)
+        {
+            line++;
+            if (chunk.error.empty() == false)
+            {
+                return;
+            }
+
+            auto fail = [&](const char* pMessage) { chunk.error = "line " + std::to_string(line) + ": " + pMessage; };
+            const char* p = SkipBlanks(pLine, pLineEnd);
+            ObjLine type = ClassifyLine(p, pLineEnd);
+            switch (type)
+            {
+            case ObjLine::Position:
+            case ObjLine::Normal:
+            {
+                // A 4th position component, or the vertex colors some exporters append, are ignored
+                glm::vec3 value;
+                if ((p = ParseFloat(p, pLineEnd, value.x)) == nullptr || (p = ParseFloat(p, pLineEnd, value.y)) == nullptr || ParseFloat(p, pLineEnd, value.z) == nullptr)
+                {
+                    return fail("expected 3 numbers");
+                }
+                if (type == ObjLine::Normal)
+                {
+                    attributes.normals[normalCount++] = value;
+                }
+                else
+                {
+                    attributes.positions[positionCount++] = value;
+                }
+                break;
+            }
+            case ObjLine::Texcoord:
+            {
+                glm::vec2 value(0.0f);
+                if ((p = ParseFloat(p, pLineEnd, value.x)) == nullptr)
+                {
+                    return fail("expected a texture coordinate");
+                }
+                p = SkipBlanks(p, pLineEnd);
+                if (p < pLineEnd && *p != '#' && ParseFloat(p, pLineEnd, value.y) == nullptr)
+                {
+                    return fail("expected a texture coordinate");
+                }
+                attributes.texcoords[texcoordCount++] = glm::vec2(value.x, 1.0f - value.y);
+                break;
+            }
+            case ObjLine::Face:
+            {
+                polygon.clear();
+                for (p = SkipBlanks(p, pLineEnd); p < pLineEnd && *p != '#'; p = SkipBlanks(p, pLineEnd))
+                {
+                    int64_t index;
+                    VertexKey key = { 0, kInvalid, kInvalid };
+                    if ((p = ParseIndex(p, pLineEnd, index)) == nullptr || ResolveIndex(index, positionCount, totalPositions, key.position) == false)
+                    {
+                        return fail("invalid position index");
+                    }
+                    if (p < pLineEnd && *p == '/')
+                    {
+                        p++;
+                        if (p < pLineEnd && *p != '/')
+                        {
+                            if ((p = ParseIndex(p, pLineEnd, index)) == nullptr || ResolveIndex(index, texcoordCount, totalTexcoords, key.texcoord) == false)
+                            {
+                                return fail("invalid texture coordinate index");
+                            }
+                        }
+                        if (p < pLineEnd && *p == '/')
+                        {
+                            p++;
+                            if ((p = ParseIndex(p, pLineEnd, index)) == nullptr || ResolveIndex(index, normalCount, totalNormals, key.normal) == false)
+                            {
+                                return fail("invalid normal index");
+                            }
+                        }
+                    }
+                    if (p < pLineEnd && IsBlank(*p) == false)
+                    {
+                        return fail("unexpected character in a face");
+                    }
+
+                    uint32_t hash = HashKey(key);
+                    uint32_t local = map.Insert(key, hash, static_cast<uint32_t>(chunk.keys.size()));
+                    if (local == chunk.keys.size())
+                    {
+                        chunk.keys.push_back(key);
+                        chunk.hashes.push_back(hash);
+                    }
+                    polygon.push_back(local);
+                }
+
+                if (polygon.size() < 3)
+                {
+                    return fail("a face needs at least 3 vertices");
+                }
+                for (size_t i = 2; i < polygon.size(); i++)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        });
+
+        // Counting sort of the keys by shard, stable so every shard sees the keys in file order
+        uint32_t counts[kShardCount + 1] = {};
+        for (uint32_t hash : chunk.hashes)
+        {
+            counts[(hash >> (32 - kShardBits)) + 1]++;
+        }
+        for (uint32_t shard = 0; shard < kShardCount; shard++)
+        {
+            counts[shard + 1] += counts[shard];
+        }
+        std::copy(counts, counts + kShardCount + 1, chunk.shardStarts);
+
+        chunk.shardKeys.resize(chunk.keys.size());
+        for (uint32_t key = 0; key < chunk.keys.size(); key++)
+        {
+            chunk.shardKeys[counts[chunk.hashes[key] >> (32 - kShardBits)]++] = key;
+        }
+    }
+
+    //
+    // Binary PLY
+    //
+
+    enum class PlyType
+    {
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Float32,
+        Float64
+    };
+
+    bool ParsePlyType(const std::string& name, PlyType& type)
+    {
+        static const std::pair<const char*, PlyType> kTypes[] =
+        {
+            { "char", PlyType::Int8 }, { "int8", PlyType::Int8 },
+            { "uchar", PlyType::UInt8 }, { "uint8", PlyType::UInt8 },
+            { "short", PlyType::Int16 }, { "int16", PlyType::Int16 },
+            { "ushort", PlyType::UInt16 }, { "uint16", PlyType::UInt16 },
+            { "int", PlyType::Int32 }, { "int32", PlyType::Int32 },
+            { "uint", PlyType::UInt32 }, { "uint32", PlyType::UInt32 },
+            { "float", PlyType::Float32 }, { "float32", PlyType::Float32 },
+            { "double", PlyType::Float64 }, { "float64", PlyType::Float64 }
+        };
+
+        for (const auto& entry : kTypes)
+        {
+            if (name == entry.first)
+            {
+                type = entry.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t GetPlyTypeSize(PlyType type)
+    {
+        switch (type)
+        {
+        case PlyType::Int8:
+        case PlyType::UInt8: return 1;
+        case PlyType::Int16:
+        case PlyType::UInt16: return 2;
+        case PlyType::Float64: return 8;
+        default: return 4;
+        }
+    }
+
+    template<typename T>
+    T LoadPlyScalar(const uint8_t* p, bool swap)
+    {
+        uint8_t bytes[sizeof(T)];
+        memcpy(bytes, p, sizeof(T));
+        if (swap)
+        {
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        T value;
+        memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    double ReadPlyValue(const uint8_t* p, PlyType type, bool swap)
+    {
+        switch (type)
+        {
+        case PlyType::Int8: return double(int8_t(*p));
+        case PlyType::UInt8: return double(*p);
+        case PlyType::Int16: return double(LoadPlyScalar<int16_t>(p, swap));
+        case PlyType::UInt16: return double(LoadPlyScalar<uint16_t>(p, swap));
+        case PlyType::Int32: return double(LoadPlyScalar<int32_t>(p, swap));
+        case PlyType::UInt32: return double(LoadPlyScalar<uint32_t>(p, swap));
+        case PlyType::Float32: return double(LoadPlyScalar<float>(p, swap));
+        default: return LoadPlyScalar<double>(p, swap);
+        }
+    }
+
+    // Negative and fractional values come back as kInvalid
+    uint32_t ReadPlyIndex(const uint8_t* p, PlyType type, bool swap)
+    {
+        switch (type)
+        {
+        case PlyType::UInt8: return *p;
+        case PlyType::UInt16: return LoadPlyScalar<uint16_t>(p, swap);
+        case PlyType::UInt32: return LoadPlyScalar<uint32_t>(p, swap);
+        case PlyType::Int8:
+        case PlyType::Int16:
+        case PlyType::Int32:
+        {
+            double value = ReadPlyValue(p, type, swap);
+            return (value >= 0.0) ? uint32_t(value) : kInvalid;
+        }
+        default:
+        {
+            double value = ReadPlyValue(p, type, swap);
+            return (value >= 0.0 && value < double(kInvalid) && value == std::floor(value)) ? uint32_t(value) : kInvalid;
+        }
+        }
+    }
+
+    struct PlyProperty
+    {
+        std::string name;
+        PlyType type = PlyType::Float32;
+        bool isList = false;
+        PlyType countType = PlyType::UInt8;
+        uint32_t offset = 0; // In the element, valid up to the first list
+    };
+
+    struct PlyElement
+    {
+        std::string name;
+        uint64_t count = 0;
+        std::vector<PlyProperty> properties;
+        uint32_t stride = 0; // Valid when there are no lists
+        bool hasLists = false;
+
+        const PlyProperty* Find(std::initializer_list<const char*> names) const
+        {
+            for (const char* pName : names)
+            {
+                for (const PlyProperty& property : properties)
+                {
+                    if (property.name == pName && property.isList == false)
+                    {
+                        return &property;
+                    }
+                }
+            }
+            return nullptr;
+        }
+    };
+}
+
+bool Primitives::MeshImporter::Fail(const std::string& error)
+{
+    mError = error;
+    mVertices.clear();
+    mIndices.clear();
+    mIndices32.clear();
+    mIndexFormat = IndexFormat::UInt16;
+    return false;
+}
+
+bool Primitives::MeshImporter::Load(const fs::path& path, ThreadPool* pPool)
+{
+    mVertices.clear();
+    mIndices.clear();
+    mIndices32.clear();
+    mIndexFormat = IndexFormat::UInt16;
+    mError.clear();
+
+    CppDirectXRayTracing21::MappedFile file;
+    if (file.Open(path) == false)
+    {
+        return Fail("can't map " + path.string());
+    }
+
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(std::tolower(uint8_t(c))); });
+
+    bool loaded = false;
+    if (extension == ".obj")
+    {
+        loaded = LoadObj(reinterpret_cast<const char*>(file.GetData()), static_cast<size_t>(file.GetSize()), pPool);
+    }
+    else if (extension == ".ply")
+    {
+        loaded = LoadPly(file.GetData(), static_cast<size_t>(file.GetSize()), pPool);
+    }
+    else
+    {
+        return Fail("unknown mesh format " + extension);
+    }
+
+    if (loaded == false)
+    {
+        return false;
+    }
+    if (mIndices32.empty())
+    {
+        return Fail("no faces");
+    }
+    Finish(pPool);
+    return true;
+}
+
+bool Primitives::MeshImporter::LoadObj(const char* pData, size_t size, ThreadPool* pPool)
+{
+    std::vector<ObjChunk> chunks = SplitLines(pData, size, pPool);
+
+    // Count the attributes of every chunk first, so the parse can resolve relative indices and store in place
+    ParallelFor(pPool, chunks.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            CountObjChunk(chunks[i]);
+        }
+    });
+
+    uint64_t positionCount = 0;
+    uint64_t texcoordCount = 0;
+    uint64_t normalCount = 0;
+    uint64_t lineCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.firstPosition = static_cast<uint32_t>(positionCount);
+        chunk.firstTexcoord = static_cast<uint32_t>(texcoordCount);
+        chunk.firstNormal = static_cast<uint32_t>(normalCount);
+        chunk.firstLine = static_cast<uint32_t>(std::min<uint64_t>(lineCount, UINT32_MAX));
+        positionCount += chunk.positionCount;
+        texcoordCount += chunk.texcoordCount;
+        normalCount += chunk.normalCount;
+        lineCount += chunk.lineCount;
+    }
+    if (std::max({ positionCount, texcoordCount, normalCount }) >= kInvalid)
+    {
+        return Fail("too many vertices");
+    }
+
+    ObjAttributes attributes;
+    attributes.positions.resize(static_cast<size_t>(positionCount));
+    attributes.texcoords.resize(static_cast<size_t>(texcoordCount));
+    attributes.normals.resize(static_cast<size_t>(normalCount));
+
+    ParallelFor(pPool, chunks.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            ParseObjChunk(chunks[i], attributes);
+        }
+    });
+
+    uint64_t keyCount = 0;
+    uint64_t triangleCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        if (chunk.error.empty() == false)
+        {
+            return Fail(chunk.error);
+        }
+        chunk.firstKey = static_cast<uint32_t>(keyCount);
+        chunk.firstTriangle = static_cast<uint32_t>(triangleCount);
+        keyCount += chunk.keys.size();
+        triangleCount += chunk.corners.size() / 3;
+    }
+    if (keyCount >= kInvalid || triangleCount * 3 >= kInvalid)
+    {
+        return Fail("too many vertices");
+    }
+
+    // The owner of a key is its first occurrence in the file. Keys are only unique within their chunk, the shards
+    // merge them across chunks and visit the chunks in file order, so the owner doesn't depend on the scheduling.
+    std::vector<uint32_t> owners(static_cast<size_t>(keyCount));
+    if (chunks.size() == 1)
+    {
+        for (uint32_t key = 0; key < keyCount; key++)
+        {
+            owners[key] = key;
+        }
+    }
+    else
+    {
+        ParallelFor(pPool, kShardCount, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t shard = begin; shard < end; shard++)
+            {
+                VertexKeyMap map(static_cast<size_t>(keyCount / kShardCount));
+                for (const ObjChunk& chunk : chunks)
+                {
+                    for (uint32_t i = chunk.shardStarts[shard]; i < chunk.shardStarts[shard + 1]; i++)
+                    {
+                        uint32_t key = chunk.shardKeys[i];
+                        owners[chunk.firstKey + key] = map.Insert(chunk.keys[key], chunk.hashes[key], chunk.firstKey + key);
+                    }
+                }
+            }
+        });
+    }
+
+    ParallelFor(pPool, chunks.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            ObjChunk& chunk = chunks[i];
+            for (uint32_t key = chunk.firstKey; key < chunk.firstKey + chunk.keys.size(); key++)
+            {
+                chunk.ownerCount += (owners[key] == key) ? 1 : 0;
+            }
+        }
+    });
+
+    uint32_t vertexCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.firstVertex = vertexCount;
+        vertexCount += chunk.ownerCount;
+    }
+
+    // The owners become the vertices, numbered in file order
+    std::vector<uint32_t> vertexIds(static_cast<size_t>(keyCount));
+    mVertices.resize(vertexCount);
+    ParallelFor(pPool, chunks.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const ObjChunk& chunk = chunks[i];
+            uint32_t vertex = chunk.firstVertex;
+            for (uint32_t key = 0; key < chunk.keys.size(); key++)
+            {
+                uint32_t globalKey = chunk.firstKey + key;
+                if (owners[globalKey] != globalKey)
+                {
+                    continue;
+                }
+
+                const VertexKey& vertexKey = chunk.keys[key];
+                Vertex& v = mVertices[vertex];
+                v.position = attributes.positions[vertexKey.position];
+                v.normal = (vertexKey.normal != kInvalid) ? attributes.normals[vertexKey.normal] : glm::vec3(0.0f);
+                v.tangent = glm::vec3(0.0f);
+                v.texcoord = (vertexKey.texcoord != kInvalid) ? attributes.texcoords[vertexKey.texcoord] : glm::vec2(0.0f);
+                vertexIds[globalKey] = vertex++;
+            }
+        }
+    });
+
+    // Every other key takes its owner's vertex, which is numbered by now whichever chunk it is in
+    mIndices32.resize(static_cast<size_t>(triangleCount * 3));
+    ParallelFor(pPool, chunks.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            ObjChunk& chunk = chunks[i];
+            for (uint32_t key = chunk.firstKey; key < chunk.firstKey + chunk.keys.size(); key++)
+            {
+                if (owners[key] != key)
+                {
+                    vertexIds[key] = vertexIds[owners[key]];
+                }
+            }
+
+            uint32_t* pIndices = mIndices32.data() + size_t(chunk.firstTriangle) * 3;
+            for (size_t corner = 0; corner < chunk.corners.size(); corner++)
+            {
+                pIndices[corner] = vertexIds[chunk.firstKey + chunk.corners[corner]];
+            }
+            chunk = ObjChunk();
+        }
+    });
+    return true;
+}
+
+bool Primitives::MeshImporter::LoadPly(const uint8_t* pData, size_t size, ThreadPool* pPool)
+{
+    // The header is text up to and including the end_header line
+    const char* pText = reinterpret_cast<const char*>(pData);
+    static const char kEndHeader[] = "end_header";
+    const char* pHeaderEnd = std::search(pText, pText + size, kEndHeader, kEndHeader + sizeof(kEndHeader) - 1);
+    const char* pDataStart = (pHeaderEnd != pText + size) ? static_cast<const char*>(memchr(pHeaderEnd, '\n', pText + size - pHeaderEnd)) : nullptr;
+    if (size < 4 || memcmp(pText, "ply", 3) != 0 || pDataStart == nullptr)
+    {
+        return Fail("not a PLY file");
+    }
+    pDataStart++;
+
+    std::istringstream header(std::string(pText, pHeaderEnd));
+    std::vector<PlyElement> elements;
+    bool littleEndian = true;
+    std::string line;
+    std::getline(header, line);
+    while (std::getline(header, line))
+    {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "format")
+        {
+            std::string format;
+            tokens >> format;
+            if (format == "ascii")
+            {
+                return Fail("ASCII PLY isn't supported, only binary");
+            }
+            if (format != "binary_little_endian" && format != "binary_big_endian")
+            {
+                return Fail("unknown PLY format " + format);
+            }
+            littleEndian = (format == "binary_little_endian");
+        }
+        else if (keyword == "element")
+        {
+            elements.emplace_back();
+            if ((tokens >> elements.back().name >> elements.back().count).fail())
+            {
+                return Fail("invalid element: " + line);
+            }
+        }
+        else if (keyword == "property")
+        {
+            if (elements.empty())
+            {
+                return Fail("property outside of an element: " + line);
+            }
+
+            PlyElement& element = elements.back();
+            PlyProperty property;
+            std::string type;
+            tokens >> type;
+            if (type == "list")
+            {
+                std::string countType;
+                tokens >> countType >> type;
+                property.isList = true;
+                if (ParsePlyType(countType, property.countType) == false)
+                {
+                    return Fail("unknown property type " + countType);
+                }
+            }
+            if (ParsePlyType(type, property.type) == false || (tokens >> property.name).fail())
+            {
+                return Fail("invalid property: " + line);
+            }
+
+            property.offset = element.stride;
+            element.stride += property.isList ? 0 : GetPlyTypeSize(property.type);
+            element.hasLists = element.hasLists || property.isList;
+            element.properties.push_back(property);
+        }
+    }
+
+    const uint16_t endianProbe = 1;
+    bool swap = (*reinterpret_cast<const uint8_t*>(&endianProbe) == 1) != littleEndian;
+
+    const uint8_t* pCursor = reinterpret_cast<const uint8_t*>(pDataStart);
+    const uint8_t* pEnd = pData + size;
+    bool hasVertices = false;
+    bool hasFaces = false;
+    for (const PlyElement& element : elements)
+    {
+        if (hasVertices && hasFaces)
+        {
+            break;
+        }
+
+        if (element.name == "vertex")
+        {
+            const PlyProperty* pX = element.Find({ "x" });
+            const PlyProperty* pY = element.Find({ "y" });
+            const PlyProperty* pZ = element.Find({ "z" });
+            const PlyProperty* pNX = element.Find({ "nx" });
+            const PlyProperty* pNY = element.Find({ "ny" });
+            const PlyProperty* pNZ = element.Find({ "nz" });
+            const PlyProperty* pU = element.Find({ "u", "s", "texture_u", "texture_s" });
+            const PlyProperty* pV = element.Find({ "v", "t", "texture_v", "texture_t" });
+            if (element.hasLists)
+            {
+                return Fail("list properties in the vertex element aren't supported");
+            }
+            if (pX == nullptr || pY == nullptr || pZ == nullptr)
+            {
+                return Fail("the vertices have no position");
+            }
+            if (element.count >= kInvalid || element.count > uint64_t(pEnd - pCursor) / element.stride)
+            {
+                return Fail("truncated vertex data");
+            }
+
+            bool hasNormals = pNX && pNY && pNZ;
+            bool hasTexcoords = pU && pV;
+            mVertices.resize(static_cast<size_t>(element.count));
+            ParallelFor(pPool, mVertices.size(), [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    const uint8_t* p = pCursor + i * element.stride;
+                    Vertex& v = mVertices[i];
+                    v.position = glm::vec3(ReadPlyValue(p + pX->offset, pX->type, swap), ReadPlyValue(p + pY->offset, pY->type, swap), ReadPlyValue(p + pZ->offset, pZ->type, swap));
+                    v.normal = hasNormals ? glm::vec3(ReadPlyValue(p + pNX->offset, pNX->type, swap), ReadPlyValue(p + pNY->offset, pNY->type, swap), ReadPlyValue(p + pNZ->offset, pNZ->type, swap)) : glm::vec3(0.0f);
+                    v.tangent = glm::vec3(0.0f);
+                    v.texcoord = hasTexcoords ? glm::vec2(ReadPlyValue(p + pU->offset, pU->type, swap), 1.0 - ReadPlyValue(p + pV->offset, pV->type, swap)) : glm::vec2(0.0f);
+                }
+            });
+            pCursor += element.count * element.stride;
+            hasVertices = true;
+        }
+        else if (element.name == "face")
+        {
+            size_t listIndex = element.properties.size();
+            for (size_t i = 0; i < element.properties.size(); i++)
+            {
+                const std::string& name = element.properties[i].name;
+                if (element.properties[i].isList && (name == "vertex_indices" || name == "vertex_index"))
+                {
+                    listIndex = i;
+                }
+            }
+            if (listIndex == element.properties.size())
+            {
+                return Fail("the faces have no vertex_indices");
+            }
+            const PlyProperty& list = element.properties[listIndex];
+            uint32_t countSize = GetPlyTypeSize(list.countType);
+            uint32_t indexSize = GetPlyTypeSize(list.type);
+
+            // Triangulated meshes have a fixed face size, the faces are then checked and copied in parallel
+            bool fixedSize = true;
+            uint32_t stride = countSize + indexSize * 3;
+            for (const PlyProperty& property : element.properties)
+            {
+                fixedSize = fixedSize && (&property == &list || property.isList == false);
+                stride += (property.isList == false) ? GetPlyTypeSize(property.type) : 0;
+            }
+
+            std::atomic<bool> allTriangles(fixedSize && element.count < kInvalid / 3 && element.count <= uint64_t(pEnd - pCursor) / stride);
+            if (allTriangles)
+            {
+                mIndices32.resize(static_cast<size_t>(element.count * 3));
+                ParallelFor(pPool, static_cast<size_t>(element.count), [&](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end && allTriangles.load(std::memory_order_relaxed); i++)
+                    {
+                        const uint8_t* p = pCursor + i * stride + list.offset;
+                        if (ReadPlyIndex(p, list.countType, swap) != 3)
+                        {
+                            allTriangles = false;
+                            break;
+                        }
+                        for (uint32_t corner = 0; corner < 3; corner++)
+                        {
+                            mIndices32[i * 3 + corner] = ReadPlyIndex(p + countSize + corner * indexSize, list.type, swap);
+                        }
+                    }
+                });
+            }
+
+            if (allTriangles)
+            {
+                pCursor += element.count * stride;
+            }
+            else
+            {
+                // Polygons are read face by face and triangulated as fans
+                mIndices32.clear();
+                std::vector<uint32_t> polygon;
+                for (uint64_t face = 0; face < element.count; face++)
+                {
+                    for (const PlyProperty& property : element.properties)
+                    {
+                        uint32_t itemSize = GetPlyTypeSize(property.type);
+                        uint32_t itemCount = 1;
+                        if (property.isList)
+                        {
+                            if (uint64_t(pEnd - pCursor) < GetPlyTypeSize(property.countType))
+                            {
+                                return Fail("truncated face data");
+                            }
+                            itemCount = ReadPlyIndex(pCursor, property.countType, swap);
+                            pCursor += GetPlyTypeSize(property.countType);
+                        }
+                        if (itemCount == kInvalid || uint64_t(pEnd - pCursor) < uint64_t(itemCount) * itemSize)
+                        {
+                            return Fail("truncated face data");
+                        }
+
+                        if (&property == &list)
+                        {
+                            if (itemCount < 3)
+                            {
+                                return Fail("face " + std::to_string(face) + " has less than 3 vertices");
+                            }
+                            polygon.resize(itemCount);
+                            for (uint32_t i = 0; i < itemCount; i++)
+                            {
+                                polygon[i] = ReadPlyIndex(pCursor + i * itemSize, property.type, swap);
+                            }
+                            for (uint32_t i = 2; i < itemCount; i++)
+                            {
+                                mIndices32.insert(mIndices32.end(), { polygon[0], polygon[i - 1], polygon[i] });
+                            }
+                            if (mIndices32.size() >= kInvalid)
+                            {
+                                return Fail("too many faces");
+                            }
+                        }
+                        pCursor += uint64_t(itemCount) * itemSize;
+                    }
+                }
+            }
+            hasFaces = true;
+        }
+        else if (element.hasLists == false && element.count <= uint64_t(pEnd - pCursor) / std::max(element.stride, 1u))
+        {
+            pCursor += element.count * element.stride;
+        }
+        else
+        {
+            return Fail("can't skip the " + element.name + " element");
+        }
+    }
+
+    if (hasVertices == false)
+    {
+        return Fail("no vertex element");
+    }
+
+    // The vertex element may come after the faces, the indices are checked once both are known
+    std::atomic<bool> indicesValid(true);
+    ParallelFor(pPool, mIndices32.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            if (mIndices32[i] >= mVertices.size())
+            {
+                indicesValid = false;
+                break;
+            }
+        }
+    });
+    if (indicesValid == false)
+    {
+        return Fail("a face index is out of range");
+    }
+    return true;
+}
+
+void Primitives::MeshImporter::Finish(ThreadPool* pPool)
+{
+    size_t vertexCount = mVertices.size();
+    IndexView indices(mIndices32);
+
+    // Vertices the file gave no normal get the area weighted normals of their faces
+    std::vector<uint8_t> missingNormals(vertexCount);
+    ParallelFor(pPool, vertexCount, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            missingNormals[i] = (mVertices[i].normal == glm::vec3(0.0f)) ? 1 : 0;
+        }
+    });
+    if (std::find(missingNormals.begin(), missingNormals.end(), uint8_t(1)) != missingNormals.end())
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            uint32_t i1 = indices[i + 0];
+            uint32_t i2 = indices[i + 1];
+            uint32_t i3 = indices[i + 2];
+
+            glm::vec3 normal = glm::cross(mVertices[i2].position - mVertices[i1].position, mVertices[i3].position - mVertices[i1].position);
+            for (uint32_t index : { i1, i2, i3 })
+            {
+                if (missingNormals[index])
+                {
+                    mVertices[index].normal += normal;
+                }
+            }
+        }
+    }
+
+    ParallelFor(pPool, vertexCount, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            glm::vec3& normal = mVertices[i].normal;
+            float length = glm::length(normal);
+            normal = (length > 0.0f) ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    });
+
+    CalculateTangentSpace(mVertices.data(), vertexCount, indices, pPool);
+
+    mIndexFormat = SelectIndexFormat(vertexCount);
+    if (mIndexFormat == IndexFormat::UInt16)
+    {
+        mIndices.resize(mIndices32.size());
+        ParallelFor(pPool, mIndices.size(), [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                mIndices[i] = static_cast<uint16_t>(mIndices32[i]);
+            }
+        });
+        std::vector<uint32_t>().swap(mIndices32);
+    }
+}
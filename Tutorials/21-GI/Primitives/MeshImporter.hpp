@@ -0,0 +1,58 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "MeshView.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	class ThreadPool;
+};
+
+namespace Primitives
+{
+	// Loads a triangle mesh from a Wavefront OBJ or a binary PLY file into the Primitives vertex layout.
+	//
+	// The file is memory-mapped. OBJ text is split into chunks on line boundaries which are parsed on the pool's
+	// workers, serially without a pool. Identical position/texcoord/normal triples are merged into one vertex, the
+	// vertices keep the order of their first use in the file so the output doesn't depend on the thread count.
+	// Polygons are triangulated as fans, every object and group of the file ends up in the same mesh and materials
+	// are ignored. Texcoords are flipped to the D3D convention (v down), missing normals are computed from the
+	// faces and the tangents come from CalculateTangentSpace().
+	class MeshImporter
+	{
+	public:
+		MeshImporter() = default;
+		~MeshImporter() = default;
+
+		// The format is picked from the extension, .obj or .ply. On failure GetError() tells why, for OBJ files
+		// with the line number, and the importer is empty.
+		bool Load(const std::filesystem::path& path, CppDirectXRayTracing21::ThreadPool* pPool = nullptr);
+		const std::string& GetError() const { return mError; }
+
+		// Views into the importer's storage, no copy is made
+		ArrayView<Vertex> GetVertices() const { return mVertices; }
+		IndexView GetIndices() const { return (mIndexFormat == IndexFormat::UInt32) ? IndexView(mIndices32) : IndexView(mIndices); }
+		IndexFormat GetIndexFormat() const { return mIndexFormat; }
+		MeshView GetView() const { return { mVertices, GetIndices() }; }
+
+		// Moves the storage out, the importer is empty afterwards
+		std::vector<Vertex> TakeVertices() { return std::move(mVertices); }
+		// Only the storage of GetIndexFormat() is filled, the other one is empty
+		std::vector<uint16_t> TakeIndices() { return std::move(mIndices); }
+		std::vector<uint32_t> TakeIndices32() { return std::move(mIndices32); }
+
+	private:
+		bool LoadObj(const char* pData, size_t size, CppDirectXRayTracing21::ThreadPool* pPool);
+		bool LoadPly(const uint8_t* pData, size_t size, CppDirectXRayTracing21::ThreadPool* pPool);
+		// Fills the missing (zero) normals and the tangents, and narrows the indices when the vertices fit 16 bits
+		void Finish(CppDirectXRayTracing21::ThreadPool* pPool);
+		bool Fail(const std::string& error);
+
+		IndexFormat mIndexFormat = IndexFormat::UInt16;
+		std::vector<uint16_t> mIndices;
+		std::vector<uint32_t> mIndices32;
+		std::vector<Vertex> mVertices;
+		std::string mError;
+	};
+};
@@ -0,0 +1,291 @@
+#pragma once
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+namespace
+{
+    const uint32_t kInvalid = UINT32_MAX;
+    const uint32_t kFetchLineSize = 64;
+    const uint32_t kFetchCacheLines = 64;
+
+    // Spreads the low 10 bits of v to every third bit
+    uint32_t Part1By2(uint32_t v)
+    {
+        v &= 0x000003FF;
+        v = (v ^ (v << 16)) & 0xFF0000FF;
+        v = (v ^ (v << 8)) & 0x0300F00F;
+        v = (v ^ (v << 4)) & 0x030C30C3;
+        v = (v ^ (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    template<typename Index>
+    void SortTrianglesSpatiallyT(Index* pIndices, size_t indexCount, const Primitives::Vertex* pVertices, size_t vertexCount)
+    {
+        size_t triangleCount = indexCount / 3;
+        std::vector<glm::vec3> centroids(triangleCount);
+        glm::vec3 minimum(FLT_MAX);
+        glm::vec3 maximum(-FLT_MAX);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            assert(pIndices[t * 3 + 0] < vertexCount && pIndices[t * 3 + 1] < vertexCount && pIndices[t * 3 + 2] < vertexCount && "Index past the end of the vertices");
+            centroids[t] = (pVertices[pIndices[t * 3 + 0]].position + pVertices[pIndices[t * 3 + 1]].position + pVertices[pIndices[t * 3 + 2]].position) / 3.0f;
+            minimum = glm::min(minimum, centroids[t]);
+            maximum = glm::max(maximum, centroids[t]);
+        }
+
+        // The same scale on every axis keeps the curve's cells cubic
+        float extent = std::max(std::max(maximum.x - minimum.x, maximum.y - minimum.y), maximum.z - minimum.z);
+        float scale = (extent > 0.0f) ? 1023.0f / extent : 0.0f;
+
+        // Code in the high bits, triangle in the low ones: the sort is stable and the keys stay a single word
+        std::vector<uint64_t> keys(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            glm::vec3 cell = (centroids[t] - minimum) * scale + 0.5f;
+            uint32_t code = Part1By2(uint32_t(cell.x)) | (Part1By2(uint32_t(cell.y)) << 1) | (Part1By2(uint32_t(cell.z)) << 2);
+            keys[t] = (uint64_t(code) << 32) | t;
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<Index> source(pIndices, pIndices + triangleCount * 3);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            size_t from = static_cast<size_t>(keys[t] & UINT32_MAX);
+            pIndices[t * 3 + 0] = source[from * 3 + 0];
+            pIndices[t * 3 + 1] = source[from * 3 + 1];
+            pIndices[t * 3 + 2] = source[from * 3 + 2];
+        }
+    }
+
+    template<typename Index>
+    void OptimizeVertexCacheT(Index* pIndices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+    {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+        {
+            return;
+        }
+
+        // Triangles around every vertex, as offsets into one array
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+        {
+            liveTriangles[pIndices[i]]++;
+        }
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+        }
+        std::vector<uint32_t> adjacency(adjacencyOffsets[vertexCount]);
+        std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+        {
+            adjacency[cursor[pIndices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<Index> source(pIndices, pIndices + triangleCount * 3);
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        // A vertex is in the FIFO while fewer than cacheSize misses happened since it was loaded
+        std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+        uint32_t time = cacheSize + 1;
+        std::vector<uint32_t> deadEnds;
+        std::vector<uint32_t> candidates;
+        size_t output = 0;
+        size_t nextVertex = 0;
+
+        uint32_t fanning = source[0];
+        while (fanning != kInvalid)
+        {
+            candidates.clear();
+            for (uint32_t i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; i++)
+            {
+                uint32_t triangle = adjacency[i];
+                if (emitted[triangle])
+                {
+                    continue;
+                }
+                emitted[triangle] = 1;
+
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    uint32_t v = source[triangle * 3 + corner];
+                    pIndices[output++] = static_cast<Index>(v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+                    liveTriangles[v]--;
+                    if (time - cacheTimestamps[v] > cacheSize)
+                    {
+                        cacheTimestamps[v] = time++;
+                    }
+                }
+            }
+
+            // The candidate that stays in cache the longest while its remaining fan still fits
+            fanning = kInvalid;
+            int bestPriority = -1;
+            for (uint32_t v : candidates)
+            {
+                if (liveTriangles[v] == 0)
+                {
+                    continue;
+                }
+                int priority = 0;
+                if (time - cacheTimestamps[v] + 2 * liveTriangles[v] <= cacheSize)
+                {
+                    priority = static_cast<int>(time - cacheTimestamps[v]);
+                }
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    fanning = v;
+                }
+            }
+
+            // Dead end, back to the most recent vertex with triangles left, then to the vertex order
+            while (fanning == kInvalid && deadEnds.empty() == false)
+            {
+                uint32_t v = deadEnds.back();
+                deadEnds.pop_back();
+                fanning = (liveTriangles[v] > 0) ? v : kInvalid;
+            }
+            for (; fanning == kInvalid && nextVertex < vertexCount; nextVertex++)
+            {
+                fanning = (liveTriangles[nextVertex] > 0) ? static_cast<uint32_t>(nextVertex) : kInvalid;
+            }
+        }
+    }
+
+    template<typename Index>
+    size_t OptimizeVertexFetchT(Primitives::Vertex* pVertices, size_t vertexCount, Index* pIndices, size_t indexCount)
+    {
+        std::vector<uint32_t> remap(vertexCount, kInvalid);
+        uint32_t usedCount = 0;
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t& target = remap[pIndices[i]];
+            if (target == kInvalid)
+            {
+                target = usedCount++;
+            }
+            pIndices[i] = static_cast<Index>(target);
+        }
+
+        uint32_t unusedCount = usedCount;
+        for (uint32_t& target : remap)
+        {
+            target = (target == kInvalid) ? unusedCount++ : target;
+        }
+
+        std::vector<Primitives::Vertex> source(pVertices, pVertices + vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            pVertices[remap[v]] = source[v];
+        }
+        return usedCount;
+    }
+
+    template<typename Index>
+    void OptimizeMeshT(std::vector<Primitives::Vertex>& vertices, std::vector<Index>& indices)
+    {
+        SortTrianglesSpatiallyT(indices.data(), indices.size(), vertices.data(), vertices.size());
+        // Tipsify restarts from the vertex order, which now follows the curve
+        OptimizeVertexFetchT(vertices.data(), vertices.size(), indices.data(), indices.size());
+        OptimizeVertexCacheT(indices.data(), indices.size(), vertices.size(), Primitives::kVertexCacheSize);
+        vertices.resize(OptimizeVertexFetchT(vertices.data(), vertices.size(), indices.data(), indices.size()));
+    }
+}
+
+Primitives::MeshLocalityStatistics Primitives::AnalyzeMeshLocality(IndexView indices, size_t vertexCount, uint32_t vertexSize, uint32_t cacheSize)
+{
+    MeshLocalityStatistics statistics = {};
+    if (indices.size() < 3 || vertexCount == 0)
+    {
+        return statistics;
+    }
+
+    // FIFO caches as timestamps, an entry is present while fewer misses than the cache size happened since it was loaded
+    std::vector<uint32_t> vertexTimestamps(vertexCount, 0);
+    uint32_t vertexTime = cacheSize + 1;
+    uint32_t vertexMisses = 0;
+
+    size_t lineCount = (uint64_t(vertexCount) * vertexSize + kFetchLineSize - 1) / kFetchLineSize;
+    std::vector<uint32_t> lineTimestamps(lineCount, 0);
+    uint32_t lineTime = kFetchCacheLines + 1;
+    uint64_t fetchedBytes = 0;
+
+    std::vector<uint8_t> used(vertexCount, 0);
+    size_t usedCount = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        uint32_t v = indices[i];
+        if (vertexTime - vertexTimestamps[v] <= cacheSize)
+        {
+            continue;
+        }
+        vertexTimestamps[v] = vertexTime++;
+        vertexMisses++;
+        usedCount += used[v] ? 0 : 1;
+        used[v] = 1;
+
+        // Only the vertex shader, or the hit shader, fetches on a miss
+        uint64_t first = uint64_t(v) * vertexSize / kFetchLineSize;
+        uint64_t last = (uint64_t(v) * vertexSize + vertexSize - 1) / kFetchLineSize;
+        for (uint64_t line = first; line <= last; line++)
+        {
+            if (lineTime - lineTimestamps[line] > kFetchCacheLines)
+            {
+                lineTimestamps[line] = lineTime++;
+                fetchedBytes += kFetchLineSize;
+            }
+        }
+    }
+
+    statistics.acmr = float(vertexMisses) / float(indices.size() / 3);
+    statistics.atvr = float(vertexMisses) / float(usedCount);
+    statistics.overfetch = float(double(fetchedBytes) / (double(usedCount) * vertexSize));
+    return statistics;
+}
+
+void Primitives::SortTrianglesSpatially(uint16_t* pIndices, size_t indexCount, const Vertex* pVertices, size_t vertexCount)
+{
+    SortTrianglesSpatiallyT(pIndices, indexCount, pVertices, vertexCount);
+}
+
+void Primitives::SortTrianglesSpatially(uint32_t* pIndices, size_t indexCount, const Vertex* pVertices, size_t vertexCount)
+{
+    SortTrianglesSpatiallyT(pIndices, indexCount, pVertices, vertexCount);
+}
+
+void Primitives::OptimizeVertexCache(uint16_t* pIndices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    OptimizeVertexCacheT(pIndices, indexCount, vertexCount, cacheSize);
+}
+
+void Primitives::OptimizeVertexCache(uint32_t* pIndices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    OptimizeVertexCacheT(pIndices, indexCount, vertexCount, cacheSize);
+}
+
+size_t Primitives::OptimizeVertexFetch(Vertex* pVertices, size_t vertexCount, uint16_t* pIndices, size_t indexCount)
+{
+    return OptimizeVertexFetchT(pVertices, vertexCount, pIndices, indexCount);
+}
+
+size_t Primitives::OptimizeVertexFetch(Vertex* pVertices, size_t vertexCount, uint32_t* pIndices, size_t indexCount)
+{
+    return OptimizeVertexFetchT(pVertices, vertexCount, pIndices, indexCount);
+}
+
+void Primitives::OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint16_t>& indices)
+{
+    OptimizeMeshT(vertices, indices);
+}
+
+void Primitives::OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    OptimizeMeshT(vertices, indices);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include "MeshView.hpp"
+
+namespace Primitives
+{
+	// Post-transform cache size the reordering targets and the analysis simulates
+	static const uint32_t kVertexCacheSize = 16;
+
+	// Locality of a mesh's index order, lower is better for every metric.
+	struct MeshLocalityStatistics
+	{
+		float acmr;      // Vertex cache misses per triangle, about 0.5 at best on closed meshes, 3 at worst
+		float atvr;      // Vertex cache misses per vertex, 1 at best
+		float overfetch; // Bytes read through 64 byte lines from a small cache, over the vertex buffer size, 1 at best
+	};
+
+	// FIFO vertex cache of cacheSize entries, and a 4 KB FIFO cache of 64 byte lines over vertices of vertexSize bytes
+	MeshLocalityStatistics AnalyzeMeshLocality(IndexView indices, size_t vertexCount, uint32_t vertexSize, uint32_t cacheSize = kVertexCacheSize);
+
+	// Orders the triangles along a Morton curve through their centroids, quantized to 10 bits per axis over the mesh bounds.
+	// Neighbouring triangles end up close in memory even where the mesh has no connectivity to follow.
+	void SortTrianglesSpatially(uint16_t* pIndices, size_t indexCount, const Vertex* pVertices, size_t vertexCount);
+	void SortTrianglesSpatially(uint32_t* pIndices, size_t indexCount, const Vertex* pVertices, size_t vertexCount);
+
+	// Tipsify, see Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+	// Fans around the vertices in cache, linear in the mesh size. Dead ends restart from the vertex order.
+	void OptimizeVertexCache(uint16_t* pIndices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = kVertexCacheSize);
+	void OptimizeVertexCache(uint32_t* pIndices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = kVertexCacheSize);
+
+	// Renumbers the vertices in the order the indices first use them. Unreferenced vertices are moved past the returned count.
+	size_t OptimizeVertexFetch(Vertex* pVertices, size_t vertexCount, uint16_t* pIndices, size_t indexCount);
+	size_t OptimizeVertexFetch(Vertex* pVertices, size_t vertexCount, uint32_t* pIndices, size_t indexCount);
+
+	// The whole pass: spatial sort, fetch order so the vertices follow it, cache order, and fetch order again.
+	// Unreferenced vertices are dropped, the index format doesn't change.
+	void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint16_t>& indices);
+	void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+};
@@ -0,0 +1,514 @@
+#pragma once
+#include "MeshSimplifier.hpp"
+#include "../RTX/ThreadPool.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+namespace
+{
+    const uint32_t kInvalid = UINT32_MAX;
+    // Corners closer than this, relative to the mesh radius, are the same position for the metric
+    const double kWeldTolerance = 1e-5;
+    // Open borders are held by a plane through every border edge, perpendicular to its triangle, weighted this much more than the faces
+    const double kBorderWeight = 10.0;
+    // Collapses turning a triangle's normal by more than about 75 degrees are skipped, they would fold the surface
+    const double kMinNormalCos = 0.25;
+    // A pass applies at most this fraction of its candidates, the cheapest ones. The others are re-evaluated around the new edges
+    const size_t kPassFractionDivisor = 2;
+    // Every level of a chain has to remove at least this fraction of the previous level's triangles
+    const double kMinLodReduction = 0.25;
+
+    // Sum of squared plane distances, as the symmetric matrix A, the vector b and the constant c of p^T A p + 2 b^T p + c
+    struct Quadric
+    {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+        double c = 0.0;
+        double weight = 0.0;  // Area of the faces, the error is the area-weighted mean squared distance
+
+        // The plane dot(n, p) + d = 0, n unit length
+        void AddPlane(const glm::dvec3& n, double d, double w)
+        {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+            b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+            c += w * d * d;
+        }
+
+        void Add(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+        }
+
+        double Evaluate(const glm::dvec3& p) const
+        {
+            double value = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+                           2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return std::max(value, 0.0);
+        }
+    };
+
+    // Collapse of every corner at position from into the corner at position to it shares a triangle with
+    struct Candidate
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+    };
+
+    struct CellKey
+    {
+        int64_t x, y, z;
+        bool operator==(const CellKey& other) const { return x == other.x && y == other.y && z == other.z; }
+    };
+
+    struct CellKeyHash
+    {
+        size_t operator()(const CellKey& key) const
+        {
+            return std::hash<int64_t>()((key.x * 73856093) ^ (key.y * 19349663) ^ (key.z * 83492791));
+        }
+    };
+
+    // Per worker storage of the collapse tests
+    struct CollapseScratch
+    {
+        std::vector<uint32_t> fromNeighbors;
+        std::vector<uint32_t> toNeighbors;
+        std::vector<std::pair<uint32_t, uint32_t>> cornerMap;
+    };
+
+    class QuadricSimplifier
+    {
+    public:
+        QuadricSimplifier(Primitives::ArrayView<Primitives::Vertex> vertices, CppDirectXRayTracing21::ThreadPool* pPool) : mpPool(pPool)
+        {
+            glm::dvec3 minimum(DBL_MAX);
+            glm::dvec3 maximum(-DBL_MAX);
+            for (const Primitives::Vertex& vertex : vertices)
+            {
+                minimum = glm::min(minimum, glm::dvec3(vertex.position));
+                maximum = glm::max(maximum, glm::dvec3(vertex.position));
+            }
+            glm::dvec3 center = (minimum + maximum) * 0.5;
+            mRadius = 0.0;
+            for (const Primitives::Vertex& vertex : vertices)
+            {
+                mRadius = std::max(mRadius, glm::length(glm::dvec3(vertex.position) - center));
+            }
+
+            // Welded on a grid, the corners of a seam are only equal up to the rounding of the generator that computed them
+            double cell = std::max(mRadius * kWeldTolerance, DBL_MIN);
+            std::unordered_map<CellKey, uint32_t, CellKeyHash> positionsByCell;
+            positionsByCell.reserve(vertices.size());
+            mPositionOf.resize(vertices.size());
+            for (size_t v = 0; v < vertices.size(); v++)
+            {
+                glm::dvec3 position(vertices[v].position);
+                CellKey key = { std::llround(position.x / cell), std::llround(position.y / cell), std::llround(position.z / cell) };
+                auto inserted = positionsByCell.emplace(key, static_cast<uint32_t>(mPositions.size()));
+                if (inserted.second)
+                {
+                    mPositions.push_back(position);
+                }
+                mPositionOf[v] = inserted.first->second;
+            }
+        }
+
+        float Simplify(std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError)
+        {
+            // Triangles already degenerate in position space have no plane and no neighborhood to keep
+            mIndices.clear();
+            mIndices.reserve(indices.size());
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                uint32_t p0 = mPositionOf[indices[i + 0]], p1 = mPositionOf[indices[i + 1]], p2 = mPositionOf[indices[i + 2]];
+                if (p0 != p1 && p1 != p2 && p2 != p0)
+                {
+                    mIndices.insert(mIndices.end(), { indices[i + 0], indices[i + 1], indices[i + 2] });
+                }
+            }
+
+            BuildAdjacency();
+            ComputeQuadrics();
+
+            double maxCost = double(maxError) * mRadius * double(maxError) * mRadius;
+            double reachedCost = 0.0;
+            size_t positionCount = mPositions.size();
+            std::vector<Candidate> candidates(positionCount);
+            std::vector<uint8_t> touched(positionCount);
+            CollapseScratch scratch;
+            while (mIndices.size() > targetIndexCount)
+            {
+                // Every position picks its cheapest collapse, they only read the mesh
+                CppDirectXRayTracing21::ParallelFor(mpPool, positionCount, [&](size_t begin, size_t end)
+                {
+                    CollapseScratch workerScratch;
+                    for (size_t p = begin; p < end; p++)
+                    {
+                        candidates[p] = FindCollapse(static_cast<uint32_t>(p), maxCost, workerScratch);
+                    }
+                });
+
+                std::vector<Candidate> pass;
+                for (const Candidate& candidate : candidates)
+                {
+                    if (candidate.to != kInvalid)
+                    {
+                        pass.push_back(candidate);
+                    }
+                }
+                if (pass.empty())
+                {
+                    break;
+                }
+                std::sort(pass.begin(), pass.end(), [](const Candidate& a, const Candidate& b) { return (a.cost != b.cost) ? a.cost < b.cost : a.from < b.from; });
+
+                // A collapse changes the triangles around its source only. Once they are touched, the tests of their positions are stale
+                std::fill(touched.begin(), touched.end(), 0);
+                size_t collapseLimit = std::max<size_t>(1, pass.size() / kPassFractionDivisor);
+                size_t triangleCount = mIndices.size() / 3;
+                size_t targetTriangleCount = targetIndexCount / 3;
+                mRemoved.assign(triangleCount, 0);
+                for (size_t i = 0; i < collapseLimit && triangleCount > targetTriangleCount; i++)
+                {
+                    const Candidate& candidate = pass[i];
+                    if (touched[candidate.from] || touched[candidate.to])
+                    {
+                        continue;
+                    }
+                    triangleCount -= Collapse(candidate.from, candidate.to, scratch, touched);
+                    reachedCost = std::max(reachedCost, candidate.cost);
+                }
+
+                size_t output = 0;
+                for (size_t t = 0; t < mRemoved.size(); t++)
+                {
+                    if (mRemoved[t] == 0)
+                    {
+                        mIndices[output++] = mIndices[t * 3 + 0];
+                        mIndices[output++] = mIndices[t * 3 + 1];
+                        mIndices[output++] = mIndices[t * 3 + 2];
+                    }
+                }
+                mIndices.resize(output);
+                BuildAdjacency();
+            }
+
+            indices = mIndices;
+            return (mRadius > 0.0) ? float(std::sqrt(reachedCost) / mRadius) : 0.0f;
+        }
+
+    private:
+        uint32_t GetPosition(uint32_t triangle, uint32_t corner) const
+        {
+            return mPositionOf[mIndices[triangle * 3 + corner]];
+        }
+
+        uint32_t FindCorner(uint32_t triangle, uint32_t position) const
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                if (GetPosition(triangle, corner) == position)
+                {
+                    return corner;
+                }
+            }
+            return kInvalid;
+        }
+
+        // Triangles around every position, as offsets into one array
+        void BuildAdjacency()
+        {
+            size_t positionCount = mPositions.size();
+            mAdjacencyOffsets.assign(positionCount + 1, 0);
+            for (uint32_t index : mIndices)
+            {
+                mAdjacencyOffsets[mPositionOf[index] + 1]++;
+            }
+            for (size_t p = 0; p < positionCount; p++)
+            {
+                mAdjacencyOffsets[p + 1] += mAdjacencyOffsets[p];
+            }
+            mAdjacency.resize(mIndices.size());
+            std::vector<uint32_t> cursor(mAdjacencyOffsets.begin(), mAdjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < mIndices.size(); i++)
+            {
+                mAdjacency[cursor[mPositionOf[mIndices[i]]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        void GatherNeighbors(uint32_t position, std::vector<uint32_t>& neighbors) const
+        {
+            neighbors.clear();
+            for (uint32_t i = mAdjacencyOffsets[position]; i < mAdjacencyOffsets[position + 1]; i++)
+            {
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    uint32_t neighbor = GetPosition(mAdjacency[i], corner);
+                    if (neighbor != position && std::find(neighbors.begin(), neighbors.end(), neighbor) == neighbors.end())
+                    {
+                        neighbors.push_back(neighbor);
+                    }
+                }
+            }
+        }
+
+        uint32_t CountEdgeTriangles(uint32_t position, uint32_t neighbor) const
+        {
+            uint32_t count = 0;
+            for (uint32_t i = mAdjacencyOffsets[position]; i < mAdjacencyOffsets[position + 1]; i++)
+            {
+                count += (FindCorner(mAdjacency[i], neighbor) != kInvalid) ? 1 : 0;
+            }
+            return count;
+        }
+
+        // The face planes of every position, plus the planes holding its border edges. Positions on non-manifold edges are locked
+        void ComputeQuadrics()
+        {
+            size_t positionCount = mPositions.size();
+            mQuadrics.assign(positionCount, Quadric());
+            mBorder.assign(positionCount, 0);
+            mLocked.assign(positionCount, 0);
+            CppDirectXRayTracing21::ParallelFor(mpPool, positionCount, [&](size_t begin, size_t end)
+            {
+                for (size_t p = begin; p < end; p++)
+                {
+                    Quadric& quadric = mQuadrics[p];
+                    for (uint32_t i = mAdjacencyOffsets[p]; i < mAdjacencyOffsets[p + 1]; i++)
+                    {
+                        uint32_t triangle = mAdjacency[i];
+                        const glm::dvec3& p0 = mPositions[GetPosition(triangle, 0)];
+                        glm::dvec3 normal = glm::cross(mPositions[GetPosition(triangle, 1)] - p0, mPositions[GetPosition(triangle, 2)] - p0);
+                        double length = glm::length(normal);
+                        if (length == 0.0)
+                        {
+                            continue;
+                        }
+                        normal /= length;
+                        quadric.AddPlane(normal, -glm::dot(normal, p0), length * 0.5);
+                        quadric.weight += length * 0.5;
+
+                        // The edges of this triangle that end here, the neighbor adds its own side of the border
+                        uint32_t corner = FindCorner(triangle, static_cast<uint32_t>(p));
+                        for (uint32_t other : { (corner + 1) % 3, (corner + 2) % 3 })
+                        {
+                            uint32_t neighbor = GetPosition(triangle, other);
+                            uint32_t edgeTriangles = CountEdgeTriangles(static_cast<uint32_t>(p), neighbor);
+                            if (edgeTriangles == 1)
+                            {
+                                glm::dvec3 edge = mPositions[neighbor] - mPositions[p];
+                                glm::dvec3 borderNormal = glm::cross(edge, normal);
+                                double borderLength = glm::length(borderNormal);
+                                if (borderLength > 0.0)
+                                {
+                                    borderNormal /= borderLength;
+                                    quadric.AddPlane(borderNormal, -glm::dot(borderNormal, mPositions[p]), glm::dot(edge, edge) * kBorderWeight);
+                                }
+                                mBorder[p] = 1;
+                            }
+                            else if (edgeTriangles > 2)
+                            {
+                                mLocked[p] = 1;
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        // Fills the corner map from the corners at from to the corners at to. Fails if a corner has no target or two,
+        // if the collapse pinches a border or the surface (link condition), or if it folds a triangle over
+        bool CanCollapse(uint32_t from, uint32_t to, CollapseScratch& scratch) const
+        {
+            scratch.cornerMap.clear();
+            uint32_t sharedTriangles = 0;
+            for (uint32_t i = mAdjacencyOffsets[from]; i < mAdjacencyOffsets[from + 1]; i++)
+            {
+                uint32_t triangle = mAdjacency[i];
+                uint32_t toCorner = FindCorner(triangle, to);
+                if (toCorner == kInvalid)
+                {
+                    continue;
+                }
+                sharedTriangles++;
+                uint32_t fromVertex = mIndices[triangle * 3 + FindCorner(triangle, from)];
+                uint32_t toVertex = mIndices[triangle * 3 + toCorner];
+                auto mapped = std::find_if(scratch.cornerMap.begin(), scratch.cornerMap.end(), [fromVertex](const std::pair<uint32_t, uint32_t>& entry) { return entry.first == fromVertex; });
+                if (mapped == scratch.cornerMap.end())
+                {
+                    scratch.cornerMap.push_back({ fromVertex, toVertex });
+                }
+                else if (mapped->second != toVertex)
+                {
+                    return false;
+                }
+            }
+
+            // Border positions only move along a border edge, interior ones along an edge with two triangles
+            if (mBorder[from] ? (mBorder[to] == 0 || sharedTriangles != 1) : (sharedTriangles != 2))
+            {
+                return false;
+            }
+
+            // The two rings may only share the corners opposite the collapsed edge, otherwise the surface gets pinched
+            GatherNeighbors(to, scratch.toNeighbors);
+            uint32_t sharedNeighbors = 0;
+            for (uint32_t neighbor : scratch.fromNeighbors)
+            {
+                sharedNeighbors += (std::find(scratch.toNeighbors.begin(), scratch.toNeighbors.end(), neighbor) != scratch.toNeighbors.end()) ? 1 : 0;
+            }
+            if (sharedNeighbors != sharedTriangles)
+            {
+                return false;
+            }
+
+            for (uint32_t i = mAdjacencyOffsets[from]; i < mAdjacencyOffsets[from + 1]; i++)
+            {
+                uint32_t triangle = mAdjacency[i];
+                if (FindCorner(triangle, to) != kInvalid)
+                {
+                    continue;
+                }
+                uint32_t fromCorner = FindCorner(triangle, from);
+                uint32_t fromVertex = mIndices[triangle * 3 + fromCorner];
+                if (std::find_if(scratch.cornerMap.begin(), scratch.cornerMap.end(), [fromVertex](const std::pair<uint32_t, uint32_t>& entry) { return entry.first == fromVertex; }) == scratch.cornerMap.end())
+                {
+                    return false;
+                }
+
+                glm::dvec3 before[3], after[3];
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    before[corner] = mPositions[GetPosition(triangle, corner)];
+                    after[corner] = (corner == fromCorner) ? mPositions[to] : before[corner];
+                }
+                glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(normalBefore, normalAfter) <= kMinNormalCos * glm::length(normalBefore) * glm::length(normalAfter) || glm::dot(normalAfter, normalAfter) == 0.0)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        Candidate FindCollapse(uint32_t from, double maxCost, CollapseScratch& scratch) const
+        {
+            Candidate best = { DBL_MAX, from, kInvalid };
+            if (mLocked[from] || mAdjacencyOffsets[from] == mAdjacencyOffsets[from + 1])
+            {
+                return best;
+            }
+
+            // The tests only overwrite the other parts of the scratch
+            GatherNeighbors(from, scratch.fromNeighbors);
+            for (uint32_t to : scratch.fromNeighbors)
+            {
+                if (mLocked[to])
+                {
+                    continue;
+                }
+                Quadric quadric = mQuadrics[from];
+                quadric.Add(mQuadrics[to]);
+                double cost = quadric.Evaluate(mPositions[to]) / std::max(quadric.weight, DBL_MIN);
+                if (cost < best.cost && cost <= maxCost && CanCollapse(from, to, scratch))
+                {
+                    best.cost = cost;
+                    best.to = to;
+                }
+            }
+            return best;
+        }
+
+        // Returns the number of removed triangles
+        size_t Collapse(uint32_t from, uint32_t to, CollapseScratch& scratch, std::vector<uint8_t>& touched)
+        {
+            GatherNeighbors(from, scratch.fromNeighbors);
+            if (CanCollapse(from, to, scratch) == false)
+            {
+                return 0;
+            }
+
+            size_t removed = 0;
+            for (uint32_t i = mAdjacencyOffsets[from]; i < mAdjacencyOffsets[from + 1]; i++)
+            {
+                uint32_t triangle = mAdjacency[i];
+                if (FindCorner(triangle, to) != kInvalid)
+                {
+                    mRemoved[triangle] = 1;
+                    removed++;
+                    continue;
+                }
+                uint32_t& vertex = mIndices[triangle * 3 + FindCorner(triangle, from)];
+                for (const std::pair<uint32_t, uint32_t>& entry : scratch.cornerMap)
+                {
+                    if (entry.first == vertex)
+                    {
+                        vertex = entry.second;
+                        break;
+                    }
+                }
+            }
+
+            mQuadrics[to].Add(mQuadrics[from]);
+            touched[from] = 1;
+            touched[to] = 1;
+            for (uint32_t neighbor : scratch.fromNeighbors)
+            {
+                touched[neighbor] = 1;
+            }
+            return removed;
+        }
+
+        CppDirectXRayTracing21::ThreadPool* mpPool;
+        double mRadius;
+
+        // Welded positions, and the position of every vertex
+        std::vector<glm::dvec3> mPositions;
+        std::vector<uint32_t> mPositionOf;
+
+        std::vector<uint32_t> mIndices;
+        std::vector<uint8_t> mRemoved;
+        std::vector<uint32_t> mAdjacencyOffsets;
+        std::vector<uint32_t> mAdjacency;
+
+        std::vector<Quadric> mQuadrics;
+        std::vector<uint8_t> mBorder;
+        std::vector<uint8_t> mLocked;
+    };
+}
+
+float Primitives::SimplifyMesh(ArrayView<Vertex> vertices, std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, CppDirectXRayTracing21::ThreadPool* pPool)
+{
+    QuadricSimplifier simplifier(vertices, pPool);
+    return simplifier.Simplify(indices, targetIndexCount, maxError);
+}
+
+std::vector<Primitives::MeshLod> Primitives::BuildLodChain(ArrayView<Vertex> vertices, ArrayView<uint32_t> indices, uint32_t levelCount, float maxError, CppDirectXRayTracing21::ThreadPool* pPool)
+{
+    std::vector<MeshLod> chain;
+    chain.push_back({ std::vector<uint32_t>(indices.begin(), indices.end()), 0.0f });
+
+    // Every level starts from the source, the errors don't add up along the chain. The welding is shared by all of them
+    QuadricSimplifier simplifier(vertices, pPool);
+    for (uint32_t level = 1; level < levelCount; level++)
+    {
+        size_t previousTriangleCount = chain.back().indices.size() / 3;
+        MeshLod lod;
+        lod.indices = chain.front().indices;
+        lod.error = simplifier.Simplify(lod.indices, (previousTriangleCount / 2) * 3, maxError);
+        if (double(lod.indices.size() / 3) > double(previousTriangleCount) * (1.0 - kMinLodReduction))
+        {
+            break;
+        }
+        chain.push_back(std::move(lod));
+    }
+    return chain;
+}
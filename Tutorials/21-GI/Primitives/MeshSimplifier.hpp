@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include "MeshView.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	class ThreadPool;
+};
+
+namespace Primitives
+{
+	// One level of a LOD chain, its indices address the source vertices
+	struct MeshLod
+	{
+		std::vector<uint32_t> indices;
+		float error;  // Quadric error of the level, a distance relative to the mesh radius
+	};
+
+	// Quadric error metric simplification, see Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics".
+	//
+	// Edges are collapsed into one of their endpoints, no vertex is created or moved so the attributes stay exact and the
+	// vertex buffer is shared by every level. The corners of one position, within a small tolerance, are welded for the metric.
+	// A corner only collapses into the corner it shares triangles with, so attribute seams are kept and only move along
+	// themselves, as do open borders. Collapses that flip a triangle or make the surface non-manifold are skipped.
+	// The costs are evaluated on the pool's workers, in passes of collapses that don't touch each other's neighborhood.
+	// Stops at targetIndexCount, or when the cheapest collapse left would exceed maxError. Returns the error reached.
+	float SimplifyMesh(ArrayView<Vertex> vertices, std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, CppDirectXRayTracing21::ThreadPool* pPool = nullptr);
+
+	// Level 0 is the source, every next level is simplified from it to half the triangles of the previous one.
+	// The chain ends early when a level doesn't remove a quarter of the triangles within maxError, a tiny mesh has a single level.
+	std::vector<MeshLod> BuildLodChain(ArrayView<Vertex> vertices, ArrayView<uint32_t> indices, uint32_t levelCount, float maxError, CppDirectXRayTracing21::ThreadPool* pPool = nullptr);
+};
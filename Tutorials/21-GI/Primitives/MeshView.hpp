@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Vertex.hpp"
+
+namespace Primitives
+{
+	// Non-owning view of a contiguous array, valid as long as the storage it points to isn't modified.
+	template<typename T>
+	class ArrayView
+	{
+	public:
+		ArrayView() = default;
+		ArrayView(const T* pData, size_t size) : mpData(pData), mSize(size) {}
+		ArrayView(const std::vector<T>& vector) : mpData(vector.data()), mSize(vector.size()) {}
+
+		const T* data() const { return mpData; }
+		size_t size() const { return mSize; }
+		size_t size_bytes() const { return mSize * sizeof(T); }
+		bool empty() const { return mSize == 0; }
+
+		const T* begin() const { return mpData; }
+		const T* end() const { return mpData + mSize; }
+		const T& operator[](size_t i) const { return mpData[i]; }
+
+	private:
+		const T* mpData = nullptr;
+		size_t mSize = 0;
+	};
+
+	// Width of a mesh's indices. Meshes whose vertices can all be addressed with 16 bits keep the smaller format,
+	// it halves the index bandwidth of the BLAS build and of the hit shaders.
+	enum class IndexFormat
+	{
+		UInt16,
+		UInt32
+	};
+
+	inline IndexFormat SelectIndexFormat(size_t vertexCount)
+	{
+		return (vertexCount <= size_t(UINT16_MAX) + 1) ? IndexFormat::UInt16 : IndexFormat::UInt32;
+	}
+
+	inline uint32_t GetIndexSize(IndexFormat format)
+	{
+		return (format == IndexFormat::UInt32) ? sizeof(uint32_t) : sizeof(uint16_t);
+	}
+
+	// The shaders read the indices as raw 32-bit words, so index buffers are padded to a multiple of 4 bytes
+	inline uint64_t GetIndexBufferSize(size_t indexCount, IndexFormat format)
+	{
+		return (uint64_t(indexCount) * GetIndexSize(format) + 3) & ~uint64_t(3);
+	}
+
+	// Non-owning view of 16 or 32-bit indices
+	class IndexView
+	{
+	public:
+		IndexView() = default;
+		IndexView(const void* pData, size_t size, IndexFormat format) : mpData(pData), mSize(size), mFormat(format) {}
+		IndexView(const std::vector<uint16_t>& vector) : mpData(vector.data()), mSize(vector.size()), mFormat(IndexFormat::UInt16) {}
+		IndexView(const std::vector<uint32_t>& vector) : mpData(vector.data()), mSize(vector.size()), mFormat(IndexFormat::UInt32) {}
+
+		const void* data() const { return mpData; }
+		size_t size() const { return mSize; }
+		size_t size_bytes() const { return mSize * GetIndexSize(mFormat); }
+		bool empty() const { return mSize == 0; }
+		IndexFormat format() const { return mFormat; }
+
+		uint32_t operator[](size_t i) const
+		{
+			return (mFormat == IndexFormat::UInt32) ? static_cast<const uint32_t*>(mpData)[i] : static_cast<const uint16_t*>(mpData)[i];
+		}
+
+	private:
+		const void* mpData = nullptr;
+		size_t mSize = 0;
+		IndexFormat mFormat = IndexFormat::UInt16;
+	};
+
+	struct MeshView
+	{
+		ArrayView<Vertex> vertices;
+		IndexView indices;
+	};
+};
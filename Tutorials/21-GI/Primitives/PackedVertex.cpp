@@ -0,0 +1,77 @@
+#pragma once
+#include "PackedVertex.hpp"
+
+namespace
+{
+    float SignNotZero(float value)
+    {
+        return (value >= 0.0f) ? 1.0f : -1.0f;
+    }
+
+    uint32_t PackSnorm16x2(float x, float y)
+    {
+        int16_t ix = static_cast<int16_t>(std::round(glm::clamp(x, -1.0f, 1.0f) * 32767.0f));
+        int16_t iy = static_cast<int16_t>(std::round(glm::clamp(y, -1.0f, 1.0f) * 32767.0f));
+        return uint32_t(uint16_t(ix)) | (uint32_t(uint16_t(iy)) << 16);
+    }
+}
+
+uint32_t Primitives::EncodeOctahedral(const glm::vec3& v)
+{
+    float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (l1 == 0.0f)
+    {
+        return PackSnorm16x2(0.0f, 0.0f);
+    }
+
+    float x = v.x / l1;
+    float y = v.y / l1;
+    if (v.z < 0.0f)
+    {
+        float fx = (1.0f - std::abs(y)) * SignNotZero(x);
+        float fy = (1.0f - std::abs(x)) * SignNotZero(y);
+        x = fx;
+        y = fy;
+    }
+
+    // Rounding each component separately isn't always the best choice, try the four snorm16 cells around the exact value
+    glm::vec3 n = glm::normalize(v);
+    float fx = std::floor(glm::clamp(x, -1.0f, 1.0f) * 32767.0f);
+    float fy = std::floor(glm::clamp(y, -1.0f, 1.0f) * 32767.0f);
+    uint32_t best = PackSnorm16x2(x, y);
+    float bestDot = glm::dot(DecodeOctahedral(best), n);
+    for (int i = 0; i < 4; i++)
+    {
+        uint32_t candidate = PackSnorm16x2((fx + float(i & 1)) / 32767.0f, (fy + float(i >> 1)) / 32767.0f);
+        float candidateDot = glm::dot(DecodeOctahedral(candidate), n);
+        if (candidateDot > bestDot)
+        {
+            best = candidate;
+            bestDot = candidateDot;
+        }
+    }
+    return best;
+}
+
+uint32_t Primitives::PackHalf2(const glm::vec2& v)
+{
+    return uint32_t(glm::packHalf1x16(v.x)) | (uint32_t(glm::packHalf1x16(v.y)) << 16);
+}
+
+Primitives::PackedVertexAttributes Primitives::PackVertexAttributes(const Vertex& vertex)
+{
+    PackedVertexAttributes attributes;
+    attributes.normal = EncodeOctahedral(vertex.normal);
+    attributes.tangent = EncodeOctahedral(vertex.tangent);
+    attributes.texcoord = PackHalf2(vertex.texcoord);
+    return attributes;
+}
+
+void Primitives::PackVertices(ArrayView<Vertex> vertices, glm::vec3* pPositions, PackedVertexAttributes* pAttributes)
+{
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        pPositions[i] = vertices[i].position;
+        pAttributes[i] = PackVertexAttributes(vertices[i]);
+    }
+}
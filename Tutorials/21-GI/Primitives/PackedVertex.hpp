@@ -0,0 +1,23 @@
+#pragma once
+#include "MeshView.hpp"
+#include "../Data/VertexPacking.hlsli"
+
+namespace Primitives
+{
+	// Declared in VertexPacking.hlsli, which is shared with the shaders. The decoders live there as well.
+	using VertexPacking::PackedVertexAttributes;
+	using VertexPacking::DecodeOctahedral;
+	using VertexPacking::DecodeNormal;
+	using VertexPacking::DecodeTangent;
+	using VertexPacking::DecodeTexCoord;
+
+	// Unit vector to two snorm16. The rounding picks the neighbour that decodes closest to the input.
+	uint32_t EncodeOctahedral(const glm::vec3& v);
+	uint32_t PackHalf2(const glm::vec2& v);
+
+	PackedVertexAttributes PackVertexAttributes(const Vertex& vertex);
+
+	// Splits the vertices into the position stream read by the BLAS build and the attribute stream read by the hit shaders.
+	// Both destinations are written in order and never read, they can point into mapped upload memory.
+	void PackVertices(ArrayView<Vertex> vertices, glm::vec3* pPositions, PackedVertexAttributes* pAttributes);
+};
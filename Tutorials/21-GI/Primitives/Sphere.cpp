@@ -1,206 +1,460 @@
 #pragma once
 #include "Sphere.hpp"
+#include "TangentSpace.hpp"
+#include "../RTX/ThreadPool.hpp"
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
 #include <Externals/GLM/glm/gtc/constants.hpp>
 
-void Primitives::Sphere::Init(float diameter, int tessellation, bool uvHorizontalFlip, bool uvVerticalFlip)
+namespace
 {
-    if (tessellation < 3)
+    struct SphereLayout
     {
-        throw std::invalid_argument("tessellation smaller than 3 is invalid.");
-    }
+        int verticalSegments;
+        int horizontalSegments;
+        int vertexCount;
+        int triangleCount;
+    };
 
-    int verticalSegments = tessellation;
-    int horizontalSegments = tessellation * 2;
-    float uIncrement = 1.0f / horizontalSegments;
-    float vIncrement = 1.0f / verticalSegments;
-    float radius = diameter / 2.0f;
+    SphereLayout GetLayout(int tessellation)
+    {
+        if (tessellation < 3)
+        {
+            throw std::invalid_argument("tessellation smaller than 3 is invalid.");
+        }
 
-    uIncrement *= uvHorizontalFlip ? 1.0f : -1.0f;
-    vIncrement *= uvVerticalFlip ? 1.0f : -1.0f;
+        SphereLayout layout;
+        layout.verticalSegments = tessellation;
+        layout.horizontalSegments = tessellation * 2;
 
-    float u = uvHorizontalFlip ? 0.0f : 1.0f;
-    float v = uvVerticalFlip ? 0.0f : 1.0f;
+        // A ring of poles at the bottom and the top, and a closed ring per latitude in between
+        int64_t vertexCount = int64_t(layout.horizontalSegments) * 2 + int64_t(layout.verticalSegments - 1) * (layout.horizontalSegments + 1);
+        if (vertexCount > std::numeric_limits<int>::max() / 6)
+        {
+            throw std::invalid_argument("tessellation is too large.");
+        }
+        layout.vertexCount = static_cast<int>(vertexCount);
+        layout.triangleCount = layout.horizontalSegments * (layout.verticalSegments - 1) * 2;
+        return layout;
+    }
 
-    // Start with a single vertex at the bottom of the sphere.
-    for (int i = 0; i < horizontalSegments; i++)
+    template<typename Index>
+    void CheckIndexRange(const SphereLayout& layout)
     {
-        u += uIncrement;
-
-        // this.AddVertex(new Vector3(0,-1,0) * radius, new Vector3(0,-1,0), new Vector2(u, v));
-        Vertex vertex;
-        vertex.position = glm::vec3(0, -1, 0) * radius;
-        vertex.normal = glm::vec3(0, -1, 0);
-        vertex.tangent = glm::vec3(0, 0, 0);
-        vertex.texcoord = glm::vec2(u, v);
-
-        mVertices.push_back(vertex);
+        if (uint64_t(layout.vertexCount) - 1 > std::numeric_limits<Index>::max())
+        {
+            throw std::invalid_argument("tessellation too large for the index format.");
+        }
     }
-    
-    // Create rings of vertices at progressively higher latitudes.
-    v = uvVerticalFlip ? 0.0f : 1.0f;
-    for (int i = 0; i < verticalSegments - 1; i++)
+
+    // Calls f(i1, i2, i3) for every triangle, in index buffer order
+    template<typename F>
+    void ForEachTriangle(const SphereLayout& layout, F&& f)
     {
-        float latitude = (((i + 1) * glm::pi <float>()) / verticalSegments) - glm::pi<float>() / 2.0f;
-        u = uvHorizontalFlip ? 0.0f : 1.0f;
-        v += vIncrement;
-        float dy = glm::sin(latitude);
-        float dxz = glm::cos(latitude);
+        int horizontalSegments = layout.horizontalSegments;
 
-        // Create a single ring of vertices at this latitude.
-        for (int j = 0; j <= horizontalSegments; j++)
+        // Create a fan connecting the bottom vertex to the bottom latitude ring.
+        for (int i = 0; i < horizontalSegments; i++)
         {
-            float longitude = j * glm::pi <float>() * 2 / horizontalSegments;
+            f(i, 1 + i + horizontalSegments, i + horizontalSegments);
+        }
 
-            float dx = glm::sin(longitude) * dxz;
-            float dz = glm::cos(longitude) * dxz;
+        // Fill the sphere body with triangles joining each pair of latitude rings.
+        for (int i = 0; i < layout.verticalSegments - 2; i++)
+        {
+            for (int j = 0; j < horizontalSegments; j++)
+            {
+                int nextI = i + 1;
+                int nextJ = j + 1;
+                int num = horizontalSegments + 1;
+
+                int i1 = horizontalSegments + (i * num) + j;
+                int i2 = horizontalSegments + (i * num) + nextJ;
+                int i3 = horizontalSegments + (nextI * num) + j;
+                int i4 = i3 + 1;
+
+                f(i1, i2, i3);
+                f(i2, i4, i3);
+            }
+        }
 
-            glm::vec3 normal(dx, dy, dz);
+        // Create a fan connecting the top vertex to the top latitude ring.
+        for (int i = 0; i < horizontalSegments; i++)
+        {
+            f(layout.vertexCount - 1 - i, layout.vertexCount - horizontalSegments - 2 - i, layout.vertexCount - horizontalSegments - 1 - i);
+        }
+    }
 
-            glm::vec2 texCoord(u, v);
-            u += uIncrement;
+    // Rows of vertices: the bottom poles, one row per latitude ring, the top poles
+    int GetRowStart(const SphereLayout& layout, int row)
+    {
+        int ringSize = layout.horizontalSegments + 1;
+        return (row == 0) ? 0 : layout.horizontalSegments + (std::min(row, layout.verticalSegments) - 1) * ringSize;
+    }
 
-            Vertex vertex;
-            vertex.position = normal * radius;
-            vertex.normal = normal;
-            vertex.tangent = glm::vec3(0, 0, 0);
-            vertex.texcoord = texCoord;
+    // Index of the first triangle of the top fan
+    int GetTopFanStart(const SphereLayout& layout)
+    {
+        return layout.horizontalSegments + (layout.verticalSegments - 2) * layout.horizontalSegments * 2;
+    }
 
-            mVertices.push_back(vertex);
+    // The same triangle as the t-th call of ForEachTriangle()
+    void GetTriangle(const SphereLayout& layout, int t, int& i1, int& i2, int& i3)
+    {
+        int horizontalSegments = layout.horizontalSegments;
+        int topFanStart = GetTopFanStart(layout);
+        if (t < horizontalSegments)
+        {
+            i1 = t;
+            i2 = 1 + t + horizontalSegments;
+            i3 = t + horizontalSegments;
+        }
+        else if (t < topFanStart)
+        {
+            int quad = (t - horizontalSegments) / 2;
+            int band = quad / horizontalSegments;
+            int j = quad % horizontalSegments;
+            int num = horizontalSegments + 1;
+            int lower = horizontalSegments + band * num + j;
+            int upper = lower + num;
+            if ((t - horizontalSegments) % 2 == 0)
+            {
+                i1 = lower;
+                i2 = lower + 1;
+                i3 = upper;
+            }
+            else
+            {
+                i1 = lower + 1;
+                i2 = upper + 1;
+                i3 = upper;
+            }
+        }
+        else
+        {
+            int i = t - topFanStart;
+            i1 = layout.vertexCount - 1 - i;
+            i2 = layout.vertexCount - horizontalSegments - 2 - i;
+            i3 = layout.vertexCount - horizontalSegments - 1 - i;
         }
     }
 
-    // Finish with a single vertex at the top of the sphere.
-    v = uvVerticalFlip ? 1.0f : 0.0f;
-    u = uvHorizontalFlip ? 0.0f : 1.0f;
-    for (int i = 0; i < horizontalSegments; i++)
+    // The triangles using a vertex, in ascending order. A vertex is shared by at most 6 triangles
+    int GetIncidentTriangles(const SphereLayout& layout, int row, int column, int* pTriangles)
     {
-        u += uIncrement;
+        int horizontalSegments = layout.horizontalSegments;
+        int verticalSegments = layout.verticalSegments;
+        int count = 0;
+        if (row == 0)
+        {
+            pTriangles[count++] = column;
+            return count;
+        }
+        if (row == verticalSegments)
+        {
+            pTriangles[count++] = GetTopFanStart(layout) + horizontalSegments - 1 - column;
+            return count;
+        }
 
-        // this.AddVertex(new Vector3(0,1,0) * radius, new Vector3(0,1,0), new Vector2(u, v));
-        Vertex vertex;
-        vertex.position = glm::vec3(0, 1, 0) * radius;
-        vertex.normal = glm::vec3(0, 1, 0);
-        vertex.tangent = glm::vec3(0, 0, 0);
-        vertex.texcoord = glm::vec2(u, v);
+        int ring = row - 1;
+        int j = column;
+        if (ring == 0)
+        {
+            if (j >= 1) pTriangles[count++] = j - 1;
+            if (j < horizontalSegments) pTriangles[count++] = j;
+        }
 
-        mVertices.push_back(vertex);
-    }
+        // The band below the ring, the ring is its upper edge
+        if (ring >= 1)
+        {
+            int base = horizontalSegments + (ring - 1) * horizontalSegments * 2;
+            if (j >= 1) pTriangles[count++] = base + (j - 1) * 2 + 1;
+            if (j < horizontalSegments) pTriangles[count++] = base + j * 2;
+            if (j < horizontalSegments) pTriangles[count++] = base + j * 2 + 1;
+        }
 
-    // Create a fan connecting the bottom vertex to the bottom latitude ring.
-    for (int i = 0; i < horizontalSegments; i++)
-    {
-        // this.AddIndex(i);
-        mIndices.push_back(i);
+        // The band above the ring, the ring is its lower edge
+        if (ring <= verticalSegments - 3)
+        {
+            int base = horizontalSegments + ring * horizontalSegments * 2;
+            if (j >= 1) pTriangles[count++] = base + (j - 1) * 2;
+            if (j >= 1) pTriangles[count++] = base + (j - 1) * 2 + 1;
+            if (j < horizontalSegments) pTriangles[count++] = base + j * 2;
+        }
 
-        // this.AddIndex(1 + i + horizontalSegments);
-        mIndices.push_back(1 + i + horizontalSegments);
+        if (ring == verticalSegments - 2)
+        {
+            int topFanStart = GetTopFanStart(layout);
+            if (j < horizontalSegments) pTriangles[count++] = topFanStart + horizontalSegments - 1 - j;
+            if (j >= 1) pTriangles[count++] = topFanStart + horizontalSegments - j;
+        }
+        return count;
+    }
 
-        // this.AddIndex(i + horizontalSegments);
-        mIndices.push_back(i + horizontalSegments);
+    struct SphereParams
+    {
+        float radius;
+        float uStart;
+        float uIncrement;
+        float vStart;
+        float vIncrement;
+        float vTop;
+    };
+
+    SphereParams GetParams(const SphereLayout& layout, float diameter, bool uvHorizontalFlip, bool uvVerticalFlip)
+    {
+        SphereParams params;
+        params.radius = diameter / 2.0f;
+        params.uIncrement = (1.0f / layout.horizontalSegments) * (uvHorizontalFlip ? 1.0f : -1.0f);
+        params.vIncrement = (1.0f / layout.verticalSegments) * (uvVerticalFlip ? 1.0f : -1.0f);
+        params.uStart = uvHorizontalFlip ? 0.0f : 1.0f;
+        params.vStart = uvVerticalFlip ? 0.0f : 1.0f;
+        params.vTop = uvVerticalFlip ? 1.0f : 0.0f;
+        return params;
     }
 
-    // Fill the sphere body with triangles joining each pair of latitude rings.
-    for (int i = 0; i < verticalSegments - 2; i++)
+    // Positions, normals and texture coordinates of one row. The texture coordinates are accumulated exactly like the
+    // serial generator does, the rows only depend on their index
+    void WriteRowVertices(const SphereLayout& layout, const SphereParams& params, int row, Primitives::Vertex* pVertices)
     {
-        for (int j = 0; j < horizontalSegments; j++)
+        Primitives::Vertex* pRow = pVertices + GetRowStart(layout, row);
+        int horizontalSegments = layout.horizontalSegments;
+        if (row == 0 || row == layout.verticalSegments)
         {
-            int nextI = i + 1;
-            int nextJ = j + 1;
-            int num = horizontalSegments + 1;
-
-            int i1 = horizontalSegments + (i * num) + j;
-            int i2 = horizontalSegments + (i * num) + nextJ;
-            int i3 = horizontalSegments + (nextI * num) + j;
-            int i4 = i3 + 1;
-
-            // this.AddIndex(i1);
-            mIndices.push_back(i1);
+            float y = (row == 0) ? -1.0f : 1.0f;
+            float v = (row == 0) ? params.vStart : params.vTop;
+            float u = params.uStart;
+            for (int i = 0; i < horizontalSegments; i++)
+            {
+                u += params.uIncrement;
+                pRow[i].position = glm::vec3(0, y, 0) * params.radius;
+                pRow[i].normal = glm::vec3(0, y, 0);
+                pRow[i].tangent = glm::vec3(0, 0, 0);
+                pRow[i].texcoord = glm::vec2(u, v);
+            }
+            return;
+        }
 
-            // this.AddIndex(i2);
-            mIndices.push_back(i2);
+        int ring = row - 1;
+        float v = params.vStart;
+        for (int i = 0; i <= ring; i++)
+        {
+            v += params.vIncrement;
+        }
 
-            // this.AddIndex(i3);
-            mIndices.push_back(i3);
+        float latitude = (((ring + 1) * glm::pi <float>()) / layout.verticalSegments) - glm::pi<float>() / 2.0f;
+        float u = params.uStart;
+        float dy = glm::sin(latitude);
+        float dxz = glm::cos(latitude);
+        for (int j = 0; j <= horizontalSegments; j++)
+        {
+            float longitude = j * glm::pi <float>() * 2 / horizontalSegments;
 
-            // this.AddIndex(i2);
-            mIndices.push_back(i2);
+            float dx = glm::sin(longitude) * dxz;
+            float dz = glm::cos(longitude) * dxz;
 
-            // this.AddIndex(i4);
-            mIndices.push_back(i4);
+            glm::vec3 normal(dx, dy, dz);
+            pRow[j].position = normal * params.radius;
+            pRow[j].normal = normal;
+            pRow[j].tangent = glm::vec3(0, 0, 0);
+            pRow[j].texcoord = glm::vec2(u, v);
+            u += params.uIncrement;
+        }
+    }
 
-            // this.AddIndex(i3);
-            mIndices.push_back(i3);
+    // Gathers the tangents of the triangles around each vertex of the row, in index buffer order so the sums
+    // are the same as the serial scatter. Nothing is written outside of the row
+    void WriteRowTangents(const SphereLayout& layout, int row, Primitives::Vertex* pVertices)
+    {
+        int rowStart = GetRowStart(layout, row);
+        int rowSize = (row == 0 || row == layout.verticalSegments) ? layout.horizontalSegments : layout.horizontalSegments + 1;
+        for (int column = 0; column < rowSize; column++)
+        {
+            int triangles[6];
+            int triangleCount = GetIncidentTriangles(layout, row, column, triangles);
+
+            glm::vec3 t(0.0f);
+            for (int k = 0; k < triangleCount; k++)
+            {
+                int i1, i2, i3;
+                GetTriangle(layout, triangles[k], i1, i2, i3);
+                t += Primitives::ComputeTriangleTangent(pVertices[i1], pVertices[i2], pVertices[i3]);
+            }
+
+            Primitives::Vertex& vertex = pVertices[rowStart + column];
+            vertex.tangent = Primitives::OrthogonalizeTangent(vertex.normal, t);
         }
     }
 
-    // Create a fan connecting the top vertex to the top latitude ring.
-    for (int i = 0; i < horizontalSegments; i++)
+    template<typename Index>
+    void GenerateParallelImpl(float diameter, int tessellation, Primitives::Vertex* pVertices, Index* pIndices, CppDirectXRayTracing21::ThreadPool* pPool, bool uvHorizontalFlip, bool uvVerticalFlip)
     {
-        // this.AddIndex(this.VerticesCount - 1 - i);
-        mIndices.push_back(static_cast<uint16_t>(mVertices.size() - 1 - i));
+        SphereLayout layout = GetLayout(tessellation);
+        CheckIndexRange<Index>(layout);
+        SphereParams params = GetParams(layout, diameter, uvHorizontalFlip, uvVerticalFlip);
+        int rowCount = layout.verticalSegments + 1;
 
-        // this.AddIndex(this.VerticesCount - horizontalSegments - 2 - i);
-        mIndices.push_back(static_cast<uint16_t>(mVertices.size() - horizontalSegments - 2 - i));
+        // The tangent pass reads the neighbor rows, all positions must be written first
+        CppDirectXRayTracing21::ParallelFor(pPool, rowCount, [&](int begin, int end)
+        {
+            for (int row = begin; row < end; row++)
+            {
+                WriteRowVertices(layout, params, row, pVertices);
+            }
+        });
+        CppDirectXRayTracing21::ParallelFor(pPool, rowCount, [&](int begin, int end)
+        {
+            for (int row = begin; row < end; row++)
+            {
+                WriteRowTangents(layout, row, pVertices);
+            }
+        });
+        CppDirectXRayTracing21::ParallelFor(pPool, layout.triangleCount, [&](int begin, int end)
+        {
+            for (int t = begin; t < end; t++)
+            {
+                int i1, i2, i3;
+                GetTriangle(layout, t, i1, i2, i3);
+                pIndices[t * 3 + 0] = static_cast<Index>(i1);
+                pIndices[t * 3 + 1] = static_cast<Index>(i2);
+                pIndices[t * 3 + 2] = static_cast<Index>(i3);
+            }
+        });
+    }
 
-        // this.AddIndex(this.VerticesCount - horizontalSegments - 1 - i);
-        mIndices.push_back(static_cast<uint16_t>(mVertices.size() - horizontalSegments - 1 - i));
+    template<typename Index>
+    void GenerateIndicesImpl(int tessellation, Index* pIndices)
+    {
+        SphereLayout layout = GetLayout(tessellation);
+        CheckIndexRange<Index>(layout);
+        ForEachTriangle(layout, [&pIndices](int i1, int i2, int i3)
+        {
+            *pIndices++ = static_cast<Index>(i1);
+            *pIndices++ = static_cast<Index>(i2);
+            *pIndices++ = static_cast<Index>(i3);
+        });
     }
+}
 
-    CalculateTangentSpace();
+uint32_t Primitives::Sphere::GetVertexCount(int tessellation)
+{
+    return static_cast<uint32_t>(GetLayout(tessellation).vertexCount);
 }
 
-void Primitives::Sphere::Transform(glm::mat4 transform)
+uint32_t Primitives::Sphere::GetIndexCount(int tessellation)
 {
-    for (int i = 0; i < mVertices.size(); i++)
+    return static_cast<uint32_t>(GetLayout(tessellation).triangleCount * 3);
+}
+
+Primitives::IndexFormat Primitives::Sphere::GetIndexFormat(int tessellation)
+{
+    return SelectIndexFormat(GetVertexCount(tessellation));
+}
+
+void Primitives::Sphere::Init(float diameter, int tessellation, bool uvHorizontalFlip, bool uvVerticalFlip, CppDirectXRayTracing21::ThreadPool* pPool)
+{
+    // Sized once, the generator fills the storage in place
+    mIndexFormat = GetIndexFormat(tessellation);
+    mVertices.resize(GetVertexCount(tessellation));
+    mIndices.clear();
+    mIndices32.clear();
+    if (mIndexFormat == IndexFormat::UInt32)
     {
-        glm::vec4 res = transform * glm::vec4(mVertices[i].position, 1.0f);
-        mVertices[i].position = glm::vec3(res.x, res.y, res.z);
+        mIndices32.resize(GetIndexCount(tessellation));
+        GenerateParallel(diameter, tessellation, mVertices.data(), mIndices32.data(), pPool, uvHorizontalFlip, uvVerticalFlip);
+    }
+    else
+    {
+        mIndices.resize(GetIndexCount(tessellation));
+        GenerateParallel(diameter, tessellation, mVertices.data(), mIndices.data(), pPool, uvHorizontalFlip, uvVerticalFlip);
     }
 }
 
-std::vector<Primitives::Vertex> Primitives::Sphere::GetVertices()
+void Primitives::Sphere::GenerateParallel(float diameter, int tessellation, Vertex* pVertices, uint16_t* pIndices, CppDirectXRayTracing21::ThreadPool* pPool, bool uvHorizontalFlip, bool uvVerticalFlip)
 {
-    return mVertices;
+    GenerateParallelImpl(diameter, tessellation, pVertices, pIndices, pPool, uvHorizontalFlip, uvVerticalFlip);
 }
 
-std::vector<uint16_t> Primitives::Sphere::GetIndices()
+void Primitives::Sphere::GenerateParallel(float diameter, int tessellation, Vertex* pVertices, uint32_t* pIndices, CppDirectXRayTracing21::ThreadPool* pPool, bool uvHorizontalFlip, bool uvVerticalFlip)
 {
-    return mIndices;
+    GenerateParallelImpl(diameter, tessellation, pVertices, pIndices, pPool, uvHorizontalFlip, uvVerticalFlip);
 }
 
-void Primitives::Sphere::CalculateTangentSpace()
+void Primitives::Sphere::GenerateVertices(float diameter, int tessellation, Vertex* pVertices, bool uvHorizontalFlip, bool uvVerticalFlip)
 {
-    int vertexCount = static_cast<int>(mVertices.size());
-    int triangleCount = static_cast<int> (mIndices.size()) / 3;
-    //todo: check if correct
-    std::vector<glm::vec3> tan1,tan2;
-    tan1.resize(vertexCount * 2);
-    tan2.resize(vertexCount * 2);
-    for (auto& t2 : tan2)
-        t2 += vertexCount;
+    SphereLayout layout = GetLayout(tessellation);
+    int verticalSegments = layout.verticalSegments;
+    int horizontalSegments = layout.horizontalSegments;
+    float uIncrement = 1.0f / horizontalSegments;
+    float vIncrement = 1.0f / verticalSegments;
+    float radius = diameter / 2.0f;
+
+    uIncrement *= uvHorizontalFlip ? 1.0f : -1.0f;
+    vIncrement *= uvVerticalFlip ? 1.0f : -1.0f;
+
+    float u = uvHorizontalFlip ? 0.0f : 1.0f;
+    float v = uvVerticalFlip ? 0.0f : 1.0f;
 
-    Vertex a1, a2, a3;
-    glm::vec3 v1, v2, v3;
-    glm::vec2 w1, w2, w3;
+    // The tangents need the whole mesh. Normals and texture coordinates are kept aside, the position is normal * radius
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texcoords;
+    normals.reserve(layout.vertexCount);
+    texcoords.reserve(layout.vertexCount);
 
-    for (int a = 0; a < triangleCount; a++)
+    // Start with a single vertex at the bottom of the sphere.
+    for (int i = 0; i < horizontalSegments; i++)
     {
-        uint16_t i1 = mIndices[(a * 3) + 0];
-        uint16_t i2 = mIndices[(a * 3) + 1];
-        uint16_t i3 = mIndices[(a * 3) + 2];
+        u += uIncrement;
+        normals.push_back(glm::vec3(0, -1, 0));
+        texcoords.push_back(glm::vec2(u, v));
+    }
 
-        a1 = mVertices[i1];
-        a2 = mVertices[i2];
-        a3 = mVertices[i3];
+    // Create rings of vertices at progressively higher latitudes.
+    v = uvVerticalFlip ? 0.0f : 1.0f;
+    for (int i = 0; i < verticalSegments - 1; i++)
+    {
+        float latitude = (((i + 1) * glm::pi <float>()) / verticalSegments) - glm::pi<float>() / 2.0f;
+        u = uvHorizontalFlip ? 0.0f : 1.0f;
+        v += vIncrement;
+        float dy = glm::sin(latitude);
+        float dxz = glm::cos(latitude);
+
+        // Create a single ring of vertices at this latitude.
+        for (int j = 0; j <= horizontalSegments; j++)
+        {
+            float longitude = j * glm::pi <float>() * 2 / horizontalSegments;
+
+            float dx = glm::sin(longitude) * dxz;
+            float dz = glm::cos(longitude) * dxz;
+
+            normals.push_back(glm::vec3(dx, dy, dz));
+            texcoords.push_back(glm::vec2(u, v));
+            u += uIncrement;
+        }
+    }
+
+    // Finish with a single vertex at the top of the sphere.
+    v = uvVerticalFlip ? 1.0f : 0.0f;
+    u = uvHorizontalFlip ? 0.0f : 1.0f;
+    for (int i = 0; i < horizontalSegments; i++)
+    {
+        u += uIncrement;
+        normals.push_back(glm::vec3(0, 1, 0));
+        texcoords.push_back(glm::vec2(u, v));
+    }
 
-        v1 = a1.position;
-        v2 = a2.position;
-        v3 = a3.position;
+    // Accumulate the texture-space tangent of every triangle on its vertices
+    std::vector<glm::vec3> tangents(layout.vertexCount, glm::vec3(0.0f));
+    ForEachTriangle(layout, [&](int i1, int i2, int i3)
+    {
+        glm::vec3 v1 = normals[i1] * radius;
+        glm::vec3 v2 = normals[i2] * radius;
+        glm::vec3 v3 = normals[i3] * radius;
 
-        w1 = a1.texcoord;
-        w2 = a2.texcoord;
-        w3 = a3.texcoord;
+        glm::vec2 w1 = texcoords[i1];
+        glm::vec2 w2 = texcoords[i2];
+        glm::vec2 w3 = texcoords[i3];
 
         float x1 = v2.x - v1.x;
         float x2 = v3.x - v1.x;
@@ -216,28 +470,44 @@ void Primitives::Sphere::CalculateTangentSpace()
 
         float r = 1.0F / ((s1 * t2) - (s2 * t1));
         glm::vec3 sdir(((t2 * x1) - (t1 * x2)) * r, ((t2 * y1) - (t1 * y2)) * r, ((t2 * z1) - (t1 * z2)) * r);
-        glm::vec3 tdir(((s1 * x2) - (s2 * x1)) * r, ((s1 * y2) - (s2 * y1)) * r, ((s1 * z2) - (s2 * z1)) * r);
 
-        tan1[i1] += sdir;
-        tan1[i2] += sdir;
-        tan1[i3] += sdir;
+        tangents[i1] += sdir;
+        tangents[i2] += sdir;
+        tangents[i3] += sdir;
+    });
 
-        tan2[i1] += tdir;
-        tan2[i2] += tdir;
-        tan2[i3] += tdir;
-    }
-
-    for (int a = 0; a < vertexCount; a++)
+    // Each vertex is written once, in order
+    for (int a = 0; a < layout.vertexCount; a++)
     {
-        Vertex vertex = mVertices[a];
+        glm::vec3 n = normals[a];
+        glm::vec3 t = tangents[a];
 
-        glm::vec3 n = vertex.normal;
-        glm::vec3 t = tan1[a];
+        Vertex vertex;
+        vertex.position = n * radius;
+        vertex.normal = n;
 
         // Gram-Schmidt orthogonalize
-        vertex.tangent = t - (n * glm::dot(n, t));
-        vertex.tangent = glm::normalize(vertex.tangent);
+        vertex.tangent = glm::normalize(t - (n * glm::dot(n, t)));
+        vertex.texcoord = texcoords[a];
+        pVertices[a] = vertex;
+    }
+}
+
+void Primitives::Sphere::GenerateIndices(int tessellation, uint16_t* pIndices)
+{
+    GenerateIndicesImpl(tessellation, pIndices);
+}
+
+void Primitives::Sphere::GenerateIndices(int tessellation, uint32_t* pIndices)
+{
+    GenerateIndicesImpl(tessellation, pIndices);
+}
 
-        mVertices[a] = vertex;
+void Primitives::Sphere::Transform(glm::mat4 transform)
+{
+    for (int i = 0; i < mVertices.size(); i++)
+    {
+        glm::vec4 res = transform * glm::vec4(mVertices[i].position, 1.0f);
+        mVertices[i].position = glm::vec3(res.x, res.y, res.z);
     }
 }
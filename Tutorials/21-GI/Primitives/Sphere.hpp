@@ -1,6 +1,11 @@
 #pragma once
 #include <vector>
-#include "Vertex.hpp"
+#include "MeshView.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	class ThreadPool;
+};
 
 namespace Primitives
 {
@@ -10,14 +15,42 @@ namespace Primitives
 		Sphere() = default;
 		~Sphere() = default;
 
-		void Init(float diameter, int tessellation, bool uvHorizontalFlip = false, bool uvVerticalFlip = false);
+		// The rings are generated on the pool's workers when one is given. The indices are 32-bit once the
+		// vertices don't fit 16 bits, see GetIndexFormat().
+		void Init(float diameter, int tessellation, bool uvHorizontalFlip = false, bool uvVerticalFlip = false, CppDirectXRayTracing21::ThreadPool* pPool = nullptr);
 		void Transform(glm::mat4 transform);
-		std::vector <Vertex> GetVertices();
-		std::vector <uint16_t> GetIndices();
+
+		// Views into the primitive's storage, no copy is made
+		ArrayView<Vertex> GetVertices() const { return mVertices; }
+		IndexView GetIndices() const { return (mIndexFormat == IndexFormat::UInt32) ? IndexView(mIndices32) : IndexView(mIndices); }
+		IndexFormat GetIndexFormat() const { return mIndexFormat; }
+		MeshView GetView() const { return { mVertices, GetIndices() }; }
+
+		// Moves the storage out, the primitive is empty afterwards
+		std::vector<Vertex> TakeVertices() { return std::move(mVertices); }
+		// Only the storage of GetIndexFormat() is filled, the other one is empty
+		std::vector<uint16_t> TakeIndices() { return std::move(mIndices); }
+		std::vector<uint32_t> TakeIndices32() { return std::move(mIndices32); }
+
+		// The generators write straight into caller memory, e.g. a mapped upload buffer. Every element is written
+		// exactly once, in order, and the destination is never read back.
+		static uint32_t GetVertexCount(int tessellation);
+		static uint32_t GetIndexCount(int tessellation);
+		static IndexFormat GetIndexFormat(int tessellation);
+		static void GenerateVertices(float diameter, int tessellation, Vertex* pVertices, bool uvHorizontalFlip = false, bool uvVerticalFlip = false);
+		static void GenerateIndices(int tessellation, uint16_t* pIndices);
+		static void GenerateIndices(int tessellation, uint32_t* pIndices);
+
+		// Fills bands of latitude rings in parallel, serially without a pool, and allocates nothing besides the caller's
+		// memory. The tangents are gathered per vertex from the triangles around it in a second pass, which reads the
+		// vertices back, so the destination should be system memory. The output matches the streaming generators bit for bit.
+		static void GenerateParallel(float diameter, int tessellation, Vertex* pVertices, uint16_t* pIndices, CppDirectXRayTracing21::ThreadPool* pPool, bool uvHorizontalFlip = false, bool uvVerticalFlip = false);
+		static void GenerateParallel(float diameter, int tessellation, Vertex* pVertices, uint32_t* pIndices, CppDirectXRayTracing21::ThreadPool* pPool, bool uvHorizontalFlip = false, bool uvVerticalFlip = false);
 	
 	private:
-		void CalculateTangentSpace();
+		IndexFormat mIndexFormat = IndexFormat::UInt16;
 		std::vector<uint16_t> mIndices;
+		std::vector<uint32_t> mIndices32;
 		std::vector <Vertex> mVertices;
 	};
 
@@ -0,0 +1,11 @@
+#pragma once
+#include "../Data/SphereIntersection.hlsli"
+
+namespace Primitives
+{
+	// Declared in SphereIntersection.hlsli, which is shared with the shaders, so both trace the same sphere.
+	using SphereIntersection::SphereAttributes;
+	using SphereIntersection::kSphereMiss;
+	using SphereIntersection::IntersectSphere;
+	using SphereIntersection::SphereNormal;
+};
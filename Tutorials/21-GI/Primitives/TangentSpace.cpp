@@ -0,0 +1,77 @@
+#pragma once
+#include "TangentSpace.hpp"
+#include "../RTX/ThreadPool.hpp"
+
+glm::vec3 Primitives::ComputeTriangleTangent(const Vertex& a, const Vertex& b, const Vertex& c)
+{
+    glm::vec3 v1 = a.position;
+    glm::vec3 v2 = b.position;
+    glm::vec3 v3 = c.position;
+
+    glm::vec2 w1 = a.texcoord;
+    glm::vec2 w2 = b.texcoord;
+    glm::vec2 w3 = c.texcoord;
+
+    float x1 = v2.x - v1.x;
+    float x2 = v3.x - v1.x;
+    float y1 = v2.y - v1.y;
+    float y2 = v3.y - v1.y;
+    float z1 = v2.z - v1.z;
+    float z2 = v3.z - v1.z;
+
+    float s1 = w2.x - w1.x;
+    float s2 = w3.x - w1.x;
+    float t1 = w2.y - w1.y;
+    float t2 = w3.y - w1.y;
+
+    // Meshes without texcoords would otherwise spread NaNs over every tangent they touch
+    float det = (s1 * t2) - (s2 * t1);
+    if (det == 0.0f)
+    {
+        return glm::vec3(0.0f);
+    }
+
+    float r = 1.0F / det;
+    return glm::vec3(((t2 * x1) - (t1 * x2)) * r, ((t2 * y1) - (t1 * y2)) * r, ((t2 * z1) - (t1 * z2)) * r);
+}
+
+glm::vec3 Primitives::OrthogonalizeTangent(const glm::vec3& normal, const glm::vec3& tangent)
+{
+    glm::vec3 t = tangent - (normal * glm::dot(normal, tangent));
+    if (glm::dot(t, t) > 1e-20f)
+    {
+        return glm::normalize(t);
+    }
+
+    // Any direction in the tangent plane, built from the axis least aligned with the normal
+    glm::vec3 axis = (std::abs(normal.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    t = axis - (normal * glm::dot(normal, axis));
+    return (glm::dot(t, t) > 1e-20f) ? glm::normalize(t) : axis;
+}
+
+void Primitives::CalculateTangentSpace(Vertex* pVertices, size_t vertexCount, IndexView indices, CppDirectXRayTracing21::ThreadPool* pPool)
+{
+    // Only the tangent is stored, the t direction (bitangent) isn't accumulated
+    std::vector<glm::vec3> tan1(vertexCount, glm::vec3(0.0f));
+
+    size_t triangleCount = indices.size() / 3;
+    for (size_t a = 0; a < triangleCount; a++)
+    {
+        uint32_t i1 = indices[(a * 3) + 0];
+        uint32_t i2 = indices[(a * 3) + 1];
+        uint32_t i3 = indices[(a * 3) + 2];
+
+        glm::vec3 sdir = ComputeTriangleTangent(pVertices[i1], pVertices[i2], pVertices[i3]);
+        tan1[i1] += sdir;
+        tan1[i2] += sdir;
+        tan1[i3] += sdir;
+    }
+
+    CppDirectXRayTracing21::ParallelFor(pPool, vertexCount, [&](size_t begin, size_t end)
+    {
+        for (size_t a = begin; a < end; a++)
+        {
+            pVertices[a].tangent = OrthogonalizeTangent(pVertices[a].normal, tan1[a]);
+        }
+    });
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "MeshView.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	class ThreadPool;
+};
+
+namespace Primitives
+{
+	// The s direction of a triangle's texture mapping, not normalized. Zero when the texcoords are degenerate.
+	// See Lengyel, "Computing Tangent Space Basis Vectors for an Arbitrary Mesh".
+	glm::vec3 ComputeTriangleTangent(const Vertex& a, const Vertex& b, const Vertex& c);
+
+	// Gram-Schmidt orthogonalize the accumulated tangent against the normal. A tangent that is zero or parallel
+	// to the normal is replaced by an arbitrary perpendicular direction.
+	glm::vec3 OrthogonalizeTangent(const glm::vec3& normal, const glm::vec3& tangent);
+
+	// Sums the triangle tangents around every vertex and orthogonalizes them. The sums are accumulated serially in
+	// index buffer order, only the per-vertex pass runs on the pool.
+	void CalculateTangentSpace(Vertex* pVertices, size_t vertexCount, IndexView indices, CppDirectXRayTracing21::ThreadPool* pPool = nullptr);
+};
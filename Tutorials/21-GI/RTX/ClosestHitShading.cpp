@@ -0,0 +1,78 @@
+#pragma once
+#include "ClosestHitShading.hpp"
+#include <algorithm>
+#include <cmath>
+
+float CppDirectXRayTracing21::NextRand(uint32_t& seed)
+{
+    seed = 1664525u * seed + 1013904223u;
+    return float(seed & 0x00FFFFFF) / float(0x01000000);
+}
+
+glm::vec3 CppDirectXRayTracing21::GetPerpendicularVector(const glm::vec3& u)
+{
+    glm::vec3 a = glm::abs(u);
+    uint32_t xm = ((a.x - a.y) < 0 && (a.x - a.z) < 0) ? 1 : 0;
+    uint32_t ym = (a.y - a.z) < 0 ? (1 ^ xm) : 0;
+    uint32_t zm = 1 ^ (xm | ym);
+    return glm::cross(u, glm::vec3(float(xm), float(ym), float(zm)));
+}
+
+glm::vec3 CppDirectXRayTracing21::CosineWeightedHemisphereSample(uint32_t& seed, const glm::vec3& normal)
+{
+    // Two statements, the order of the two random numbers is the one of the HLSL float2 constructor
+    float randomX = NextRand(seed);
+    float randomY = NextRand(seed);
+
+    glm::vec3 bitangent = GetPerpendicularVector(normal);
+    glm::vec3 tangent = glm::cross(bitangent, normal);
+    float r = std::sqrt(randomX);
+    float phi = 2.0f * 3.14159265f * randomY;
+
+    return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * std::sqrt(1 - randomX);
+}
+
+float CppDirectXRayTracing21::NormalDistribution(float NdotH, float roughness)
+{
+    float a2 = roughness * roughness;
+    float d = ((NdotH * a2 - NdotH) * NdotH + 1);
+    return a2 / (d * d * kShaderPi);
+}
+
+float CppDirectXRayTracing21::SchlickMaskingTerm(float NdotL, float NdotV, float roughness)
+{
+    float k = roughness * roughness / 2;
+    float gV = NdotV / (NdotV * (1 - k) + k);
+    float gL = NdotL / (NdotL * (1 - k) + k);
+    return gV * gL;
+}
+
+glm::vec3 CppDirectXRayTracing21::SchlickFresnel(const glm::vec3& f0, float LdotH)
+{
+    return f0 + (glm::vec3(1.0f) - f0) * std::pow(1.0f - LdotH, 5.0f);
+}
+
+glm::vec3 CppDirectXRayTracing21::GetGGXMicrofacet(uint32_t& seed, float roughness, const glm::vec3& normal)
+{
+    float randomX = NextRand(seed);
+    float randomY = NextRand(seed);
+
+    glm::vec3 B = GetPerpendicularVector(normal);
+    glm::vec3 T = glm::cross(B, normal);
+
+    float a2 = roughness * roughness;
+    float cosThetaH = std::sqrt(std::max(0.0f, (1.0f - randomX) / ((a2 - 1.0f) * randomX + 1)));
+    float sinThetaH = std::sqrt(std::max(0.0f, 1.0f - cosThetaH * cosThetaH));
+    float phiH = randomY * kShaderPi * 2.0f;
+
+    return T * (sinThetaH * std::cos(phiH)) + B * (sinThetaH * std::sin(phiH)) + normal * cosThetaH;
+}
+
+float CppDirectXRayTracing21::ProbabilityToSampleDiffuse(const glm::vec3& diffuse, const glm::vec3& specular)
+{
+    // Same weights as luminance() in GGX.hlsli
+    auto luminance = [](const glm::vec3& rgb) { return (rgb.x / 255.0f) * 0.3f + (rgb.y / 255.0f) * 0.59f + (rgb.z / 255.0f) * 0.11f; };
+    float lumDiffuse = std::max(0.01f, luminance(diffuse));
+    float lumSpecular = std::max(0.01f, luminance(specular));
+    return lumDiffuse / (lumDiffuse + lumSpecular);
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "ShaderPermutations.hpp"
+#include "Externals/GLM/glm/glm.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	// What chs() gathers from the hit, the material and the scene constants before shading.
+	struct ShadingInput
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec3 viewDir;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		float roughness;
+		glm::vec3 lightPosition;
+		glm::vec3 lightIntensity;
+		uint32_t aoSamples;
+		float maxRecursionDepth;
+	};
+
+	// CPU port of the sampling and BRDF helpers of Helpers.hlsli and GGX.hlsli, with the same constants,
+	// so a seed produces the same random sequence and the same rays as on the GPU.
+	static const float kShaderPi = 3.1415f;
+	static const float kIndirectTMin = 0.01f;
+	static const float kIndirectTMax = 1000.0f;
+
+	float NextRand(uint32_t& seed);
+	glm::vec3 GetPerpendicularVector(const glm::vec3& u);
+	glm::vec3 CosineWeightedHemisphereSample(uint32_t& seed, const glm::vec3& normal);
+	float NormalDistribution(float NdotH, float roughness);
+	float SchlickMaskingTerm(float NdotL, float NdotV, float roughness);
+	glm::vec3 SchlickFresnel(const glm::vec3& f0, float LdotH);
+	glm::vec3 GetGGXMicrofacet(uint32_t& seed, float roughness, const glm::vec3& normal);
+	float ProbabilityToSampleDiffuse(const glm::vec3& diffuse, const glm::vec3& specular);
+
+	// The Tracer stands in for TraceRay() and provides:
+	//   float ShadowRay(const glm::vec3& origin, const glm::vec3& dir, float tmin, float tmax);   1 when unoccluded
+	//   glm::vec3 IndirectRay(const glm::vec3& origin, const glm::vec3& dir, float tmin, float tmax, uint32_t seed, uint32_t depth);
+	template<ShadingMode Mode, typename Tracer>
+	glm::vec3 LambertianDirect(const ShadingInput& in, uint32_t& seed, Tracer& tracer)
+	{
+		float distToLight = glm::length(in.lightPosition - in.position);
+		glm::vec3 dirToLight = glm::normalize(in.lightPosition - in.position);
+
+		float NdotL = glm::clamp(glm::dot(in.normal, dirToLight), 0.0f, 1.0f);
+		float isLit = tracer.ShadowRay(in.position, dirToLight, 0.001f, distToLight);
+		glm::vec3 rayColor = isLit * in.lightIntensity;
+
+		// Only the AO permutation contains the occlusion loop
+		float ao = 1.0f;
+		if constexpr (Mode == ShadingMode::AmbientOcclusion)
+		{
+			if (in.aoSamples > 0)
+			{
+				float ambientOcclusion = 0.0f;
+				for (uint32_t i = 0; i < in.aoSamples; i++)
+				{
+					glm::vec3 aoDir = CosineWeightedHemisphereSample(seed, in.normal);
+					ambientOcclusion += tracer.ShadowRay(in.position, aoDir, 0.001f, 100.0f);
+				}
+				ao = ambientOcclusion / float(in.aoSamples);
+			}
+		}
+
+		return (NdotL * rayColor * (in.diffuse / 3.14f)) * ao;
+	}
+
+	template<typename Tracer>
+	glm::vec3 LambertianIndirect(const ShadingInput& in, uint32_t& seed, uint32_t depth, Tracer& tracer)
+	{
+		glm::vec3 dir = CosineWeightedHemisphereSample(seed, in.normal);
+		glm::vec3 indirect = tracer.IndirectRay(in.position, dir, kIndirectTMin, kIndirectTMax, seed, depth);
+		return in.diffuse * indirect;
+	}
+
+	template<typename Tracer>
+	glm::vec3 GgxDirect(const ShadingInput& in, uint32_t& seed, Tracer& tracer)
+	{
+		const glm::vec3& N = in.normal;
+		const glm::vec3& V = in.viewDir;
+		float distToLight = glm::length(in.lightPosition - in.position);
+		glm::vec3 L = glm::normalize(in.lightPosition - in.position);
+
+		float NdotL = glm::clamp(glm::dot(N, L), 0.0f, 1.0f);
+		float isLit = tracer.ShadowRay(in.position, L, 0.001f, distToLight);
+
+		glm::vec3 H = glm::normalize(V + L);
+		float NdotH = glm::clamp(glm::dot(N, H), 0.0f, 1.0f);
+		float LdotH = glm::clamp(glm::dot(L, H), 0.0f, 1.0f);
+		float NdotV = glm::clamp(glm::dot(N, V), 0.0f, 1.0f);
+
+		float D = NormalDistribution(NdotH, in.roughness);
+		float G = SchlickMaskingTerm(NdotL, NdotV, in.roughness);
+		glm::vec3 F = SchlickFresnel(in.specular, LdotH);
+		glm::vec3 ggxTerm = D * G * F / (4 * NdotV);
+
+		return isLit * in.lightIntensity * (ggxTerm + NdotL * in.diffuse / kShaderPi);
+	}
+
+	template<typename Tracer>
+	glm::vec3 GgxIndirect(const ShadingInput& in, uint32_t& seed, uint32_t depth, Tracer& tracer)
+	{
+		const glm::vec3& N = in.normal;
+		const glm::vec3& V = in.viewDir;
+		float probDiffuse = ProbabilityToSampleDiffuse(in.diffuse, in.specular);
+		bool chooseDiffuse = NextRand(seed) < probDiffuse;
+		float NdotV = glm::clamp(glm::dot(N, V), 0.0f, 1.0f);
+
+		if (chooseDiffuse)
+		{
+			glm::vec3 L = CosineWeightedHemisphereSample(seed, N);
+			glm::vec3 bounceColor = tracer.IndirectRay(in.position, L, 0.01f, 100000.0f, seed, depth);
+			return bounceColor * in.diffuse / probDiffuse;
+		}
+
+		glm::vec3 H = GetGGXMicrofacet(seed, in.roughness, N);
+		glm::vec3 L = glm::normalize(2.0f * glm::dot(V, H) * H - V);
+		glm::vec3 bounceColor = tracer.IndirectRay(in.position, L, 0.01f, 100000.0f, seed, depth);
+
+		float NdotL = glm::clamp(glm::dot(N, L), 0.0f, 1.0f);
+		float NdotH = glm::clamp(glm::dot(N, H), 0.0f, 1.0f);
+		float LdotH = glm::clamp(glm::dot(L, H), 0.0f, 1.0f);
+
+		float D = NormalDistribution(NdotH, in.roughness);
+		float G = SchlickMaskingTerm(NdotL, NdotV, in.roughness);
+		glm::vec3 F = SchlickFresnel(in.specular, LdotH);
+		glm::vec3 ggxTerm = D * G * F / (4 * NdotL * NdotV);
+		float ggxProb = D * NdotH / (4 * LdotH);
+
+		return NdotL * bounceColor * ggxTerm / (ggxProb * (1.0f - probDiffuse));
+	}
+
+	// Port of chs() after the attribute fetch. The mode is a template parameter, so each instantiation only
+	// contains the code of its permutation, like the DXIL library compiled with the matching SHADING_MODE.
+	// recursionDepth is the payload's, it is incremented when an indirect ray was traced.
+	template<ShadingMode Mode, typename Tracer>
+	glm::vec3 ShadeClosestHit(const ShadingInput& in, uint32_t& seed, uint32_t& recursionDepth, Tracer& tracer)
+	{
+		static_assert(Mode != ShadingMode::Count, "Count is not a shading mode");
+
+		glm::vec3 color;
+		if constexpr (Mode == ShadingMode::GgxGI)
+		{
+			color = GgxDirect(in, seed, tracer);
+		}
+		else
+		{
+			color = LambertianDirect<Mode>(in, seed, tracer);
+		}
+
+		// The recursion depth is per-ray data, it stays a runtime test
+		if constexpr (Mode != ShadingMode::AmbientOcclusion)
+		{
+			if (recursionDepth < in.maxRecursionDepth)
+			{
+				if constexpr (Mode == ShadingMode::GgxGI)
+				{
+					color += GgxIndirect(in, seed, recursionDepth, tracer);
+				}
+				else
+				{
+					color += LambertianIndirect(in, seed, recursionDepth, tracer);
+				}
+				recursionDepth++;
+			}
+		}
+		return color;
+	}
+
+	// Picks the specialization at runtime, the CPU counterpart of switching the hit group.
+	template<typename Tracer>
+	glm::vec3 ShadeClosestHit(ShadingMode mode, const ShadingInput& in, uint32_t& seed, uint32_t& recursionDepth, Tracer& tracer)
+	{
+		switch (mode)
+		{
+		case ShadingMode::AmbientOcclusion: return ShadeClosestHit<ShadingMode::AmbientOcclusion>(in, seed, recursionDepth, tracer);
+		case ShadingMode::GgxGI:            return ShadeClosestHit<ShadingMode::GgxGI>(in, seed, recursionDepth, tracer);
+		default:                            return ShadeClosestHit<ShadingMode::LambertGI>(in, seed, recursionDepth, tracer);
+		}
+	}
+};
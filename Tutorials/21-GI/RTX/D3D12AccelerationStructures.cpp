@@ -1,123 +1,337 @@
 #pragma once
 #include "D3D12AccelerationStructures.hpp"
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
+#include <sstream>
 
-ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::createBuffer(ID3D12Device5Ptr pDevice, uint64_t size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState, const D3D12_HEAP_PROPERTIES& heapProps)
+CppDirectXRayTracing21::D3D12AccelerationStructures::D3D12AccelerationStructures()
+    : mLodSelector(kInstancesNum)
 {
-    D3D12_RESOURCE_DESC bufDesc = {};
-    bufDesc.Alignment = 0;
-    bufDesc.DepthOrArraySize = 1;
-    bufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    bufDesc.Flags = flags;
-    bufDesc.Format = DXGI_FORMAT_UNKNOWN;
-    bufDesc.Height = 1;
-    bufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-    bufDesc.MipLevels = 1;
-    bufDesc.SampleDesc.Count = 1;
-    bufDesc.SampleDesc.Quality = 0;
-    bufDesc.Width = size;
+    mat4 transformation[kInstancesNum];
+    transformation[0] = glm::translate(glm::mat4(1.0), glm::vec3(0.0f, -0.5f, 0.0f)); // Identity
+    transformation[1] = translate(mat4(), vec3(0, 0.0, 0));
+    transformation[2] = translate(mat4(), vec3(0.7, 0.0, -3));
+    transformation[3] = translate(mat4(), vec3(2, 0.0, -3));
 
-    ID3D12ResourcePtr pBuffer;
-    d3d_call(pDevice->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufDesc, initState, nullptr, IID_PPV_ARGS(&pBuffer)));
-    return pBuffer;
+    // Plane: 0, spheres: 1-3, one material per instance
+    for (int i = 0; i < kInstancesNum; i++)
+    {
+        mat4 m = transpose(transformation[i]);
+        memcpy(mInstances[i].transform, &m, sizeof(mInstances[i].transform));
+        mInstances[i].mesh = (i == 0) ? kPlaneMesh : kSphereMesh;
+        mInstances[i].material = i;
+    }
 }
 
-CppDirectXRayTracing21::AccelerationStructureBuffers CppDirectXRayTracing21::D3D12AccelerationStructures::createPrimitiveBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList)
+void CppDirectXRayTracing21::D3D12AccelerationStructures::SetMemoryAllocator(D3D12MemoryAllocator* pAllocator)
 {
-    ID3D12ResourcePtr vb = CreateSphereVB(pDevice);
-    ID3D12ResourcePtr ib = CreateSphereIB(pDevice);
-
-    mSphereVertexBuffer = vb;
-    mSphereIndexBuffer = ib;
-    
-    int vertexCount = static_cast<int>(mSphere.GetVertices().size());
-    int indexCount = static_cast<int>(mSphere.GetIndices().size());
-    return createBottomLevelAS(pDevice, pCmdList,vb,ib, vertexCount, indexCount);
+    mpAllocator = pAllocator;
 }
 
-CppDirectXRayTracing21::AccelerationStructureBuffers CppDirectXRayTracing21::D3D12AccelerationStructures::createCubeBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList)
+void CppDirectXRayTracing21::D3D12AccelerationStructures::SetUploader(D3D12CopyQueueUploader* pUploader)
 {
-    auto& primitive = mQuad;
-    auto& vb = CreateCubeVB(pDevice);
-    auto& ib = CreateCubeIB(pDevice);
+    mpUploader = pUploader;
+}
 
-    mQuadVertexBuffer = vb;
-    mQuadIndexBuffer = ib;
-    
-    int vertexCount = static_cast<int>(primitive.GetVertices().size());
-    int indexCount = static_cast<int>(primitive.GetIndices().size());
-    return createBottomLevelAS(pDevice, pCmdList, vb, ib, vertexCount, indexCount);
+uint64_t CppDirectXRayTracing21::D3D12AccelerationStructures::GetSceneSourceKey()
+{
+    // Bump kGeneratorVersion whenever the generators or the vertex packing change the output
+    static const uint32_t kGeneratorVersion = 4;
+    struct
+    {
+        uint32_t generatorVersion = kGeneratorVersion;
+        float quadSize = kQuadSize;
+        float sphereDiameter = kSphereDiameter;
+        int32_t sphereTessellation = kSphereTessellation;
+        uint32_t instanceCount = kInstancesNum;
+        uint32_t attributeSize = sizeof(Primitives::PackedVertexAttributes);
+        uint32_t lodCount = kLodCount;
+        float lodMaxError = kLodMaxError;
+    } parameters;
+    return ComputeChecksum(&parameters, sizeof(parameters));
 }
 
-ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::CreateCubeVB(ID3D12Device5Ptr pDevice)
+bool CppDirectXRayTracing21::D3D12AccelerationStructures::loadGeometry(const SceneCacheReader& cache, uint32_t materialCount)
 {
-    // Vertex buffer
-    auto& primitive = mQuad;
-    int vertexCount = static_cast<int>(primitive.GetVertices().size());
-    ID3D12ResourcePtr vBuffer = createBuffer(pDevice, sizeof(Primitives::Vertex) * vertexCount, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
-    uint8_t* vData;
-    vBuffer->Map(0, nullptr, (void**)&vData);
-    memcpy(vData, &primitive.GetVertices().data()[0], sizeof(Primitives::Vertex) * vertexCount);
-    vBuffer->Unmap(0, nullptr);
+    Primitives::ArrayView<SceneCacheMesh> meshes = cache.GetArray<SceneCacheMesh>(SceneCacheSection::Meshes);
+    Primitives::ArrayView<glm::vec3> positions = cache.GetArray<glm::vec3>(SceneCacheSection::Positions);
+    Primitives::ArrayView<Primitives::PackedVertexAttributes> attributes = cache.GetArray<Primitives::PackedVertexAttributes>(SceneCacheSection::Attributes);
+    Primitives::ArrayView<SceneCacheInstance> instances = cache.GetArray<SceneCacheInstance>(SceneCacheSection::Instances);
+    const SceneCacheSectionEntry* pIndices = cache.FindSection(SceneCacheSection::Indices);
+    if (meshes.size() != kMeshLodNum || instances.size() != kInstancesNum || pIndices == nullptr || positions.size() != attributes.size())
+    {
+        return false;
+    }
 
-    return vBuffer;
+    // Only the ranges are checked, the content is covered by the section checksums
+    for (const SceneCacheMesh& mesh : meshes)
+    {
+        uint64_t indexSize = Primitives::GetIndexBufferSize(mesh.indexCount, static_cast<Primitives::IndexFormat>(mesh.indexFormat));
+        if (uint64_t(mesh.firstVertex) + mesh.vertexCount > positions.size() || mesh.indexFormat > static_cast<uint32_t>(Primitives::IndexFormat::UInt32) ||
+            mesh.indexOffset % 4 != 0 || mesh.indexOffset > pIndices->size || indexSize > pIndices->size - mesh.indexOffset)
+        {
+            return false;
+        }
+    }
+    for (const SceneCacheInstance& instance : instances)
+    {
+        if (instance.mesh >= kDefaultNumDesc || instance.material >= materialCount)
+        {
+            return false;
+        }
+    }
+
+    memcpy(mInstances, instances.data(), sizeof(mInstances));
+    return uploadMeshes(meshes, positions, attributes, cache.GetSectionData(*pIndices));
 }
 
-ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::CreateCubeIB(ID3D12Device5Ptr pDevice)
+bool CppDirectXRayTracing21::D3D12AccelerationStructures::generateGeometry(SceneCacheWriter& writer, ThreadPool* pPool)
 {
-    auto& primitive = mQuad;
-    int indexCount = static_cast<int>(primitive.GetIndices().size());
+    Primitives::Quad quad;
+    quad.Init(kQuadSize);
+    Primitives::Sphere sphere;
+    sphere.Init(kSphereDiameter, kSphereTessellation);
+
+    // Every placement is handed over as a separate mesh, the way an imported scene lists its objects. The builder finds
+    // the copies, the three spheres end up as instances of one mesh. The plane comes first, so the mesh order is kept
+    SceneBuilder builder;
+    for (int i = 0; i < kInstancesNum; i++)
+    {
+        glm::mat4 transform(1.0f);
+        for (int row = 0; row < 3; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                transform[column][row] = mInstances[i].transform[row][column];
+            }
+        }
+        builder.AddMesh((mInstances[i].mesh == kPlaneMesh) ? quad.GetView() : sphere.GetView(), transform, mInstances[i].material);
+    }
+
+    std::vector<SceneBuilder::Mesh> builtMeshes = builder.TakeMeshes();
+    std::vector<SceneCacheInstance> builtInstances = builder.TakeInstances();
+    if (builtMeshes.size() != kDefaultNumDesc)
+    {
+        msgBox("The scene builder found " + std::to_string(builtMeshes.size()) + " distinct meshes, " + std::to_string(kDefaultNumDesc) + " were expected");
+        return false;
+    }
+    memcpy(mInstances, builtInstances.data(), sizeof(mInstances));
+
+    // Every mesh is simplified into its LOD chain. The generators emit in construction order, ring by ring for the sphere. Every level
+    // is reordered for vertex locality, which the BLAS build and the hit shaders' attribute fetches both benefit from
+    static const char* kMeshNames[kDefaultNumDesc] = { "plane", "sphere" };
+    std::stringstream report;
+    report << "mesh,lod,instances,triangles,error,acmr_before,acmr_after,atvr_before,atvr_after,overfetch_before,overfetch_after\n";
+    report.precision(3);
+    report << std::fixed;
+
+    std::vector<Primitives::Vertex> lodVertices[kMeshLodNum];
+    std::vector<uint32_t> lodIndices[kMeshLodNum];
+    std::vector<uint16_t> indices16[kMeshLodNum];
+    Primitives::MeshView views[kMeshLodNum];
+    int lodCounts[kDefaultNumDesc];
+    for (int i = 0; i < kDefaultNumDesc; i++)
+    {
+        const SceneBuilder::Mesh& built = builtMeshes[i];
+        std::vector<Primitives::MeshLod> chain = Primitives::BuildLodChain(built.vertices, built.indices, kLodCount, kLodMaxError, pPool);
+        lodCounts[i] = static_cast<int>(chain.size());
+        for (int lod = 0; lod < lodCounts[i]; lod++)
+        {
+            int meshLod = GetMeshLod(i, lod);
+            std::vector<Primitives::Vertex>& vertices = lodVertices[meshLod];
+            std::vector<uint32_t>& levelIndices = lodIndices[meshLod];
+            vertices = built.vertices;
+            levelIndices = std::move(chain[lod].indices);
+            Primitives::MeshLocalityStatistics before = Primitives::AnalyzeMeshLocality(levelIndices, vertices.size(), sizeof(Primitives::PackedVertexAttributes));
+            // The levels share the source vertices, the optimization drops the ones a level doesn't use
+            Primitives::OptimizeMesh(vertices, levelIndices);
+
+            // The builder works on 32-bit indices, they are narrowed again when the vertices allow it
+            if (Primitives::SelectIndexFormat(vertices.size()) == Primitives::IndexFormat::UInt16)
+            {
+                indices16[meshLod].resize(levelIndices.size());
+                std::transform(levelIndices.begin(), levelIndices.end(), indices16[meshLod].begin(), [](uint32_t index) { return static_cast<uint16_t>(index); });
+                views[meshLod] = { vertices, indices16[meshLod] };
+            }
+            else
+            {
+                views[meshLod] = { vertices, levelIndices };
+            }
+            Primitives::MeshLocalityStatistics after = Primitives::AnalyzeMeshLocality(views[meshLod].indices, vertices.size(), sizeof(Primitives::PackedVertexAttributes));
+
+            report << kMeshNames[i] << "," << lod << "," << built.instanceCount << "," << views[meshLod].indices.size() / 3 << "," << chain[lod].error << "," << before.acmr << "," << after.acmr
+                   << "," << before.atvr << "," << after.atvr << "," << before.overfetch << "," << after.overfetch << "\n";
+        }
+    }
+    mMeshLocalityReport = report.str();
+
+    // Laid out as in the cache: the mesh levels back to back in each stream, the indices of every level padded to whole words.
+    // The levels past the end of a chain repeat the entry of the coarsest one
+    std::vector<SceneCacheMesh> meshes(kMeshLodNum);
+    std::vector<glm::vec3> positions;
+    std::vector<Primitives::PackedVertexAttributes> attributes;
+    std::vector<uint8_t> indices;
+    for (int i = 0; i < kMeshLodNum; i++)
+    {
+        SceneCacheMesh& mesh = meshes[i];
+        if (i % kLodCount >= lodCounts[i / kLodCount])
+        {
+            mesh = meshes[i - 1];
+            continue;
+        }
+
+        const Primitives::MeshView& view = views[i];
+        mesh.firstVertex = static_cast<uint32_t>(positions.size());
+        mesh.vertexCount = static_cast<uint32_t>(view.vertices.size());
+        mesh.indexOffset = indices.size();
+        mesh.indexCount = static_cast<uint32_t>(view.indices.size());
+        mesh.indexFormat = static_cast<uint32_t>(view.indices.format());
+
+        positions.resize(positions.size() + view.vertices.size());
+        attributes.resize(positions.size());
+        Primitives::PackVertices(view.vertices, &positions[mesh.firstVertex], &attributes[mesh.firstVertex]);
+
+        indices.resize(indices.size() + Primitives::GetIndexBufferSize(view.indices.size(), view.indices.format()), 0);
+        memcpy(&indices[mesh.indexOffset], view.indices.data(), view.indices.size_bytes());
+    }
 
-    ID3D12ResourcePtr iBuffer = createBuffer(pDevice, sizeof(uint16_t) * indexCount, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
-    uint8_t* iData;
-    iBuffer->Map(0, nullptr, (void**)&iData);
-    memcpy(iData, &primitive.GetIndices().data()[0], sizeof(uint16_t) * indexCount);
-    iBuffer->Unmap(0, nullptr);
+    writer.AddSection(SceneCacheSection::Meshes, meshes);
+    writer.AddSection(SceneCacheSection::Positions, positions);
+    writer.AddSection(SceneCacheSection::Attributes, attributes);
+    writer.AddSection(SceneCacheSection::Indices, indices.data(), indices.size(), 1);
+    writer.AddSection(SceneCacheSection::Instances, mInstances, sizeof(mInstances), sizeof(SceneCacheInstance));
 
-    return iBuffer;
+    return uploadMeshes(meshes, positions, attributes, indices.data());
 }
 
-ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::CreateSphereVB(ID3D12Device5Ptr pDevice)
+bool CppDirectXRayTracing21::D3D12AccelerationStructures::uploadMeshes(Primitives::ArrayView<SceneCacheMesh> meshes, Primitives::ArrayView<glm::vec3> positions, Primitives::ArrayView<Primitives::PackedVertexAttributes> attributes, const uint8_t* pIndices)
 {
-    // Vertex buffer
+    // The data is copied into the staging memory right away, the source only has to live until these calls return
+    for (int i = 0; i < kMeshLodNum; i++)
+    {
+        const SceneCacheMesh& mesh = meshes[i];
+        MeshBuffers& buffers = mMeshes[i];
+        int lod = i % kLodCount;
+        if (lod == 0)
+        {
+            mLodCounts[i / kLodCount] = 1;
+        }
+        else if (mesh.firstVertex == meshes[i - 1].firstVertex && mesh.indexOffset == meshes[i - 1].indexOffset)
+        {
+            // Past the end of the chain, the level shares the coarsest one's buffers
+            buffers = mMeshes[i - 1];
+            continue;
+        }
+        else if (mLodCounts[i / kLodCount] == lod)
+        {
+            mLodCounts[i / kLodCount]++;
+        }
+        buffers.vertexCount = static_cast<int>(mesh.vertexCount);
+        buffers.indexCount = static_cast<int>(mesh.indexCount);
+        buffers.indexFormat = static_cast<Primitives::IndexFormat>(mesh.indexFormat);
+
+        // The BLAS build reads the positions and the hit shaders the attributes, both live in the default heap
+        buffers.pPositions = mpUploader->createBufferWithData(&positions[mesh.firstVertex], sizeof(glm::vec3) * mesh.vertexCount, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        buffers.pAttributes = mpUploader->createBufferWithData(&attributes[mesh.firstVertex], sizeof(Primitives::PackedVertexAttributes) * mesh.vertexCount, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        buffers.pIndices = mpUploader->createBufferWithData(pIndices + mesh.indexOffset, Primitives::GetIndexBufferSize(mesh.indexCount, buffers.indexFormat), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        if (buffers.pPositions == nullptr || buffers.pAttributes == nullptr || buffers.pIndices == nullptr)
+        {
+            return false;
+        }
+    }
 
-    int vertexCount = static_cast<int>(mSphere.GetVertices().size());
-    ID3D12ResourcePtr vBuffer = createBuffer(pDevice, sizeof(Primitives::Vertex) * vertexCount, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
-    uint8_t* vData;
-    vBuffer->Map(0, nullptr, (void**)&vData);
-    memcpy(vData, &mSphere.GetVertices().data()[0], sizeof(Primitives::Vertex) * vertexCount);
-    vBuffer->Unmap(0, nullptr);
+    // The bounds of the full-detail level, around the center of its box
+    for (int i = 0; i < kDefaultNumDesc; i++)
+    {
+        const SceneCacheMesh& mesh = meshes[GetMeshLod(i, 0)];
+        glm::vec3 minimum(FLT_MAX);
+        glm::vec3 maximum(-FLT_MAX);
+        for (uint32_t v = 0; v < mesh.vertexCount; v++)
+        {
+            minimum = glm::min(minimum, positions[mesh.firstVertex + v]);
+            maximum = glm::max(maximum, positions[mesh.firstVertex + v]);
+        }
+        glm::vec3 center = (mesh.vertexCount > 0) ? (minimum + maximum) * 0.5f : glm::vec3(0.0f);
+        float radius = 0.0f;
+        for (uint32_t v = 0; v < mesh.vertexCount; v++)
+        {
+            radius = std::max(radius, glm::length(positions[mesh.firstVertex + v] - center));
+        }
+        mMeshBounds[i] = glm::vec4(center, radius);
+    }
 
-    return vBuffer;
+    // The procedural BLAS reads it like the positions
+    D3D12_RAYTRACING_AABB sphereAabb = { -1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+    mpSphereAabb = mpUploader->createBufferWithData(&sphereAabb, sizeof(sphereAabb), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    return mpSphereAabb != nullptr;
 }
 
-ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::CreateSphereIB(ID3D12Device5Ptr pDevice)
+ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::createBuffer(ID3D12Device5Ptr pDevice, uint64_t size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState, const D3D12_HEAP_PROPERTIES& heapProps)
 {
-    int indexCount = static_cast<int>(mSphere.GetIndices().size());
+    if (mpAllocator)
+    {
+        return mpAllocator->createBuffer(size, flags, initState, heapProps);
+    }
+
+    D3D12_RESOURCE_DESC bufDesc = {};
+    bufDesc.Alignment = 0;
+    bufDesc.DepthOrArraySize = 1;
+    bufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufDesc.Flags = flags;
+    bufDesc.Format = DXGI_FORMAT_UNKNOWN;
+    bufDesc.Height = 1;
+    bufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufDesc.MipLevels = 1;
+    bufDesc.SampleDesc.Count = 1;
+    bufDesc.SampleDesc.Quality = 0;
+    bufDesc.Width = size;
 
-    ID3D12ResourcePtr iBuffer = createBuffer(pDevice, sizeof(uint16_t) * indexCount, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
-    uint8_t* iData;
-    iBuffer->Map(0, nullptr, (void**)&iData);
-    memcpy(iData, &mSphere.GetIndices().data()[0], sizeof(uint16_t)* indexCount);
-    iBuffer->Unmap(0, nullptr);
+    ID3D12ResourcePtr pBuffer;
+    d3d_call(pDevice->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufDesc, initState, nullptr, IID_PPV_ARGS(&pBuffer)));
+    return pBuffer;
+}
 
-    return iBuffer;
+CppDirectXRayTracing21::AccelerationStructureBuffers CppDirectXRayTracing21::D3D12AccelerationStructures::createMeshBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, int meshLod)
+{
+    if (IsProceduralMesh(meshLod / kLodCount))
+    {
+        return createSphereBottomLevelAS(pDevice, pCmdList);
+    }
+    const MeshBuffers& mesh = mMeshes[meshLod];
+    return createBottomLevelAS(pDevice, pCmdList, mesh.pPositions, mesh.pIndices, mesh.vertexCount, mesh.indexCount, mesh.indexFormat);
 }
 
-CppDirectXRayTracing21::AccelerationStructureBuffers CppDirectXRayTracing21::D3D12AccelerationStructures::createBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr vBuffer, ID3D12ResourcePtr iBuffer, int vertexCount, int indexCount)
+CppDirectXRayTracing21::AccelerationStructureBuffers CppDirectXRayTracing21::D3D12AccelerationStructures::createBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr vBuffer, ID3D12ResourcePtr iBuffer, int vertexCount, int indexCount, Primitives::IndexFormat indexFormat)
 {
     D3D12_RAYTRACING_GEOMETRY_DESC geomDesc = {};
     geomDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
     geomDesc.Triangles.VertexBuffer.StartAddress = vBuffer->GetGPUVirtualAddress();
-    geomDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(Primitives::Vertex); // change to vec3 if use hand-made cube buffer
+    geomDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(glm::vec3); // Tight position stream
     geomDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
     geomDesc.Triangles.VertexCount = vertexCount;
     geomDesc.Triangles.IndexBuffer = iBuffer->GetGPUVirtualAddress();
     geomDesc.Triangles.IndexCount = indexCount;
-    geomDesc.Triangles.IndexFormat = DXGI_FORMAT_R16_UINT;
+    geomDesc.Triangles.IndexFormat = (indexFormat == Primitives::IndexFormat::UInt32) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
 
     geomDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-    
+    return buildBottomLevelAS(pDevice, pCmdList, geomDesc);
+}
+
+CppDirectXRayTracing21::AccelerationStructureBuffers CppDirectXRayTracing21::D3D12AccelerationStructures::createSphereBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList)
+{
+    // A single box, the intersection shader finds the sphere inside it. Opaque as well, there is no any-hit
+    D3D12_RAYTRACING_GEOMETRY_DESC geomDesc = {};
+    geomDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS;
+    geomDesc.AABBs.AABBCount = 1;
+    geomDesc.AABBs.AABBs.StartAddress = mpSphereAabb->GetGPUVirtualAddress();
+    geomDesc.AABBs.AABBs.StrideInBytes = sizeof(D3D12_RAYTRACING_AABB);
+    geomDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+    return buildBottomLevelAS(pDevice, pCmdList, geomDesc);
+}
+
+CppDirectXRayTracing21::AccelerationStructureBuffers CppDirectXRayTracing21::D3D12AccelerationStructures::buildBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, const D3D12_RAYTRACING_GEOMETRY_DESC& geomDesc)
+{
     // Get the size requirements for the scratch and AS buffers
     D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
     inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
@@ -173,74 +387,145 @@ CppDirectXRayTracing21::AccelerationStructureBuffers CppDirectXRayTracing21::D3D
     buffers.pInstanceDesc = createBuffer(pDevice, sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * kInstancesNum, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
     D3D12_RAYTRACING_INSTANCE_DESC* pInstanceDesc;
     buffers.pInstanceDesc->Map(0, nullptr, (void**)&pInstanceDesc);
-    ZeroMemory(pInstanceDesc, sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * kInstancesNum);
+    writeInstanceDescs(pInstanceDesc, pBottomLevelAS);
+    buffers.pInstanceDesc->Unmap(0, nullptr);
 
-    mat4 transformation[kInstancesNum];
-    transformation[0] = glm::translate(glm::mat4(1.0), glm::vec3(0.0f, -0.5f, 0.0f)); // Identity
-    transformation[1] = translate(mat4(), vec3(0, 0.0, 0));
-    transformation[2] = translate(mat4(), vec3(0.7, 0.0, -3));
-    transformation[3] = translate(mat4(), vec3(2, 0.0, -3));
+    buildTopLevelAS(pCmdList, buffers.pResult, buffers.pScratch, buffers.pInstanceDesc->GetGPUVirtualAddress());
+    return buffers;
+}
 
-    // Plane
-    {
-        pInstanceDesc[0].InstanceID = 0;                            // This value will be exposed to the shader via InstanceID()
-        pInstanceDesc[0].InstanceContributionToHitGroupIndex = 0;   // This is the offset inside the shader-table. We only have a single geometry, so the offset 0
-        pInstanceDesc[0].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-        mat4 m = transpose(transformation[0]);
-        memcpy(pInstanceDesc[0].Transform, &m, sizeof(pInstanceDesc[0].Transform));
-        pInstanceDesc[0].AccelerationStructure = pBottomLevelAS[0]->GetGPUVirtualAddress();
-        pInstanceDesc[0].InstanceMask = 0xFF;
-    }
-    // Initialize the instance desc.
-    for (int i = 1; i < kInstancesNum; i++)
+void CppDirectXRayTracing21::D3D12AccelerationStructures::rebuildTopLevelAS(ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr pBottomLevelAS[], ID3D12ResourcePtr pResult, ID3D12ResourcePtr pScratch, D3D12_RAYTRACING_INSTANCE_DESC* pInstanceDesc, D3D12_GPU_VIRTUAL_ADDRESS instanceDescAddress)
+{
+    // The frames still in flight finished their rays before this build runs, they are ahead of it on the queue
+    writeInstanceDescs(pInstanceDesc, pBottomLevelAS);
+    buildTopLevelAS(pCmdList, pResult, pScratch, instanceDescAddress);
+}
+
+void CppDirectXRayTracing21::D3D12AccelerationStructures::writeInstanceDescs(D3D12_RAYTRACING_INSTANCE_DESC* pInstanceDesc, ID3D12ResourcePtr pBottomLevelAS[])
+{
+    ZeroMemory(pInstanceDesc, sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * kInstancesNum);
+
+    // Initialize the instance desc. Every triangle mesh uses the same hit record, the hit shader finds the geometry of its level
+    // and its material through InstanceID() in the instance buffer. The analytic spheres use the sphere hit record
+    for (int i = 0; i < kInstancesNum; i++)
     {
-        pInstanceDesc[i].InstanceID = i;                            // This value will be exposed to the shader via InstanceID()
-        pInstanceDesc[i].InstanceContributionToHitGroupIndex = i;   // This is the offset inside the shader-table. Since we have unique constant-buffer for each instance, we need a different offset
+        int lod = mLodSelector.GetLevel(i);
+        bool procedural = IsProceduralMesh(mInstances[i].mesh);
+        pInstanceDesc[i].InstanceID = GetInstanceRecord(i, lod);    // This value will be exposed to the shader via InstanceID()
+        pInstanceDesc[i].InstanceContributionToHitGroupIndex = procedural ? kSphereHitGroupRecord : kTriangleHitGroupRecord; // This is the offset inside the shader-table
         pInstanceDesc[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-        mat4 m = transpose(transformation[i]);
-        memcpy(pInstanceDesc[i].Transform, &m, sizeof(pInstanceDesc[i].Transform));
-        pInstanceDesc[i].AccelerationStructure = pBottomLevelAS[1]->GetGPUVirtualAddress();
+        memcpy(pInstanceDesc[i].Transform, mInstances[i].transform, sizeof(pInstanceDesc[i].Transform));
+        if (procedural)
+        {
+            // The unit sphere is scaled to the mesh's bounding sphere and moved to its center, before the instance transform
+            const glm::vec4& bounds = mMeshBounds[mInstances[i].mesh];
+            for (int row = 0; row < 3; row++)
+            {
+                const float* pRow = mInstances[i].transform[row];
+                pInstanceDesc[i].Transform[row][3] = pRow[0] * bounds.x + pRow[1] * bounds.y + pRow[2] * bounds.z + pRow[3];
+                for (int column = 0; column < 3; column++)
+                {
+                    pInstanceDesc[i].Transform[row][column] = pRow[column] * bounds.w;
+                }
+            }
+        }
+        pInstanceDesc[i].AccelerationStructure = pBottomLevelAS[GetMeshLod(mInstances[i].mesh, lod)]->GetGPUVirtualAddress();
         pInstanceDesc[i].InstanceMask = 0xFF;
     }
-    
-    // Unmap
-    buffers.pInstanceDesc->Unmap(0, nullptr);
+}
 
+void CppDirectXRayTracing21::D3D12AccelerationStructures::buildTopLevelAS(ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr pResult, ID3D12ResourcePtr pScratch, D3D12_GPU_VIRTUAL_ADDRESS instanceDescAddress)
+{
     // Create the TLAS
     D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC asDesc = {};
-    asDesc.Inputs = inputs;
-    asDesc.Inputs.InstanceDescs = buffers.pInstanceDesc->GetGPUVirtualAddress();
-    asDesc.DestAccelerationStructureData = buffers.pResult->GetGPUVirtualAddress();
-    asDesc.ScratchAccelerationStructureData = buffers.pScratch->GetGPUVirtualAddress();
+    asDesc.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+    asDesc.Inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
+    asDesc.Inputs.NumDescs = kInstancesNum;
+    asDesc.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+    asDesc.Inputs.InstanceDescs = instanceDescAddress;
+    asDesc.DestAccelerationStructureData = pResult->GetGPUVirtualAddress();
+    asDesc.ScratchAccelerationStructureData = pScratch->GetGPUVirtualAddress();
 
     pCmdList->BuildRaytracingAccelerationStructure(&asDesc, 0, nullptr);
 
     // We need to insert a UAV barrier before using the acceleration structures in a raytracing operation
     D3D12_RESOURCE_BARRIER uavBarrier = {};
     uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-    uavBarrier.UAV.pResource = buffers.pResult;
+    uavBarrier.UAV.pResource = pResult;
     pCmdList->ResourceBarrier(1, &uavBarrier);
+}
 
-    return buffers;
+bool CppDirectXRayTracing21::D3D12AccelerationStructures::selectLods(const glm::vec3& cameraPosition, float tanHalfFov)
+{
+    // The mesh bounds in world space, the radius grows with the largest scale of the transform
+    glm::vec4 bounds[kInstancesNum];
+    uint32_t levelCounts[kInstancesNum];
+    for (int i = 0; i < kInstancesNum; i++)
+    {
+        const SceneCacheInstance& instance = mInstances[i];
+        const glm::vec4& meshBounds = mMeshBounds[instance.mesh];
+        glm::vec3 center;
+        float scale = 0.0f;
+        for (int row = 0; row < 3; row++)
+        {
+            center[row] = instance.transform[row][0] * meshBounds.x + instance.transform[row][1] * meshBounds.y + instance.transform[row][2] * meshBounds.z + instance.transform[row][3];
+        }
+        for (int column = 0; column < 3; column++)
+        {
+            scale = std::max(scale, glm::length(glm::vec3(instance.transform[0][column], instance.transform[1][column], instance.transform[2][column])));
+        }
+        bounds[i] = glm::vec4(center, meshBounds.w * scale);
+        levelCounts[i] = static_cast<uint32_t>(GetMeshLodCount(instance.mesh));
+    }
+    return mLodSelector.Update(cameraPosition, tanHalfFov, { bounds, kInstancesNum }, { levelCounts, kInstancesNum });
 }
 
-int CppDirectXRayTracing21::D3D12AccelerationStructures::GetVertexCount()
+int CppDirectXRayTracing21::D3D12AccelerationStructures::GetMeshLodCount(int mesh)
 {
-    return static_cast<int>(mSceneVertices.size());
+    return IsProceduralMesh(mesh) ? 1 : mLodCounts[mesh];
 }
 
-int CppDirectXRayTracing21::D3D12AccelerationStructures::GetIndexCount()
+int CppDirectXRayTracing21::D3D12AccelerationStructures::GetMeshIndexCount(int mesh)
 {
-    return static_cast<int>(mSceneIndices.size());
+    return mMeshes[mesh].indexCount;
 }
 
+int CppDirectXRayTracing21::D3D12AccelerationStructures::GetMeshVertexCount(int mesh)
+{
+    return mMeshes[mesh].vertexCount;
+}
+
+Primitives::IndexFormat CppDirectXRayTracing21::D3D12AccelerationStructures::GetMeshIndexFormat(int mesh)
+{
+    return mMeshes[mesh].indexFormat;
+}
+
+ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::GetIndexBuffer(int mesh)
+{
+    return mMeshes[mesh].pIndices;
+}
+
+ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::GetPositionBuffer(int mesh)
+{
+    return mMeshes[mesh].pPositions;
+}
+
+ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::GetAttributeBuffer(int mesh)
+{
+    return mMeshes[mesh].pAttributes;
+}
+
+int CppDirectXRayTracing21::D3D12AccelerationStructures::GetInstanceMesh(int instance)
+{
+    return static_cast<int>(mInstances[instance].mesh);
+}
 
-ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::GetSphereIndexBuffer()
+int CppDirectXRayTracing21::D3D12AccelerationStructures::GetInstanceMaterial(int instance)
 {
-    return mSphereIndexBuffer;
+    return static_cast<int>(mInstances[instance].material);
 }
 
-ID3D12ResourcePtr CppDirectXRayTracing21::D3D12AccelerationStructures::GetSphereVertexBuffer()
+int CppDirectXRayTracing21::D3D12AccelerationStructures::GetInstanceLod(int instance)
 {
-    return mSphereVertexBuffer;
+    return static_cast<int>(mLodSelector.GetLevel(instance));
 }
@@ -1,72 +1,156 @@
 #pragma once
 #include "Structs/AccelerationStructureBuffer.hpp"
 #include "Structs/HeapData.hpp"
+#include "D3D12MemoryAllocator.hpp"
+#include "D3D12CopyQueueUploader.hpp"
+#include "SceneCache.hpp"
+#include "SceneBuilder.hpp"
+#include "LodSelector.hpp"
+#include "ThreadPool.hpp"
 #include "../Primitives/Sphere.hpp" 
 #include "../Primitives/Cube.hpp" 
 #include "../Primitives/Quad.hpp" 
+#include "../Primitives/PackedVertex.hpp"
+#include "../Primitives/MeshOptimizer.hpp"
+#include "../Primitives/MeshSimplifier.hpp"
 
 namespace CppDirectXRayTracing21
 {
 	// Number of geometry types, we only have sphere and plane.
 	static const int kDefaultNumDesc = 2;
+	static const int kPlaneMesh = 0;
+	static const int kSphereMesh = 1;
 
 	// NUmber of instances, plane:0, sphere:1-3
 	static const int kInstancesNum = 4;
 
+	// The sphere instances are traced as analytic spheres: a procedural BLAS with one AABB and the intersection shader of the
+	// sphere hit group. The triangulated sphere is still generated and cached, turning this off brings its LOD chain back
+	static const bool kAnalyticSpheres = true;
+
+	// Hit records of the shader table, selected by InstanceContributionToHitGroupIndex. The triangle meshes use the first one,
+	// the analytic spheres the second
+	static const int kTriangleHitGroupRecord = 0;
+	static const int kSphereHitGroupRecord = 1;
+
+	// Levels of detail per mesh, every level has about half the triangles of the previous one. The meshes are stored,
+	// and their bottom-level AS built, per level
+	static const int kLodCount = static_cast<int>(LodSelector::kMaxLevelCount);
+	static const int kMeshLodNum = kDefaultNumDesc * kLodCount;
+
 	class D3D12AccelerationStructures
 	{
 	public:
-		D3D12AccelerationStructures() 
-		{
-			mQuad.Init(18.5f);
-			mSphere.Init(1.0f,32);
-
-			mSceneIndices = mSphere.GetIndices();
-			mSceneVertices = mSphere.GetVertices();
-		};
+		D3D12AccelerationStructures();
 
 		~D3D12AccelerationStructures() = default;
 
-		ID3D12ResourcePtr createBuffer(ID3D12Device5Ptr pDevice, uint64_t size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState, const D3D12_HEAP_PROPERTIES& heapProps);
+		// All buffers are placed into the allocator's heaps once it is set, otherwise they are committed resources.
+		void SetMemoryAllocator(D3D12MemoryAllocator* pAllocator);
+		void SetUploader(D3D12CopyQueueUploader* pUploader);
 
-		AccelerationStructureBuffers createCubeBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList);
+		// Both schedule the vertex and index buffers upload to the default heap. The uploader has to be flushed
+		// and waited on before the bottom-level AS are built. Both fail if a buffer can't be created.
+		// loadGeometry() copies the meshes and instances straight from the mapped cache. It fails, without uploading anything,
+		// if the cache doesn't hold kMeshLodNum meshes and kInstancesNum instances referencing materialCount materials.
+		bool loadGeometry(const SceneCacheReader& cache, uint32_t materialCount);
+		// generateGeometry() builds the procedural scene, merges the copies of a mesh into instances, simplifies every mesh
+		// into its LOD chain on the pool, optimizes the levels for vertex locality and adds them and the instances to the writer.
+		// The levels a mesh doesn't have, because it can't be simplified any further, reference the data of its coarsest one.
+		// Fails, without adding or uploading anything, if the builder doesn't find kDefaultNumDesc distinct meshes.
+		bool generateGeometry(SceneCacheWriter& writer, ThreadPool* pPool = nullptr);
 
-		AccelerationStructureBuffers createPrimitiveBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList);
+		// CSV with the instance count of every mesh level and its locality metrics before and after the optimization, empty until generateGeometry()
+		const std::string& getMeshLocalityReport() const { return mMeshLocalityReport; }
 
-		AccelerationStructureBuffers createTopLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr pBottomLevelAS[], uint64_t& tlasSize);
+		// Identifies the procedural scene parameters, caches built from other ones are rejected
+		static uint64_t GetSceneSourceKey();
 
-		int GetIndexCount();
-		int GetVertexCount();
+		ID3D12ResourcePtr createBuffer(ID3D12Device5Ptr pDevice, uint64_t size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState, const D3D12_HEAP_PROPERTIES& heapProps);
 
-		ID3D12ResourcePtr GetSphereIndexBuffer();
-		ID3D12ResourcePtr GetSphereVertexBuffer();
+		// The level's triangles, or the sphere's AABB when the mesh is procedural
+		AccelerationStructureBuffers createMeshBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, int meshLod);
 
-	
+		// Every instance references the bottom-level AS of its selected level, pBottomLevelAS is indexed by GetMeshLod().
+		// selectLods() has to be called once before.
+		AccelerationStructureBuffers createTopLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr pBottomLevelAS[], uint64_t& tlasSize);
+		// Rebuilds the TLAS into the buffers createTopLevelAS() returned. The instance descs are written to pInstanceDesc, which the
+		// GPU reads at instanceDescAddress, e.g. this frame's region of an upload ring
+		void rebuildTopLevelAS(ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr pBottomLevelAS[], ID3D12ResourcePtr pResult, ID3D12ResourcePtr pScratch, D3D12_RAYTRACING_INSTANCE_DESC* pInstanceDesc, D3D12_GPU_VIRTUAL_ADDRESS instanceDescAddress);
+
+		// Picks the level of every instance from its projected size seen from the camera. Returns true when one changed,
+		// the TLAS has to be rebuilt then
+		bool selectLods(const glm::vec3& cameraPosition, float tanHalfFov);
+
+		// Mesh levels are addressed by GetMeshLod(kPlaneMesh/kSphereMesh, lod), the same index as their bottom-level AS
+		static int GetMeshLod(int mesh, int lod) { return mesh * kLodCount + lod; }
+		// The levels the mesh really has, the ones past them share the buffers of its coarsest level. A procedural mesh has one
+		int GetMeshLodCount(int mesh);
+		// Traced as an analytic sphere bounding the mesh instead of its triangles
+		static bool IsProceduralMesh(int mesh) { return kAnalyticSpheres && mesh == kSphereMesh; }
+		int GetMeshIndexCount(int mesh);
+		int GetMeshVertexCount(int mesh);
+		Primitives::IndexFormat GetMeshIndexFormat(int mesh);
+		ID3D12ResourcePtr GetIndexBuffer(int mesh);
+		// Vertices are split in two streams: float3 positions for the BLAS build, packed attributes for the hit shaders
+		ID3D12ResourcePtr GetPositionBuffer(int mesh);
+		ID3D12ResourcePtr GetAttributeBuffer(int mesh);
+
+		// The mesh and material referenced by a TLAS instance, and its selected level
+		int GetInstanceMesh(int instance);
+		int GetInstanceMaterial(int instance);
+		int GetInstanceLod(int instance);
+
+		// The hit shaders find the geometry of an instance level at this InstanceID(), one record per instance and level
+		static int GetInstanceRecord(int instance, int lod) { return instance * kLodCount + lod; }
 
 	private:
 
-		// Create cube vertex and index buffer
-		ID3D12ResourcePtr CreateCubeVB(ID3D12Device5Ptr pDevice);
-		ID3D12ResourcePtr CreateCubeIB(ID3D12Device5Ptr pDevice);
+		// GPU copy of one mesh: both vertex streams and the index buffer, padded to whole 32-bit words
+		struct MeshBuffers
+		{
+			ID3D12ResourcePtr pPositions;
+			ID3D12ResourcePtr pAttributes;
+			ID3D12ResourcePtr pIndices;
+			int vertexCount = 0;
+			int indexCount = 0;
+			Primitives::IndexFormat indexFormat = Primitives::IndexFormat::UInt16;
+		};
+
+		// Creates the buffers of every mesh level from the streams laid out as in the scene cache, and the bounds of every mesh.
+		// Returns false if the allocator couldn't create one of the buffers
+		bool uploadMeshes(Primitives::ArrayView<SceneCacheMesh> meshes, Primitives::ArrayView<glm::vec3> positions, Primitives::ArrayView<Primitives::PackedVertexAttributes> attributes, const uint8_t* pIndices);
 
-		// Create primitive vertex and index buffer
-		ID3D12ResourcePtr CreateSphereVB(ID3D12Device5Ptr pDevice);
-		ID3D12ResourcePtr CreateSphereIB(ID3D12Device5Ptr pDevice);
 
+		AccelerationStructureBuffers createBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr vBuffer, ID3D12ResourcePtr iBuffer, int vertexCount, int indexCount, Primitives::IndexFormat indexFormat);
+		AccelerationStructureBuffers createSphereBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList);
+		AccelerationStructureBuffers buildBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, const D3D12_RAYTRACING_GEOMETRY_DESC& geomDesc);
 
-		AccelerationStructureBuffers createBottomLevelAS(ID3D12Device5Ptr pDevice, ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr vBuffer, ID3D12ResourcePtr iBuffer, int vertexCount, int indexCount);
+		void writeInstanceDescs(D3D12_RAYTRACING_INSTANCE_DESC* pInstanceDesc, ID3D12ResourcePtr pBottomLevelAS[]);
+		void buildTopLevelAS(ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12ResourcePtr pResult, ID3D12ResourcePtr pScratch, D3D12_GPU_VIRTUAL_ADDRESS instanceDescAddress);
 
-		Primitives::Quad mQuad;
-		Primitives::Sphere mSphere;
+		// Procedural scene parameters, part of the scene source key
+		static constexpr float kQuadSize = 18.5f;
+		static constexpr float kSphereDiameter = 1.0f;
+		static const int kSphereTessellation = 32;
+		// Largest quadric error of a level, relative to the mesh radius
+		static constexpr float kLodMaxError = 0.05f;
 
-		std::vector<Primitives::Vertex> mSceneVertices;
-		std::vector<uint16_t> mSceneIndices;
+		MeshBuffers mMeshes[kMeshLodNum];
+		int mLodCounts[kDefaultNumDesc] = {};
+		// Bounding sphere of every mesh in its own space, center and radius
+		glm::vec4 mMeshBounds[kDefaultNumDesc];
+		// The AABB of the unit sphere, the procedural meshes' instances scale it to their bounds
+		ID3D12ResourcePtr mpSphereAabb;
 
-		ID3D12ResourcePtr mQuadIndexBuffer;
-		ID3D12ResourcePtr mQuadVertexBuffer;
+		// Plane: 0, spheres: 1-3. The constructor places every instance, generateGeometry() replaces them with the scene
+		// builder's and loadGeometry() with the cached ones
+		SceneCacheInstance mInstances[kInstancesNum];
+		LodSelector mLodSelector;
 
-		ID3D12ResourcePtr mSphereIndexBuffer;
-		ID3D12ResourcePtr mSphereVertexBuffer;
+		D3D12MemoryAllocator* mpAllocator = nullptr;
+		D3D12CopyQueueUploader* mpUploader = nullptr;
+		std::string mMeshLocalityReport;
 	};
 
 };
@@ -0,0 +1,215 @@
+#pragma once
+#include "D3D12CopyQueueUploader.hpp"
+#include "Structs/HeapData.hpp"
+
+CppDirectXRayTracing21::D3D12CopyQueueUploader::D3D12CopyQueueUploader(ID3D12Device5Ptr pDevice, D3D12MemoryAllocator* pAllocator, uint64_t stagingSize)
+    : mpDevice(pDevice), mpAllocator(pAllocator), mStagingRing(stagingSize)
+{
+    D3D12_COMMAND_QUEUE_DESC cqDesc = {};
+    cqDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    cqDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    d3d_call(mpDevice->CreateCommandQueue(&cqDesc, IID_PPV_ARGS(&mpCopyQueue)));
+
+    d3d_call(mpDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mpFence)));
+    mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    // The staging ring is persistently mapped
+    mpStagingBuffer = mpAllocator->createBuffer(stagingSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
+    d3d_call(mpStagingBuffer->Map(0, nullptr, (void**)&mpStagingData));
+}
+
+CppDirectXRayTracing21::D3D12CopyQueueUploader::~D3D12CopyQueueUploader()
+{
+    waitIdle();
+    mpStagingBuffer->Unmap(0, nullptr);
+    CloseHandle(mFenceEvent);
+}
+
+void CppDirectXRayTracing21::D3D12CopyQueueUploader::beginBatch()
+{
+    if (mBatchOpen)
+    {
+        return;
+    }
+
+    if (mFreeAllocators.empty())
+    {
+        ID3D12CommandAllocatorPtr pCmdAllocator;
+        d3d_call(mpDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&pCmdAllocator)));
+        mFreeAllocators.push_back(pCmdAllocator);
+    }
+    mCurrentBatch = Batch();
+    mCurrentBatch.pCmdAllocator = mFreeAllocators.back();
+    mFreeAllocators.pop_back();
+    d3d_call(mCurrentBatch.pCmdAllocator->Reset());
+
+    if (mpCopyList)
+    {
+        d3d_call(mpCopyList->Reset(mCurrentBatch.pCmdAllocator, nullptr));
+    }
+    else
+    {
+        d3d_call(mpDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, mCurrentBatch.pCmdAllocator, nullptr, IID_PPV_ARGS(&mpCopyList)));
+    }
+    mBatchOpen = true;
+}
+
+ID3D12ResourcePtr CppDirectXRayTracing21::D3D12CopyQueueUploader::createBufferWithData(const void* pData, uint64_t size, D3D12_RESOURCE_STATES finalState, std::function<void()> onComplete)
+{
+    ID3D12ResourcePtr pBuffer = mpAllocator->createBuffer(size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON, kDefaultHeapProps);
+    if (pBuffer == nullptr || uploadBuffer(pBuffer, 0, pData, size, finalState, onComplete) == false)
+    {
+        return nullptr;
+    }
+    return pBuffer;
+}
+
+ID3D12ResourcePtr CppDirectXRayTracing21::D3D12CopyQueueUploader::createBufferWithWriter(uint64_t size, D3D12_RESOURCE_STATES finalState, const UploadWriter& write, std::function<void()> onComplete)
+{
+    ID3D12ResourcePtr pBuffer = mpAllocator->createBuffer(size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON, kDefaultHeapProps);
+    if (pBuffer == nullptr || uploadBufferWithWriter(pBuffer, 0, size, finalState, write, onComplete) == false)
+    {
+        return nullptr;
+    }
+    return pBuffer;
+}
+
+bool CppDirectXRayTracing21::D3D12CopyQueueUploader::uploadBuffer(ID3D12ResourcePtr pDst, uint64_t dstOffset, const void* pData, uint64_t size, D3D12_RESOURCE_STATES finalState, std::function<void()> onComplete)
+{
+    return uploadBufferWithWriter(pDst, dstOffset, size, finalState, [pData, size](void* pStaging) { memcpy(pStaging, pData, static_cast<size_t>(size)); }, onComplete);
+}
+
+bool CppDirectXRayTracing21::D3D12CopyQueueUploader::uploadBufferWithWriter(ID3D12ResourcePtr pDst, uint64_t dstOffset, uint64_t size, D3D12_RESOURCE_STATES finalState, const UploadWriter& write, std::function<void()> onComplete)
+{
+    if (pDst == nullptr)
+    {
+        return false;
+    }
+
+    ID3D12ResourcePtr pSrc;
+    uint64_t srcOffset = 0;
+
+    if (size > mStagingRing.GetCapacity())
+    {
+        // Too big for the ring, use a dedicated staging buffer that lives until the batch completed
+        pSrc = mpAllocator->createBuffer(size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
+        if (pSrc == nullptr)
+        {
+            return false;
+        }
+        uint8_t* pMapped;
+        d3d_call(pSrc->Map(0, nullptr, (void**)&pMapped));
+        write(pMapped);
+        pSrc->Unmap(0, nullptr);
+    }
+    else
+    {
+        // Wait for older batches to retire if the ring is full
+        poll();
+        while (mStagingRing.Allocate(size, 4, srcOffset) == false)
+        {
+            if (mInFlightBatches.empty())
+            {
+                flush();
+            }
+            mpFence->SetEventOnCompletion(mInFlightBatches.front().fenceValue, mFenceEvent);
+            WaitForSingleObject(mFenceEvent, INFINITE);
+            poll();
+        }
+        pSrc = mpStagingBuffer;
+        write(mpStagingData + srcOffset);
+    }
+
+    beginBatch();
+    mpCopyList->CopyBufferRegion(pDst, dstOffset, pSrc, srcOffset, size);
+
+    if (pSrc != mpStagingBuffer)
+    {
+        mCurrentBatch.keepAlive.push_back(pSrc);
+    }
+    mCurrentBatch.keepAlive.push_back(pDst);
+    if (onComplete)
+    {
+        mCurrentBatch.callbacks.push_back(onComplete);
+    }
+    if (finalState != D3D12_RESOURCE_STATE_COMMON)
+    {
+        mCurrentBatch.transitions.push_back({ pDst, finalState });
+    }
+    return true;
+}
+
+uint64_t CppDirectXRayTracing21::D3D12CopyQueueUploader::flush()
+{
+    if (mBatchOpen == false)
+    {
+        return mFenceValue;
+    }
+
+    d3d_call(mpCopyList->Close());
+    ID3D12CommandList* pList = mpCopyList.GetInterfacePtr();
+    mpCopyQueue->ExecuteCommandLists(1, &pList);
+    mFenceValue++;
+    d3d_call(mpCopyQueue->Signal(mpFence, mFenceValue));
+
+    mStagingRing.FinishBatch(mFenceValue);
+    mCurrentBatch.fenceValue = mFenceValue;
+
+    // The transitions can be recorded as soon as the consumer queue waits for this fence
+    for (auto& transition : mCurrentBatch.transitions)
+    {
+        mReadyTransitions.push_back(transition);
+    }
+    mCurrentBatch.transitions.clear();
+
+    mInFlightBatches.push_back(std::move(mCurrentBatch));
+    mCurrentBatch = Batch();
+    mBatchOpen = false;
+    return mFenceValue;
+}
+
+void CppDirectXRayTracing21::D3D12CopyQueueUploader::waitOnQueue(ID3D12CommandQueuePtr pQueue)
+{
+    d3d_call(pQueue->Wait(mpFence, mFenceValue));
+}
+
+void CppDirectXRayTracing21::D3D12CopyQueueUploader::recordFinalTransitions(D3D12ResourceStateTracker& stateTracker)
+{
+    // The tracker batches them with the other pending barriers of its next flush
+    for (const PendingTransition& transition : mReadyTransitions)
+    {
+        stateTracker.registerResource(transition.pResource, D3D12_RESOURCE_STATE_COMMON);
+        stateTracker.transition(transition.pResource, transition.finalState);
+    }
+    mReadyTransitions.clear();
+}
+
+void CppDirectXRayTracing21::D3D12CopyQueueUploader::poll()
+{
+    uint64_t completed = mpFence->GetCompletedValue();
+    mStagingRing.Retire(completed);
+
+    size_t retired = 0;
+    while (retired < mInFlightBatches.size() && mInFlightBatches[retired].fenceValue <= completed)
+    {
+        Batch& batch = mInFlightBatches[retired];
+        for (auto& callback : batch.callbacks)
+        {
+            callback();
+        }
+        mFreeAllocators.push_back(batch.pCmdAllocator);
+        retired++;
+    }
+    mInFlightBatches.erase(mInFlightBatches.begin(), mInFlightBatches.begin() + retired);
+}
+
+void CppDirectXRayTracing21::D3D12CopyQueueUploader::waitIdle()
+{
+    flush();
+    if (mpFence->GetCompletedValue() < mFenceValue)
+    {
+        d3d_call(mpFence->SetEventOnCompletion(mFenceValue, mFenceEvent));
+        WaitForSingleObject(mFenceEvent, INFINITE);
+    }
+    poll();
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "Framework.h"
+#include "StagingRingAllocator.hpp"
+#include "D3D12MemoryAllocator.hpp"
+#include "D3D12ResourceStateTracker.hpp"
+#include <functional>
+
+namespace CppDirectXRayTracing21
+{
+	// Uploads data into default-heap resources on a dedicated copy queue.
+	// Copies are recorded into a batch and submitted together by flush(). Staging memory comes from a ring
+	// that is recycled as the copy fence advances, completion callbacks run from poll() on the calling thread.
+	class D3D12CopyQueueUploader
+	{
+	public:
+		D3D12CopyQueueUploader(ID3D12Device5Ptr pDevice, D3D12MemoryAllocator* pAllocator, uint64_t stagingSize = kDefaultStagingSize);
+		~D3D12CopyQueueUploader();
+
+		// Creates a default-heap buffer and schedules the upload of its content.
+		// The creation functions return nullptr, and the uploads false, when the allocator couldn't create the destination
+		// or a dedicated staging buffer. It was reported and no copy is recorded then.
+		ID3D12ResourcePtr createBufferWithData(const void* pData, uint64_t size, D3D12_RESOURCE_STATES finalState, std::function<void()> onComplete = nullptr);
+
+		// pDst must be a buffer in the COMMON state, it is implicitly promoted to COPY_DEST on the copy queue.
+		bool uploadBuffer(ID3D12ResourcePtr pDst, uint64_t dstOffset, const void* pData, uint64_t size, D3D12_RESOURCE_STATES finalState, std::function<void()> onComplete = nullptr);
+
+		// Same as above, but the writer fills the mapped staging memory itself, so generated data doesn't need a
+		// CPU-side copy first. Staging memory is write-combined, the writer should only write, ideally sequentially.
+		using UploadWriter = std::function<void(void* pDst)>;
+		ID3D12ResourcePtr createBufferWithWriter(uint64_t size, D3D12_RESOURCE_STATES finalState, const UploadWriter& write, std::function<void()> onComplete = nullptr);
+		bool uploadBufferWithWriter(ID3D12ResourcePtr pDst, uint64_t dstOffset, uint64_t size, D3D12_RESOURCE_STATES finalState, const UploadWriter& write, std::function<void()> onComplete = nullptr);
+
+		// Submits the current batch and returns the fence value that marks its completion.
+		uint64_t flush();
+
+		// GPU-side wait, the queue won't execute further work until all flushed copies completed.
+		void waitOnQueue(ID3D12CommandQueuePtr pQueue);
+
+		// Copy queues can't transition into shader states. Resources decay to COMMON once the copy completed, this
+		// registers them with the tracker in COMMON and requests their final state. The tracker's next flush() must be
+		// recorded on a direct command list executed after waitOnQueue().
+		void recordFinalTransitions(D3D12ResourceStateTracker& stateTracker);
+
+		// Runs callbacks and recycles staging memory of completed batches. Never blocks.
+		void poll();
+		void waitIdle();
+
+		static const uint64_t kDefaultStagingSize = 32ull * 1024 * 1024;
+
+	private:
+		struct PendingTransition
+		{
+			ID3D12ResourcePtr pResource;
+			D3D12_RESOURCE_STATES finalState;
+		};
+
+		struct Batch
+		{
+			ID3D12CommandAllocatorPtr pCmdAllocator;
+			uint64_t fenceValue = 0;
+			std::vector<std::function<void()>> callbacks;
+			std::vector<ID3D12ResourcePtr> keepAlive; // Dedicated staging buffers for uploads larger than the ring
+			std::vector<PendingTransition> transitions;
+		};
+
+		void beginBatch();
+
+		ID3D12Device5Ptr mpDevice;
+		D3D12MemoryAllocator* mpAllocator;
+		ID3D12CommandQueuePtr mpCopyQueue;
+		ID3D12GraphicsCommandList4Ptr mpCopyList;
+		ID3D12FencePtr mpFence;
+		HANDLE mFenceEvent;
+		uint64_t mFenceValue = 0;
+
+		StagingRingAllocator mStagingRing;
+		ID3D12ResourcePtr mpStagingBuffer;
+		uint8_t* mpStagingData = nullptr;
+
+		bool mBatchOpen = false;
+		Batch mCurrentBatch;
+		std::vector<Batch> mInFlightBatches;
+		std::vector<ID3D12CommandAllocatorPtr> mFreeAllocators;
+		std::vector<PendingTransition> mReadyTransitions;
+	};
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include "D3D12DescriptorHeap.hpp"
+
+CppDirectXRayTracing21::D3D12DescriptorHeap::D3D12DescriptorHeap(ID3D12Device5Ptr pDevice, uint32_t frameCount, uint32_t persistentCount, uint32_t dynamicCount, uint32_t transientCountPerFrame)
+    : mAllocator(persistentCount, dynamicCount, transientCountPerFrame, frameCount)
+{
+    D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+    desc.NumDescriptors = mAllocator.GetDescriptorCount();
+    desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    d3d_call(pDevice->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&mpHeap)));
+
+    mCpuStart = mpHeap->GetCPUDescriptorHandleForHeapStart();
+    mGpuStart = mpHeap->GetGPUDescriptorHandleForHeapStart();
+    mDescriptorSize = pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+CppDirectXRayTracing21::DescriptorHandle CppDirectXRayTracing21::D3D12DescriptorHeap::allocatePersistent(uint32_t count)
+{
+    DescriptorHandle handle = mAllocator.AllocatePersistent(count);
+    if (handle.IsValid() == false)
+    {
+        msgBox("The persistent descriptor region is full. Increase persistentCount.");
+    }
+    return handle;
+}
+
+CppDirectXRayTracing21::DescriptorHandle CppDirectXRayTracing21::D3D12DescriptorHeap::allocate(uint32_t count)
+{
+    DescriptorHandle handle = mAllocator.Allocate(count);
+    if (handle.IsValid() == false)
+    {
+        msgBox("The dynamic descriptor region is full or too fragmented. Increase dynamicCount.");
+    }
+    return handle;
+}
+
+CppDirectXRayTracing21::DescriptorHandle CppDirectXRayTracing21::D3D12DescriptorHeap::allocateTransient(uint32_t count)
+{
+    DescriptorHandle handle = mAllocator.AllocateTransient(count);
+    if (handle.IsValid() == false)
+    {
+        msgBox("The per-frame descriptor region is full. Increase transientCountPerFrame.");
+    }
+    return handle;
+}
+
+void CppDirectXRayTracing21::D3D12DescriptorHeap::free(DescriptorHandle& handle)
+{
+    mAllocator.Free(handle);
+    handle = DescriptorHandle();
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE CppDirectXRayTracing21::D3D12DescriptorHeap::getCpuHandle(const DescriptorHandle& handle, uint32_t offset) const
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = mCpuStart;
+    cpuHandle.ptr += static_cast<SIZE_T>(handle.index + offset) * mDescriptorSize;
+    return cpuHandle;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE CppDirectXRayTracing21::D3D12DescriptorHeap::getGpuHandle(const DescriptorHandle& handle, uint32_t offset) const
+{
+    D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = mGpuStart;
+    gpuHandle.ptr += static_cast<UINT64>(handle.index + offset) * mDescriptorSize;
+    return gpuHandle;
+}
+
+void CppDirectXRayTracing21::D3D12DescriptorHeap::beginFrame(ID3D12FencePtr pFence, HANDLE fenceEvent)
+{
+    uint64_t fenceValue = mAllocator.BeginFrame();
+    if (pFence->GetCompletedValue() < fenceValue)
+    {
+        d3d_call(pFence->SetEventOnCompletion(fenceValue, fenceEvent));
+        WaitForSingleObject(fenceEvent, INFINITE);
+    }
+    mAllocator.Retire(pFence->GetCompletedValue());
+}
+
+void CppDirectXRayTracing21::D3D12DescriptorHeap::endFrame(uint64_t fenceValue)
+{
+    mAllocator.EndFrame(fenceValue);
+}
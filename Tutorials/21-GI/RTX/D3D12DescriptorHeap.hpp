@@ -0,0 +1,42 @@
+#pragma once
+#include "Framework.h"
+#include "DescriptorAllocator.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	// Shader-visible CBV/SRV/UAV heap managed by a DescriptorAllocator.
+	// Descriptor tables are allocated as handles, their GPU handle goes into root arguments or shader records.
+	class D3D12DescriptorHeap
+	{
+	public:
+		D3D12DescriptorHeap(ID3D12Device5Ptr pDevice, uint32_t frameCount, uint32_t persistentCount = kDefaultPersistentCount, uint32_t dynamicCount = kDefaultDynamicCount, uint32_t transientCountPerFrame = kDefaultTransientCount);
+		~D3D12DescriptorHeap() = default;
+
+		DescriptorHandle allocatePersistent(uint32_t count);
+		DescriptorHandle allocate(uint32_t count);
+		DescriptorHandle allocateTransient(uint32_t count);
+
+		// The range is reused once the GPU finished the current frame.
+		void free(DescriptorHandle& handle);
+
+		D3D12_CPU_DESCRIPTOR_HANDLE getCpuHandle(const DescriptorHandle& handle, uint32_t offset = 0) const;
+		D3D12_GPU_DESCRIPTOR_HANDLE getGpuHandle(const DescriptorHandle& handle, uint32_t offset = 0) const;
+
+		// Waits until the GPU is done with the transient slot we are about to reuse and recycles the completed frees.
+		void beginFrame(ID3D12FencePtr pFence, HANDLE fenceEvent);
+		void endFrame(uint64_t fenceValue);
+
+		ID3D12DescriptorHeapPtr getHeap() const { return mpHeap; }
+
+		static const uint32_t kDefaultPersistentCount = 256;
+		static const uint32_t kDefaultDynamicCount = 4096;
+		static const uint32_t kDefaultTransientCount = 256;
+
+	private:
+		DescriptorAllocator mAllocator;
+		ID3D12DescriptorHeapPtr mpHeap;
+		D3D12_CPU_DESCRIPTOR_HANDLE mCpuStart;
+		D3D12_GPU_DESCRIPTOR_HANDLE mGpuStart;
+		uint32_t mDescriptorSize;
+	};
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include "D3D12FramePacer.hpp"
+
+CppDirectXRayTracing21::D3D12FramePacer::D3D12FramePacer(ID3D12Device5Ptr pDevice, IDXGISwapChain3Ptr pSwapChain, Profiler* pProfiler, uint32_t framesInFlight, uint32_t maxFrameLatency)
+    : mPacer(framesInFlight), mAllocators(framesInFlight), mpProfiler(pProfiler)
+{
+    for (ID3D12CommandAllocatorPtr& pAllocator : mAllocators)
+    {
+        d3d_call(pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&pAllocator)));
+    }
+
+    // Present() no longer blocks, the CPU waits here instead, before it samples input and records the next frame
+    d3d_call(pSwapChain->SetMaximumFrameLatency(maxFrameLatency));
+    mLatencyWaitable = pSwapChain->GetFrameLatencyWaitableObject();
+    mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+}
+
+CppDirectXRayTracing21::D3D12FramePacer::~D3D12FramePacer()
+{
+    CloseHandle(mLatencyWaitable);
+    CloseHandle(mFenceEvent);
+}
+
+uint32_t CppDirectXRayTracing21::D3D12FramePacer::beginFrame(ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12FencePtr pFence)
+{
+    double startUs = mpProfiler->NowUs();
+    WaitForSingleObjectEx(mLatencyWaitable, 1000, TRUE);
+    double latencyDoneUs = mpProfiler->NowUs();
+    mpProfiler->AddSample("FrameLatencyWait", ProfileTrack::Cpu, startUs, latencyDoneUs - startUs);
+
+    FrameSlot slot = mPacer.BeginFrame();
+    if (pFence->GetCompletedValue() < slot.waitValue)
+    {
+        d3d_call(pFence->SetEventOnCompletion(slot.waitValue, mFenceEvent));
+        WaitForSingleObject(mFenceEvent, INFINITE);
+    }
+    double fenceDoneUs = mpProfiler->NowUs();
+    mpProfiler->AddSample("FrameFenceWait", ProfileTrack::Cpu, latencyDoneUs, fenceDoneUs - latencyDoneUs);
+    mLastCpuWaitMs = (fenceDoneUs - startUs) / 1000.0;
+
+    if (slot.resetAllocator)
+    {
+        d3d_call(mAllocators[slot.index]->Reset());
+        d3d_call(pCmdList->Reset(mAllocators[slot.index], nullptr));
+    }
+    return slot.index;
+}
+
+void CppDirectXRayTracing21::D3D12FramePacer::endFrame(uint64_t fenceValue)
+{
+    mPacer.EndFrame(fenceValue);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Framework.h"
+#include "FramePacer.hpp"
+#include "Profiler.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	// Paces the CPU against the GPU and the display.
+	// Every frame in flight has its own command allocator and fence value. A frame starts once the swap chain's
+	// frame-latency waitable object is signaled and the GPU finished the last frame recorded into the slot.
+	// The time the CPU spends in both waits goes into the profiler.
+	class D3D12FramePacer
+	{
+	public:
+		// The swap chain must be created with DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT.
+		D3D12FramePacer(ID3D12Device5Ptr pDevice, IDXGISwapChain3Ptr pSwapChain, Profiler* pProfiler, uint32_t framesInFlight, uint32_t maxFrameLatency);
+		~D3D12FramePacer();
+
+		// The command list is created open on the first slot, everything recorded at load time is submitted with the first frame.
+		ID3D12CommandAllocatorPtr getInitialAllocator() const { return mAllocators[0]; }
+
+		// Returns the slot of the new frame. The slot's allocator and the command list are reset when needed.
+		uint32_t beginFrame(ID3D12GraphicsCommandList4Ptr pCmdList, ID3D12FencePtr pFence);
+		void endFrame(uint64_t fenceValue);
+
+		uint32_t getFrameCount() const { return mPacer.GetFrameCount(); }
+		double getLastCpuWaitMs() const { return mLastCpuWaitMs; }
+
+	private:
+		FramePacer mPacer;
+		std::vector<ID3D12CommandAllocatorPtr> mAllocators;
+		HANDLE mLatencyWaitable = nullptr;
+		HANDLE mFenceEvent = nullptr;
+		Profiler* mpProfiler;
+		double mLastCpuWaitMs = 0.0;
+	};
+};
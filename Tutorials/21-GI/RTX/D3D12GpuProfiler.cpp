@@ -0,0 +1,126 @@
+#pragma once
+#include "D3D12GpuProfiler.hpp"
+#include "Structs/HeapData.hpp"
+
+CppDirectXRayTracing21::D3D12GpuProfiler::D3D12GpuProfiler(ID3D12Device5Ptr pDevice, D3D12MemoryAllocator* pAllocator, ID3D12CommandQueuePtr pQueue, Profiler* pProfiler, uint32_t frameCount, uint32_t maxScopesPerFrame)
+    : mpQueue(pQueue), mpProfiler(pProfiler), mFrames(frameCount), mMaxScopesPerFrame(maxScopesPerFrame)
+{
+    // Two timestamps per scope
+    uint32_t queryCount = frameCount * maxScopesPerFrame * 2;
+
+    D3D12_QUERY_HEAP_DESC heapDesc = {};
+    heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    heapDesc.Count = queryCount;
+    d3d_call(pDevice->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&mpQueryHeap)));
+
+    // Readback heaps can stay mapped, the data is only read after the fence of its frame passed
+    mpReadback = pAllocator->createBuffer(queryCount * sizeof(uint64_t), D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST, kReadbackHeapProps);
+    d3d_call(mpReadback->Map(0, nullptr, (void**)&mpTimestamps));
+
+    d3d_call(mpQueue->GetTimestampFrequency(&mGpuFrequency));
+    calibrate();
+}
+
+CppDirectXRayTracing21::D3D12GpuProfiler::~D3D12GpuProfiler()
+{
+    D3D12_RANGE written = {};
+    mpReadback->Unmap(0, &written);
+}
+
+void CppDirectXRayTracing21::D3D12GpuProfiler::calibrate()
+{
+    // The profiler time is taken right after the calibration, the error is far below the length of a scope
+    uint64_t cpuTicks;
+    if (SUCCEEDED(mpQueue->GetClockCalibration(&mCalibrationTicks, &cpuTicks)))
+    {
+        mCalibrationUs = mpProfiler->NowUs();
+    }
+}
+
+void CppDirectXRayTracing21::D3D12GpuProfiler::readFrame(Frame& frame, uint32_t slot)
+{
+    const uint64_t* pTimestamps = mpTimestamps + slot * mMaxScopesPerFrame * 2;
+    for (uint32_t i = 0; i < frame.names.size(); i++)
+    {
+        uint64_t begin = pTimestamps[i * 2];
+        uint64_t end = pTimestamps[i * 2 + 1];
+        if (end < begin)
+        {
+            continue;
+        }
+
+        // Signed, the frame can start before the calibration point
+        double startUs = mCalibrationUs + (static_cast<double>(begin) - static_cast<double>(mCalibrationTicks)) * 1e6 / mGpuFrequency;
+        double durationUs = static_cast<double>(end - begin) * 1e6 / mGpuFrequency;
+        mpProfiler->AddSample(frame.names[i], ProfileTrack::Gpu, startUs, durationUs);
+    }
+    frame.names.clear();
+    frame.pending = false;
+}
+
+void CppDirectXRayTracing21::D3D12GpuProfiler::beginFrame(ID3D12FencePtr pFence)
+{
+    // Re-calibrating keeps the GPU and CPU clocks from drifting apart over a long capture
+    calibrate();
+
+    uint64_t completedValue = pFence->GetCompletedValue();
+    for (uint32_t slot = 0; slot < mFrames.size(); slot++)
+    {
+        Frame& frame = mFrames[slot];
+        if (frame.pending && frame.fenceValue <= completedValue)
+        {
+            readFrame(frame, slot);
+        }
+    }
+
+    mFrameActive = (mFrames[mFrameIndex].pending == false);
+}
+
+uint32_t CppDirectXRayTracing21::D3D12GpuProfiler::beginScope(ID3D12GraphicsCommandList4Ptr pCmdList, const char* name)
+{
+    Frame& frame = mFrames[mFrameIndex];
+    if (mFrameActive == false || frame.names.size() >= mMaxScopesPerFrame)
+    {
+        return kInvalidScope;
+    }
+
+    uint32_t scope = static_cast<uint32_t>(frame.names.size());
+    frame.names.push_back(name);
+    pCmdList->EndQuery(mpQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, (mFrameIndex * mMaxScopesPerFrame + scope) * 2);
+    return scope;
+}
+
+void CppDirectXRayTracing21::D3D12GpuProfiler::endScope(ID3D12GraphicsCommandList4Ptr pCmdList, uint32_t scope)
+{
+    if (scope == kInvalidScope)
+    {
+        return;
+    }
+    pCmdList->EndQuery(mpQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, (mFrameIndex * mMaxScopesPerFrame + scope) * 2 + 1);
+}
+
+void CppDirectXRayTracing21::D3D12GpuProfiler::resolve(ID3D12GraphicsCommandList4Ptr pCmdList)
+{
+    const Frame& frame = mFrames[mFrameIndex];
+    if (mFrameActive == false || frame.names.empty())
+    {
+        return;
+    }
+
+    // Only the queries this frame used
+    uint32_t firstQuery = mFrameIndex * mMaxScopesPerFrame * 2;
+    uint32_t queryCount = static_cast<uint32_t>(frame.names.size()) * 2;
+    pCmdList->ResolveQueryData(mpQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, queryCount, mpReadback, firstQuery * sizeof(uint64_t));
+}
+
+void CppDirectXRayTracing21::D3D12GpuProfiler::endFrame(uint64_t fenceValue)
+{
+    Frame& frame = mFrames[mFrameIndex];
+    if (mFrameActive && frame.names.empty() == false)
+    {
+        frame.fenceValue = fenceValue;
+        frame.pending = true;
+    }
+    mFrameIndex = (mFrameIndex + 1) % static_cast<uint32_t>(mFrames.size());
+    mFrameActive = false;
+}
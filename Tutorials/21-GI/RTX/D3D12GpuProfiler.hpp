@@ -0,0 +1,61 @@
+#pragma once
+#include "Framework.h"
+#include "Profiler.hpp"
+#include "D3D12MemoryAllocator.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	MAKE_SMART_COM_PTR(ID3D12QueryHeap);
+
+	// Named GPU scopes measured with timestamp queries.
+	// Every frame in flight owns a range of the query heap and of a persistently mapped readback buffer. The queries are
+	// resolved at the end of the command list and read once the fence of that frame passed, the CPU never waits on them.
+	// The results go into the Profiler, shifted onto its timeline.
+	class D3D12GpuProfiler
+	{
+	public:
+		D3D12GpuProfiler(ID3D12Device5Ptr pDevice, D3D12MemoryAllocator* pAllocator, ID3D12CommandQueuePtr pQueue, Profiler* pProfiler, uint32_t frameCount, uint32_t maxScopesPerFrame = kDefaultMaxScopesPerFrame);
+		~D3D12GpuProfiler();
+
+		// Reads the timestamps of the frames the GPU finished. If the slot of the new frame is still in flight the frame isn't profiled.
+		void beginFrame(ID3D12FencePtr pFence);
+
+		// Scopes can nest. The name must outlive the frame, string literals are the common case.
+		uint32_t beginScope(ID3D12GraphicsCommandList4Ptr pCmdList, const char* name);
+		void endScope(ID3D12GraphicsCommandList4Ptr pCmdList, uint32_t scope);
+
+		// Copies the frame's timestamps into the readback buffer. Recorded last, before the command list is closed.
+		void resolve(ID3D12GraphicsCommandList4Ptr pCmdList);
+		void endFrame(uint64_t fenceValue);
+
+		static const uint32_t kDefaultMaxScopesPerFrame = 32;
+		static const uint32_t kInvalidScope = ~0u;
+
+	private:
+		struct Frame
+		{
+			std::vector<const char*> names;
+			uint64_t fenceValue = 0;
+			bool pending = false;
+		};
+
+		void readFrame(Frame& frame, uint32_t slot);
+		void calibrate();
+
+		ID3D12CommandQueuePtr mpQueue;
+		Profiler* mpProfiler;
+		ID3D12QueryHeapPtr mpQueryHeap;
+		ID3D12ResourcePtr mpReadback;
+		const uint64_t* mpTimestamps = nullptr;
+
+		std::vector<Frame> mFrames;
+		uint32_t mMaxScopesPerFrame;
+		uint32_t mFrameIndex = 0;
+		bool mFrameActive = false;
+
+		// A GPU tick and the profiler time taken at the same moment
+		uint64_t mGpuFrequency = 1;
+		uint64_t mCalibrationTicks = 0;
+		double mCalibrationUs = 0.0;
+	};
+};
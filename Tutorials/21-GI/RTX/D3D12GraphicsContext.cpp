@@ -12,6 +12,9 @@ IDXGISwapChain3Ptr CppDirectXRayTracing21::D3D12GraphicsContext::createDxgiSwapC
     swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
     swapChainDesc.SampleDesc.Count = 1;
 
+    // The frame pacer waits on the latency object instead of blocking in Present()
+    swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+
     // CreateSwapChainForHwnd() doesn't accept IDXGISwapChain3 (Why MS? Why?)
     MAKE_SMART_COM_PTR(IDXGISwapChain1);
     IDXGISwapChain1Ptr pSwapChain;
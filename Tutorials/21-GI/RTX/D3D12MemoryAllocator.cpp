@@ -0,0 +1,275 @@
+#pragma once
+#include "D3D12MemoryAllocator.hpp"
+#include <algorithm>
+#include <sstream>
+
+struct CppDirectXRayTracing21::D3D12MemoryAllocator::Pool
+{
+    struct Block
+    {
+        ID3D12HeapPtr pHeap;         // PlacedResources
+        ID3D12ResourcePtr pBuffer;   // SubAllocatedBuffers
+        uint8_t* pCpuAddress = nullptr;
+        std::unique_ptr<TlsfAllocator> allocator;
+    };
+
+    D3D12_HEAP_PROPERTIES heapProps = {};
+    MemoryPoolKind kind = MemoryPoolKind::PlacedResources;
+    uint64_t alignment = 0;
+    std::vector<Block> blocks;
+};
+
+namespace
+{
+    using Pool = CppDirectXRayTracing21::D3D12MemoryAllocator::Pool;
+
+    // {5B8C2A4E-9F3D-4C1B-8E2A-713D6F10A4C7}
+    const GUID kPlacedAllocationGuid = { 0x5b8c2a4e, 0x9f3d, 0x4c1b, { 0x8e, 0x2a, 0x71, 0x3d, 0x6f, 0x10, 0xa4, 0xc7 } };
+
+    // Attached to every placed resource as private data. D3D12 releases it together with the resource,
+    // which is when we return the range to the heap. This keeps ID3D12ResourcePtr as the only handle the callers need.
+    class PlacedAllocationOwner : public IUnknown
+    {
+    public:
+        PlacedAllocationOwner(std::shared_ptr<Pool> pPool, uint32_t block, const CppDirectXRayTracing21::TlsfAllocator::Allocation& range)
+            : mpPool(pPool), mBlock(block), mRange(range) {}
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+        {
+            if (riid == __uuidof(IUnknown))
+            {
+                *ppvObject = static_cast<IUnknown*>(this);
+                AddRef();
+                return S_OK;
+            }
+            *ppvObject = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++mRefCount;
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            ULONG refCount = --mRefCount;
+            if (refCount == 0)
+            {
+                mpPool->blocks[mBlock].allocator->Free(mRange);
+                delete this;
+            }
+            return refCount;
+        }
+
+    private:
+        ULONG mRefCount = 1;
+        std::shared_ptr<Pool> mpPool;
+        uint32_t mBlock;
+        CppDirectXRayTracing21::TlsfAllocator::Allocation mRange;
+    };
+
+    D3D12_RESOURCE_DESC makeBufferDesc(uint64_t size, D3D12_RESOURCE_FLAGS flags)
+    {
+        D3D12_RESOURCE_DESC bufDesc = {};
+        bufDesc.Alignment = 0;
+        bufDesc.DepthOrArraySize = 1;
+        bufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        bufDesc.Flags = flags;
+        bufDesc.Format = DXGI_FORMAT_UNKNOWN;
+        bufDesc.Height = 1;
+        bufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        bufDesc.MipLevels = 1;
+        bufDesc.SampleDesc.Count = 1;
+        bufDesc.SampleDesc.Quality = 0;
+        bufDesc.Width = size;
+        return bufDesc;
+    }
+
+    const char* heapTypeName(D3D12_HEAP_TYPE type)
+    {
+        switch (type)
+        {
+        case D3D12_HEAP_TYPE_DEFAULT: return "Default";
+        case D3D12_HEAP_TYPE_UPLOAD: return "Upload";
+        case D3D12_HEAP_TYPE_READBACK: return "Readback";
+        default: return "Custom";
+        }
+    }
+}
+
+CppDirectXRayTracing21::D3D12MemoryAllocator::D3D12MemoryAllocator(ID3D12Device5Ptr pDevice, uint64_t heapBlockSize, uint64_t bufferBlockSize)
+    : mpDevice(pDevice), mHeapBlockSize(heapBlockSize), mBufferBlockSize(bufferBlockSize)
+{
+}
+
+std::shared_ptr<CppDirectXRayTracing21::D3D12MemoryAllocator::Pool> CppDirectXRayTracing21::D3D12MemoryAllocator::getPool(D3D12_HEAP_TYPE heapType, MemoryPoolKind kind)
+{
+    for (auto& pPool : mPools)
+    {
+        if (pPool->heapProps.Type == heapType && pPool->kind == kind)
+        {
+            return pPool;
+        }
+    }
+
+    // One pool per heap type and alignment class
+    std::shared_ptr<Pool> pPool = std::make_shared<Pool>();
+    pPool->heapProps.Type = heapType;
+    pPool->heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    pPool->heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    pPool->kind = kind;
+    pPool->alignment = (kind == MemoryPoolKind::PlacedResources) ? D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+    mPools.push_back(pPool);
+    return pPool;
+}
+
+uint32_t CppDirectXRayTracing21::D3D12MemoryAllocator::addBlock(Pool& pool, uint64_t minSize, uint64_t alignment)
+{
+    uint64_t blockSize = (pool.kind == MemoryPoolKind::PlacedResources) ? mHeapBlockSize : mBufferBlockSize;
+    blockSize = align_to(pool.alignment, std::max(blockSize, TlsfAllocator::GetRequiredCapacity(minSize, alignment)));
+
+    Pool::Block block;
+    if (pool.kind == MemoryPoolKind::PlacedResources)
+    {
+        D3D12_HEAP_DESC heapDesc = {};
+        heapDesc.SizeInBytes = blockSize;
+        heapDesc.Properties = pool.heapProps;
+        heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+        d3d_call(mpDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&block.pHeap)));
+    }
+    else
+    {
+        D3D12_RESOURCE_DESC bufDesc = makeBufferDesc(blockSize, D3D12_RESOURCE_FLAG_NONE);
+        D3D12_RESOURCE_STATES state = (pool.heapProps.Type == D3D12_HEAP_TYPE_UPLOAD) ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COMMON;
+        d3d_call(mpDevice->CreateCommittedResource(&pool.heapProps, D3D12_HEAP_FLAG_NONE, &bufDesc, state, nullptr, IID_PPV_ARGS(&block.pBuffer)));
+
+        // Upload blocks stay mapped for their whole lifetime
+        if (pool.heapProps.Type == D3D12_HEAP_TYPE_UPLOAD)
+        {
+            d3d_call(block.pBuffer->Map(0, nullptr, (void**)&block.pCpuAddress));
+        }
+    }
+    block.allocator = std::make_unique<TlsfAllocator>(blockSize);
+
+    pool.blocks.push_back(std::move(block));
+    return static_cast<uint32_t>(pool.blocks.size() - 1);
+}
+
+ID3D12ResourcePtr CppDirectXRayTracing21::D3D12MemoryAllocator::createBuffer(uint64_t size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState, const D3D12_HEAP_PROPERTIES& heapProps)
+{
+    D3D12_RESOURCE_DESC bufDesc = makeBufferDesc(size, flags);
+    D3D12_RESOURCE_ALLOCATION_INFO info = mpDevice->GetResourceAllocationInfo(0, 1, &bufDesc);
+
+    std::shared_ptr<Pool> pPool = getPool(heapProps.Type, MemoryPoolKind::PlacedResources);
+
+    uint32_t blockIndex = 0;
+    TlsfAllocator::Allocation range;
+    for (; blockIndex < pPool->blocks.size(); blockIndex++)
+    {
+        range = pPool->blocks[blockIndex].allocator->Allocate(info.SizeInBytes, info.Alignment);
+        if (range.IsValid()) break;
+    }
+    if (range.IsValid() == false)
+    {
+        blockIndex = addBlock(*pPool, info.SizeInBytes, info.Alignment);
+        range = pPool->blocks[blockIndex].allocator->Allocate(info.SizeInBytes, info.Alignment);
+    }
+    if (range.IsValid() == false)
+    {
+        // The new block is sized for the request, placing the buffer at an invalid offset would alias other resources
+        msgBox("Can't allocate a placed buffer of " + std::to_string(info.SizeInBytes) + " bytes");
+        return nullptr;
+    }
+
+    ID3D12ResourcePtr pBuffer;
+    d3d_call(mpDevice->CreatePlacedResource(pPool->blocks[blockIndex].pHeap, range.offset, &bufDesc, initState, nullptr, IID_PPV_ARGS(&pBuffer)));
+
+    // Hand the range over to the resource. SetPrivateDataInterface() takes its own reference
+    PlacedAllocationOwner* pOwner = new PlacedAllocationOwner(pPool, blockIndex, range);
+    d3d_call(pBuffer->SetPrivateDataInterface(kPlacedAllocationGuid, pOwner));
+    pOwner->Release();
+
+    return pBuffer;
+}
+
+CppDirectXRayTracing21::BufferAllocation CppDirectXRayTracing21::D3D12MemoryAllocator::allocateBuffer(uint64_t size, uint64_t alignment, const D3D12_HEAP_PROPERTIES& heapProps)
+{
+    std::shared_ptr<Pool> pPool = getPool(heapProps.Type, MemoryPoolKind::SubAllocatedBuffers);
+    alignment = std::max(alignment, pPool->alignment);
+
+    BufferAllocation allocation;
+    for (; allocation.block < pPool->blocks.size(); allocation.block++)
+    {
+        allocation.range = pPool->blocks[allocation.block].allocator->Allocate(size, alignment);
+        if (allocation.range.IsValid()) break;
+    }
+    if (allocation.range.IsValid() == false)
+    {
+        allocation.block = addBlock(*pPool, size, alignment);
+        allocation.range = pPool->blocks[allocation.block].allocator->Allocate(size, alignment);
+    }
+    if (allocation.range.IsValid() == false)
+    {
+        msgBox("Can't sub-allocate a buffer range of " + std::to_string(size) + " bytes");
+        return BufferAllocation();
+    }
+
+    const Pool::Block& block = pPool->blocks[allocation.block];
+    for (uint32_t i = 0; i < mPools.size(); i++)
+    {
+        if (mPools[i] == pPool) allocation.pool = i;
+    }
+    allocation.pResource = block.pBuffer;
+    allocation.offset = allocation.range.offset;
+    allocation.size = size;
+    allocation.gpuAddress = block.pBuffer->GetGPUVirtualAddress() + allocation.offset;
+    allocation.pCpuAddress = block.pCpuAddress ? block.pCpuAddress + allocation.offset : nullptr;
+    return allocation;
+}
+
+void CppDirectXRayTracing21::D3D12MemoryAllocator::freeBuffer(BufferAllocation& allocation)
+{
+    if (allocation.range.IsValid() == false)
+    {
+        return;
+    }
+    mPools[allocation.pool]->blocks[allocation.block].allocator->Free(allocation.range);
+    allocation = BufferAllocation();
+}
+
+std::vector<CppDirectXRayTracing21::MemoryPoolStats> CppDirectXRayTracing21::D3D12MemoryAllocator::getStats() const
+{
+    std::vector<MemoryPoolStats> stats;
+    for (const auto& pPool : mPools)
+    {
+        MemoryPoolStats poolStats;
+        poolStats.heapType = pPool->heapProps.Type;
+        poolStats.kind = pPool->kind;
+        poolStats.alignment = pPool->alignment;
+        poolStats.blockCount = static_cast<uint32_t>(pPool->blocks.size());
+        for (const auto& block : pPool->blocks)
+        {
+            TlsfAllocator::Stats blockStats = block.allocator->GetStats();
+            poolStats.reservedBytes += blockStats.capacity;
+            poolStats.usedBytes += blockStats.usedBytes;
+            poolStats.allocationCount += blockStats.allocationCount;
+            poolStats.largestFreeBlock = std::max(poolStats.largestFreeBlock, blockStats.largestFreeBlock);
+        }
+        stats.push_back(poolStats);
+    }
+    return stats;
+}
+
+std::string CppDirectXRayTracing21::D3D12MemoryAllocator::getStatsString() const
+{
+    std::stringstream ss;
+    for (const MemoryPoolStats& s : getStats())
+    {
+        ss << heapTypeName(s.heapType) << (s.kind == MemoryPoolKind::PlacedResources ? " placed" : " sub-allocated")
+           << " (align " << s.alignment << "): " << s.allocationCount << " allocations, "
+           << s.usedBytes << " / " << s.reservedBytes << " bytes in " << s.blockCount << " blocks, largest free " << s.largestFreeBlock << "\n";
+    }
+    return ss.str();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Framework.h"
+#include "TlsfAllocator.hpp"
+#include <memory>
+
+namespace CppDirectXRayTracing21
+{
+	MAKE_SMART_COM_PTR(ID3D12Heap);
+
+	// A range of a shared buffer. Small buffers such as constant buffers live here instead of getting their own 64KB resource.
+	struct BufferAllocation
+	{
+		ID3D12ResourcePtr pResource;
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+		uint8_t* pCpuAddress = nullptr; // Only for upload-heap allocations, the shared buffer is persistently mapped
+
+		uint32_t pool = 0;
+		uint32_t block = 0;
+		TlsfAllocator::Allocation range;
+	};
+
+	enum class MemoryPoolKind
+	{
+		PlacedResources,    // ID3D12Heap blocks holding placed resources, 64KB alignment
+		SubAllocatedBuffers // Big buffers split into ranges, 256 bytes alignment
+	};
+
+	struct MemoryPoolStats
+	{
+		D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT;
+		MemoryPoolKind kind = MemoryPoolKind::PlacedResources;
+		uint64_t alignment = 0;
+		uint32_t blockCount = 0;
+		uint64_t reservedBytes = 0;
+		uint64_t usedBytes = 0;
+		uint64_t largestFreeBlock = 0;
+		uint32_t allocationCount = 0;
+	};
+
+	class D3D12MemoryAllocator
+	{
+	public:
+		D3D12MemoryAllocator(ID3D12Device5Ptr pDevice, uint64_t heapBlockSize = kDefaultHeapBlockSize, uint64_t bufferBlockSize = kDefaultBufferBlockSize);
+		~D3D12MemoryAllocator() = default;
+
+		// Creates a placed buffer. The range is returned to its heap automatically when the resource is released.
+		// Returns nullptr, after reporting it, when no heap can hold the buffer.
+		ID3D12ResourcePtr createBuffer(uint64_t size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState, const D3D12_HEAP_PROPERTIES& heapProps);
+
+		// Sub-allocates a range of a shared buffer. Upload ranges start in GENERIC_READ, default ranges in COMMON.
+		// The range is invalid, after reporting it, when no block can hold it.
+		BufferAllocation allocateBuffer(uint64_t size, uint64_t alignment, const D3D12_HEAP_PROPERTIES& heapProps);
+		void freeBuffer(BufferAllocation& allocation);
+
+		std::vector<MemoryPoolStats> getStats() const;
+		std::string getStatsString() const;
+
+		static const uint64_t kDefaultHeapBlockSize = 64ull * 1024 * 1024;
+		static const uint64_t kDefaultBufferBlockSize = 4ull * 1024 * 1024;
+
+		struct Pool;
+
+	private:
+		std::shared_ptr<Pool> getPool(D3D12_HEAP_TYPE heapType, MemoryPoolKind kind);
+		// The block is large enough for an aligned allocation of minSize, even on its own
+		uint32_t addBlock(Pool& pool, uint64_t minSize, uint64_t alignment);
+
+		ID3D12Device5Ptr mpDevice;
+		uint64_t mHeapBlockSize;
+		uint64_t mBufferBlockSize;
+		std::vector<std::shared_ptr<Pool>> mPools;
+	};
+};
@@ -0,0 +1,156 @@
+#pragma once
+#include "D3D12PipelineReloader.hpp"
+
+namespace
+{
+    template<typename T>
+    bool isReady(const std::future<T>& future)
+    {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+}
+
+CppDirectXRayTracing21::D3D12PipelineReloader::D3D12PipelineReloader(ID3D12Device5Ptr pDevice, D3D12RTPipeline* pRtpipe, ID3D12RootSignaturePtr pGlobalRootSig, uint32_t maxTraceRecursionDepth, const std::wstring& shaderDirectory)
+    : mpDevice(pDevice), mpRtpipe(pRtpipe), mpGlobalRootSig(pGlobalRootSig), mMaxTraceRecursionDepth(maxTraceRecursionDepth),
+      mWatcher(shaderDirectory), mLastWatch(std::chrono::steady_clock::now()),
+      // One worker per permutation, the link task runs once they are all done
+      mPool(kShadingModeCount)
+{
+}
+
+CppDirectXRayTracing21::D3D12PipelineReloader::~D3D12PipelineReloader()
+{
+    // Don't let a task run past the pipeline and device it uses
+    mRebuildRequested = false;
+    while (mState != BuildState::Idle)
+    {
+        advance(true);
+    }
+}
+
+void CppDirectXRayTracing21::D3D12PipelineReloader::requestBuild()
+{
+    if (mState == BuildState::Idle)
+    {
+        startBuild();
+    }
+    else
+    {
+        // The running build may have read the sources before the last edit
+        mRebuildRequested = true;
+    }
+}
+
+void CppDirectXRayTracing21::D3D12PipelineReloader::startBuild()
+{
+    mCollectionTasks = mpRtpipe->buildCollections(mPool, mpDevice, mpGlobalRootSig, mMaxTraceRecursionDepth);
+    mState = BuildState::Compiling;
+}
+
+void CppDirectXRayTracing21::D3D12PipelineReloader::poll()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - mLastWatch >= std::chrono::milliseconds(kWatchIntervalMs))
+    {
+        mLastWatch = now;
+        if (mWatcher.Poll().empty() == false)
+        {
+            requestBuild();
+        }
+    }
+
+    advance(false);
+}
+
+void CppDirectXRayTracing21::D3D12PipelineReloader::advance(bool wait)
+{
+    if (mState == BuildState::Compiling)
+    {
+        for (std::future<CollectionBuild>& task : mCollectionTasks)
+        {
+            if (wait == false && isReady(task) == false)
+            {
+                return;
+            }
+            task.wait();
+        }
+
+        std::array<ID3D12StateObjectPtr, kShadingModeCount> collections;
+        std::string errorLog;
+        bool compiled = true;
+        for (uint32_t i = 0; i < kShadingModeCount; i++)
+        {
+            CollectionBuild build = mCollectionTasks[i].get();
+            collections[i] = build.pCollection;
+            compiled = compiled && (collections[i] != nullptr);
+
+            // The permutations usually fail with the same errors, each distinct log is shown once
+            if (build.errorLog.empty() == false && errorLog.find(build.errorLog) == std::string::npos)
+            {
+                errorLog += build.errorLog;
+            }
+        }
+
+        // The workers never block on a message box, the errors are shown from this thread
+        if (errorLog.empty() == false)
+        {
+            msgBox("Compiler error:\n" + errorLog);
+        }
+
+        if (compiled)
+        {
+            // Linking doesn't touch the command list, it runs on a worker too
+            mLinkTask = mPool.Submit([this, collections]() { return mpRtpipe->linkPipeline(mpDevice, collections, mpGlobalRootSig, mMaxTraceRecursionDepth); });
+            mState = BuildState::Linking;
+        }
+        else
+        {
+            // The current pipeline stays, the next edit of the sources starts another build
+            mState = BuildState::Idle;
+        }
+    }
+
+    if (mState == BuildState::Linking)
+    {
+        if (wait == false && isReady(mLinkTask) == false)
+        {
+            return;
+        }
+
+        ID3D12StateObjectPtr pPipelineState = mLinkTask.get();
+        if (pPipelineState)
+        {
+            mpCompletedPipeline = pPipelineState;
+        }
+        mState = BuildState::Idle;
+    }
+
+    if (mState == BuildState::Idle && mRebuildRequested)
+    {
+        mRebuildRequested = false;
+        startBuild();
+    }
+}
+
+bool CppDirectXRayTracing21::D3D12PipelineReloader::takePipeline(ID3D12StateObjectPtr& pPipelineState)
+{
+    if (mpCompletedPipeline == nullptr)
+    {
+        return false;
+    }
+    pPipelineState = mpCompletedPipeline;
+    mpCompletedPipeline = nullptr;
+    return true;
+}
+
+ID3D12StateObjectPtr CppDirectXRayTracing21::D3D12PipelineReloader::waitForPipeline()
+{
+    while (mState != BuildState::Idle)
+    {
+        advance(true);
+    }
+
+    ID3D12StateObjectPtr pPipelineState;
+    takePipeline(pPipelineState);
+    return pPipelineState;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "D3D12RTPipeline.hpp"
+#include "ShaderFileWatcher.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+
+namespace CppDirectXRayTracing21
+{
+	// Compiles the shader libraries, creates their collections and links the ray-tracing pipeline on worker threads.
+	// The shader directory is watched, editing a source rebuilds the pipeline in the background. The render thread
+	// only polls the tasks and picks up the new pipeline at a frame boundary. A build that fails to compile or link
+	// is dropped and the previous pipeline stays in use. The compiler errors are reported from the polling thread.
+	class D3D12PipelineReloader
+	{
+	public:
+		D3D12PipelineReloader(ID3D12Device5Ptr pDevice, D3D12RTPipeline* pRtpipe, ID3D12RootSignaturePtr pGlobalRootSig, uint32_t maxTraceRecursionDepth, const std::wstring& shaderDirectory);
+		~D3D12PipelineReloader();
+
+		// Starts a build. If one is already running, another one follows it.
+		void requestBuild();
+
+		// Render thread, once per frame. Watches the sources and advances the running build without blocking.
+		void poll();
+
+		// Returns true and the new pipeline when a build completed since the last call.
+		bool takePipeline(ID3D12StateObjectPtr& pPipelineState);
+
+		// Blocks until the running build completed and returns its pipeline, nullptr if it failed. Used at load time.
+		ID3D12StateObjectPtr waitForPipeline();
+
+	private:
+		enum class BuildState
+		{
+			Idle,
+			Compiling,
+			Linking
+		};
+
+		void startBuild();
+		void advance(bool wait);
+
+		static const uint32_t kWatchIntervalMs = 500;
+
+		ID3D12Device5Ptr mpDevice;
+		D3D12RTPipeline* mpRtpipe;
+		ID3D12RootSignaturePtr mpGlobalRootSig;
+		uint32_t mMaxTraceRecursionDepth;
+
+		ShaderFileWatcher mWatcher;
+		std::chrono::steady_clock::time_point mLastWatch;
+
+		BuildState mState = BuildState::Idle;
+		bool mRebuildRequested = false;
+		std::array<std::future<CollectionBuild>, kShadingModeCount> mCollectionTasks;
+		std::future<ID3D12StateObjectPtr> mLinkTask;
+		ID3D12StateObjectPtr mpCompletedPipeline;
+
+		// Declared last, the workers are joined before the tasks' captures go away
+		ThreadPool mPool;
+	};
+};
@@ -1,49 +1,148 @@
 #pragma once
 #include "D3D12RTPipeline.hpp"
+#include "PayloadPacking.hpp"
+#include "../Primitives/SphereIntersection.hpp"
+#include <mutex>
 #include <sstream>
 
 #define DXC
 
 #ifdef DXC
     static dxc::DxcDllSupport gDxcDllHelper;
+    static std::once_flag gDxcInitFlag;
     MAKE_SMART_COM_PTR(IDxcCompiler);
     MAKE_SMART_COM_PTR(IDxcLibrary);
     MAKE_SMART_COM_PTR(IDxcIncludeHandler);
     MAKE_SMART_COM_PTR(IDxcBlobEncoding);
     MAKE_SMART_COM_PTR(IDxcOperationResult);
+    MAKE_SMART_COM_PTR(IDxcVersionInfo);
+
+    // Part of the cache key, a new compiler may generate different DXIL from the same source
+    static std::string getCompilerVersion(IDxcCompilerPtr pCompiler)
+    {
+        IDxcVersionInfoPtr pVersionInfo;
+        UINT32 major = 0, minor = 0;
+        if (SUCCEEDED(pCompiler->QueryInterface(IID_PPV_ARGS(&pVersionInfo))))
+        {
+            pVersionInfo->GetVersion(&major, &minor);
+        }
+        return std::to_string(major) + "." + std::to_string(minor);
+    }
+
+    // Serves the includes from the snapshot the cache key was computed from, instead of reading them again from the disk.
+    // Files the snapshot doesn't know, like the ones found through a system include path, go to the default handler
+    class SnapshotIncludeHandler : public IDxcIncludeHandler
+    {
+    public:
+        SnapshotIncludeHandler(const CppDirectXRayTracing21::ShaderSourceSnapshot& source, IDxcLibraryPtr pLibrary, IDxcIncludeHandlerPtr pDefault)
+            : mSource(source), mpLibrary(pLibrary), mpDefault(pDefault) {}
+
+        HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename, IDxcBlob** ppIncludeSource) override
+        {
+            const std::string* pContent = mSource.Find(std::filesystem::path(pFilename));
+            if (pContent == nullptr)
+            {
+                return mpDefault->LoadSource(pFilename, ppIncludeSource);
+            }
+            IDxcBlobEncodingPtr pBlob;
+            HRESULT hr = mpLibrary->CreateBlobWithEncodingOnHeapCopy(pContent->data(), (uint32_t)pContent->size(), 0, &pBlob);
+            if (SUCCEEDED(hr))
+            {
+                *ppIncludeSource = pBlob.Detach();
+            }
+            return hr;
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+        {
+            if (riid == __uuidof(IUnknown) || riid == __uuidof(IDxcIncludeHandler))
+            {
+                *ppvObject = static_cast<IDxcIncludeHandler*>(this);
+                AddRef();
+                return S_OK;
+            }
+            *ppvObject = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++mRefCount;
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            ULONG refCount = --mRefCount;
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+    private:
+        ULONG mRefCount = 1;
+        const CppDirectXRayTracing21::ShaderSourceSnapshot& mSource;
+        IDxcLibraryPtr mpLibrary;
+        IDxcIncludeHandlerPtr mpDefault;
+    };
 #endif // DXC
 
-ID3DBlobPtr CppDirectXRayTracing21::D3D12RTPipeline::compileLibrary(const WCHAR* filename, const WCHAR* targetString)
+bool CppDirectXRayTracing21::D3D12RTPipeline::supportsRaytracingTier1_1(ID3D12Device5Ptr pDevice)
+{
+    D3D12_FEATURE_DATA_D3D12_OPTIONS5 options5 = {};
+    return SUCCEEDED(pDevice->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS5, &options5, sizeof(options5))) &&
+        options5.RaytracingTier >= D3D12_RAYTRACING_TIER_1_1;
+}
+
+ID3DBlobPtr CppDirectXRayTracing21::D3D12RTPipeline::compileLibrary(const WCHAR* filename, const WCHAR* targetString, const ShaderDefines& defines, std::string& errorLog)
 {
-    // Initialize the helper
-    d3d_call(gDxcDllHelper.Initialize());
+    // Initialize the helper. Libraries are compiled from several threads, the DLL is only loaded once
+    std::call_once(gDxcInitFlag, [] { d3d_call(gDxcDllHelper.Initialize()); });
     IDxcCompilerPtr pCompiler;
     IDxcLibraryPtr pLibrary;
-    IDxcIncludeHandlerPtr pInclude;
+    IDxcIncludeHandlerPtr pDefaultInclude;
     d3d_call(gDxcDllHelper.CreateInstance(CLSID_DxcCompiler, &pCompiler));
     d3d_call(gDxcDllHelper.CreateInstance(CLSID_DxcLibrary, &pLibrary));
 
-    // Open and read the file
-    std::ifstream shaderFile(filename);
-    if (shaderFile.good() == false)
+    // Read the file and its includes once, the key is hashed from these bytes and the compiler gets the same ones
+    ShaderSourceSnapshot source;
+    if (ShaderCache::ReadSource(filename, source) == false)
     {
-        msgBox("Can't open file " + wstring_2_string(std::wstring(filename)));
+        errorLog = "Can't open file " + wstring_2_string(std::wstring(filename)) + " or one of its includes";
         return nullptr;
     }
-    std::stringstream strStream;
-    strStream << shaderFile.rdbuf();
-    std::string shader = strStream.str();
 
-    // Create blob from the string
+    // Skip the compilation if the library was already compiled from the same source, includes, target and defines
+    std::string cacheKey = mShaderCache.ComputeKey(source, targetString, defines, getCompilerVersion(pCompiler));
+    std::vector<uint8_t> cachedLibrary;
+    if (mShaderCache.Load(cacheKey, cachedLibrary))
+    {
+        IDxcBlobEncodingPtr pCachedBlob;
+        d3d_call(pLibrary->CreateBlobWithEncodingOnHeapCopy(cachedLibrary.data(), static_cast<uint32_t>(cachedLibrary.size()), 0, &pCachedBlob));
+        return pCachedBlob;
+    }
+
+    // Create blob from the snapshot of the file
+    const std::string& shader = source.files.front().second;
     IDxcBlobEncodingPtr pTextBlob;
     d3d_call(pLibrary->CreateBlobWithEncodingFromPinned((LPBYTE)shader.c_str(), (uint32_t)shader.size(), 0, &pTextBlob));
 
     // Include header
-    d3d_call(pLibrary->CreateIncludeHandler(&pInclude));
+    d3d_call(pLibrary->CreateIncludeHandler(&pDefaultInclude));
+    IDxcIncludeHandlerPtr pInclude(new SnapshotIncludeHandler(source, pLibrary, pDefaultInclude), false);
+
+    // The defines only point into the caller's strings, which outlive the compilation
+    std::vector<DxcDefine> dxcDefines(defines.size());
+    for (size_t i = 0; i < defines.size(); i++)
+    {
+        dxcDefines[i].Name = defines[i].first.c_str();
+        dxcDefines[i].Value = defines[i].second.c_str();
+    }
 
     // Compile
     IDxcOperationResultPtr pResult;
-    d3d_call(pCompiler->Compile(pTextBlob, filename, L"", targetString, nullptr, 0, nullptr, 0, pInclude, &pResult));
+    d3d_call(pCompiler->Compile(pTextBlob, filename, L"", targetString, nullptr, 0, dxcDefines.data(), (uint32_t)dxcDefines.size(), pInclude, &pResult));
 
     // Verify the result
     HRESULT resultCode;
@@ -52,46 +151,41 @@ ID3DBlobPtr CppDirectXRayTracing21::D3D12RTPipeline::compileLibrary(const WCHAR*
     {
         IDxcBlobEncodingPtr pError;
         d3d_call(pResult->GetErrorBuffer(&pError));
-        std::string log = convertBlobToString(pError.GetInterfacePtr());
-        msgBox("Compiler error:\n" + log);
+        errorLog = convertBlobToString(pError.GetInterfacePtr());
         return nullptr;
     }
 
     MAKE_SMART_COM_PTR(IDxcBlob);
     IDxcBlobPtr pBlob;
     d3d_call(pResult->GetResult(&pBlob));
+
+    // A failed store only costs a recompilation on the next launch
+    mShaderCache.Store(cacheKey, pBlob->GetBufferPointer(), pBlob->GetBufferSize());
     return pBlob;
 }
 
 CppDirectXRayTracing21::RootSignatureDesc CppDirectXRayTracing21::D3D12RTPipeline::createRayGenRootDesc()
 {
-    // Create the root-signature
+    // Create the root-signature. The table is allocated as one contiguous range, the descriptors follow the range order
     CppDirectXRayTracing21::RootSignatureDesc desc;
-    desc.range.resize(3);
+    desc.range.resize(2);
     // gOutput
     desc.range[0].BaseShaderRegister = 0;
     desc.range[0].NumDescriptors = 1;
     desc.range[0].RegisterSpace = 0;
     desc.range[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
-    desc.range[0].OffsetInDescriptorsFromTableStart = 0;
+    desc.range[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 
     // gRtScene
     desc.range[1].BaseShaderRegister = 0;
     desc.range[1].NumDescriptors = 1;
     desc.range[1].RegisterSpace = 0;
     desc.range[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-    desc.range[1].OffsetInDescriptorsFromTableStart = 1;
-
-    // Scene Constant Buffer
-    desc.range[2].BaseShaderRegister = 0;
-    desc.range[2].NumDescriptors = 1;
-    desc.range[2].RegisterSpace = 0;
-    desc.range[2].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-    desc.range[2].OffsetInDescriptorsFromTableStart = 4;
+    desc.range[1].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 
     desc.rootParams.resize(1);
     desc.rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    desc.rootParams[0].DescriptorTable.NumDescriptorRanges = 3;
+    desc.rootParams[0].DescriptorTable.NumDescriptorRanges = 2;
     desc.rootParams[0].DescriptorTable.pDescriptorRanges = desc.range.data();
 
     // Create the desc
@@ -104,52 +198,61 @@ CppDirectXRayTracing21::RootSignatureDesc CppDirectXRayTracing21::D3D12RTPipelin
 
 CppDirectXRayTracing21::RootSignatureDesc CppDirectXRayTracing21::D3D12RTPipeline::createHitRootDesc()
 {
+    // Three descriptor tables: the scene table, then the bindless index and vertex buffer arrays.
+    // Each array is unbounded and lives in its own register space, so it gets its own table.
     RootSignatureDesc desc;
-    desc.range.resize(4);
+    desc.range.resize(5);
 
     // gRtScene
     desc.range[0].BaseShaderRegister = 0;
     desc.range[0].NumDescriptors = 1;
     desc.range[0].RegisterSpace = 0;
     desc.range[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-    desc.range[0].OffsetInDescriptorsFromTableStart = 1;
+    desc.range[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 
-    // indices
-    desc.range[1].NumDescriptors = 1;
+    // gInstances
     desc.range[1].BaseShaderRegister = 1;
+    desc.range[1].NumDescriptors = 1;
     desc.range[1].RegisterSpace = 0;
     desc.range[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-    desc.range[1].OffsetInDescriptorsFromTableStart = 2;
+    desc.range[1].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 
-    // vertices
-    desc.range[2].NumDescriptors = 1;
+    // gMaterials
     desc.range[2].BaseShaderRegister = 2;
+    desc.range[2].NumDescriptors = 1;
     desc.range[2].RegisterSpace = 0;
     desc.range[2].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-    desc.range[2].OffsetInDescriptorsFromTableStart = 3;
+    desc.range[2].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 
-    // Scene Constant Buffer
+    // gIndexBuffers[]
     desc.range[3].BaseShaderRegister = 0;
-    desc.range[3].NumDescriptors = 1;
-    desc.range[3].RegisterSpace = 0;
-    desc.range[3].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-    desc.range[3].OffsetInDescriptorsFromTableStart = 4;
+    desc.range[3].NumDescriptors = UINT_MAX;
+    desc.range[3].RegisterSpace = 1;
+    desc.range[3].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    desc.range[3].OffsetInDescriptorsFromTableStart = 0;
+
+    // gVertexBuffers[]
+    desc.range[4].BaseShaderRegister = 0;
+    desc.range[4].NumDescriptors = UINT_MAX;
+    desc.range[4].RegisterSpace = 2;
+    desc.range[4].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    desc.range[4].OffsetInDescriptorsFromTableStart = 0;
 
     // Create desc
-    desc.rootParams.resize(2);
+    desc.rootParams.resize(3);
     desc.rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    desc.rootParams[0].Descriptor.RegisterSpace = 0;
-    desc.rootParams[0].Descriptor.ShaderRegister = 0;
-    desc.rootParams[0].DescriptorTable.NumDescriptorRanges = 4;
-    desc.rootParams[0].DescriptorTable.pDescriptorRanges = desc.range.data();
+    desc.rootParams[0].DescriptorTable.NumDescriptorRanges = 3;
+    desc.rootParams[0].DescriptorTable.pDescriptorRanges = &desc.range[0];
 
-    // Constant Buffer register
-    desc.rootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-    desc.rootParams[1].Descriptor.RegisterSpace = 0;
-    desc.rootParams[1].Descriptor.ShaderRegister = 1;
+    desc.rootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    desc.rootParams[1].DescriptorTable.NumDescriptorRanges = 1;
+    desc.rootParams[1].DescriptorTable.pDescriptorRanges = &desc.range[3];
 
+    desc.rootParams[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    desc.rootParams[2].DescriptorTable.NumDescriptorRanges = 1;
+    desc.rootParams[2].DescriptorTable.pDescriptorRanges = &desc.range[4];
 
-    desc.desc.NumParameters = 2;
+    desc.desc.NumParameters = 3;
     desc.desc.pParameters = desc.rootParams.data();
     desc.desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
 
@@ -158,34 +261,213 @@ CppDirectXRayTracing21::RootSignatureDesc CppDirectXRayTracing21::D3D12RTPipelin
 
 CppDirectXRayTracing21::RootSignatureDesc CppDirectXRayTracing21::D3D12RTPipeline::CreateMissRootDesc()
 {
-    // Create the root-signature
+    // The miss shaders only read the scene constant buffer, which is bound through the global root signature
     CppDirectXRayTracing21::RootSignatureDesc desc;
-    desc.range.resize(1);
+    desc.desc.NumParameters = 0;
+    desc.desc.pParameters = nullptr;
+    desc.desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
 
-    // Scene Constant Buffer
-    desc.range[0].BaseShaderRegister = 0;
-    desc.range[0].NumDescriptors = 1;
-    desc.range[0].RegisterSpace = 0;
-    desc.range[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-    desc.range[0].OffsetInDescriptorsFromTableStart = 4;
+    return desc;
+}
 
+CppDirectXRayTracing21::RootSignatureDesc CppDirectXRayTracing21::D3D12RTPipeline::createGlobalRootDesc()
+{
+    // Scene Constant Buffer. It is re-written every frame, so it is a root CBV pointing into the per-frame upload ring
+    CppDirectXRayTracing21::RootSignatureDesc desc;
     desc.rootParams.resize(1);
-    desc.rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    desc.rootParams[0].DescriptorTable.NumDescriptorRanges = 1;
-    desc.rootParams[0].DescriptorTable.pDescriptorRanges = desc.range.data();
+    desc.rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+    desc.rootParams[0].Descriptor.RegisterSpace = 0;
+    desc.rootParams[0].Descriptor.ShaderRegister = 0;
 
-    // Create the desc
     desc.desc.NumParameters = 1;
     desc.desc.pParameters = desc.rootParams.data();
-    desc.desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
+    desc.desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
 
     return desc;
 }
 
-CppDirectXRayTracing21::DxilLibrary CppDirectXRayTracing21::D3D12RTPipeline::createDxilLibrary()
+std::array<std::future<CppDirectXRayTracing21::CollectionBuild>, CppDirectXRayTracing21::kShadingModeCount> CppDirectXRayTracing21::D3D12RTPipeline::buildCollections(ThreadPool& pool, ID3D12Device5Ptr pDevice, ID3D12RootSignaturePtr pGlobalRootSig, uint32_t maxTraceRecursionDepth)
 {
-    // Compile the shader
-    ID3DBlobPtr pDxilLib = compileLibrary(kShaderName, L"lib_6_3");
-    const WCHAR* entryPoints[] = { kRayGenShader, kMissShader, kClosestHitShader, kShadowMiss };
-    return DxilLibrary(pDxilLib, entryPoints, arraysize(entryPoints));
+    // Each permutation is compiled and turned into a collection on its own task. Creating the collection is where the
+    // driver compiles the DXIL, so that work is spread over the workers too
+    std::array<std::future<CollectionBuild>, kShadingModeCount> tasks;
+    for (uint32_t i = 0; i < kShadingModeCount; i++)
+    {
+        ShadingMode mode = static_cast<ShadingMode>(i);
+        tasks[i] = pool.Submit([this, mode, pDevice, pGlobalRootSig, maxTraceRecursionDepth]() -> CollectionBuild
+        {
+            CollectionBuild build;
+            ID3DBlobPtr pLibrary = compileLibrary(kShaderName, GetLibraryTarget(mInlineVisibility), GetShadingModeDefines(mode, mInlineVisibility), build.errorLog);
+            if (pLibrary)
+            {
+                build.pCollection = getCollection(pDevice, mode, pLibrary, pGlobalRootSig, maxTraceRecursionDepth);
+            }
+            return build;
+        });
+    }
+    return tasks;
 }
+
+ID3D12StateObjectPtr CppDirectXRayTracing21::D3D12RTPipeline::getCollection(ID3D12Device5Ptr pDevice, ShadingMode mode, ID3DBlobPtr pLibrary, ID3D12RootSignaturePtr pGlobalRootSig, uint32_t maxTraceRecursionDepth)
+{
+    // A permutation whose DXIL didn't change keeps its collection, only the edited ones are re-created
+    CachedCollection& cached = mCollections[static_cast<uint32_t>(mode)];
+    if (cached.pCollection && cached.pLibrary->GetBufferSize() == pLibrary->GetBufferSize() &&
+        memcmp(cached.pLibrary->GetBufferPointer(), pLibrary->GetBufferPointer(), pLibrary->GetBufferSize()) == 0)
+    {
+        return cached.pCollection;
+    }
+
+    std::wstring chsExport = getClosestHitExport(mode);
+    std::wstring hitGroupExport = getHitGroupExport(mode);
+    std::wstring sphereChsExport = getModeExport(kSphereClosestHitShader, mode);
+    std::wstring sphereIntersectionExport = getModeExport(kSphereIntersectionShader, mode);
+    std::wstring sphereHitGroupExport = getSphereHitGroupExport(mode);
+
+    D3D12StateObjectBuilder builder(StateObjectGraphType::Collection);
+    StateObjectGraph& graph = builder.getGraph();
+
+    // Every collection holds its hit shaders, renamed with the name of the mode, and the hit groups using them: the triangle one
+    // and the procedural one of the analytic spheres. The collection of kBaseShadingMode also holds the ray-gen and miss shaders
+    std::vector<std::wstring> hitShaders = { chsExport, sphereChsExport, sphereIntersectionExport };
+    std::vector<std::wstring> shaders = hitShaders;
+    std::vector<LibraryExport> exports = {
+        { chsExport, kClosestHitShader },
+        { sphereChsExport, kSphereClosestHitShader },
+        { sphereIntersectionExport, kSphereIntersectionShader }
+    };
+    if (mode == kBaseShadingMode)
+    {
+        exports.push_back({ kRayGenShader, L"" });
+        exports.push_back({ kMissShader, L"" });
+        shaders.insert(shaders.end(), { kRayGenShader, kMissShader });
+        if (mInlineVisibility == false)
+        {
+            exports.push_back({ kShadowMiss, L"" });
+            shaders.push_back(kShadowMiss);
+        }
+    }
+    builder.addLibrary(pLibrary, exports);
+    graph.AddHitGroup(hitGroupExport, chsExport);
+    graph.AddHitGroup(sphereHitGroupExport, sphereChsExport, std::wstring(), sphereIntersectionExport);
+
+    // Both hit groups read the same local root arguments, the shader table gives them the same descriptor tables
+    builder.addLocalRootSignature(LocalRootSignature(pDevice, createHitRootDesc().desc).pRootSig, hitShaders);
+    if (mode == kBaseShadingMode)
+    {
+        builder.addLocalRootSignature(LocalRootSignature(pDevice, createRayGenRootDesc().desc).pRootSig, { kRayGenShader });
+        std::vector<std::wstring> missShaders = { kMissShader };
+        if (mInlineVisibility == false)
+        {
+            missShaders.push_back(kShadowMiss);
+        }
+        builder.addLocalRootSignature(LocalRootSignature(pDevice, CreateMissRootDesc().desc).pRootSig, missShaders);
+    }
+
+    // The payload and attribute sizes are shared by all the shaders. The payload is the largest of the packed payloads,
+    // the attributes the larger of the triangle barycentrics and the sphere normal
+    uint32_t maxAttributeSize = static_cast<uint32_t>(std::max(sizeof(float) * 2, sizeof(Primitives::SphereAttributes)));
+    graph.AddShaderConfig(maxAttributeSize, kMaxPayloadSizeInBytes, shaders);
+
+    // The collection is compiled on its own, it needs the whole configuration
+    builder.setGlobalRootSignature(pGlobalRootSig);
+    graph.SetPipelineConfig(maxTraceRecursionDepth);
+
+    ID3D12StateObjectPtr pCollection = builder.create(pDevice);
+    if (pCollection)
+    {
+        cached.pLibrary = pLibrary;
+        cached.pCollection = pCollection;
+    }
+    return pCollection;
+}
+
+std::vector<std::wstring> CppDirectXRayTracing21::D3D12RTPipeline::getCollectionExports(ShadingMode mode) const
+{
+    std::vector<std::wstring> exports = { getClosestHitExport(mode), getModeExport(kSphereClosestHitShader, mode), getModeExport(kSphereIntersectionShader, mode),
+                                          getHitGroupExport(mode), getSphereHitGroupExport(mode) };
+    if (mode == kBaseShadingMode)
+    {
+        exports.insert(exports.end(), { kRayGenShader, kMissShader });
+        if (mInlineVisibility == false)
+        {
+            exports.push_back(kShadowMiss);
+        }
+    }
+    return exports;
+}
+
+ID3D12StateObjectPtr CppDirectXRayTracing21::D3D12RTPipeline::linkPipeline(ID3D12Device5Ptr pDevice, const std::array<ID3D12StateObjectPtr, kShadingModeCount>& collections, ID3D12RootSignaturePtr pGlobalRootSig, uint32_t maxTraceRecursionDepth)
+{
+    for (const ID3D12StateObjectPtr& pCollection : collections)
+    {
+        if (pCollection == nullptr)
+        {
+            return nullptr;
+        }
+    }
+
+    // AddToStateObject() needs ID3D12Device7 and ray-tracing tier 1.1
+    ID3D12Device7Ptr pDevice7;
+    bool supportsAdditions = SUCCEEDED(pDevice->QueryInterface(IID_PPV_ARGS(&pDevice7))) && supportsRaytracingTier1_1(pDevice);
+
+    // Without additions, the pipeline links all the collections at once
+    D3D12StateObjectBuilder builder(StateObjectGraphType::RaytracingPipeline);
+    uint32_t base = static_cast<uint32_t>(kBaseShadingMode);
+    builder.addCollection(collections[base], getCollectionExports(kBaseShadingMode));
+    for (uint32_t i = 0; i < kShadingModeCount; i++)
+    {
+        if (supportsAdditions == false && i != base)
+        {
+            builder.addCollection(collections[i], getCollectionExports(static_cast<ShadingMode>(i)));
+        }
+    }
+    builder.setGlobalRootSignature(pGlobalRootSig);
+    builder.getGraph().SetPipelineConfig(maxTraceRecursionDepth);
+    builder.getGraph().SetAllowStateObjectAdditions(supportsAdditions);
+
+    ID3D12StateObjectPtr pPipelineState = builder.create(pDevice);
+    if (supportsAdditions == false)
+    {
+        return pPipelineState;
+    }
+
+    // Otherwise it grows one hit group collection at a time, the same path a material streamed in at runtime takes
+    for (uint32_t i = 0; i < kShadingModeCount && pPipelineState; i++)
+    {
+        if (i != base)
+        {
+            pPipelineState = addCollection(pDevice7, pPipelineState, collections[i], getCollectionExports(static_cast<ShadingMode>(i)));
+        }
+    }
+    return pPipelineState;
+}
+
+ID3D12StateObjectPtr CppDirectXRayTracing21::D3D12RTPipeline::addCollection(ID3D12Device7Ptr pDevice, ID3D12StateObjectPtr pPipelineState, ID3D12StateObjectPtr pCollection, const std::vector<std::wstring>& exports)
+{
+    // The parent stays valid, the frames in flight can keep using it
+    D3D12StateObjectBuilder builder(StateObjectGraphType::RaytracingPipeline);
+    builder.addCollection(pCollection, exports);
+    builder.getGraph().SetAllowStateObjectAdditions(true);
+    return builder.addTo(pDevice, pPipelineState);
+}
+
+std::wstring CppDirectXRayTracing21::D3D12RTPipeline::getClosestHitExport(ShadingMode mode) const
+{
+    return getModeExport(kClosestHitShader, mode);
+}
+
+std::wstring CppDirectXRayTracing21::D3D12RTPipeline::getHitGroupExport(ShadingMode mode) const
+{
+    return getModeExport(kHitGroup, mode);
+}
+
+std::wstring CppDirectXRayTracing21::D3D12RTPipeline::getSphereHitGroupExport(ShadingMode mode) const
+{
+    return getModeExport(kSphereHitGroup, mode);
+}
+
+std::wstring CppDirectXRayTracing21::D3D12RTPipeline::getModeExport(const WCHAR* name, ShadingMode mode)
+{
+    return std::wstring(name) + L"_" + GetShadingModeName(mode);
+}
\ No newline at end of file
@@ -1,29 +1,96 @@
 #pragma once
-#include "Structs/DxilLibrary.hpp"
 #include "Structs/RootSignature.hpp"
+#include "D3D12StateObjectBuilder.hpp"
+#include "ShaderCache.hpp"
+#include "ShaderPermutations.hpp"
+#include "ThreadPool.hpp"
+#include <array>
 
 namespace CppDirectXRayTracing21
 {
+	// The result of one task of D3D12RTPipeline::buildCollections(). The workers don't report anything, the errors of a
+	// failed compilation are returned to the thread polling the task.
+	struct CollectionBuild
+	{
+		ID3D12StateObjectPtr pCollection;
+		std::string errorLog;
+	};
+
 	class D3D12RTPipeline
 	{
 	public:
 		D3D12RTPipeline() = default;
 		~D3D12RTPipeline() = default;
 
-		ID3DBlobPtr compileLibrary(const WCHAR* filename, const WCHAR* targetString);
+		// Tier 1.1 brings inline ray tracing and AddToStateObject().
+		static bool supportsRaytracingTier1_1(ID3D12Device5Ptr pDevice);
+
+		// Selects how visibility rays are traced, must be set before the first build. With inline visibility the
+		// libraries target lib_6_5 and the shadow miss shader isn't exported.
+		void setInlineVisibility(bool inlineVisibility) { mInlineVisibility = inlineVisibility; }
+		bool getInlineVisibility() const { return mInlineVisibility; }
+
+		// Returns nullptr and the compiler output in errorLog if the library can't be read or compiled. Nothing is shown to
+		// the user, this runs on the worker threads.
+		ID3DBlobPtr compileLibrary(const WCHAR* filename, const WCHAR* targetString, const ShaderDefines& defines, std::string& errorLog);
+
+		// Compiles the shader library once per shading mode and creates a COLLECTION state object from each permutation.
+		// Each one is a task of the pool, a future holds a null collection if its compilation or creation failed.
+		std::array<std::future<CollectionBuild>, kShadingModeCount> buildCollections(ThreadPool& pool, ID3D12Device5Ptr pDevice, ID3D12RootSignaturePtr pGlobalRootSig, uint32_t maxTraceRecursionDepth);
+
+		// Returns the cached collection of the mode if it was created from the same DXIL, creates it otherwise.
+		ID3D12StateObjectPtr getCollection(ID3D12Device5Ptr pDevice, ShadingMode mode, ID3DBlobPtr pLibrary, ID3D12RootSignaturePtr pGlobalRootSig, uint32_t maxTraceRecursionDepth);
+
+		// Links the collections into a ray-tracing pipeline. When the device supports it, the pipeline is created from the
+		// base collection and the other hit groups are added with addCollection(). Returns nullptr if anything failed.
+		// Only uses the device, it can run on any thread.
+		ID3D12StateObjectPtr linkPipeline(ID3D12Device5Ptr pDevice, const std::array<ID3D12StateObjectPtr, kShadingModeCount>& collections, ID3D12RootSignaturePtr pGlobalRootSig, uint32_t maxTraceRecursionDepth);
+
+		// Returns a new pipeline made of pPipelineState and the collection. pPipelineState must allow additions.
+		ID3D12StateObjectPtr addCollection(ID3D12Device7Ptr pDevice, ID3D12StateObjectPtr pPipelineState, ID3D12StateObjectPtr pCollection, const std::vector<std::wstring>& exports);
+
 		RootSignatureDesc createRayGenRootDesc();
 		RootSignatureDesc createHitRootDesc();
 		RootSignatureDesc CreateMissRootDesc();
-		DxilLibrary createDxilLibrary();
+		RootSignatureDesc createGlobalRootDesc();
+
+		// The hit shaders of each collection are renamed with the name of the mode, the triangle closest-hit to getClosestHitExport(mode).
+		// Every collection has two hit groups: getHitGroupExport(mode) for the triangle meshes and getSphereHitGroupExport(mode)
+		// for the analytic spheres. The collection of kBaseShadingMode also exports the ray-gen and miss shaders.
+		std::vector<std::wstring> getCollectionExports(ShadingMode mode) const;
+		std::wstring getClosestHitExport(ShadingMode mode) const;
+		std::wstring getHitGroupExport(ShadingMode mode) const;
+		std::wstring getSphereHitGroupExport(ShadingMode mode) const;
 
 		const WCHAR* kShaderName = L"Data/Shaders.hlsl";
 		const WCHAR* kRayGenShader = L"rayGen";
 		const WCHAR* kMissShader = L"miss";
 		const WCHAR* kClosestHitShader = L"chs";
 		const WCHAR* kShadowMiss = L"shadowMiss";
+		const WCHAR* kSphereIntersectionShader = L"sphereIntersection";
+		const WCHAR* kSphereClosestHitShader = L"chsSphere";
 		
 		const WCHAR* kHitGroup = L"HitGroup";
-		
+		const WCHAR* kSphereHitGroup = L"SphereHitGroup";
+
+		const ShadingMode kBaseShadingMode = ShadingMode::LambertGI;
+
+	private:
+		// name_<mode>, the exports of the collections must not collide once they are linked
+		static std::wstring getModeExport(const WCHAR* name, ShadingMode mode);
+
+		// Compiled libraries, relative to the working directory like the shader sources
+		ShaderCache mShaderCache{ L"ShaderCache" };
+		bool mInlineVisibility = false;
+
+		struct CachedCollection
+		{
+			ID3DBlobPtr pLibrary;
+			ID3D12StateObjectPtr pCollection;
+		};
+
+		// One slot per shading mode, a slot is only touched by the task building that mode
+		std::array<CachedCollection, kShadingModeCount> mCollections;
 	};
 
 };
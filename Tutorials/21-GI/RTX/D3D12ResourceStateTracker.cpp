@@ -0,0 +1,58 @@
+#pragma once
+#include "D3D12ResourceStateTracker.hpp"
+
+static_assert(CppDirectXRayTracing21::kResourceStateCommon == D3D12_RESOURCE_STATE_COMMON, "The tracker's states are D3D12_RESOURCE_STATES");
+static_assert(CppDirectXRayTracing21::kResourceStateUnorderedAccess == D3D12_RESOURCE_STATE_UNORDERED_ACCESS, "The tracker's states are D3D12_RESOURCE_STATES");
+static_assert(CppDirectXRayTracing21::kResourceStateWriteMask == (D3D12_RESOURCE_STATE_RENDER_TARGET | D3D12_RESOURCE_STATE_UNORDERED_ACCESS | D3D12_RESOURCE_STATE_DEPTH_WRITE |
+    D3D12_RESOURCE_STATE_STREAM_OUT | D3D12_RESOURCE_STATE_COPY_DEST | D3D12_RESOURCE_STATE_RESOLVE_DEST | D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE), "The write states don't match D3D12_RESOURCE_STATES");
+
+void CppDirectXRayTracing21::D3D12ResourceStateTracker::registerResource(ID3D12ResourcePtr pResource, D3D12_RESOURCE_STATES state)
+{
+    mTracker.Register(pResource.GetInterfacePtr(), state);
+}
+
+void CppDirectXRayTracing21::D3D12ResourceStateTracker::unregisterResource(ID3D12ResourcePtr pResource)
+{
+    mTracker.Unregister(pResource.GetInterfacePtr());
+}
+
+void CppDirectXRayTracing21::D3D12ResourceStateTracker::transition(ID3D12ResourcePtr pResource, D3D12_RESOURCE_STATES state)
+{
+    mTracker.Transition(pResource.GetInterfacePtr(), state);
+}
+
+void CppDirectXRayTracing21::D3D12ResourceStateTracker::uavAccess(ID3D12ResourcePtr pResource)
+{
+    mTracker.UavAccess(pResource.GetInterfacePtr());
+}
+
+void CppDirectXRayTracing21::D3D12ResourceStateTracker::flush(ID3D12GraphicsCommandList4Ptr pCmdList)
+{
+    std::vector<ResourceBarrierDesc> pending = mTracker.Flush();
+    if (pending.empty())
+    {
+        return;
+    }
+
+    std::vector<D3D12_RESOURCE_BARRIER> barriers(pending.size());
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        // The tracker only stores the pointers, the resources are owned by the caller
+        ID3D12Resource* pResource = static_cast<ID3D12Resource*>(const_cast<void*>(pending[i].pResource));
+        D3D12_RESOURCE_BARRIER& barrier = barriers[i];
+        if (pending[i].type == ResourceBarrierType::Uav)
+        {
+            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+            barrier.UAV.pResource = pResource;
+        }
+        else
+        {
+            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            barrier.Transition.pResource = pResource;
+            barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            barrier.Transition.StateBefore = static_cast<D3D12_RESOURCE_STATES>(pending[i].stateBefore);
+            barrier.Transition.StateAfter = static_cast<D3D12_RESOURCE_STATES>(pending[i].stateAfter);
+        }
+    }
+    pCmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "Framework.h"
+#include "ResourceStateTracker.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	// Records the state of the resources used on the frame's command list. Transitions and UAV accesses are only
+	// requested, flush() issues all pending barriers with a single ResourceBarrier() before the next draw, dispatch or copy.
+	class D3D12ResourceStateTracker
+	{
+	public:
+		D3D12ResourceStateTracker() = default;
+		~D3D12ResourceStateTracker() = default;
+
+		void registerResource(ID3D12ResourcePtr pResource, D3D12_RESOURCE_STATES state);
+		void unregisterResource(ID3D12ResourcePtr pResource);
+
+		void transition(ID3D12ResourcePtr pResource, D3D12_RESOURCE_STATES state);
+		void uavAccess(ID3D12ResourcePtr pResource);
+
+		void flush(ID3D12GraphicsCommandList4Ptr pCmdList);
+
+	private:
+		ResourceStateTracker mTracker;
+	};
+};
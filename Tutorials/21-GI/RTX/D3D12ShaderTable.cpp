@@ -0,0 +1,113 @@
+#pragma once
+#include "D3D12ShaderTable.hpp"
+
+CppDirectXRayTracing21::D3D12ShaderTable::D3D12ShaderTable(D3D12CopyQueueUploader* pUploader, D3D12ResourceStateTracker* pStateTracker)
+    : mpUploader(pUploader), mpStateTracker(pStateTracker)
+{
+}
+
+const void* CppDirectXRayTracing21::D3D12ShaderTable::getShaderIdentifier(const std::wstring& exportName) const
+{
+    const void* pIdentifier = mpRtsoProps->GetShaderIdentifier(exportName.c_str());
+    if (pIdentifier == nullptr)
+    {
+        msgBox("Can't find the shader identifier of " + wstring_2_string(exportName));
+    }
+    return pIdentifier;
+}
+
+bool CppDirectXRayTracing21::D3D12ShaderTable::build(ID3D12StateObjectPtr pPipelineState)
+{
+    if (pPipelineState == nullptr)
+    {
+        msgBox("The shader table can't be built without a pipeline.");
+        return false;
+    }
+    d3d_call(pPipelineState->QueryInterface(IID_PPV_ARGS(&mpRtsoProps)));
+
+    mBuilder.ComputeLayout();
+    mCpuTable.resize(static_cast<size_t>(mBuilder.GetTotalSize()));
+    mBuilder.WriteTable(mCpuTable.data(), [this](const std::wstring& exportName) { return getShaderIdentifier(exportName); });
+
+    // The GPU reads the table for every ray, so it lives in the default heap. The uploader registers the new buffer
+    if (mpBuffer)
+    {
+        mpStateTracker->unregisterResource(mpBuffer);
+    }
+    mpBuffer = mpUploader->createBufferWithData(mCpuTable.data(), mCpuTable.size(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    return mpBuffer != nullptr;
+}
+
+void CppDirectXRayTracing21::D3D12ShaderTable::setPipeline(ID3D12StateObjectPtr pPipelineState)
+{
+    // The table keeps the identifiers of the current pipeline
+    if (pPipelineState == nullptr)
+    {
+        return;
+    }
+    mpRtsoProps = nullptr;
+    d3d_call(pPipelineState->QueryInterface(IID_PPV_ARGS(&mpRtsoProps)));
+    mBuilder.MarkAllDirty();
+}
+
+void CppDirectXRayTracing21::D3D12ShaderTable::update(ID3D12GraphicsCommandList4Ptr pCmdList, D3D12UploadRing* pUploadRing)
+{
+    if (mBuilder.IsLayoutDirty())
+    {
+        msgBox("The shader table layout changed, it has to be re-built.");
+        return;
+    }
+
+    std::vector<ShaderTableDirtyRange> ranges = mBuilder.WriteDirtyRecords(mCpuTable.data(), [this](const std::wstring& exportName) { return getShaderIdentifier(exportName); });
+    if (ranges.empty())
+    {
+        return;
+    }
+
+    // The copies need the barrier now, it goes out with whatever else is pending
+    mpStateTracker->transition(mpBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    mpStateTracker->flush(pCmdList);
+
+    // Only the changed records are copied, the ring keeps the source alive until the frame completed
+    for (const ShaderTableDirtyRange& range : ranges)
+    {
+        UploadAllocation allocation = pUploadRing->allocate(range.size, kShaderRecordAlignment);
+        if (allocation.pCpuAddress == nullptr)
+        {
+            // Reported by the allocator. The records are copied again on the next update
+            mBuilder.MarkAllDirty();
+            break;
+        }
+        memcpy(allocation.pCpuAddress, mCpuTable.data() + range.offset, static_cast<size_t>(range.size));
+        pCmdList->CopyBufferRegion(mpBuffer, range.offset, allocation.pResource, allocation.offset, range.size);
+    }
+
+    // Issued with the barriers of the dispatch
+    mpStateTracker->transition(mpBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+}
+
+D3D12_DISPATCH_RAYS_DESC CppDirectXRayTracing21::D3D12ShaderTable::getDispatchRaysDesc(uint32_t width, uint32_t height, uint32_t depth) const
+{
+    D3D12_GPU_VIRTUAL_ADDRESS start = mpBuffer->GetGPUVirtualAddress();
+    const ShaderTableSectionLayout& rayGen = mBuilder.GetSectionLayout(ShaderTableSection::RayGen);
+    const ShaderTableSectionLayout& miss = mBuilder.GetSectionLayout(ShaderTableSection::Miss);
+    const ShaderTableSectionLayout& hit = mBuilder.GetSectionLayout(ShaderTableSection::HitGroup);
+
+    D3D12_DISPATCH_RAYS_DESC desc = {};
+    desc.Width = width;
+    desc.Height = height;
+    desc.Depth = depth;
+
+    // Only the first ray-gen record is used by a dispatch
+    desc.RayGenerationShaderRecord.StartAddress = start + rayGen.offset;
+    desc.RayGenerationShaderRecord.SizeInBytes = rayGen.stride;
+
+    desc.MissShaderTable.StartAddress = start + miss.offset;
+    desc.MissShaderTable.StrideInBytes = miss.stride;
+    desc.MissShaderTable.SizeInBytes = miss.GetSize();
+
+    desc.HitGroupTable.StartAddress = start + hit.offset;
+    desc.HitGroupTable.StrideInBytes = hit.stride;
+    desc.HitGroupTable.SizeInBytes = hit.GetSize();
+    return desc;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Framework.h"
+#include "ShaderTableBuilder.hpp"
+#include "D3D12CopyQueueUploader.hpp"
+#include "D3D12ResourceStateTracker.hpp"
+#include "D3D12UploadRing.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	MAKE_SMART_COM_PTR(ID3D12StateObjectProperties);
+
+	// Default-heap shader table built from a ShaderTableBuilder.
+	// Records whose local root arguments changed are patched in place through the per-frame upload ring.
+	// The table is registered with the frame's state tracker, which records its transitions around the copies.
+	class D3D12ShaderTable
+	{
+	public:
+		D3D12ShaderTable(D3D12CopyQueueUploader* pUploader, D3D12ResourceStateTracker* pStateTracker);
+		~D3D12ShaderTable() = default;
+
+		ShaderTableBuilder& getBuilder() { return mBuilder; }
+
+		// Creates the table with all its records. The copy is scheduled on the uploader, which has to be flushed
+		// and waited on before the first DispatchRays(). Returns false, without a table, if there is no pipeline or the
+		// buffer can't be created.
+		bool build(ID3D12StateObjectPtr pPipelineState);
+
+		// Takes the shader identifiers from another pipeline with the same exports. Every record is re-written by the next update().
+		// A null pipeline is ignored, the table keeps the current identifiers.
+		void setPipeline(ID3D12StateObjectPtr pPipelineState);
+
+		// Copies the dirty records into the table. Must be recorded before the DispatchRays() that reads them, the transition
+		// back to the shader resource state is left to the tracker's flush before the dispatch.
+		void update(ID3D12GraphicsCommandList4Ptr pCmdList, D3D12UploadRing* pUploadRing);
+
+		D3D12_DISPATCH_RAYS_DESC getDispatchRaysDesc(uint32_t width, uint32_t height, uint32_t depth = 1) const;
+
+	private:
+		const void* getShaderIdentifier(const std::wstring& exportName) const;
+
+		ShaderTableBuilder mBuilder;
+		D3D12CopyQueueUploader* mpUploader;
+		D3D12ResourceStateTracker* mpStateTracker;
+		ID3D12StateObjectPropertiesPtr mpRtsoProps;
+		ID3D12ResourcePtr mpBuffer;
+		std::vector<uint8_t> mCpuTable; // Mirror of the GPU table, dirty records are written here first
+	};
+};
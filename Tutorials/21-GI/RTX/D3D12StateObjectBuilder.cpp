@@ -0,0 +1,190 @@
+#pragma once
+#include "D3D12StateObjectBuilder.hpp"
+
+void CppDirectXRayTracing21::D3D12StateObjectBuilder::addLibrary(ID3DBlobPtr pLibrary, const std::vector<LibraryExport>& exports)
+{
+    mGraph.AddLibrary(static_cast<uint32_t>(mLibraries.size()), exports);
+    mLibraries.push_back(pLibrary);
+}
+
+void CppDirectXRayTracing21::D3D12StateObjectBuilder::addLocalRootSignature(ID3D12RootSignaturePtr pRootSig, const std::vector<std::wstring>& exports)
+{
+    mGraph.AddLocalRootSignature(static_cast<uint32_t>(mRootSignatures.size()), exports);
+    mRootSignatures.push_back(pRootSig);
+}
+
+void CppDirectXRayTracing21::D3D12StateObjectBuilder::addCollection(ID3D12StateObjectPtr pCollection, const std::vector<std::wstring>& exports)
+{
+    mGraph.AddCollection(static_cast<uint32_t>(mCollections.size()), exports);
+    mCollections.push_back(pCollection);
+}
+
+void CppDirectXRayTracing21::D3D12StateObjectBuilder::setGlobalRootSignature(ID3D12RootSignaturePtr pRootSig)
+{
+    mGraph.SetGlobalRootSignature(static_cast<uint32_t>(mRootSignatures.size()));
+    mRootSignatures.push_back(pRootSig);
+}
+
+void CppDirectXRayTracing21::D3D12StateObjectBuilder::addAssociation(Desc& desc, const std::vector<std::wstring>& exports)
+{
+    // Associates the subobject written just before with the exports
+    std::vector<LPCWSTR>& names = desc.exportNames[desc.associations.size()];
+    for (const std::wstring& name : exports)
+    {
+        names.push_back(name.c_str());
+    }
+
+    D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION association = {};
+    association.pSubobjectToAssociate = &desc.subobjects.back();
+    association.NumExports = static_cast<UINT>(names.size());
+    association.pExports = names.data();
+    desc.associations.push_back(association);
+
+    D3D12_STATE_SUBOBJECT subobject = { D3D12_STATE_SUBOBJECT_TYPE_SUBOBJECT_TO_EXPORTS_ASSOCIATION, &desc.associations.back() };
+    desc.subobjects.push_back(subobject);
+}
+
+bool CppDirectXRayTracing21::D3D12StateObjectBuilder::buildDesc(Desc& desc)
+{
+    std::vector<std::string> errors;
+    if (mGraph.Validate(errors) == false)
+    {
+        std::string msg = "Invalid state object:";
+        for (const std::string& error : errors)
+        {
+            msg += "\n" + error;
+        }
+        msgBox(msg);
+        return false;
+    }
+
+    // Reserve everything first, the subobjects and associations point into these arrays
+    const StateObjectGraph& graph = mGraph;
+    size_t associationCount = graph.GetLocalRootSignatures().size() + graph.GetShaderConfigs().size();
+    desc.subobjects.reserve(graph.GetSubobjectCount());
+    desc.libraries.reserve(graph.GetLibraries().size());
+    desc.libraryExports.resize(graph.GetLibraries().size());
+    desc.hitGroups.reserve(graph.GetHitGroups().size());
+    desc.rootSignatures.reserve(graph.GetLocalRootSignatures().size() + 1);
+    desc.shaderConfigs.reserve(graph.GetShaderConfigs().size());
+    desc.collections.reserve(graph.GetCollections().size());
+    desc.exportNames.resize(associationCount);
+    desc.associations.reserve(associationCount);
+
+    for (size_t i = 0; i < graph.GetLibraries().size(); i++)
+    {
+        const StateObjectGraph::Library& library = graph.GetLibraries()[i];
+        std::vector<D3D12_EXPORT_DESC>& exports = desc.libraryExports[i];
+        for (const LibraryExport& libraryExport : library.exports)
+        {
+            D3D12_EXPORT_DESC exportDesc = {};
+            exportDesc.Name = libraryExport.name.c_str();
+            exportDesc.ExportToRename = libraryExport.exportToRename.empty() ? nullptr : libraryExport.exportToRename.c_str();
+            exportDesc.Flags = D3D12_EXPORT_FLAG_NONE;
+            exports.push_back(exportDesc);
+        }
+
+        ID3DBlobPtr pBlob = mLibraries[library.resource];
+        D3D12_DXIL_LIBRARY_DESC libraryDesc = {};
+        libraryDesc.DXILLibrary.pShaderBytecode = pBlob->GetBufferPointer();
+        libraryDesc.DXILLibrary.BytecodeLength = pBlob->GetBufferSize();
+        libraryDesc.NumExports = static_cast<UINT>(exports.size());
+        libraryDesc.pExports = exports.data();
+        desc.libraries.push_back(libraryDesc);
+        desc.subobjects.push_back({ D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY, &desc.libraries.back() });
+    }
+
+    for (const StateObjectGraph::HitGroup& hitGroup : graph.GetHitGroups())
+    {
+        D3D12_HIT_GROUP_DESC hitGroupDesc = {};
+        hitGroupDesc.HitGroupExport = hitGroup.name.c_str();
+        hitGroupDesc.Type = hitGroup.intersection.empty() ? D3D12_HIT_GROUP_TYPE_TRIANGLES : D3D12_HIT_GROUP_TYPE_PROCEDURAL_PRIMITIVE;
+        hitGroupDesc.ClosestHitShaderImport = hitGroup.closestHit.empty() ? nullptr : hitGroup.closestHit.c_str();
+        hitGroupDesc.AnyHitShaderImport = hitGroup.anyHit.empty() ? nullptr : hitGroup.anyHit.c_str();
+        hitGroupDesc.IntersectionShaderImport = hitGroup.intersection.empty() ? nullptr : hitGroup.intersection.c_str();
+        desc.hitGroups.push_back(hitGroupDesc);
+        desc.subobjects.push_back({ D3D12_STATE_SUBOBJECT_TYPE_HIT_GROUP, &desc.hitGroups.back() });
+    }
+
+    for (const StateObjectGraph::LocalRootSignature& rootSignature : graph.GetLocalRootSignatures())
+    {
+        desc.rootSignatures.push_back(mRootSignatures[rootSignature.resource].GetInterfacePtr());
+        desc.subobjects.push_back({ D3D12_STATE_SUBOBJECT_TYPE_LOCAL_ROOT_SIGNATURE, &desc.rootSignatures.back() });
+        addAssociation(desc, rootSignature.exports);
+    }
+
+    for (const StateObjectGraph::ShaderConfig& config : graph.GetShaderConfigs())
+    {
+        desc.shaderConfigs.push_back({ config.maxPayloadSizeInBytes, config.maxAttributeSizeInBytes });
+        desc.subobjects.push_back({ D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_SHADER_CONFIG, &desc.shaderConfigs.back() });
+        addAssociation(desc, config.exports);
+    }
+
+    for (const StateObjectGraph::Collection& collection : graph.GetCollections())
+    {
+        // No export list, everything the collection exports is imported. The graph only keeps the names for validation
+        D3D12_EXISTING_COLLECTION_DESC collectionDesc = {};
+        collectionDesc.pExistingCollection = mCollections[collection.resource];
+        desc.collections.push_back(collectionDesc);
+        desc.subobjects.push_back({ D3D12_STATE_SUBOBJECT_TYPE_EXISTING_COLLECTION, &desc.collections.back() });
+    }
+
+    if (graph.HasGlobalRootSignature())
+    {
+        desc.rootSignatures.push_back(mRootSignatures[graph.GetGlobalRootSignature()].GetInterfacePtr());
+        desc.subobjects.push_back({ D3D12_STATE_SUBOBJECT_TYPE_GLOBAL_ROOT_SIGNATURE, &desc.rootSignatures.back() });
+    }
+
+    if (graph.HasPipelineConfig())
+    {
+        desc.pipelineConfig.MaxTraceRecursionDepth = graph.GetMaxTraceRecursionDepth();
+        desc.subobjects.push_back({ D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_PIPELINE_CONFIG, &desc.pipelineConfig });
+    }
+
+    if (graph.GetAllowStateObjectAdditions())
+    {
+        desc.stateObjectConfig.Flags = D3D12_STATE_OBJECT_FLAG_ALLOW_STATE_OBJECT_ADDITIONS;
+        desc.subobjects.push_back({ D3D12_STATE_SUBOBJECT_TYPE_STATE_OBJECT_CONFIG, &desc.stateObjectConfig });
+    }
+
+    desc.desc.Type = (graph.GetType() == StateObjectGraphType::Collection) ? D3D12_STATE_OBJECT_TYPE_COLLECTION : D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE;
+    desc.desc.NumSubobjects = static_cast<UINT>(desc.subobjects.size());
+    desc.desc.pSubobjects = desc.subobjects.data();
+    return true;
+}
+
+ID3D12StateObjectPtr CppDirectXRayTracing21::D3D12StateObjectBuilder::create(ID3D12Device5Ptr pDevice)
+{
+    Desc desc;
+    if (buildDesc(desc) == false)
+    {
+        return nullptr;
+    }
+
+    ID3D12StateObjectPtr pStateObject;
+    HRESULT hr = pDevice->CreateStateObject(&desc.desc, IID_PPV_ARGS(&pStateObject));
+    if (FAILED(hr))
+    {
+        d3dTraceHR("Failed to create the state object", hr);
+        return nullptr;
+    }
+    return pStateObject;
+}
+
+ID3D12StateObjectPtr CppDirectXRayTracing21::D3D12StateObjectBuilder::addTo(ID3D12Device7Ptr pDevice, ID3D12StateObjectPtr pParent)
+{
+    Desc desc;
+    if (buildDesc(desc) == false)
+    {
+        return nullptr;
+    }
+
+    ID3D12StateObjectPtr pStateObject;
+    HRESULT hr = pDevice->AddToStateObject(&desc.desc, pParent, IID_PPV_ARGS(&pStateObject));
+    if (FAILED(hr))
+    {
+        d3dTraceHR("Failed to add to the state object", hr);
+        return nullptr;
+    }
+    return pStateObject;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Framework.h"
+#include "StateObjectGraph.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	MAKE_SMART_COM_PTR(ID3D12Device7);
+
+	// Translates a StateObjectGraph into D3D12_STATE_SUBOBJECTs and creates the state object.
+	// The builder owns the resources the graph indexes, the add* methods register a resource and its graph entry together.
+	class D3D12StateObjectBuilder
+	{
+	public:
+		explicit D3D12StateObjectBuilder(StateObjectGraphType type) : mGraph(type) {}
+		~D3D12StateObjectBuilder() = default;
+
+		StateObjectGraph& getGraph() { return mGraph; }
+
+		void addLibrary(ID3DBlobPtr pLibrary, const std::vector<LibraryExport>& exports);
+		void addLocalRootSignature(ID3D12RootSignaturePtr pRootSig, const std::vector<std::wstring>& exports);
+		void addCollection(ID3D12StateObjectPtr pCollection, const std::vector<std::wstring>& exports);
+		void setGlobalRootSignature(ID3D12RootSignaturePtr pRootSig);
+
+		// Both return nullptr and report the problem if the graph is invalid or the runtime rejected it.
+		ID3D12StateObjectPtr create(ID3D12Device5Ptr pDevice);
+
+		// Grows pParent, which was created with additions allowed, by the subobjects of the graph. Needs ID3D12Device7.
+		ID3D12StateObjectPtr addTo(ID3D12Device7Ptr pDevice, ID3D12StateObjectPtr pParent);
+
+	private:
+		// Storage the subobjects point into, sized before any pointer is taken
+		struct Desc
+		{
+			std::vector<D3D12_STATE_SUBOBJECT> subobjects;
+			std::vector<D3D12_DXIL_LIBRARY_DESC> libraries;
+			std::vector<std::vector<D3D12_EXPORT_DESC>> libraryExports;
+			std::vector<D3D12_HIT_GROUP_DESC> hitGroups;
+			std::vector<ID3D12RootSignature*> rootSignatures;
+			std::vector<D3D12_RAYTRACING_SHADER_CONFIG> shaderConfigs;
+			std::vector<D3D12_EXISTING_COLLECTION_DESC> collections;
+			std::vector<std::vector<LPCWSTR>> exportNames;
+			std::vector<D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION> associations;
+			D3D12_RAYTRACING_PIPELINE_CONFIG pipelineConfig = {};
+			D3D12_STATE_OBJECT_CONFIG stateObjectConfig = {};
+			D3D12_STATE_OBJECT_DESC desc = {};
+		};
+
+		bool buildDesc(Desc& desc);
+		void addAssociation(Desc& desc, const std::vector<std::wstring>& exports);
+
+		StateObjectGraph mGraph;
+		std::vector<ID3DBlobPtr> mLibraries;
+		std::vector<ID3D12RootSignaturePtr> mRootSignatures;
+		std::vector<ID3D12StateObjectPtr> mCollections;
+	};
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include "D3D12UploadRing.hpp"
+#include "Structs/HeapData.hpp"
+
+CppDirectXRayTracing21::D3D12UploadRing::D3D12UploadRing(D3D12MemoryAllocator* pAllocator, uint32_t frameCount, uint64_t bytesPerFrame)
+    : mRing(frameCount, align_to(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, bytesPerFrame)), mpAllocator(pAllocator), mOverflowBuffers(frameCount)
+{
+    mpBuffer = pAllocator->createBuffer(mRing.GetTotalSize(), D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
+
+    // Upload heaps can stay mapped for the whole lifetime of the resource
+    d3d_call(mpBuffer->Map(0, nullptr, (void**)&mpCpuAddress));
+}
+
+CppDirectXRayTracing21::D3D12UploadRing::~D3D12UploadRing()
+{
+    mpBuffer->Unmap(0, nullptr);
+}
+
+void CppDirectXRayTracing21::D3D12UploadRing::beginFrame(ID3D12FencePtr pFence, HANDLE fenceEvent)
+{
+    uint64_t fenceValue = mRing.BeginFrame();
+    if (pFence->GetCompletedValue() < fenceValue)
+    {
+        d3d_call(pFence->SetEventOnCompletion(fenceValue, fenceEvent));
+        WaitForSingleObject(fenceEvent, INFINITE);
+    }
+    mOverflowBuffers[mRing.GetCurrentSlot()].clear();
+}
+
+void CppDirectXRayTracing21::D3D12UploadRing::endFrame(uint64_t fenceValue)
+{
+    mRing.EndFrame(fenceValue);
+}
+
+CppDirectXRayTracing21::UploadAllocation CppDirectXRayTracing21::D3D12UploadRing::allocate(uint64_t size, uint64_t alignment)
+{
+    UploadAllocation allocation;
+    uint64_t offset;
+    if (mRing.Allocate(size, alignment, offset) == false)
+    {
+        // Placed buffers start at a 64KB boundary, which covers every upload alignment
+        ID3D12ResourcePtr pOverflow = mpAllocator->createBuffer(align_to(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, size), D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, kUploadHeapProps);
+        if (pOverflow == nullptr)
+        {
+            return allocation;
+        }
+        d3d_call(pOverflow->Map(0, nullptr, (void**)&allocation.pCpuAddress));
+        allocation.gpuAddress = pOverflow->GetGPUVirtualAddress();
+        allocation.pResource = pOverflow.GetInterfacePtr();
+        allocation.offset = 0;
+        mOverflowBuffers[mRing.GetCurrentSlot()].push_back(pOverflow);
+        return allocation;
+    }
+
+    allocation.pCpuAddress = mpCpuAddress + offset;
+    allocation.gpuAddress = mpBuffer->GetGPUVirtualAddress() + offset;
+    allocation.pResource = mpBuffer.GetInterfacePtr();
+    allocation.offset = offset;
+    return allocation;
+}
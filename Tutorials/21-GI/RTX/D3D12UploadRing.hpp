@@ -0,0 +1,57 @@
+#pragma once
+#include "Framework.h"
+#include "FrameRingAllocator.hpp"
+#include "D3D12MemoryAllocator.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	struct UploadAllocation
+	{
+		uint8_t* pCpuAddress = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+
+		// Source of CopyBufferRegion() calls
+		ID3D12Resource* pResource = nullptr;
+		uint64_t offset = 0;
+	};
+
+	// Persistently mapped upload buffer with one linear region per frame in flight.
+	// Everything written between beginFrame() and endFrame() stays untouched until the GPU has finished that frame.
+	// When the frame's region is full the allocation gets an upload buffer of its own, released with the region once
+	// the frame completed, so a burst of uploads costs an extra buffer instead of failing.
+	class D3D12UploadRing
+	{
+	public:
+		D3D12UploadRing(D3D12MemoryAllocator* pAllocator, uint32_t frameCount, uint64_t bytesPerFrame);
+		~D3D12UploadRing();
+
+		// Waits until the GPU is done with the slot we are about to reuse.
+		void beginFrame(ID3D12FencePtr pFence, HANDLE fenceEvent);
+		void endFrame(uint64_t fenceValue);
+
+		// pCpuAddress is nullptr if even the overflow buffer couldn't be created, which the allocator already reported.
+		UploadAllocation allocate(uint64_t size, uint64_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+		// Copies the data into the ring and returns the address to put into root arguments or shader records, 0 if allocate() failed.
+		template<typename T>
+		D3D12_GPU_VIRTUAL_ADDRESS push(const T& data)
+		{
+			UploadAllocation allocation = allocate(sizeof(T));
+			if (allocation.pCpuAddress == nullptr)
+			{
+				return 0;
+			}
+			memcpy(allocation.pCpuAddress, &data, sizeof(T));
+			return allocation.gpuAddress;
+		}
+
+	private:
+		FrameRingAllocator mRing;
+		D3D12MemoryAllocator* mpAllocator;
+		ID3D12ResourcePtr mpBuffer;
+		uint8_t* mpCpuAddress = nullptr;
+
+		// The overflow buffers of every region, kept alive until the region is reused
+		std::vector<std::vector<ID3D12ResourcePtr>> mOverflowBuffers;
+	};
+};
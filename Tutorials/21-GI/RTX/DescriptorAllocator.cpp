@@ -0,0 +1,148 @@
+#pragma once
+#include "DescriptorAllocator.hpp"
+#include <algorithm>
+#include <cassert>
+
+CppDirectXRayTracing21::DescriptorAllocator::DescriptorAllocator(uint32_t persistentCount, uint32_t dynamicCount, uint32_t transientCountPerFrame, uint32_t frameCount)
+    : mPersistentCount(persistentCount), mDynamicCount(dynamicCount), mTransientCountPerFrame(transientCountPerFrame),
+      mCurrentSlot(frameCount - 1), mTransientFences(frameCount, 0)
+{
+    assert(frameCount > 0);
+
+    // The heap layout is [persistent | dynamic | transient slot 0 | transient slot 1 | ...]
+    if (dynamicCount > 0)
+    {
+        mFreeRanges.push_back({ persistentCount, dynamicCount });
+    }
+}
+
+CppDirectXRayTracing21::DescriptorHandle CppDirectXRayTracing21::DescriptorAllocator::AllocatePersistent(uint32_t count)
+{
+    DescriptorHandle handle;
+    if (count == 0 || mPersistentUsed + count > mPersistentCount)
+    {
+        return handle;
+    }
+
+    handle.index = mPersistentUsed;
+    handle.count = count;
+    handle.region = DescriptorRegion::Persistent;
+    mPersistentUsed += count;
+    return handle;
+}
+
+CppDirectXRayTracing21::DescriptorHandle CppDirectXRayTracing21::DescriptorAllocator::Allocate(uint32_t count)
+{
+    DescriptorHandle handle;
+    if (count == 0)
+    {
+        return handle;
+    }
+
+    // First fit. Descriptor tables need contiguous ranges, and the lowest address keeps the region compact
+    for (size_t i = 0; i < mFreeRanges.size(); i++)
+    {
+        Range& range = mFreeRanges[i];
+        if (range.count < count)
+        {
+            continue;
+        }
+
+        handle.index = range.start;
+        handle.count = count;
+        handle.region = DescriptorRegion::Dynamic;
+
+        range.start += count;
+        range.count -= count;
+        if (range.count == 0)
+        {
+            mFreeRanges.erase(mFreeRanges.begin() + i);
+        }
+        mDynamicUsed += count;
+        return handle;
+    }
+    return handle;
+}
+
+CppDirectXRayTracing21::DescriptorHandle CppDirectXRayTracing21::DescriptorAllocator::AllocateTransient(uint32_t count)
+{
+    DescriptorHandle handle;
+    if (count == 0 || mTransientUsed + count > mTransientCountPerFrame)
+    {
+        return handle;
+    }
+
+    handle.index = mPersistentCount + mDynamicCount + mCurrentSlot * mTransientCountPerFrame + mTransientUsed;
+    handle.count = count;
+    handle.region = DescriptorRegion::Transient;
+    mTransientUsed += count;
+    return handle;
+}
+
+void CppDirectXRayTracing21::DescriptorAllocator::Free(const DescriptorHandle& handle)
+{
+    if (handle.IsValid() == false)
+    {
+        return;
+    }
+
+    assert(handle.region == DescriptorRegion::Dynamic);
+    mFrameFrees.push_back({ handle.index, handle.count });
+}
+
+uint64_t CppDirectXRayTracing21::DescriptorAllocator::BeginFrame()
+{
+    mCurrentSlot = (mCurrentSlot + 1) % GetFrameCount();
+    mTransientUsed = 0;
+    return mTransientFences[mCurrentSlot];
+}
+
+void CppDirectXRayTracing21::DescriptorAllocator::EndFrame(uint64_t fenceValue)
+{
+    mTransientFences[mCurrentSlot] = fenceValue;
+
+    for (const Range& range : mFrameFrees)
+    {
+        mPendingFrees.push_back({ fenceValue, range });
+    }
+    mFrameFrees.clear();
+}
+
+void CppDirectXRayTracing21::DescriptorAllocator::Retire(uint64_t completedFenceValue)
+{
+    // Fence values are increasing, so the completed frees are at the front
+    size_t retired = 0;
+    while (retired < mPendingFrees.size() && mPendingFrees[retired].fenceValue <= completedFenceValue)
+    {
+        Release(mPendingFrees[retired].range);
+        retired++;
+    }
+    mPendingFrees.erase(mPendingFrees.begin(), mPendingFrees.begin() + retired);
+}
+
+void CppDirectXRayTracing21::DescriptorAllocator::Release(Range range)
+{
+    mDynamicUsed -= range.count;
+
+    auto next = std::lower_bound(mFreeRanges.begin(), mFreeRanges.end(), range.start,
+        [](const Range& r, uint32_t start) { return r.start < start; });
+
+    // Merge with the following range
+    if (next != mFreeRanges.end() && range.start + range.count == next->start)
+    {
+        range.count += next->count;
+        next = mFreeRanges.erase(next);
+    }
+
+    // Merge with the preceding range
+    if (next != mFreeRanges.begin())
+    {
+        auto prev = next - 1;
+        if (prev->start + prev->count == range.start)
+        {
+            prev->count += range.count;
+            return;
+        }
+    }
+    mFreeRanges.insert(next, range);
+}
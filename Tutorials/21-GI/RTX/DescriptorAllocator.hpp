@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	static const uint32_t kInvalidDescriptorIndex = 0xFFFFFFFF;
+
+	enum class DescriptorRegion : uint32_t
+	{
+		Persistent, // Allocated once at load time, never freed
+		Dynamic,    // Free-list, for resources that are created and destroyed at runtime
+		Transient   // One linear slot per frame in flight, released when the frame completed
+	};
+
+	// A contiguous range of descriptors. index is the position of the first descriptor in the heap,
+	// so a handle can directly be used as the start of a descriptor table.
+	struct DescriptorHandle
+	{
+		uint32_t index = kInvalidDescriptorIndex;
+		uint32_t count = 0;
+		DescriptorRegion region = DescriptorRegion::Persistent;
+
+		bool IsValid() const { return index != kInvalidDescriptorIndex; }
+	};
+
+	// Splits a descriptor heap into a persistent region, a free-list region and a per-frame transient ring.
+	// Frees are deferred: a freed range is only reused once the fence value of the frame that freed it completed.
+	// The class only deals with indices, the D3D12 heap is owned by D3D12DescriptorHeap.
+	class DescriptorAllocator
+	{
+	public:
+		DescriptorAllocator(uint32_t persistentCount, uint32_t dynamicCount, uint32_t transientCountPerFrame, uint32_t frameCount);
+		~DescriptorAllocator() = default;
+
+		// All the allocations return an invalid handle when their region is full.
+		DescriptorHandle AllocatePersistent(uint32_t count);
+		DescriptorHandle Allocate(uint32_t count);
+		DescriptorHandle AllocateTransient(uint32_t count);
+
+		// Only dynamic ranges can be freed. The range stays reserved until the current frame completed.
+		void Free(const DescriptorHandle& handle);
+
+		// Moves to the next transient slot and returns the fence value that must be completed before reusing it (0 if none).
+		uint64_t BeginFrame();
+
+		// Tags the current transient slot and the frees of this frame with the fence value signaled after the frame.
+		void EndFrame(uint64_t fenceValue);
+
+		// Returns the dynamic ranges freed by frames up to completedFenceValue to the free-list.
+		void Retire(uint64_t completedFenceValue);
+
+		uint32_t GetDescriptorCount() const { return mPersistentCount + mDynamicCount + mTransientCountPerFrame * GetFrameCount(); }
+		uint32_t GetFrameCount() const { return static_cast<uint32_t>(mTransientFences.size()); }
+		uint32_t GetPersistentUsed() const { return mPersistentUsed; }
+		uint32_t GetDynamicUsed() const { return mDynamicUsed; }
+		uint32_t GetTransientUsed() const { return mTransientUsed; }
+
+	private:
+		struct Range
+		{
+			uint32_t start;
+			uint32_t count;
+		};
+
+		struct PendingFree
+		{
+			uint64_t fenceValue;
+			Range range;
+		};
+
+		void Release(Range range);
+
+		uint32_t mPersistentCount;
+		uint32_t mDynamicCount;
+		uint32_t mTransientCountPerFrame;
+
+		uint32_t mPersistentUsed = 0;
+		uint32_t mDynamicUsed = 0;
+		uint32_t mTransientUsed = 0;
+		uint32_t mCurrentSlot;
+
+		std::vector<Range> mFreeRanges;           // Sorted by start, neighbours are always merged
+		std::vector<Range> mFrameFrees;           // Freed during the current frame
+		std::vector<PendingFree> mPendingFrees;   // Waiting for their fence
+		std::vector<uint64_t> mTransientFences;
+	};
+};
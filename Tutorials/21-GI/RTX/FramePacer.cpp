@@ -0,0 +1,55 @@
+#pragma once
+#include "FramePacer.hpp"
+#include <cassert>
+
+CppDirectXRayTracing21::FramePacer::FramePacer(uint32_t framesInFlight) : mSlotFences(framesInFlight, 0)
+{
+    assert(framesInFlight > 0);
+}
+
+CppDirectXRayTracing21::FrameSlot CppDirectXRayTracing21::FramePacer::BeginFrame()
+{
+    FrameSlot slot;
+    switch (mState)
+    {
+    case FramePacerState::Loading:
+        // The list was opened on the first slot at creation and nothing was submitted from it yet
+        slot.index = mCurrentSlot;
+        break;
+    case FramePacerState::Submitted:
+        mCurrentSlot = (mCurrentSlot + 1) % GetFrameCount();
+        slot.index = mCurrentSlot;
+        slot.waitValue = mSlotFences[mCurrentSlot];
+        slot.resetAllocator = true;
+        break;
+    case FramePacerState::Recording:
+        assert(false && "BeginFrame() called twice");
+        slot.index = mCurrentSlot;
+        return slot;
+    }
+
+    mState = FramePacerState::Recording;
+    return slot;
+}
+
+void CppDirectXRayTracing21::FramePacer::EndFrame(uint64_t fenceValue)
+{
+    assert(mState == FramePacerState::Recording);
+    assert(fenceValue > mLastSubmittedValue);
+    mSlotFences[mCurrentSlot] = fenceValue;
+    mLastSubmittedValue = fenceValue;
+    mState = FramePacerState::Submitted;
+}
+
+uint32_t CppDirectXRayTracing21::FramePacer::GetPendingFrameCount(uint64_t completedValue) const
+{
+    uint32_t count = 0;
+    for (uint64_t fenceValue : mSlotFences)
+    {
+        if (fenceValue > completedValue)
+        {
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	enum class FramePacerState : uint32_t
+	{
+		Loading,   // The command list is open on the first slot, load-time work goes into the first frame
+		Recording, // Between BeginFrame() and EndFrame()
+		Submitted  // The last frame was submitted, the next BeginFrame() moves to the next slot
+	};
+
+	struct FrameSlot
+	{
+		uint32_t index = 0;
+		uint64_t waitValue = 0;      // Fence value that must be completed before the slot's allocator is reused, 0 if none
+		bool resetAllocator = false; // False for the first frame, its command list is already open
+	};
+
+	// Frame-in-flight bookkeeping, decoupled from the swap-chain buffer count.
+	// Every slot owns a command allocator and a region of the per-frame rings on the D3D12 side and remembers the fence
+	// value of the last frame recorded into it. The class only tracks slots and fence values so it can be driven by a
+	// simulated queue.
+	class FramePacer
+	{
+	public:
+		explicit FramePacer(uint32_t framesInFlight);
+		~FramePacer() = default;
+
+		FrameSlot BeginFrame();
+
+		// Tags the current slot with the fence value signaled after its command list. Values must increase.
+		void EndFrame(uint64_t fenceValue);
+
+		// Submitted frames the GPU hasn't finished yet.
+		uint32_t GetPendingFrameCount(uint64_t completedValue) const;
+
+		uint32_t GetFrameCount() const { return static_cast<uint32_t>(mSlotFences.size()); }
+		uint32_t GetCurrentSlot() const { return mCurrentSlot; }
+		uint64_t GetLastSubmittedValue() const { return mLastSubmittedValue; }
+		FramePacerState GetState() const { return mState; }
+
+	private:
+		FramePacerState mState = FramePacerState::Loading;
+		uint32_t mCurrentSlot = 0;
+		uint64_t mLastSubmittedValue = 0;
+		std::vector<uint64_t> mSlotFences;
+	};
+};
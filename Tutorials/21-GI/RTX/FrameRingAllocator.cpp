@@ -0,0 +1,35 @@
+#pragma once
+#include "FrameRingAllocator.hpp"
+#include <cassert>
+
+CppDirectXRayTracing21::FrameRingAllocator::FrameRingAllocator(uint32_t frameCount, uint64_t bytesPerFrame)
+    : mBytesPerFrame(bytesPerFrame), mCurrentSlot(frameCount - 1), mSlotFences(frameCount, 0)
+{
+    assert(frameCount > 0);
+}
+
+uint64_t CppDirectXRayTracing21::FrameRingAllocator::BeginFrame()
+{
+    mCurrentSlot = (mCurrentSlot + 1) % GetFrameCount();
+    mUsedBytes = 0;
+    return mSlotFences[mCurrentSlot];
+}
+
+void CppDirectXRayTracing21::FrameRingAllocator::EndFrame(uint64_t fenceValue)
+{
+    mSlotFences[mCurrentSlot] = fenceValue;
+}
+
+bool CppDirectXRayTracing21::FrameRingAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    uint64_t aligned = (mUsedBytes + alignment - 1) & ~(alignment - 1);
+    if (aligned + size > mBytesPerFrame)
+    {
+        return false;
+    }
+
+    mUsedBytes = aligned + size;
+    offset = mCurrentSlot * mBytesPerFrame + aligned;
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	// Splits one buffer into a slot per frame in flight and hands out linear sub-allocations from the current slot.
+	// Each slot remembers the fence value of the frame that used it, the slot can only be reused once that value completed.
+	// The class only tracks offsets and fence values so the D3D12 side stays a thin wrapper.
+	class FrameRingAllocator
+	{
+	public:
+		FrameRingAllocator(uint32_t frameCount, uint64_t bytesPerFrame);
+		~FrameRingAllocator() = default;
+
+		// Moves to the next slot and returns the fence value that must be completed before writing to it (0 if none).
+		uint64_t BeginFrame();
+
+		// Tags the current slot with the fence value signaled after the frame's command list.
+		void EndFrame(uint64_t fenceValue);
+
+		// Returns false when the current slot is full. The offset is relative to the start of the whole buffer.
+		bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+
+		uint32_t GetFrameCount() const { return static_cast<uint32_t>(mSlotFences.size()); }
+		uint32_t GetCurrentSlot() const { return mCurrentSlot; }
+		uint64_t GetBytesPerFrame() const { return mBytesPerFrame; }
+		uint64_t GetUsedBytes() const { return mUsedBytes; }
+		uint64_t GetTotalSize() const { return mBytesPerFrame * GetFrameCount(); }
+
+	private:
+		uint64_t mBytesPerFrame;
+		uint64_t mUsedBytes = 0;
+		uint32_t mCurrentSlot;
+		std::vector<uint64_t> mSlotFences;
+	};
+};
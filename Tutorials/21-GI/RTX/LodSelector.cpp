@@ -0,0 +1,56 @@
+#pragma once
+#include "LodSelector.hpp"
+#include <algorithm>
+#include <cfloat>
+
+CppDirectXRayTracing21::LodSelector::LodSelector(uint32_t instanceCount)
+    : mLevels(instanceCount, 0)
+{
+}
+
+float CppDirectXRayTracing21::LodSelector::ComputeProjectedSize(const glm::vec4& bounds, const glm::vec3& cameraPosition, float tanHalfFov)
+{
+    // Inside the sphere the instance covers the screen
+    float distance = glm::length(glm::vec3(bounds) - cameraPosition);
+    return (distance > bounds.w) ? bounds.w / (distance * tanHalfFov) : FLT_MAX;
+}
+
+uint32_t CppDirectXRayTracing21::LodSelector::SelectLevel(float projectedSize, uint32_t levelCount)
+{
+    uint32_t level = 0;
+    while (level + 1 < std::min(levelCount, kMaxLevelCount) && projectedSize < kLodSwitchSizes[level])
+    {
+        level++;
+    }
+    return level;
+}
+
+uint32_t CppDirectXRayTracing21::LodSelector::SelectLevel(float projectedSize, uint32_t currentLevel, uint32_t levelCount)
+{
+    // Coarser once the size is clearly below the boundary, finer once it's clearly above
+    uint32_t coarser = SelectLevel(projectedSize * (1.0f + kLodHysteresis), levelCount);
+    uint32_t finer = SelectLevel(projectedSize * (1.0f - kLodHysteresis), levelCount);
+    if (coarser > currentLevel)
+    {
+        return coarser;
+    }
+    if (finer < currentLevel)
+    {
+        return finer;
+    }
+    return currentLevel;
+}
+
+bool CppDirectXRayTracing21::LodSelector::Update(const glm::vec3& cameraPosition, float tanHalfFov, Primitives::ArrayView<glm::vec4> bounds, Primitives::ArrayView<uint32_t> levelCounts)
+{
+    bool changed = (mSelected == false);
+    for (uint32_t i = 0; i < mLevels.size(); i++)
+    {
+        float projectedSize = ComputeProjectedSize(bounds[i], cameraPosition, tanHalfFov);
+        uint32_t level = mSelected ? SelectLevel(projectedSize, mLevels[i], levelCounts[i]) : SelectLevel(projectedSize, levelCounts[i]);
+        changed |= (level != mLevels[i]);
+        mLevels[i] = level;
+    }
+    mSelected = true;
+    return changed;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "../Primitives/MeshView.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	// Picks the level of detail of every instance from its projected size: the radius of its bounding sphere over the
+	// distance to the camera and the tangent of half the vertical field of view, 1 when the sphere fills the screen height.
+	//
+	// Level l+1 takes over below kLodSwitchSizes[l], the sizes halve with the triangle counts of the chain. Once an instance has
+	// a level it only switches when its size is past a boundary by kLodHysteresis, so a camera resting near a boundary
+	// doesn't make it flip between two levels, and rebuild the TLAS, every frame.
+	class LodSelector
+	{
+	public:
+		static const uint32_t kMaxLevelCount = 4;
+
+		explicit LodSelector(uint32_t instanceCount);
+		~LodSelector() = default;
+
+		// Bounds are world-space spheres, center and radius, levelCounts the number of levels of each instance's mesh.
+		// Returns true when an instance changed level, always on the first call.
+		bool Update(const glm::vec3& cameraPosition, float tanHalfFov, Primitives::ArrayView<glm::vec4> bounds, Primitives::ArrayView<uint32_t> levelCounts);
+		uint32_t GetLevel(uint32_t instance) const { return mLevels[instance]; }
+
+		static float ComputeProjectedSize(const glm::vec4& bounds, const glm::vec3& cameraPosition, float tanHalfFov);
+		// The level for the projected size, without hysteresis
+		static uint32_t SelectLevel(float projectedSize, uint32_t levelCount);
+		// The level for the projected size of an instance currently at currentLevel
+		static uint32_t SelectLevel(float projectedSize, uint32_t currentLevel, uint32_t levelCount);
+
+	private:
+		static constexpr float kLodSwitchSizes[kMaxLevelCount - 1] = { 0.1f, 0.05f, 0.025f };
+		static constexpr float kLodHysteresis = 0.1f;
+
+		std::vector<uint32_t> mLevels;
+		bool mSelected = false;
+	};
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include "MappedFile.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+bool CppDirectXRayTracing21::MappedFile::Open(const fs::path& path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) == FALSE || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* pView = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (pView == nullptr)
+    {
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+
+    mFile = file;
+    mMapping = mapping;
+    mpData = static_cast<const uint8_t*>(pView);
+    mSize = static_cast<uint64_t>(size.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file
+    void* pView = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (pView == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(pView, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+    mpData = static_cast<const uint8_t*>(pView);
+    mSize = static_cast<uint64_t>(info.st_size);
+#endif
+    return true;
+}
+
+void CppDirectXRayTracing21::MappedFile::Close()
+{
+    if (mpData == nullptr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(mpData);
+    CloseHandle(mMapping);
+    CloseHandle(mFile);
+    mMapping = nullptr;
+    mFile = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(mpData), static_cast<size_t>(mSize));
+#endif
+    mpData = nullptr;
+    mSize = 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+
+namespace CppDirectXRayTracing21
+{
+	// Read-only mapping of a whole file.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile() { Close(); }
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::filesystem::path& path);
+		void Close();
+
+		const uint8_t* GetData() const { return mpData; }
+		uint64_t GetSize() const { return mSize; }
+
+	private:
+		const uint8_t* mpData = nullptr;
+		uint64_t mSize = 0;
+#ifdef _WIN32
+		void* mFile = nullptr;
+		void* mMapping = nullptr;
+#endif
+	};
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include "PayloadPacking.hpp"
+#include <cmath>
+
+namespace
+{
+    const int kMantissaBits = 9;
+    const int kExponentBias = 15;
+    const int kMaxExponent = 31;
+}
+
+uint32_t CppDirectXRayTracing21::PackRGB9E5(const glm::vec3& rgb)
+{
+    // Same steps as the HLSL version, see EXT_texture_shared_exponent
+    glm::vec3 c = glm::clamp(rgb, glm::vec3(0.0f), glm::vec3(kMaxRGB9E5));
+    float maxComponent = std::max(c.x, std::max(c.y, c.z));
+
+    // The lower bound keeps log2() finite for black
+    int exponent = std::max(-kExponentBias - 1, static_cast<int>(std::floor(std::log2(std::max(maxComponent, 1e-30f))))) + 1 + kExponentBias;
+    float scale = std::exp2(static_cast<float>(exponent - kExponentBias - kMantissaBits));
+
+    // Rounding may carry the largest mantissa over 9 bits
+    if (std::floor(maxComponent / scale + 0.5f) >= float(1 << kMantissaBits))
+    {
+        scale *= 2.0f;
+        exponent++;
+    }
+    exponent = std::min(exponent, kMaxExponent);
+
+    uint32_t r = static_cast<uint32_t>(std::floor(c.x / scale + 0.5f));
+    uint32_t g = static_cast<uint32_t>(std::floor(c.y / scale + 0.5f));
+    uint32_t b = static_cast<uint32_t>(std::floor(c.z / scale + 0.5f));
+    return r | (g << 9) | (b << 18) | (static_cast<uint32_t>(exponent) << 27);
+}
+
+glm::vec3 CppDirectXRayTracing21::UnpackRGB9E5(uint32_t packed)
+{
+    int exponent = static_cast<int>(packed >> 27);
+    float scale = std::exp2(static_cast<float>(exponent - kExponentBias - kMantissaBits));
+    return glm::vec3(float(packed & 0x1FF), float((packed >> 9) & 0x1FF), float((packed >> 18) & 0x1FF)) * scale;
+}
+
+uint32_t CppDirectXRayTracing21::PackDepthAndSeed(uint32_t depth, uint32_t seed)
+{
+    return (std::min(depth, kPayloadMaxDepth) << kPayloadSeedBits) | (seed & ((1u << kPayloadSeedBits) - 1));
+}
+
+uint32_t CppDirectXRayTracing21::UnpackDepth(uint32_t depthAndSeed)
+{
+    return depthAndSeed >> kPayloadSeedBits;
+}
+
+uint32_t CppDirectXRayTracing21::UnpackSeed(uint32_t depthAndSeed)
+{
+    return depthAndSeed & ((1u << kPayloadSeedBits) - 1);
+}
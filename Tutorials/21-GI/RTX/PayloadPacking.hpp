@@ -0,0 +1,35 @@
+#pragma once
+#include "Externals/GLM/glm/glm.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace CppDirectXRayTracing21
+{
+	// Ray payloads as declared in Helpers.hlsli, the shader config is sized from these structs.
+	struct PackedRayPayload
+	{
+		uint32_t radiance;     // RGB9E5
+		uint32_t depthAndSeed; // Recursion depth in the top 8 bits, random seed in the low 24 bits
+	};
+
+	struct PackedShadowPayload
+	{
+		uint32_t visible;      // Cleared by the caller, only the miss shader sets it
+	};
+
+	static const uint32_t kMaxPayloadSizeInBytes = static_cast<uint32_t>(std::max(sizeof(PackedRayPayload), sizeof(PackedShadowPayload)));
+
+	// Shared exponent format of DXGI_FORMAT_R9G9B9E5_SHAREDEXP: three 9 bit mantissas and a 5 bit exponent with a bias of 15.
+	// Negative values are clamped to 0, values above kMaxRGB9E5 to kMaxRGB9E5.
+	static const float kMaxRGB9E5 = 65408.0f;
+	uint32_t PackRGB9E5(const glm::vec3& rgb);
+	glm::vec3 UnpackRGB9E5(uint32_t packed);
+
+	// nextRand() only reads the low 24 bits of the LCG state, and those only depend on the low 24 bits of the previous
+	// state, so dropping the top 8 bits of the seed doesn't change the random sequence.
+	static const uint32_t kPayloadSeedBits = 24;
+	static const uint32_t kPayloadMaxDepth = (1u << (32 - kPayloadSeedBits)) - 1;
+	uint32_t PackDepthAndSeed(uint32_t depth, uint32_t seed);
+	uint32_t UnpackDepth(uint32_t depthAndSeed);
+	uint32_t UnpackSeed(uint32_t depthAndSeed);
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace
+{
+    // The GPU gets its own row in the trace, after the CPU threads
+    const uint32_t kGpuThread = 1000;
+
+    const char* getTrackName(CppDirectXRayTracing21::ProfileTrack track)
+    {
+        return (track == CppDirectXRayTracing21::ProfileTrack::Gpu) ? "gpu" : "cpu";
+    }
+
+    std::string escapeJson(const std::string& s)
+    {
+        std::string escaped;
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+CppDirectXRayTracing21::Profiler::Profiler(uint32_t windowSize, size_t maxTraceEvents)
+    : mStart(std::chrono::steady_clock::now()), mWindowSize(std::max(windowSize, 1u)), mMaxTraceEvents(maxTraceEvents)
+{
+}
+
+double CppDirectXRayTracing21::Profiler::NowUs() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - mStart).count();
+}
+
+uint32_t CppDirectXRayTracing21::Profiler::GetThreadIndex()
+{
+    auto result = mThreads.insert({ std::this_thread::get_id(), static_cast<uint32_t>(mThreads.size()) });
+    return result.first->second;
+}
+
+void CppDirectXRayTracing21::Profiler::AddSample(const char* name, ProfileTrack track, double startUs, double durationUs)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto scope = mScopes.try_emplace(ScopeKey(track, name)).first;
+    ScopeWindow& window = scope->second;
+    if (window.durationsMs.size() < mWindowSize)
+    {
+        window.durationsMs.push_back(durationUs / 1000.0);
+    }
+    else
+    {
+        window.durationsMs[window.next] = durationUs / 1000.0;
+    }
+    window.next = (window.next + 1) % mWindowSize;
+
+    // The trace keeps the oldest events, the statistics keep rolling
+    if (mEvents.size() < mMaxTraceEvents)
+    {
+        uint32_t thread = (track == ProfileTrack::Gpu) ? kGpuThread : GetThreadIndex();
+        mEvents.push_back({ &scope->first.second, track, thread, startUs, durationUs });
+    }
+}
+
+CppDirectXRayTracing21::ScopeStatistics CppDirectXRayTracing21::Profiler::ComputeStatistics(const ScopeWindow& window) const
+{
+    ScopeStatistics stats;
+    if (window.durationsMs.empty())
+    {
+        return stats;
+    }
+
+    std::vector<double> sorted = window.durationsMs;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (double duration : sorted)
+    {
+        sum += duration;
+    }
+
+    // Nearest-rank percentile
+    size_t rank = static_cast<size_t>(std::ceil(0.99 * sorted.size()));
+    stats.count = static_cast<uint32_t>(sorted.size());
+    stats.minMs = sorted.front();
+    stats.avgMs = sum / sorted.size();
+    stats.p99Ms = sorted[std::max<size_t>(rank, 1) - 1];
+    return stats;
+}
+
+CppDirectXRayTracing21::ScopeStatistics CppDirectXRayTracing21::Profiler::GetStatistics(const char* name, ProfileTrack track) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto scope = mScopes.find(ScopeKey(track, name));
+    return (scope == mScopes.end()) ? ScopeStatistics() : ComputeStatistics(scope->second);
+}
+
+bool CppDirectXRayTracing21::Profiler::WriteChromeTrace(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::ofstream file(path, std::ios::trunc);
+    if (file.good() == false)
+    {
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << kGpuThread << ",\"args\":{\"name\":\"GPU\"}}";
+    for (const auto& thread : mThreads)
+    {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread.second << ",\"args\":{\"name\":\"CPU " << thread.second << "\"}}";
+    }
+
+    file.precision(3);
+    file << std::fixed;
+    for (const TraceEvent& event : mEvents)
+    {
+        file << ",\n{\"name\":\"" << escapeJson(*event.pName) << "\",\"cat\":\"" << getTrackName(event.track) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+             << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs << "}";
+    }
+    file << "\n]}\n";
+    return file.good();
+}
+
+bool CppDirectXRayTracing21::Profiler::WriteStatisticsCsv(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::ofstream file(path, std::ios::trunc);
+    if (file.good() == false)
+    {
+        return false;
+    }
+
+    file << "track,scope,count,min_ms,avg_ms,p99_ms\n";
+    file.precision(4);
+    file << std::fixed;
+    for (const auto& scope : mScopes)
+    {
+        ScopeStatistics stats = ComputeStatistics(scope.second);
+        file << getTrackName(scope.first.first) << "," << scope.first.second << "," << stats.count << ","
+             << stats.minMs << "," << stats.avgMs << "," << stats.p99Ms << "\n";
+    }
+    return file.good();
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	enum class ProfileTrack : uint32_t
+	{
+		Cpu,
+		Gpu
+	};
+
+	struct ScopeStatistics
+	{
+		uint32_t count = 0; // Samples in the rolling window
+		double minMs = 0.0;
+		double avgMs = 0.0;
+		double p99Ms = 0.0;
+	};
+
+	// Collects named CPU and GPU scopes on one timeline, in microseconds since the profiler was created.
+	// Every scope keeps its last kWindowSize durations for the statistics, and the scopes are kept as trace events
+	// up to a cap for the Chrome trace export. Samples can be added from any thread.
+	class Profiler
+	{
+	public:
+		explicit Profiler(uint32_t windowSize = kDefaultWindowSize, size_t maxTraceEvents = kDefaultMaxTraceEvents);
+		~Profiler() = default;
+
+		double NowUs() const;
+
+		// Scope names are kept as strings, literals are the common case.
+		void AddSample(const char* name, ProfileTrack track, double startUs, double durationUs);
+
+		ScopeStatistics GetStatistics(const char* name, ProfileTrack track) const;
+
+		// chrome://tracing and Perfetto format, one row per CPU thread plus one for the GPU.
+		bool WriteChromeTrace(const std::string& path) const;
+
+		// One line per scope: track, name, count, min, avg and p99 of the rolling window in milliseconds.
+		bool WriteStatisticsCsv(const std::string& path) const;
+
+		static const uint32_t kDefaultWindowSize = 256;
+		static const size_t kDefaultMaxTraceEvents = 1 << 18;
+
+	private:
+		struct TraceEvent
+		{
+			const std::string* pName; // Points at a key of mScopes, which never moves
+			ProfileTrack track;
+			uint32_t thread;
+			double startUs;
+			double durationUs;
+		};
+
+		struct ScopeWindow
+		{
+			std::vector<double> durationsMs;
+			uint32_t next = 0;
+		};
+
+		using ScopeKey = std::pair<ProfileTrack, std::string>;
+
+		ScopeStatistics ComputeStatistics(const ScopeWindow& window) const;
+		uint32_t GetThreadIndex();
+
+		std::chrono::steady_clock::time_point mStart;
+		uint32_t mWindowSize;
+		size_t mMaxTraceEvents;
+
+		mutable std::mutex mMutex;
+		std::map<ScopeKey, ScopeWindow> mScopes;
+		std::vector<TraceEvent> mEvents;
+		std::map<std::thread::id, uint32_t> mThreads;
+	};
+
+	// Times its own lifetime as a CPU scope. A null profiler turns it into a no-op.
+	class ProfileScope
+	{
+	public:
+		ProfileScope(Profiler* pProfiler, const char* name) : mpProfiler(pProfiler), mName(name)
+		{
+			mStartUs = mpProfiler ? mpProfiler->NowUs() : 0.0;
+		}
+
+		~ProfileScope()
+		{
+			if (mpProfiler)
+			{
+				mpProfiler->AddSample(mName, ProfileTrack::Cpu, mStartUs, mpProfiler->NowUs() - mStartUs);
+			}
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		Profiler* mpProfiler;
+		const char* mName;
+		double mStartUs;
+	};
+};
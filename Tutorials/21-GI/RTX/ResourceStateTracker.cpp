@@ -0,0 +1,160 @@
+#pragma once
+#include "ResourceStateTracker.hpp"
+#include <cassert>
+
+namespace
+{
+    bool IsCoveredBy(uint32_t requested, uint32_t current)
+    {
+        if (requested == current)
+        {
+            return true;
+        }
+
+        // COMMON is 0 and can't be tested as a subset. Read states can be combined, write states must match exactly
+        bool readOnly = (requested & CppDirectXRayTracing21::kResourceStateWriteMask) == 0 && (current & CppDirectXRayTracing21::kResourceStateWriteMask) == 0;
+        return requested != CppDirectXRayTracing21::kResourceStateCommon && readOnly && (current & requested) == requested;
+    }
+}
+
+void CppDirectXRayTracing21::ResourceStateTracker::Register(const void* pResource, uint32_t state)
+{
+    ResourceState& resource = mResources[pResource];
+    resource.state = state;
+}
+
+void CppDirectXRayTracing21::ResourceStateTracker::Unregister(const void* pResource)
+{
+    auto it = mResources.find(pResource);
+    if (it == mResources.end())
+    {
+        return;
+    }
+
+    // A pending transition of a released resource must not reach the command list
+    if (it->second.pendingTransition >= 0)
+    {
+        mPending[it->second.pendingTransition].pResource = nullptr;
+    }
+    if (it->second.pendingUav >= 0)
+    {
+        mPending[it->second.pendingUav].pResource = nullptr;
+    }
+    mResources.erase(it);
+}
+
+void CppDirectXRayTracing21::ResourceStateTracker::Transition(const void* pResource, uint32_t state)
+{
+    auto it = mResources.find(pResource);
+    assert(it != mResources.end() && "The resource was never registered");
+    if (it == mResources.end())
+    {
+        return;
+    }
+
+    ResourceState& resource = it->second;
+    if (IsCoveredBy(state, resource.state))
+    {
+        return;
+    }
+
+    if (resource.pendingTransition >= 0)
+    {
+        // Merge with the transition already waiting for the next flush. Going back to the original state cancels it
+        ResourceBarrierDesc& barrier = mPending[resource.pendingTransition];
+        barrier.stateAfter = state;
+        if (barrier.stateBefore == state)
+        {
+            barrier.pResource = nullptr;
+            resource.pendingTransition = -1;
+            resource.state = state;
+
+            // Nothing orders the accesses made before the cancelled transition, their UAV hazard is back
+            resource.uavAccessed = resource.uavAccessedBeforeTransition;
+            if (resource.uavBarrierBeforeTransition)
+            {
+                resource.pendingUav = static_cast<int32_t>(mPending.size());
+                mPending.push_back({ ResourceBarrierType::Uav, pResource, kResourceStateUnorderedAccess, kResourceStateUnorderedAccess });
+            }
+            return;
+        }
+    }
+    else
+    {
+        resource.uavAccessedBeforeTransition = resource.uavAccessed;
+        resource.uavBarrierBeforeTransition = (resource.pendingUav >= 0);
+        resource.pendingTransition = static_cast<int32_t>(mPending.size());
+        mPending.push_back({ ResourceBarrierType::Transition, pResource, resource.state, state });
+    }
+
+    // The transition orders the accesses on both sides, a UAV barrier waiting for the same flush is redundant
+    if (resource.pendingUav >= 0)
+    {
+        mPending[resource.pendingUav].pResource = nullptr;
+        resource.pendingUav = -1;
+    }
+
+    // A transition waits for all prior accesses, the UAV hazard is resolved by it
+    resource.state = state;
+    resource.uavAccessed = false;
+}
+
+void CppDirectXRayTracing21::ResourceStateTracker::UavAccess(const void* pResource)
+{
+    Transition(pResource, kResourceStateUnorderedAccess);
+
+    auto it = mResources.find(pResource);
+    if (it == mResources.end())
+    {
+        return;
+    }
+
+    // A previous command accessed the UAV and nothing ordered it against this one. A pending transition into
+    // UNORDERED_ACCESS already orders the two
+    ResourceState& resource = it->second;
+    if (resource.uavAccessed && resource.pendingTransition < 0 && resource.pendingUav < 0)
+    {
+        resource.pendingUav = static_cast<int32_t>(mPending.size());
+        mPending.push_back({ ResourceBarrierType::Uav, pResource, kResourceStateUnorderedAccess, kResourceStateUnorderedAccess });
+    }
+    resource.uavAccessed = true;
+}
+
+std::vector<CppDirectXRayTracing21::ResourceBarrierDesc> CppDirectXRayTracing21::ResourceStateTracker::Flush()
+{
+    std::vector<ResourceBarrierDesc> barriers;
+    barriers.reserve(mPending.size());
+    for (const ResourceBarrierDesc& barrier : mPending)
+    {
+        // Cancelled entries were already detached from their resource
+        if (barrier.pResource == nullptr)
+        {
+            continue;
+        }
+        barriers.push_back(barrier);
+
+        ResourceState& resource = mResources[barrier.pResource];
+        resource.pendingTransition = -1;
+        resource.pendingUav = -1;
+    }
+    mPending.clear();
+    return barriers;
+}
+
+uint32_t CppDirectXRayTracing21::ResourceStateTracker::GetState(const void* pResource) const
+{
+    auto it = mResources.find(pResource);
+    return (it == mResources.end()) ? kResourceStateCommon : it->second.state;
+}
+
+bool CppDirectXRayTracing21::ResourceStateTracker::HasPendingBarriers() const
+{
+    for (const ResourceBarrierDesc& barrier : mPending)
+    {
+        if (barrier.pResource)
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	// The states are the D3D12_RESOURCE_STATES bits. Only the ones the tracker has to tell apart are named here,
+	// the D3D12 side checks they match the SDK values.
+	const uint32_t kResourceStateCommon = 0x0;
+	const uint32_t kResourceStateUnorderedAccess = 0x8;
+
+	// States a resource can be written in. Every other state is read-only and read states can be combined.
+	// RENDER_TARGET | UNORDERED_ACCESS | DEPTH_WRITE | STREAM_OUT | COPY_DEST | RESOLVE_DEST | RAYTRACING_ACCELERATION_STRUCTURE
+	const uint32_t kResourceStateWriteMask = 0x4 | 0x8 | 0x10 | 0x100 | 0x400 | 0x1000 | 0x400000;
+
+	enum class ResourceBarrierType : uint32_t
+	{
+		Transition,
+		Uav
+	};
+
+	struct ResourceBarrierDesc
+	{
+		ResourceBarrierType type;
+		const void* pResource;
+		uint32_t stateBefore;
+		uint32_t stateAfter;
+	};
+
+	// Tracks the state of whole resources on one command list and collects the barriers they need.
+	// Requests are recorded as pending and merged: a resource transitioned twice before the next flush gets a single
+	// barrier, one transitioned back to where it was gets none. Flush() hands out all pending barriers at once, right
+	// before the draw, dispatch or copy that needs them.
+	// UAV barriers are only added between two commands accessing the same UAV without a transition in between.
+	class ResourceStateTracker
+	{
+	public:
+		ResourceStateTracker() = default;
+		~ResourceStateTracker() = default;
+
+		void Register(const void* pResource, uint32_t state);
+		void Unregister(const void* pResource);
+
+		// Requests the resource in the given state. Read states already covered by the current state don't need a barrier.
+		void Transition(const void* pResource, uint32_t state);
+
+		// Declares an unordered access by the next command. Call once per command and resource.
+		void UavAccess(const void* pResource);
+
+		std::vector<ResourceBarrierDesc> Flush();
+
+		// The state after the pending barriers.
+		uint32_t GetState(const void* pResource) const;
+		bool IsRegistered(const void* pResource) const { return mResources.count(pResource) != 0; }
+		bool HasPendingBarriers() const;
+
+	private:
+		struct ResourceState
+		{
+			uint32_t state = kResourceStateCommon;
+			bool uavAccessed = false; // Accessed as UAV since its last barrier
+			int32_t pendingTransition = -1; // Indices into mPending
+			int32_t pendingUav = -1;
+
+			// The UAV hazard when the pending transition was requested, restored if the transition is cancelled
+			bool uavAccessedBeforeTransition = false;
+			bool uavBarrierBeforeTransition = false;
+		};
+
+		std::unordered_map<const void*, ResourceState> mResources;
+		std::vector<ResourceBarrierDesc> mPending;
+	};
+};
@@ -0,0 +1,187 @@
+#pragma once
+#include "SceneBuilder.hpp"
+#include <algorithm>
+
+namespace
+{
+    // The frame axes come from vertices at least this far from the origin, and from the first axis, relative to the radius
+    const float kFrameVertexDistance = 0.1f;
+    // Copies match within this distance relative to the radius, and within this difference of their unit vectors
+    const float kPositionTolerance = 1e-4f;
+    const float kDirectionTolerance = 1e-3f;
+    // Rotations this close to the identity are float noise, the instance gets a pure translation
+    const float kIdentityTolerance = 1e-5f;
+
+    bool NearlyEqual(const glm::vec3& a, const glm::vec3& b, float tolerance)
+    {
+        glm::vec3 d = glm::abs(a - b);
+        return std::max(std::max(d.x, d.y), d.z) <= tolerance;
+    }
+}
+
+CppDirectXRayTracing21::SceneBuilder::Frame CppDirectXRayTracing21::SceneBuilder::ComputeFrame(const std::vector<Primitives::Vertex>& vertices) const
+{
+    Frame frame;
+    glm::dvec3 sum(0.0);
+    for (const Primitives::Vertex& vertex : vertices)
+    {
+        sum += glm::dvec3(vertex.position);
+    }
+    frame.origin = glm::vec3(sum / double(std::max<size_t>(vertices.size(), 1)));
+
+    frame.radius = 0.0f;
+    for (const Primitives::Vertex& vertex : vertices)
+    {
+        frame.radius = std::max(frame.radius, glm::length(vertex.position - frame.origin));
+    }
+
+    // Degenerate meshes keep the world axes, their copies are only found when they aren't rotated
+    glm::vec3 x(1.0f, 0.0f, 0.0f);
+    glm::vec3 y(0.0f, 1.0f, 0.0f);
+    float threshold = kFrameVertexDistance * frame.radius;
+    size_t i = 0;
+    for (; i < vertices.size(); i++)
+    {
+        glm::vec3 d = vertices[i].position - frame.origin;
+        if (glm::length(d) > threshold)
+        {
+            x = glm::normalize(d);
+            break;
+        }
+    }
+    for (; i < vertices.size(); i++)
+    {
+        glm::vec3 d = vertices[i].position - frame.origin;
+        glm::vec3 perpendicular = d - x * glm::dot(d, x);
+        if (glm::length(perpendicular) > threshold)
+        {
+            y = glm::normalize(perpendicular);
+            break;
+        }
+    }
+    if (std::abs(glm::dot(x, y)) > 0.5f)
+    {
+        // Only the first axis was found, any perpendicular will do
+        y = (std::abs(x.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        y = glm::normalize(y - x * glm::dot(y, x));
+    }
+
+    frame.axes = glm::mat3(x, y, glm::cross(x, y));
+    return frame;
+}
+
+bool CppDirectXRayTracing21::SceneBuilder::IsCopy(const Mesh& mesh, const Frame& meshFrame, const std::vector<Primitives::Vertex>& vertices, const std::vector<uint32_t>& indices, const Frame& frame) const
+{
+    if (mesh.vertices.size() != vertices.size() || mesh.indices != indices || std::abs(meshFrame.radius - frame.radius) > kPositionTolerance * meshFrame.radius)
+    {
+        return false;
+    }
+
+    // Both sides in their own frame, the stored vertices are already relative to the origin
+    glm::mat3 meshToFrame = glm::transpose(meshFrame.axes);
+    glm::mat3 toFrame = glm::transpose(frame.axes);
+    float tolerance = kPositionTolerance * std::max(meshFrame.radius, 1e-6f);
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Primitives::Vertex& a = mesh.vertices[i];
+        const Primitives::Vertex& b = vertices[i];
+        if (a.texcoord != b.texcoord ||
+            NearlyEqual(meshToFrame * a.position, toFrame * (b.position - frame.origin), tolerance) == false ||
+            NearlyEqual(meshToFrame * a.normal, toFrame * b.normal, kDirectionTolerance) == false ||
+            NearlyEqual(meshToFrame * a.tangent, toFrame * b.tangent, kDirectionTolerance) == false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t CppDirectXRayTracing21::SceneBuilder::AddMesh(Primitives::MeshView mesh, const glm::mat4& transform, uint32_t material)
+{
+    // Baked into world space, the normals with the inverse transpose so sheared meshes stay lit correctly
+    glm::mat3 linear(transform);
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+    std::vector<Primitives::Vertex> vertices(mesh.vertices.begin(), mesh.vertices.end());
+    for (Primitives::Vertex& vertex : vertices)
+    {
+        vertex.position = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+        glm::vec3 normal = normalMatrix * vertex.normal;
+        glm::vec3 tangent = linear * vertex.tangent;
+        vertex.normal = (glm::dot(normal, normal) > 0.0f) ? glm::normalize(normal) : normal;
+        vertex.tangent = (glm::dot(tangent, tangent) > 0.0f) ? glm::normalize(tangent) : tangent;
+    }
+
+    std::vector<uint32_t> indices(mesh.indices.size());
+    std::vector<glm::vec2> texcoords(vertices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        indices[i] = mesh.indices[i];
+    }
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        texcoords[i] = vertices[i].texcoord;
+    }
+
+    uint64_t counts[2] = { vertices.size(), indices.size() };
+    uint64_t hash = ComputeChecksum(counts, sizeof(counts));
+    hash = hash * 31 + ComputeChecksum(indices.data(), indices.size() * sizeof(uint32_t));
+    hash = hash * 31 + ComputeChecksum(texcoords.data(), texcoords.size() * sizeof(glm::vec2));
+
+    Frame frame = ComputeFrame(vertices);
+    uint32_t meshIndex = static_cast<uint32_t>(mMeshes.size());
+    auto candidates = mMeshesByHash.equal_range(hash);
+    for (auto it = candidates.first; it != candidates.second; ++it)
+    {
+        if (IsCopy(mMeshes[it->second], mFrames[it->second], vertices, indices, frame))
+        {
+            meshIndex = it->second;
+            break;
+        }
+    }
+
+    if (meshIndex == mMeshes.size())
+    {
+        for (Primitives::Vertex& vertex : vertices)
+        {
+            vertex.position -= frame.origin;
+        }
+        mMeshes.push_back({ std::move(vertices), std::move(indices), 0 });
+        mFrames.push_back(frame);
+        mMeshesByHash.emplace(hash, meshIndex);
+    }
+    mMeshes[meshIndex].instanceCount++;
+
+    // Stored mesh to world: back to the first copy's frame, into this copy's frame, and to its origin
+    glm::mat3 rotation = frame.axes * glm::transpose(mFrames[meshIndex].axes);
+    if (NearlyEqual(rotation[0], glm::vec3(1.0f, 0.0f, 0.0f), kIdentityTolerance) && NearlyEqual(rotation[1], glm::vec3(0.0f, 1.0f, 0.0f), kIdentityTolerance) &&
+        NearlyEqual(rotation[2], glm::vec3(0.0f, 0.0f, 1.0f), kIdentityTolerance))
+    {
+        rotation = glm::mat3(1.0f);
+    }
+
+    SceneCacheInstance instance;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 3; column++)
+        {
+            instance.transform[row][column] = rotation[column][row];
+        }
+        instance.transform[row][3] = frame.origin[row];
+    }
+    instance.mesh = meshIndex;
+    instance.material = material;
+    mInstances.push_back(instance);
+    return static_cast<uint32_t>(mInstances.size() - 1);
+}
+
+std::vector<CppDirectXRayTracing21::SceneBuilder::Mesh> CppDirectXRayTracing21::SceneBuilder::TakeMeshes()
+{
+    mFrames.clear();
+    mMeshesByHash.clear();
+    return std::move(mMeshes);
+}
+
+std::vector<CppDirectXRayTracing21::SceneCacheInstance> CppDirectXRayTracing21::SceneBuilder::TakeInstances()
+{
+    return std::move(mInstances);
+}
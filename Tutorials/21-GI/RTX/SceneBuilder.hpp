@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "SceneCache.hpp"
+#include "../Primitives/MeshView.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	// Merges the meshes that are copies of each other up to a rigid transform, the copies become instances of one mesh.
+	//
+	// Every added mesh is baked into world space and gets a frame of its own: the origin at the vertex centroid, the axes
+	// from the first vertices far enough from it and from each other. The frame only depends on the vertex order, so it
+	// follows the copies of a mesh through any rotation and translation, symmetric shapes included.
+	// The candidates are found by hashing what a rigid transform leaves exactly as it is: the counts, the indices and the
+	// texcoords. The positions, normals and tangents in the frame are then compared within a tolerance relative to the
+	// mesh size; hashed after quantization they would split copies that straddle a rounding boundary.
+	// Scaled and mirrored copies stay separate meshes.
+	class SceneBuilder
+	{
+	public:
+		struct Mesh
+		{
+			std::vector<Primitives::Vertex> vertices; // Oriented as the first copy, centered on its centroid
+			std::vector<uint32_t> indices;
+			uint32_t instanceCount = 0;
+		};
+
+		SceneBuilder() = default;
+		~SceneBuilder() = default;
+
+		// The transform is baked before the comparison, it may scale or shear. Returns the index of the new instance.
+		uint32_t AddMesh(Primitives::MeshView mesh, const glm::mat4& transform, uint32_t material);
+
+		// Meshes in the order of their first copy, the instances in the order they were added
+		const std::vector<Mesh>& GetMeshes() const { return mMeshes; }
+		const std::vector<SceneCacheInstance>& GetInstances() const { return mInstances; }
+
+		// Moves the meshes out, e.g. to optimize them in place. The builder is empty afterwards.
+		std::vector<Mesh> TakeMeshes();
+		std::vector<SceneCacheInstance> TakeInstances();
+
+	private:
+		struct Frame
+		{
+			glm::vec3 origin;
+			glm::mat3 axes;  // Orthonormal, columns are the frame axes in world space
+			float radius;    // Largest vertex distance from the origin
+		};
+
+		Frame ComputeFrame(const std::vector<Primitives::Vertex>& vertices) const;
+		bool IsCopy(const Mesh& mesh, const Frame& meshFrame, const std::vector<Primitives::Vertex>& vertices, const std::vector<uint32_t>& indices, const Frame& frame) const;
+
+		std::vector<Mesh> mMeshes;
+		std::vector<Frame> mFrames;  // Of the first copy of every mesh, the stored vertices are relative to its origin
+		std::vector<SceneCacheInstance> mInstances;
+		std::unordered_multimap<uint64_t, uint32_t> mMeshesByHash;
+	};
+};
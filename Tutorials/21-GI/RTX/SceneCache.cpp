@@ -0,0 +1,230 @@
+#pragma once
+#include "SceneCache.hpp"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+    const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+
+    uint64_t Rotl(uint64_t value, int shift)
+    {
+        return (value << shift) | (value >> (64 - shift));
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint64_t ComputeHeaderChecksum(const CppDirectXRayTracing21::SceneCacheHeader& header, const CppDirectXRayTracing21::SceneCacheSectionEntry* pSections)
+    {
+        CppDirectXRayTracing21::SceneCacheHeader copy = header;
+        copy.headerChecksum = 0;
+        uint64_t checksum = CppDirectXRayTracing21::ComputeChecksum(&copy, sizeof(copy));
+        return checksum ^ Rotl(CppDirectXRayTracing21::ComputeChecksum(pSections, sizeof(*pSections) * header.sectionCount), 17);
+    }
+}
+
+uint64_t CppDirectXRayTracing21::ComputeChecksum(const void* pData, size_t size)
+{
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    uint64_t lanes[4] = { kPrime1, kPrime2, ~kPrime1, ~kPrime2 };
+
+    // The lanes don't depend on each other, the loop runs at memory speed
+    size_t blockCount = size / 32;
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        for (int lane = 0; lane < 4; lane++)
+        {
+            uint64_t word;
+            memcpy(&word, pBytes + block * 32 + lane * 8, sizeof(word));
+            lanes[lane] = Rotl(lanes[lane] + word * kPrime2, 31) * kPrime1;
+        }
+    }
+
+    uint64_t hash = uint64_t(size) * kPrime1;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        hash = Rotl(hash ^ lanes[lane], 27) * kPrime2 + kPrime1;
+    }
+    for (size_t i = blockCount * 32; i < size; i++)
+    {
+        hash = Rotl(hash ^ (pBytes[i] * kPrime1), 11) * kPrime2;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+void CppDirectXRayTracing21::SceneCacheWriter::AddSection(SceneCacheSection type, const void* pData, uint64_t size, uint32_t elementSize)
+{
+    Section section;
+    section.type = type;
+    section.elementSize = elementSize;
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    section.data.assign(pBytes, pBytes + size);
+    mSections.push_back(std::move(section));
+}
+
+bool CppDirectXRayTracing21::SceneCacheWriter::Write(const fs::path& path, uint64_t sourceKey) const
+{
+    SceneCacheHeader header = {};
+    memcpy(header.magic, kSceneCacheMagic, sizeof(header.magic));
+    header.version = kSceneCacheVersion;
+    header.sectionCount = static_cast<uint32_t>(mSections.size());
+    header.sourceKey = sourceKey;
+
+    // Every section starts on its own page
+    std::vector<SceneCacheSectionEntry> entries(mSections.size());
+    uint64_t offset = sizeof(SceneCacheHeader) + sizeof(SceneCacheSectionEntry) * entries.size();
+    for (size_t i = 0; i < mSections.size(); i++)
+    {
+        offset = AlignUp(offset, kSceneCacheAlignment);
+        entries[i].type = static_cast<uint32_t>(mSections[i].type);
+        entries[i].elementSize = mSections[i].elementSize;
+        entries[i].offset = offset;
+        entries[i].size = mSections[i].data.size();
+        entries[i].checksum = ComputeChecksum(mSections[i].data.data(), mSections[i].data.size());
+        offset += entries[i].size;
+    }
+    header.fileSize = offset;
+    header.headerChecksum = ComputeHeaderChecksum(header, entries.data());
+
+    std::error_code ec;
+    if (path.has_parent_path())
+    {
+        fs::create_directories(path.parent_path(), ec);
+    }
+
+    fs::path tempPath = path;
+    tempPath += ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(sizeof(SceneCacheSectionEntry) * entries.size()));
+
+        static const char kPadding[kSceneCacheAlignment] = {};
+        uint64_t written = sizeof(header) + sizeof(SceneCacheSectionEntry) * entries.size();
+        for (size_t i = 0; i < mSections.size(); i++)
+        {
+            file.write(kPadding, static_cast<std::streamsize>(entries[i].offset - written));
+            file.write(reinterpret_cast<const char*>(mSections[i].data.data()), static_cast<std::streamsize>(mSections[i].data.size()));
+            written = entries[i].offset + entries[i].size;
+        }
+
+        if (file.good() == false)
+        {
+            file.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tempPath, path, ec);
+    if (ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool CppDirectXRayTracing21::SceneCacheReader::Fail(const std::string& error)
+{
+    mError = error;
+    mSections.clear();
+    mFile.Close();
+    return false;
+}
+
+bool CppDirectXRayTracing21::SceneCacheReader::Open(const fs::path& path, uint64_t sourceKey, bool verifyChecksums)
+{
+    Close();
+    if (mFile.Open(path) == false)
+    {
+        return Fail("can't map " + path.string());
+    }
+
+    const uint8_t* pData = mFile.GetData();
+    uint64_t fileSize = mFile.GetSize();
+    if (fileSize < sizeof(SceneCacheHeader))
+    {
+        return Fail("truncated header");
+    }
+
+    SceneCacheHeader header;
+    memcpy(&header, pData, sizeof(header));
+    if (memcmp(header.magic, kSceneCacheMagic, sizeof(header.magic)) != 0)
+    {
+        return Fail("not a scene cache");
+    }
+    if (header.version != kSceneCacheVersion)
+    {
+        return Fail("version " + std::to_string(header.version) + ", expected " + std::to_string(kSceneCacheVersion));
+    }
+    if (header.fileSize != fileSize)
+    {
+        return Fail("file size doesn't match the header");
+    }
+    if (header.sourceKey != sourceKey)
+    {
+        return Fail("built from another source");
+    }
+    if (header.sectionCount > (fileSize - sizeof(SceneCacheHeader)) / sizeof(SceneCacheSectionEntry))
+    {
+        return Fail("truncated section table");
+    }
+
+    mSections.resize(header.sectionCount);
+    memcpy(mSections.data(), pData + sizeof(SceneCacheHeader), sizeof(SceneCacheSectionEntry) * mSections.size());
+    if (ComputeHeaderChecksum(header, mSections.data()) != header.headerChecksum)
+    {
+        return Fail("header checksum mismatch");
+    }
+
+    for (const SceneCacheSectionEntry& section : mSections)
+    {
+        // Written so that a corrupted offset or size can't overflow
+        if (section.offset % kSceneCacheAlignment != 0 || section.offset > fileSize || section.size > fileSize - section.offset)
+        {
+            return Fail("section " + std::to_string(section.type) + " is out of bounds");
+        }
+        if (section.elementSize == 0 || section.size % section.elementSize != 0)
+        {
+            return Fail("section " + std::to_string(section.type) + " isn't a whole number of elements");
+        }
+        if (verifyChecksums && ComputeChecksum(pData + section.offset, static_cast<size_t>(section.size)) != section.checksum)
+        {
+            return Fail("section " + std::to_string(section.type) + " checksum mismatch");
+        }
+    }
+    return true;
+}
+
+void CppDirectXRayTracing21::SceneCacheReader::Close()
+{
+    mSections.clear();
+    mFile.Close();
+    mError.clear();
+}
+
+const CppDirectXRayTracing21::SceneCacheSectionEntry* CppDirectXRayTracing21::SceneCacheReader::FindSection(SceneCacheSection type) const
+{
+    for (const SceneCacheSectionEntry& section : mSections)
+    {
+        if (section.type == static_cast<uint32_t>(type))
+        {
+            return &section;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+#include "../Primitives/MeshView.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	// Binary scene container. A header and a section table are followed by the sections, each one starting on a page
+	// boundary so it can be handed to the upload staging straight from the mapped file, without any parsing.
+	// Every section carries a checksum, the header carries one over itself and the section table.
+	//
+	//   SceneCacheHeader | SceneCacheSectionEntry[sectionCount] | padding | section 0 | padding | section 1 ...
+	enum class SceneCacheSection : uint32_t
+	{
+		Meshes,         // SceneCacheMesh
+		Positions,      // glm::vec3, all meshes back to back
+		Attributes,     // Primitives::PackedVertexAttributes, same order as the positions
+		Indices,        // 16 or 32-bit indices, each mesh padded to a multiple of 4 bytes
+		BvhNodes,       // Reserved for serialized bottom-level AS, they are driver specific and not written yet
+		Instances,      // SceneCacheInstance
+		Materials       // PrimitiveCB
+	};
+
+	static const char kSceneCacheMagic[8] = { 'D', 'X', 'R', 'S', 'C', 'E', 'N', 'E' };
+	static const uint32_t kSceneCacheVersion = 1;
+	static const uint64_t kSceneCacheAlignment = 4096;
+
+	struct SceneCacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t sectionCount;
+		uint64_t fileSize;
+		uint64_t sourceKey;      // Identifies what the cache was built from, a mismatch means it's stale
+		uint64_t headerChecksum; // Covers the header, with this field zeroed, and the section table
+		uint64_t reserved;
+	};
+
+	struct SceneCacheSectionEntry
+	{
+		uint32_t type;
+		uint32_t elementSize;
+		uint64_t offset;
+		uint64_t size;
+		uint64_t checksum;
+	};
+
+	struct SceneCacheMesh
+	{
+		uint64_t indexOffset;    // In bytes, into the Indices section
+		uint32_t firstVertex;    // Into the Positions and Attributes sections
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexFormat;    // Primitives::IndexFormat
+	};
+
+	struct SceneCacheInstance
+	{
+		float transform[3][4];   // Row-major 3x4, the layout of D3D12_RAYTRACING_INSTANCE_DESC::Transform
+		uint32_t mesh;
+		uint32_t material;
+	};
+
+	// 64-bit checksum, four independent multiply-rotate lanes over 8 byte words. Not cryptographic.
+	uint64_t ComputeChecksum(const void* pData, size_t size);
+
+	// Collects the sections in memory, Write() lays them out and stores the file.
+	class SceneCacheWriter
+	{
+	public:
+		SceneCacheWriter() = default;
+		~SceneCacheWriter() = default;
+
+		// The data is copied. elementSize is what readers check the section against, 1 for untyped bytes.
+		void AddSection(SceneCacheSection type, const void* pData, uint64_t size, uint32_t elementSize);
+
+		template<typename T>
+		void AddSection(SceneCacheSection type, const std::vector<T>& elements)
+		{
+			AddSection(type, elements.data(), elements.size() * sizeof(T), sizeof(T));
+		}
+
+		// Written to a temporary file and renamed into place, readers never see a partial cache.
+		bool Write(const std::filesystem::path& path, uint64_t sourceKey) const;
+
+	private:
+		struct Section
+		{
+			SceneCacheSection type;
+			uint32_t elementSize;
+			std::vector<uint8_t> data;
+		};
+
+		std::vector<Section> mSections;
+	};
+
+	// Maps a cache and validates its structure. The section views point into the mapping and stay valid until Close().
+	class SceneCacheReader
+	{
+	public:
+		SceneCacheReader() = default;
+		~SceneCacheReader() = default;
+
+		// Fails if the file is missing, truncated, from another version or built from another source.
+		// The section checksums read every page of the file, they can be skipped when the file is trusted.
+		bool Open(const std::filesystem::path& path, uint64_t sourceKey, bool verifyChecksums = true);
+		void Close();
+
+		bool IsOpen() const { return mFile.GetData() != nullptr; }
+		const std::string& GetError() const { return mError; }
+
+		// nullptr if the section is missing
+		const SceneCacheSectionEntry* FindSection(SceneCacheSection type) const;
+		const uint8_t* GetSectionData(const SceneCacheSectionEntry& section) const { return mFile.GetData() + section.offset; }
+
+		// Empty if the section is missing or its elements aren't T sized
+		template<typename T>
+		Primitives::ArrayView<T> GetArray(SceneCacheSection type) const
+		{
+			const SceneCacheSectionEntry* pSection = FindSection(type);
+			if (pSection == nullptr || pSection->elementSize != sizeof(T))
+			{
+				return Primitives::ArrayView<T>();
+			}
+			return Primitives::ArrayView<T>(reinterpret_cast<const T*>(GetSectionData(*pSection)), static_cast<size_t>(pSection->size / sizeof(T)));
+		}
+
+	private:
+		bool Fail(const std::string& error);
+
+		MappedFile mFile;
+		std::vector<SceneCacheSectionEntry> mSections;
+		std::string mError;
+	};
+};
@@ -0,0 +1,358 @@
+#pragma once
+#include "ShaderCache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Bumped whenever the key or the entry format changes
+    const char* kCacheFormatVersion = "dxil-cache-1";
+    const char* kEntryExtension = ".dxil";
+
+    // Two FNV-1a streams with different offset bases give a 128-bit key
+    struct Hash128
+    {
+        uint64_t h0 = 14695981039346656037ull;
+        uint64_t h1 = 0x6c62272e07bb0142ull;
+
+        void Add(const void* pData, size_t size)
+        {
+            const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+            for (size_t i = 0; i < size; i++)
+            {
+                h0 = (h0 ^ pBytes[i]) * 1099511628211ull;
+                h1 = (h1 ^ pBytes[i]) * 1099511628211ull;
+                h1 ^= h1 >> 29;
+            }
+        }
+
+        void Add(const std::string& s)
+        {
+            uint64_t size = s.size();
+            Add(&size, sizeof(size));
+            Add(s.data(), s.size());
+        }
+
+        void Add(const std::wstring& s)
+        {
+            uint64_t size = s.size();
+            Add(&size, sizeof(size));
+            Add(s.data(), s.size() * sizeof(wchar_t));
+        }
+
+        std::string ToString() const
+        {
+            static const char* kHex = "0123456789abcdef";
+            std::string s;
+            for (uint64_t h : { h0, h1 })
+            {
+                for (int shift = 60; shift >= 0; shift -= 4)
+                {
+                    s += kHex[(h >> shift) & 0xF];
+                }
+            }
+            return s;
+        }
+    };
+
+    bool ReadFile(const fs::path& path, std::string& content)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (file.good() == false)
+        {
+            return false;
+        }
+        std::stringstream strStream;
+        strStream << file.rdbuf();
+        content = strStream.str();
+        return true;
+    }
+
+    // Returns the names of the #include "..." and #include <...> directives. Line comments are skipped, and so are the
+    // branches only C++ compiles: the .hlsli shared with the application include standard headers under #ifdef __cplusplus.
+    std::vector<std::string> ParseIncludes(const std::string& source)
+    {
+        // One entry per open conditional, whether its current branch is only seen by C++
+        struct Conditional
+        {
+            bool testsCplusplus;
+            bool cplusplusWhenTrue;
+            bool inElse;
+
+            bool IsCppOnly() const { return testsCplusplus && (cplusplusWhenTrue != inElse); }
+        };
+        std::vector<Conditional> conditionals;
+
+        std::vector<std::string> includes;
+        std::istringstream lines(source);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            size_t pos = line.find_first_not_of(" \t");
+            if (pos == std::string::npos || line[pos] != '#')
+            {
+                continue;
+            }
+            std::istringstream tokens(line.substr(pos + 1));
+            std::string directive, argument;
+            tokens >> directive >> argument;
+
+            if (directive == "ifdef" || directive == "ifndef" || directive == "if")
+            {
+                bool testsCplusplus = argument == "__cplusplus" || argument == "defined(__cplusplus)";
+                conditionals.push_back({ testsCplusplus, directive != "ifndef", false });
+                continue;
+            }
+            if ((directive == "else" || directive == "elif") && conditionals.empty() == false)
+            {
+                conditionals.back().inElse = true;
+                continue;
+            }
+            if (directive == "endif" && conditionals.empty() == false)
+            {
+                conditionals.pop_back();
+                continue;
+            }
+            if (directive.compare(0, 7, "include") != 0 ||
+                std::any_of(conditionals.begin(), conditionals.end(), [](const Conditional& c) { return c.IsCppOnly(); }))
+            {
+                continue;
+            }
+
+            pos = line.find_first_of("\"<", line.find("include", pos) + 7);
+            if (pos == std::string::npos)
+            {
+                continue;
+            }
+            char close = (line[pos] == '"') ? '"' : '>';
+            size_t end = line.find(close, pos + 1);
+            if (end != std::string::npos)
+            {
+                includes.push_back(line.substr(pos + 1, end - pos - 1));
+            }
+        }
+        return includes;
+    }
+
+    // Files that can't be read are listed with an empty content and complete is cleared
+    void CollectIncludesRecursive(const fs::path& file, const fs::path& sourceDir, std::set<fs::path>& visited, std::vector<std::pair<fs::path, std::string>>& files, bool& complete)
+    {
+        fs::path normalized = file.lexically_normal();
+        if (visited.insert(normalized).second == false)
+        {
+            return;
+        }
+        files.push_back({ normalized, std::string() });
+
+        std::string content;
+        if (ReadFile(normalized, content) == false)
+        {
+            complete = false;
+            return;
+        }
+        std::vector<std::string> includes = ParseIncludes(content);
+        files.back().second = std::move(content);
+
+        for (const std::string& include : includes)
+        {
+            // Same search order as the compiler: next to the including file, then next to the main file
+            fs::path candidate = normalized.parent_path() / include;
+            if (fs::exists(candidate) == false)
+            {
+                candidate = sourceDir / include;
+            }
+            CollectIncludesRecursive(candidate, sourceDir, visited, files, complete);
+        }
+    }
+}
+
+const std::string* CppDirectXRayTracing21::ShaderSourceSnapshot::Find(const fs::path& file) const
+{
+    fs::path normalized = file.lexically_normal();
+    for (const auto& entry : files)
+    {
+        if (entry.first == normalized)
+        {
+            return &entry.second;
+        }
+    }
+    return nullptr;
+}
+
+CppDirectXRayTracing21::ShaderCache::ShaderCache(const fs::path& directory, uint64_t maxBytes) : mDirectory(directory), mMaxBytes(maxBytes)
+{
+}
+
+std::vector<fs::path> CppDirectXRayTracing21::ShaderCache::CollectIncludes(const fs::path& sourceFile)
+{
+    ShaderSourceSnapshot source;
+    ReadSource(sourceFile, source);
+    std::vector<fs::path> files;
+    for (const auto& entry : source.files)
+    {
+        files.push_back(entry.first);
+    }
+    return files;
+}
+
+bool CppDirectXRayTracing21::ShaderCache::ReadSource(const fs::path& sourceFile, ShaderSourceSnapshot& source)
+{
+    std::set<fs::path> visited;
+    bool complete = true;
+    source.files.clear();
+    CollectIncludesRecursive(sourceFile, sourceFile.parent_path(), visited, source.files, complete);
+    return complete;
+}
+
+std::string CppDirectXRayTracing21::ShaderCache::ComputeKey(const ShaderSourceSnapshot& source, const std::wstring& target, const ShaderDefines& defines, const std::string& compilerVersion) const
+{
+    Hash128 hash;
+    hash.Add(std::string(kCacheFormatVersion));
+
+    for (const auto& entry : source.files)
+    {
+        hash.Add(entry.first.generic_string());
+        hash.Add(entry.second);
+    }
+
+    hash.Add(target);
+    for (const auto& define : defines)
+    {
+        hash.Add(define.first);
+        hash.Add(define.second);
+    }
+    hash.Add(compilerVersion);
+    return hash.ToString();
+}
+
+fs::path CppDirectXRayTracing21::ShaderCache::GetEntryPath(const std::string& key) const
+{
+    return mDirectory / (key + kEntryExtension);
+}
+
+bool CppDirectXRayTracing21::ShaderCache::Load(const std::string& key, std::vector<uint8_t>& blob)
+{
+    if (key.empty())
+    {
+        return false;
+    }
+
+    fs::path path = GetEntryPath(key);
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (file.good() == false)
+    {
+        return false;
+    }
+
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    blob.resize(static_cast<size_t>(size));
+    if (size > 0 && file.read(reinterpret_cast<char*>(blob.data()), size).good() == false)
+    {
+        return false;
+    }
+    file.close();
+
+    // The modification time is the LRU clock
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+bool CppDirectXRayTracing21::ShaderCache::Store(const std::string& key, const void* pData, size_t size)
+{
+    if (key.empty())
+    {
+        return false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(mDirectory, ec);
+
+    // Write next to the final entry and rename, readers only ever see complete files
+    fs::path finalPath = GetEntryPath(key);
+    fs::path tempPath = mDirectory / (key + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size));
+        if (file.good() == false)
+        {
+            file.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tempPath, finalPath, ec);
+    if (ec)
+    {
+        // Another process may have stored the same entry, the content is identical
+        fs::remove(tempPath, ec);
+        return fs::exists(finalPath);
+    }
+
+    Evict();
+    return true;
+}
+
+uint64_t CppDirectXRayTracing21::ShaderCache::GetSize() const
+{
+    uint64_t size = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(mDirectory, ec), end; ec.value() == 0 && it != end; it.increment(ec))
+    {
+        if (it->path().extension() == kEntryExtension)
+        {
+            size += it->file_size(ec);
+        }
+    }
+    return size;
+}
+
+void CppDirectXRayTracing21::ShaderCache::Evict()
+{
+    struct Entry
+    {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type lastUse;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t totalSize = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(mDirectory, ec), end; ec.value() == 0 && it != end; it.increment(ec))
+    {
+        if (it->path().extension() != kEntryExtension)
+        {
+            continue;
+        }
+        Entry entry = { it->path(), it->file_size(ec), it->last_write_time(ec) };
+        totalSize += entry.size;
+        entries.push_back(entry);
+    }
+
+    if (totalSize <= mMaxBytes)
+    {
+        return;
+    }
+
+    // Oldest first
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+    for (const Entry& entry : entries)
+    {
+        if (totalSize <= mMaxBytes)
+        {
+            break;
+        }
+        if (fs::remove(entry.path, ec))
+        {
+            totalSize -= entry.size;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	using ShaderDefines = std::vector<std::pair<std::wstring, std::wstring>>;
+
+	// The content of a source file and of every file it transitively includes, each read once. The cache key is computed from
+	// these bytes and the compiler is fed the same ones, so a file saved in between can't pair a key with DXIL built from
+	// another version of the source.
+	struct ShaderSourceSnapshot
+	{
+		// The source file first, then the includes depth first. The paths are lexically normalized
+		std::vector<std::pair<std::filesystem::path, std::string>> files;
+
+		// nullptr if the file isn't part of the snapshot
+		const std::string* Find(const std::filesystem::path& file) const;
+	};
+
+	// Content-addressed disk cache for compiled shader libraries.
+	// The key covers the source file, every file it transitively includes, the target, the defines and the compiler version,
+	// so editing any .hlsli invalidates the entry. Blobs are written to a temporary file and renamed into place, a crash
+	// never leaves a truncated entry behind. The least recently used entries are evicted once the cache exceeds its size cap.
+	class ShaderCache
+	{
+	public:
+		ShaderCache(const std::filesystem::path& directory, uint64_t maxBytes = kDefaultMaxBytes);
+		~ShaderCache() = default;
+
+		// Returns false if the source or one of its includes can't be read.
+		static bool ReadSource(const std::filesystem::path& sourceFile, ShaderSourceSnapshot& source);
+
+		std::string ComputeKey(const ShaderSourceSnapshot& source, const std::wstring& target, const ShaderDefines& defines, const std::string& compilerVersion) const;
+
+		bool Load(const std::string& key, std::vector<uint8_t>& blob);
+		bool Store(const std::string& key, const void* pData, size_t size);
+
+		// The source file followed by all the files it includes, depth first, each file only once.
+		static std::vector<std::filesystem::path> CollectIncludes(const std::filesystem::path& sourceFile);
+
+		uint64_t GetSize() const;
+
+		static const uint64_t kDefaultMaxBytes = 64ull * 1024 * 1024;
+
+	private:
+		std::filesystem::path GetEntryPath(const std::string& key) const;
+		void Evict();
+
+		std::filesystem::path mDirectory;
+		uint64_t mMaxBytes;
+	};
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include "ShaderFileWatcher.hpp"
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+CppDirectXRayTracing21::ShaderFileWatcher::ShaderFileWatcher(const fs::path& directory, const std::vector<std::wstring>& extensions)
+    : mDirectory(directory), mExtensions(extensions)
+{
+    mFiles = Scan();
+}
+
+std::map<fs::path, CppDirectXRayTracing21::ShaderFileWatcher::FileState> CppDirectXRayTracing21::ShaderFileWatcher::Scan() const
+{
+    std::map<fs::path, FileState> files;
+    std::error_code ec;
+    for (fs::directory_iterator it(mDirectory, ec), end; ec.value() == 0 && it != end; it.increment(ec))
+    {
+        std::wstring extension = it->path().extension().wstring();
+        if (std::find(mExtensions.begin(), mExtensions.end(), extension) == mExtensions.end())
+        {
+            continue;
+        }
+
+        // A file being written by an editor may briefly fail to stat, it is picked up by the next poll
+        std::error_code fileEc;
+        FileState state = { it->last_write_time(fileEc), it->file_size(fileEc) };
+        if (fileEc.value() == 0)
+        {
+            files[it->path()] = state;
+        }
+    }
+    return files;
+}
+
+std::vector<fs::path> CppDirectXRayTracing21::ShaderFileWatcher::Poll()
+{
+    std::map<fs::path, FileState> files = Scan();
+    std::vector<fs::path> changed;
+
+    for (const auto& file : files)
+    {
+        auto previous = mFiles.find(file.first);
+        if (previous == mFiles.end() || previous->second != file.second)
+        {
+            changed.push_back(file.first);
+        }
+    }
+    for (const auto& file : mFiles)
+    {
+        if (files.count(file.first) == 0)
+        {
+            changed.push_back(file.first);
+        }
+    }
+
+    mFiles = std::move(files);
+    return changed;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	// Detects added, removed and modified shader sources in a directory by comparing the file sizes and
+	// modification times against the previous poll. Polling a handful of files is cheap enough for the render thread.
+	class ShaderFileWatcher
+	{
+	public:
+		ShaderFileWatcher(const std::filesystem::path& directory, const std::vector<std::wstring>& extensions = { L".hlsl", L".hlsli" });
+		~ShaderFileWatcher() = default;
+
+		// Returns the files that changed since the previous call, or since construction for the first call.
+		std::vector<std::filesystem::path> Poll();
+
+	private:
+		struct FileState
+		{
+			std::filesystem::file_time_type lastWrite;
+			uintmax_t size;
+
+			bool operator!=(const FileState& other) const { return lastWrite != other.lastWrite || size != other.size; }
+		};
+
+		std::map<std::filesystem::path, FileState> Scan() const;
+
+		std::filesystem::path mDirectory;
+		std::vector<std::wstring> mExtensions;
+		std::map<std::filesystem::path, FileState> mFiles;
+	};
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include "ShaderPermutations.hpp"
+
+CppDirectXRayTracing21::ShadingMode CppDirectXRayTracing21::SelectShadingMode(bool aoEnabled, bool ggxEnabled)
+{
+    if (aoEnabled)
+    {
+        return ShadingMode::AmbientOcclusion;
+    }
+    return ggxEnabled ? ShadingMode::GgxGI : ShadingMode::LambertGI;
+}
+
+CppDirectXRayTracing21::ShaderDefines CppDirectXRayTracing21::GetShadingModeDefines(ShadingMode mode, bool inlineVisibility)
+{
+    ShaderDefines defines = { { L"SHADING_MODE", std::to_wstring(static_cast<uint32_t>(mode)) } };
+    if (inlineVisibility)
+    {
+        defines.push_back({ L"INLINE_VISIBILITY", L"1" });
+    }
+    return defines;
+}
+
+const wchar_t* CppDirectXRayTracing21::GetLibraryTarget(bool inlineVisibility)
+{
+    return inlineVisibility ? L"lib_6_5" : L"lib_6_3";
+}
+
+const wchar_t* CppDirectXRayTracing21::GetShadingModeName(ShadingMode mode)
+{
+    switch (mode)
+    {
+    case ShadingMode::AmbientOcclusion: return L"AO";
+    case ShadingMode::LambertGI:        return L"Lambert";
+    case ShadingMode::GgxGI:            return L"GGX";
+    default:                            return L"";
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "ShaderCache.hpp"
+
+namespace CppDirectXRayTracing21
+{
+	// The shading of the closest-hit shader is compiled in, one DXIL library per mode.
+	// The values match the SHADING_MODE_* defines of Helpers.hlsli.
+	enum class ShadingMode : uint32_t
+	{
+		AmbientOcclusion = 0, // Lambertian direct lighting with ambient occlusion, no indirect bounce
+		LambertGI = 1,        // Lambertian direct and indirect lighting
+		GgxGI = 2,            // GGX direct and indirect lighting
+		Count
+	};
+
+	static const uint32_t kShadingModeCount = static_cast<uint32_t>(ShadingMode::Count);
+
+	// Maps the keyboard toggles of the framework onto a mode. AO wins over GGX, like the key handling does.
+	ShadingMode SelectShadingMode(bool aoEnabled, bool ggxEnabled);
+
+	// The defines the library of a mode is compiled with. With inline visibility, shadow and AO rays are traced with
+	// RayQuery inside the closest-hit instead of TraceRay() and the shadow miss shader.
+	ShaderDefines GetShadingModeDefines(ShadingMode mode, bool inlineVisibility = false);
+
+	// RayQuery needs shader model 6.5.
+	const wchar_t* GetLibraryTarget(bool inlineVisibility);
+
+	// Short name used to build the export names of the mode, e.g. L"GGX".
+	const wchar_t* GetShadingModeName(ShadingMode mode);
+};
@@ -0,0 +1,157 @@
+#pragma once
+#include "ShaderTableBuilder.hpp"
+#include <cassert>
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+uint32_t CppDirectXRayTracing21::ShaderTableBuilder::AddRecord(ShaderTableSection section, const std::wstring& exportName)
+{
+    std::vector<Record>& records = mRecords[static_cast<uint32_t>(section)];
+    Record record;
+    record.exportName = exportName;
+    records.push_back(record);
+
+    mLayoutDirty = true;
+    return static_cast<uint32_t>(records.size() - 1);
+}
+
+void CppDirectXRayTracing21::ShaderTableBuilder::SetLocalRootArguments(ShaderTableSection section, uint32_t index, const void* pData, uint32_t size)
+{
+    Record& record = mRecords[static_cast<uint32_t>(section)][index];
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    if (record.localRootArguments.size() == size && memcmp(record.localRootArguments.data(), pBytes, size) == 0)
+    {
+        return;
+    }
+
+    record.localRootArguments.assign(pBytes, pBytes + size);
+    record.dirty = true;
+
+    if (kShaderIdentifierSize + size > GetSectionLayout(section).stride)
+    {
+        mLayoutDirty = true;
+    }
+}
+
+void CppDirectXRayTracing21::ShaderTableBuilder::SetExportName(ShaderTableSection section, uint32_t index, const std::wstring& exportName)
+{
+    Record& record = mRecords[static_cast<uint32_t>(section)][index];
+    if (record.exportName != exportName)
+    {
+        record.exportName = exportName;
+        record.dirty = true;
+    }
+}
+
+void CppDirectXRayTracing21::ShaderTableBuilder::MarkAllDirty()
+{
+    for (std::vector<Record>& records : mRecords)
+    {
+        for (Record& record : records)
+        {
+            record.dirty = true;
+        }
+    }
+}
+
+void CppDirectXRayTracing21::ShaderTableBuilder::ComputeLayout()
+{
+    uint64_t offset = 0;
+    for (uint32_t s = 0; s < static_cast<uint32_t>(ShaderTableSection::Count); s++)
+    {
+        // Each section only pays for its own largest record
+        uint32_t largest = 0;
+        for (const Record& record : mRecords[s])
+        {
+            uint32_t size = kShaderIdentifierSize + static_cast<uint32_t>(record.localRootArguments.size());
+            largest = (size > largest) ? size : largest;
+        }
+
+        ShaderTableSectionLayout& layout = mLayouts[s];
+        layout.offset = AlignUp(offset, kShaderTableAlignment);
+        layout.stride = static_cast<uint32_t>(AlignUp(largest, kShaderRecordAlignment));
+        layout.recordCount = static_cast<uint32_t>(mRecords[s].size());
+        offset = layout.offset + layout.GetSize();
+    }
+
+    mTotalSize = offset;
+    mLayoutDirty = false;
+}
+
+uint64_t CppDirectXRayTracing21::ShaderTableBuilder::GetRecordOffset(ShaderTableSection section, uint32_t index) const
+{
+    const ShaderTableSectionLayout& layout = GetSectionLayout(section);
+    return layout.offset + static_cast<uint64_t>(layout.stride) * index;
+}
+
+void CppDirectXRayTracing21::ShaderTableBuilder::WriteTable(uint8_t* pDst, const IdentifierCallback& getIdentifier)
+{
+    assert(mLayoutDirty == false);
+
+    // The padding between records and sections is zeroed so the table content is deterministic
+    memset(pDst, 0, static_cast<size_t>(mTotalSize));
+    for (uint32_t s = 0; s < static_cast<uint32_t>(ShaderTableSection::Count); s++)
+    {
+        ShaderTableSection section = static_cast<ShaderTableSection>(s);
+        for (uint32_t i = 0; i < mRecords[s].size(); i++)
+        {
+            WriteRecord(section, i, pDst + GetRecordOffset(section, i), getIdentifier);
+            mRecords[s][i].dirty = false;
+        }
+    }
+}
+
+void CppDirectXRayTracing21::ShaderTableBuilder::WriteRecord(ShaderTableSection section, uint32_t index, uint8_t* pDst, const IdentifierCallback& getIdentifier) const
+{
+    const Record& record = mRecords[static_cast<uint32_t>(section)][index];
+    uint32_t stride = GetSectionLayout(section).stride;
+
+    memset(pDst, 0, stride);
+    const void* pIdentifier = getIdentifier(record.exportName);
+    if (pIdentifier)
+    {
+        memcpy(pDst, pIdentifier, kShaderIdentifierSize);
+    }
+    if (record.localRootArguments.empty() == false)
+    {
+        memcpy(pDst + kShaderIdentifierSize, record.localRootArguments.data(), record.localRootArguments.size());
+    }
+}
+
+std::vector<CppDirectXRayTracing21::ShaderTableDirtyRange> CppDirectXRayTracing21::ShaderTableBuilder::WriteDirtyRecords(uint8_t* pTable, const IdentifierCallback& getIdentifier)
+{
+    assert(mLayoutDirty == false);
+
+    std::vector<ShaderTableDirtyRange> ranges;
+    for (uint32_t s = 0; s < static_cast<uint32_t>(ShaderTableSection::Count); s++)
+    {
+        ShaderTableSection section = static_cast<ShaderTableSection>(s);
+        uint32_t stride = GetSectionLayout(section).stride;
+        for (uint32_t i = 0; i < mRecords[s].size(); i++)
+        {
+            if (mRecords[s][i].dirty == false)
+            {
+                continue;
+            }
+            mRecords[s][i].dirty = false;
+
+            uint64_t offset = GetRecordOffset(section, i);
+            WriteRecord(section, i, pTable + offset, getIdentifier);
+            if (ranges.empty() == false && ranges.back().offset + ranges.back().size == offset)
+            {
+                ranges.back().size += stride;
+            }
+            else
+            {
+                ranges.push_back({ offset, stride });
+            }
+        }
+    }
+    return ranges;
+}
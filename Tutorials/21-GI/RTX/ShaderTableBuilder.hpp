@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	// Same values as D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT
+	// and D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT, the builder doesn't include d3d12.h.
+	static const uint32_t kShaderIdentifierSize = 32;
+	static const uint32_t kShaderRecordAlignment = 32;
+	static const uint32_t kShaderTableAlignment = 64;
+
+	enum class ShaderTableSection : uint32_t
+	{
+		RayGen,
+		Miss,
+		HitGroup,
+		Count
+	};
+
+	struct ShaderTableSectionLayout
+	{
+		uint64_t offset = 0;     // From the start of the table, aligned to kShaderTableAlignment
+		uint32_t stride = 0;     // Size of the largest record of the section, aligned to kShaderRecordAlignment
+		uint32_t recordCount = 0;
+
+		uint64_t GetSize() const { return static_cast<uint64_t>(stride) * recordCount; }
+	};
+
+	struct ShaderTableDirtyRange
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// Describes the shader table as records made of an export name and the raw local root arguments.
+	// Each section is sized to its own largest record. The layout and the record contents are computed on the CPU,
+	// the shader identifiers are provided by the caller when the records are written.
+	class ShaderTableBuilder
+	{
+	public:
+		using IdentifierCallback = std::function<const void*(const std::wstring& exportName)>;
+
+		ShaderTableBuilder() = default;
+		~ShaderTableBuilder() = default;
+
+		// Returns the index of the record inside its section. The index is the one used by TraceRay() for miss
+		// shaders and by InstanceContributionToHitGroupIndex for hit groups.
+		uint32_t AddRecord(ShaderTableSection section, const std::wstring& exportName);
+
+		template<typename T>
+		uint32_t AddRecord(ShaderTableSection section, const std::wstring& exportName, const T& localRootArguments)
+		{
+			uint32_t index = AddRecord(section, exportName);
+			SetLocalRootArguments(section, index, localRootArguments);
+			return index;
+		}
+
+		// Only marks the record dirty when the arguments changed. Growing a record past its section stride invalidates the layout.
+		template<typename T>
+		void SetLocalRootArguments(ShaderTableSection section, uint32_t index, const T& localRootArguments)
+		{
+			SetLocalRootArguments(section, index, &localRootArguments, sizeof(T));
+		}
+		void SetLocalRootArguments(ShaderTableSection section, uint32_t index, const void* pData, uint32_t size);
+
+		// Points the record at another shader, e.g. a different hit group. Only marks the record dirty when the name changed.
+		void SetExportName(ShaderTableSection section, uint32_t index, const std::wstring& exportName);
+
+		// Marks every record dirty, e.g. when the shader identifiers changed with a new pipeline.
+		void MarkAllDirty();
+
+		// Computes the section offsets and strides. Must be called again after the layout was invalidated.
+		void ComputeLayout();
+		bool IsLayoutDirty() const { return mLayoutDirty; }
+
+		const ShaderTableSectionLayout& GetSectionLayout(ShaderTableSection section) const { return mLayouts[static_cast<uint32_t>(section)]; }
+		uint64_t GetTotalSize() const { return mTotalSize; }
+		uint64_t GetRecordOffset(ShaderTableSection section, uint32_t index) const;
+
+		// Writes the whole table into pDst (GetTotalSize() bytes) and clears the dirty flags.
+		void WriteTable(uint8_t* pDst, const IdentifierCallback& getIdentifier);
+
+		// Writes a single record into pDst (the section stride bytes).
+		void WriteRecord(ShaderTableSection section, uint32_t index, uint8_t* pDst, const IdentifierCallback& getIdentifier) const;
+
+		// Writes the records changed since the last write into pTable, a CPU copy of the whole table, and returns
+		// their byte ranges. Adjacent records are merged into one range.
+		std::vector<ShaderTableDirtyRange> WriteDirtyRecords(uint8_t* pTable, const IdentifierCallback& getIdentifier);
+
+	private:
+		struct Record
+		{
+			std::wstring exportName;
+			std::vector<uint8_t> localRootArguments;
+			bool dirty = true;
+		};
+
+		std::vector<Record> mRecords[static_cast<uint32_t>(ShaderTableSection::Count)];
+		ShaderTableSectionLayout mLayouts[static_cast<uint32_t>(ShaderTableSection::Count)];
+		uint64_t mTotalSize = 0;
+		bool mLayoutDirty = true;
+	};
+};
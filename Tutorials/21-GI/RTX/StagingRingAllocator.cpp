@@ -0,0 +1,87 @@
+#pragma once
+#include "StagingRingAllocator.hpp"
+#include <cassert>
+
+CppDirectXRayTracing21::StagingRingAllocator::StagingRingAllocator(uint64_t capacity) : mCapacity(capacity)
+{
+}
+
+bool CppDirectXRayTracing21::StagingRingAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    if (size > mCapacity)
+    {
+        return false;
+    }
+
+    // Restart from the beginning whenever the ring drained, it keeps large uploads from wrapping needlessly
+    if (mUsedBytes == 0)
+    {
+        mHead = 0;
+        mTail = 0;
+    }
+    else if (mHead == mTail)
+    {
+        return false; // Full
+    }
+
+    uint64_t aligned = (mHead + alignment - 1) & ~(alignment - 1);
+    uint64_t consumed = 0;
+    if (mHead >= mTail)
+    {
+        // Used space is [tail, head), try the end of the buffer first and then wrap around to [0, tail)
+        if (aligned + size <= mCapacity)
+        {
+            consumed = aligned - mHead + size;
+        }
+        else if (size <= mTail)
+        {
+            consumed = (mCapacity - mHead) + size;
+            aligned = 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // Used space wraps, the only free range is [head, tail)
+        if (aligned + size > mTail)
+        {
+            return false;
+        }
+        consumed = aligned - mHead + size;
+    }
+
+    mHead = aligned + size;
+    mUsedBytes += consumed;
+    mPendingBytes += consumed;
+    offset = aligned;
+    return true;
+}
+
+void CppDirectXRayTracing21::StagingRingAllocator::FinishBatch(uint64_t fenceValue)
+{
+    if (mPendingBytes == 0)
+    {
+        return;
+    }
+
+    Batch batch;
+    batch.fenceValue = fenceValue;
+    batch.bytes = mPendingBytes;
+    batch.end = mHead;
+    mBatches.push_back(batch);
+    mPendingBytes = 0;
+}
+
+void CppDirectXRayTracing21::StagingRingAllocator::Retire(uint64_t completedFenceValue)
+{
+    while (mBatches.empty() == false && mBatches.front().fenceValue <= completedFenceValue)
+    {
+        mUsedBytes -= mBatches.front().bytes;
+        mTail = mBatches.front().end;
+        mBatches.pop_front();
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+
+namespace CppDirectXRayTracing21
+{
+	// Wrap-around ring for staging memory. Allocations are grouped into batches, each batch is tagged
+	// with the fence value of the submission that reads it and retired once that fence completed.
+	class StagingRingAllocator
+	{
+	public:
+		explicit StagingRingAllocator(uint64_t capacity);
+		~StagingRingAllocator() = default;
+
+		// Returns false if there is not enough free space until older batches are retired.
+		bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+
+		// Closes the current batch. Everything allocated since the previous call is released by Retire(fenceValue).
+		void FinishBatch(uint64_t fenceValue);
+		void Retire(uint64_t completedFenceValue);
+
+		bool HasPendingAllocations() const { return mPendingBytes > 0; }
+		uint64_t GetCapacity() const { return mCapacity; }
+		uint64_t GetUsedBytes() const { return mUsedBytes; }
+
+	private:
+		struct Batch
+		{
+			uint64_t fenceValue;
+			uint64_t bytes;
+			uint64_t end;
+		};
+
+		uint64_t mCapacity;
+		uint64_t mHead = 0;
+		uint64_t mTail = 0;
+		uint64_t mUsedBytes = 0;
+		uint64_t mPendingBytes = 0;
+		std::deque<Batch> mBatches;
+	};
+};
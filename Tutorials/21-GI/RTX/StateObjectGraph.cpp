@@ -0,0 +1,183 @@
+#pragma once
+#include "StateObjectGraph.hpp"
+#include <map>
+#include <set>
+
+namespace
+{
+    std::string toString(const std::wstring& s)
+    {
+        // Export names are plain identifiers, narrowing is enough for the error messages
+        return std::string(s.begin(), s.end());
+    }
+}
+
+void CppDirectXRayTracing21::StateObjectGraph::AddLibrary(uint32_t resource, const std::vector<LibraryExport>& exports)
+{
+    mLibraries.push_back({ resource, exports });
+}
+
+void CppDirectXRayTracing21::StateObjectGraph::AddHitGroup(const std::wstring& name, const std::wstring& closestHit, const std::wstring& anyHit, const std::wstring& intersection)
+{
+    mHitGroups.push_back({ name, closestHit, anyHit, intersection });
+}
+
+void CppDirectXRayTracing21::StateObjectGraph::AddLocalRootSignature(uint32_t resource, const std::vector<std::wstring>& exports)
+{
+    mLocalRootSignatures.push_back({ resource, exports });
+}
+
+void CppDirectXRayTracing21::StateObjectGraph::AddShaderConfig(uint32_t maxAttributeSizeInBytes, uint32_t maxPayloadSizeInBytes, const std::vector<std::wstring>& exports)
+{
+    mShaderConfigs.push_back({ maxAttributeSizeInBytes, maxPayloadSizeInBytes, exports });
+}
+
+void CppDirectXRayTracing21::StateObjectGraph::AddCollection(uint32_t resource, const std::vector<std::wstring>& exports)
+{
+    mCollections.push_back({ resource, exports });
+}
+
+void CppDirectXRayTracing21::StateObjectGraph::SetGlobalRootSignature(uint32_t resource)
+{
+    mHasGlobalRootSignature = true;
+    mGlobalRootSignature = resource;
+}
+
+void CppDirectXRayTracing21::StateObjectGraph::SetPipelineConfig(uint32_t maxTraceRecursionDepth)
+{
+    mHasPipelineConfig = true;
+    mMaxTraceRecursionDepth = maxTraceRecursionDepth;
+}
+
+std::vector<std::wstring> CppDirectXRayTracing21::StateObjectGraph::GetExports() const
+{
+    std::vector<std::wstring> exports;
+    for (const Library& library : mLibraries)
+    {
+        for (const LibraryExport& libraryExport : library.exports)
+        {
+            exports.push_back(libraryExport.name);
+        }
+    }
+    for (const HitGroup& hitGroup : mHitGroups)
+    {
+        exports.push_back(hitGroup.name);
+    }
+    for (const Collection& collection : mCollections)
+    {
+        exports.insert(exports.end(), collection.exports.begin(), collection.exports.end());
+    }
+    return exports;
+}
+
+bool CppDirectXRayTracing21::StateObjectGraph::Validate(std::vector<std::string>& errors) const
+{
+    errors.clear();
+
+    // Shaders defined by this graph, they need their own configuration
+    std::set<std::wstring> shaders;
+    std::set<std::wstring> exports;
+    for (const Library& library : mLibraries)
+    {
+        for (const LibraryExport& libraryExport : library.exports)
+        {
+            shaders.insert(libraryExport.name);
+        }
+    }
+    for (const std::wstring& name : GetExports())
+    {
+        if (exports.insert(name).second == false)
+        {
+            errors.push_back("Export " + toString(name) + " is defined more than once");
+        }
+    }
+
+    // Hit groups may import the shaders of a collection, but not other hit groups
+    std::set<std::wstring> hitGroups;
+    for (const HitGroup& hitGroup : mHitGroups)
+    {
+        hitGroups.insert(hitGroup.name);
+    }
+    for (const HitGroup& hitGroup : mHitGroups)
+    {
+        if (hitGroup.closestHit.empty() && hitGroup.anyHit.empty() && hitGroup.intersection.empty())
+        {
+            errors.push_back("Hit group " + toString(hitGroup.name) + " has no shader");
+        }
+        for (const std::wstring* pImport : { &hitGroup.closestHit, &hitGroup.anyHit, &hitGroup.intersection })
+        {
+            if (pImport->empty() == false && (exports.count(*pImport) == 0 || hitGroups.count(*pImport) != 0))
+            {
+                errors.push_back("Hit group " + toString(hitGroup.name) + " imports unknown shader " + toString(*pImport));
+            }
+        }
+    }
+
+    std::map<std::wstring, uint32_t> localRootSignatureCount;
+    for (const LocalRootSignature& rootSignature : mLocalRootSignatures)
+    {
+        for (const std::wstring& name : rootSignature.exports)
+        {
+            if (exports.count(name) == 0)
+            {
+                errors.push_back("Local root signature associated with unknown export " + toString(name));
+            }
+            if (++localRootSignatureCount[name] == 2)
+            {
+                errors.push_back("Export " + toString(name) + " has more than one local root signature");
+            }
+        }
+    }
+
+    std::map<std::wstring, uint32_t> shaderConfigCount;
+    for (const ShaderConfig& config : mShaderConfigs)
+    {
+        if (config.maxAttributeSizeInBytes > kMaxAttributeSizeInBytes)
+        {
+            errors.push_back("Shader config attributes are larger than " + std::to_string(kMaxAttributeSizeInBytes) + " bytes");
+        }
+        for (const std::wstring& name : config.exports)
+        {
+            if (exports.count(name) == 0)
+            {
+                errors.push_back("Shader config associated with unknown export " + toString(name));
+            }
+            shaderConfigCount[name]++;
+        }
+    }
+    for (const std::wstring& name : shaders)
+    {
+        if (shaderConfigCount[name] != 1)
+        {
+            errors.push_back("Shader " + toString(name) + " needs exactly one shader config");
+        }
+    }
+
+    if (mHasPipelineConfig && mMaxTraceRecursionDepth > kMaxDeclarableRecursionDepth)
+    {
+        errors.push_back("Max trace recursion depth is larger than " + std::to_string(kMaxDeclarableRecursionDepth));
+    }
+
+    // The collections carry their own pipeline config, a pipeline made only of collections doesn't need one
+    if (mType == StateObjectGraphType::RaytracingPipeline && mHasPipelineConfig == false && mLibraries.empty() == false)
+    {
+        errors.push_back("A ray-tracing pipeline needs a pipeline config");
+    }
+    if (mType == StateObjectGraphType::Collection && mCollections.empty() == false)
+    {
+        errors.push_back("A collection can't contain another collection");
+    }
+
+    return errors.empty();
+}
+
+uint32_t CppDirectXRayTracing21::StateObjectGraph::GetSubobjectCount() const
+{
+    // Root signatures and shader configs are followed by their export association
+    uint32_t count = static_cast<uint32_t>(mLibraries.size() + mHitGroups.size() + mCollections.size());
+    count += static_cast<uint32_t>(mLocalRootSignatures.size() + mShaderConfigs.size()) * 2;
+    count += mHasGlobalRootSignature ? 1 : 0;
+    count += mHasPipelineConfig ? 1 : 0;
+    count += mAllowAdditions ? 1 : 0;
+    return count;
+}
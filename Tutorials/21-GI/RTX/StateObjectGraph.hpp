@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	// Same values as D3D12_RAYTRACING_MAX_DECLARABLE_TRACE_RECURSION_DEPTH and D3D12_RAYTRACING_MAX_ATTRIBUTE_SIZE_IN_BYTES,
+	// the graph doesn't include d3d12.h.
+	static const uint32_t kMaxDeclarableRecursionDepth = 31;
+	static const uint32_t kMaxAttributeSizeInBytes = 32;
+
+	enum class StateObjectGraphType
+	{
+		Collection,
+		RaytracingPipeline
+	};
+
+	struct LibraryExport
+	{
+		std::wstring name;
+		std::wstring exportToRename; // Name of the shader inside the library, empty when it keeps its name
+	};
+
+	// The subobjects of a state object and the exports they are associated with.
+	// Libraries, root signatures and collections are referenced by an index into the caller's own resource arrays,
+	// so the graph can be assembled and validated without a device.
+	class StateObjectGraph
+	{
+	public:
+		struct Library
+		{
+			uint32_t resource;
+			std::vector<LibraryExport> exports;
+		};
+
+		struct HitGroup
+		{
+			std::wstring name;
+			std::wstring closestHit;
+			std::wstring anyHit;
+			std::wstring intersection;  // Procedural primitive hit group when set, triangle hit group otherwise
+		};
+
+		struct LocalRootSignature
+		{
+			uint32_t resource;
+			std::vector<std::wstring> exports;
+		};
+
+		struct ShaderConfig
+		{
+			uint32_t maxAttributeSizeInBytes;
+			uint32_t maxPayloadSizeInBytes;
+			std::vector<std::wstring> exports;
+		};
+
+		// An existing collection and the shaders and hit groups it exports
+		struct Collection
+		{
+			uint32_t resource;
+			std::vector<std::wstring> exports;
+		};
+
+		explicit StateObjectGraph(StateObjectGraphType type) : mType(type) {}
+		~StateObjectGraph() = default;
+
+		void AddLibrary(uint32_t resource, const std::vector<LibraryExport>& exports);
+		void AddHitGroup(const std::wstring& name, const std::wstring& closestHit, const std::wstring& anyHit = std::wstring(), const std::wstring& intersection = std::wstring());
+		void AddLocalRootSignature(uint32_t resource, const std::vector<std::wstring>& exports);
+		void AddShaderConfig(uint32_t maxAttributeSizeInBytes, uint32_t maxPayloadSizeInBytes, const std::vector<std::wstring>& exports);
+		void AddCollection(uint32_t resource, const std::vector<std::wstring>& exports);
+		void SetGlobalRootSignature(uint32_t resource);
+		void SetPipelineConfig(uint32_t maxTraceRecursionDepth);
+
+		// Lets AddToStateObject() grow the state object later.
+		void SetAllowStateObjectAdditions(bool allow) { mAllowAdditions = allow; }
+
+		// Every shader and hit group name the state object exports, its own and the ones of its collections.
+		std::vector<std::wstring> GetExports() const;
+
+		// Checks the graph against the rules of CreateStateObject() that don't need the DXIL: unique export names,
+		// hit groups importing existing shaders, associations naming existing exports, one shader config and at most
+		// one local root signature per shader, and the pipeline config limits. Returns false and the problems otherwise.
+		bool Validate(std::vector<std::string>& errors) const;
+
+		// The number of D3D12_STATE_SUBOBJECTs the graph translates into, associations included.
+		uint32_t GetSubobjectCount() const;
+
+		StateObjectGraphType GetType() const { return mType; }
+		const std::vector<Library>& GetLibraries() const { return mLibraries; }
+		const std::vector<HitGroup>& GetHitGroups() const { return mHitGroups; }
+		const std::vector<LocalRootSignature>& GetLocalRootSignatures() const { return mLocalRootSignatures; }
+		const std::vector<ShaderConfig>& GetShaderConfigs() const { return mShaderConfigs; }
+		const std::vector<Collection>& GetCollections() const { return mCollections; }
+		bool HasGlobalRootSignature() const { return mHasGlobalRootSignature; }
+		uint32_t GetGlobalRootSignature() const { return mGlobalRootSignature; }
+		bool HasPipelineConfig() const { return mHasPipelineConfig; }
+		uint32_t GetMaxTraceRecursionDepth() const { return mMaxTraceRecursionDepth; }
+		bool GetAllowStateObjectAdditions() const { return mAllowAdditions; }
+
+	private:
+		StateObjectGraphType mType;
+		std::vector<Library> mLibraries;
+		std::vector<HitGroup> mHitGroups;
+		std::vector<LocalRootSignature> mLocalRootSignatures;
+		std::vector<ShaderConfig> mShaderConfigs;
+		std::vector<Collection> mCollections;
+		bool mHasGlobalRootSignature = false;
+		uint32_t mGlobalRootSignature = 0;
+		bool mHasPipelineConfig = false;
+		uint32_t mMaxTraceRecursionDepth = 0;
+		bool mAllowAdditions = false;
+	};
+};
@@ -5,7 +5,11 @@ namespace CppDirectXRayTracing21
 {
     struct DxilLibrary
     {
-        DxilLibrary(ID3DBlobPtr pBlob, const WCHAR* entryPoint[], uint32_t entryPointCount) : pShaderBlob(pBlob)
+        DxilLibrary(ID3DBlobPtr pBlob, const WCHAR* entryPoint[], uint32_t entryPointCount) : DxilLibrary(pBlob, entryPoint, nullptr, entryPointCount) {}
+
+        // exportToRename[i] is the name of the shader inside the library, exported as entryPoint[i].
+        // Lets several permutations of the same shader live in one state object.
+        DxilLibrary(ID3DBlobPtr pBlob, const WCHAR* entryPoint[], const WCHAR* exportToRename[], uint32_t entryPointCount) : pShaderBlob(pBlob)
         {
             stateSubobject.Type = D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY;
             stateSubobject.pDesc = &dxilLibDesc;
@@ -13,6 +17,7 @@ namespace CppDirectXRayTracing21
             dxilLibDesc = {};
             exportDesc.resize(entryPointCount);
             exportName.resize(entryPointCount);
+            renamedName.resize(entryPointCount);
             if (pBlob)
             {
                 dxilLibDesc.DXILLibrary.pShaderBytecode = pBlob->GetBufferPointer();
@@ -26,6 +31,11 @@ namespace CppDirectXRayTracing21
                     exportDesc[i].Name = exportName[i].c_str();
                     exportDesc[i].Flags = D3D12_EXPORT_FLAG_NONE;
                     exportDesc[i].ExportToRename = nullptr;
+                    if (exportToRename && exportToRename[i])
+                    {
+                        renamedName[i] = exportToRename[i];
+                        exportDesc[i].ExportToRename = renamedName[i].c_str();
+                    }
                 }
             }
         };
@@ -37,5 +47,6 @@ namespace CppDirectXRayTracing21
         ID3DBlobPtr pShaderBlob;
         std::vector<D3D12_EXPORT_DESC> exportDesc;
         std::vector<std::wstring> exportName;
+        std::vector<std::wstring> renamedName;
     };
 }
\ No newline at end of file
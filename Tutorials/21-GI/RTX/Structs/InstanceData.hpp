@@ -0,0 +1,20 @@
+#pragma once
+#include "Framework.h"
+
+namespace CppDirectXRayTracing21
+{
+    // One entry per TLAS instance, the hit shader reads it with InstanceID().
+    // Must match the InstanceData layout in Helpers.hlsli.
+    struct InstanceData
+    {
+        // Indices into the bindless vertex/index buffer arrays
+        uint32_t vertexBufferIndex;
+        uint32_t indexBufferIndex;
+
+        // Index into the material buffer
+        uint32_t materialIndex;
+
+        // Size of an index in bytes, 2 or 4
+        uint32_t indexStride;
+    };
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include "Framework.h"
+
+namespace CppDirectXRayTracing21
+{
+    // Local root arguments of the shader records, in the order of the local root signature parameters.
+
+    // createRayGenRootDesc()
+    struct RayGenRootArguments
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE table; // gOutput, gRtScene
+    };
+
+    // createHitRootDesc()
+    struct HitRootArguments
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE sceneTable;    // gRtScene, gInstances, gMaterials
+        D3D12_GPU_DESCRIPTOR_HANDLE indexBuffers;  // gIndexBuffers[]
+        D3D12_GPU_DESCRIPTOR_HANDLE vertexBuffers; // gVertexBuffers[]
+    };
+};
@@ -3,12 +3,13 @@
 
 namespace CppDirectXRayTracing21
 {
-    // The constant buffer defined for each instance.
+    // The material of an instance. All materials live in one structured buffer indexed by InstanceData::materialIndex,
+    // the layout must match the Material struct in Helpers.hlsli.
     struct PrimitiveCB
     {
         glm::vec3 matDiffuse;
         float matRoughness;
         glm::vec3 matSpecular;
-        
+        float padding; // Keeps the stride at 32 bytes
     };
 };
\ No newline at end of file
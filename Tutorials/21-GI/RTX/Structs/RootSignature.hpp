@@ -49,6 +49,14 @@ namespace CppDirectXRayTracing21
             subobject.pDesc = &pInterface;
             subobject.Type = D3D12_STATE_SUBOBJECT_TYPE_GLOBAL_ROOT_SIGNATURE;
         }
+
+        // Wraps a root signature created earlier, e.g. one shared by several pipelines
+        explicit GlobalRootSignature(ID3D12RootSignaturePtr pExisting) : pRootSig(pExisting)
+        {
+            pInterface = pRootSig.GetInterfacePtr();
+            subobject.pDesc = &pInterface;
+            subobject.Type = D3D12_STATE_SUBOBJECT_TYPE_GLOBAL_ROOT_SIGNATURE;
+        }
         ID3D12RootSignaturePtr pRootSig;
         ID3D12RootSignature* pInterface = nullptr;
         D3D12_STATE_SUBOBJECT subobject = {};
@@ -0,0 +1,53 @@
+#pragma once
+#include "ThreadPool.hpp"
+
+CppDirectXRayTracing21::ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    threadCount = (threadCount > 0) ? threadCount : 1;
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        mWorkers.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+CppDirectXRayTracing21::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void CppDirectXRayTracing21::ThreadPool::Enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back(std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void CppDirectXRayTracing21::ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStopping || mTasks.empty() == false; });
+            if (mTasks.empty())
+            {
+                // Only reached when stopping, the queue is drained first
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
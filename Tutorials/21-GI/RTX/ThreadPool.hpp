@@ -0,0 +1,76 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	// Fixed set of worker threads running tasks in submission order.
+	// The destructor finishes the queued tasks before joining the workers.
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(uint32_t threadCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// The returned future holds the result, or the exception the task threw.
+		template<typename F>
+		std::future<std::invoke_result_t<F>> Submit(F&& task)
+		{
+			using Result = std::invoke_result_t<F>;
+			auto pTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+			std::future<Result> future = pTask->get_future();
+			Enqueue([pTask]() { (*pTask)(); });
+			return future;
+		}
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(mWorkers.size()); }
+
+	private:
+		void Enqueue(std::function<void()> task);
+		void WorkerLoop();
+
+		std::vector<std::thread> mWorkers;
+		std::deque<std::function<void()>> mTasks;
+		std::mutex mMutex;
+		std::condition_variable mCondition;
+		bool mStopping = false;
+	};
+
+	// Splits [0, count) into a few chunks per worker and waits for them, or runs it inline without a pool.
+	// f(begin, end) must not submit to the same pool and wait, all the workers may be blocked in here.
+	template<typename Count, typename F>
+	void ParallelFor(ThreadPool* pPool, Count count, F&& f)
+	{
+		uint32_t threadCount = pPool ? pPool->GetThreadCount() : 1;
+		if (threadCount <= 1 || count < 2)
+		{
+			f(Count(0), count);
+			return;
+		}
+
+		// A few chunks per worker evens out the chunks of different cost
+		Count chunkSize = std::max(Count(1), static_cast<Count>(count / static_cast<Count>(threadCount * 4)));
+		std::vector<std::future<void>> chunks;
+		for (Count begin = 0; begin < count; begin += chunkSize)
+		{
+			Count end = std::min(count, static_cast<Count>(begin + chunkSize));
+			chunks.push_back(pPool->Submit([&f, begin, end]() { f(begin, end); }));
+		}
+		for (std::future<void>& chunk : chunks)
+		{
+			chunk.get();
+		}
+	}
+};
@@ -0,0 +1,315 @@
+#pragma once
+#include "TlsfAllocator.hpp"
+#include <algorithm>
+#include <cassert>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    uint32_t FindLowestBit(uint64_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(mask));
+#endif
+    }
+
+    uint32_t FindHighestBit(uint64_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, mask);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(63 - __builtin_clzll(mask));
+#endif
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+CppDirectXRayTracing21::TlsfAllocator::TlsfAllocator(uint64_t capacity) : mCapacity(capacity)
+{
+    for (uint32_t fl = 0; fl < kFirstLevelCount; fl++)
+    {
+        for (uint32_t sl = 0; sl < kSecondLevelCount; sl++)
+        {
+            mFreeHeads[fl][sl] = kInvalidBlock;
+        }
+    }
+
+    // The whole range starts as a single free block
+    if (capacity > 0)
+    {
+        uint32_t block = NewBlock();
+        mBlocks[block].offset = 0;
+        mBlocks[block].size = capacity;
+        InsertFree(block);
+    }
+}
+
+void CppDirectXRayTracing21::TlsfAllocator::Mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+    if (size < kSecondLevelCount)
+    {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+        return;
+    }
+
+    uint32_t msb = FindHighestBit(size);
+    sl = static_cast<uint32_t>(size >> (msb - kSecondLevelLog2)) ^ kSecondLevelCount;
+    fl = msb - kSecondLevelLog2 + 1;
+}
+
+uint64_t CppDirectXRayTracing21::TlsfAllocator::RoundUpToClass(uint64_t size)
+{
+    // Round the request up to the start of the next class so every block in the found list is large enough
+    if (size < kSecondLevelCount)
+    {
+        return size;
+    }
+    uint64_t round = (1ull << (FindHighestBit(size) - kSecondLevelLog2)) - 1;
+    return size + round;
+}
+
+uint32_t CppDirectXRayTracing21::TlsfAllocator::NewBlock()
+{
+    if (mUnusedBlocks.empty() == false)
+    {
+        uint32_t block = mUnusedBlocks.back();
+        mUnusedBlocks.pop_back();
+        mBlocks[block] = Block();
+        return block;
+    }
+    mBlocks.push_back(Block());
+    return static_cast<uint32_t>(mBlocks.size() - 1);
+}
+
+void CppDirectXRayTracing21::TlsfAllocator::ReleaseBlock(uint32_t block)
+{
+    mBlocks[block] = Block();
+    mUnusedBlocks.push_back(block);
+}
+
+void CppDirectXRayTracing21::TlsfAllocator::InsertFree(uint32_t block)
+{
+    uint32_t fl, sl;
+    Mapping(mBlocks[block].size, fl, sl);
+
+    Block& b = mBlocks[block];
+    b.free = true;
+    b.prevFree = kInvalidBlock;
+    b.nextFree = mFreeHeads[fl][sl];
+    if (b.nextFree != kInvalidBlock)
+    {
+        mBlocks[b.nextFree].prevFree = block;
+    }
+    mFreeHeads[fl][sl] = block;
+
+    mFirstLevelBitmap |= (1ull << fl);
+    mSecondLevelBitmap[fl] |= (1u << sl);
+}
+
+void CppDirectXRayTracing21::TlsfAllocator::RemoveFree(uint32_t block)
+{
+    uint32_t fl, sl;
+    Mapping(mBlocks[block].size, fl, sl);
+
+    Block& b = mBlocks[block];
+    if (b.prevFree != kInvalidBlock)
+    {
+        mBlocks[b.prevFree].nextFree = b.nextFree;
+    }
+    else
+    {
+        mFreeHeads[fl][sl] = b.nextFree;
+    }
+    if (b.nextFree != kInvalidBlock)
+    {
+        mBlocks[b.nextFree].prevFree = b.prevFree;
+    }
+    b.prevFree = kInvalidBlock;
+    b.nextFree = kInvalidBlock;
+    b.free = false;
+
+    if (mFreeHeads[fl][sl] == kInvalidBlock)
+    {
+        mSecondLevelBitmap[fl] &= ~(1u << sl);
+        if (mSecondLevelBitmap[fl] == 0)
+        {
+            mFirstLevelBitmap &= ~(1ull << fl);
+        }
+    }
+}
+
+uint32_t CppDirectXRayTracing21::TlsfAllocator::FindFree(uint64_t size)
+{
+    uint32_t fl, sl;
+    Mapping(RoundUpToClass(size), fl, sl);
+    if (fl >= kFirstLevelCount)
+    {
+        return kInvalidBlock;
+    }
+
+    // First look for a class >= sl inside the same power of two, then move on to the next non-empty power of two
+    uint32_t slMap = mSecondLevelBitmap[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+        uint64_t flMap = (fl + 1 < kFirstLevelCount) ? (mFirstLevelBitmap & (~0ull << (fl + 1))) : 0;
+        if (flMap == 0)
+        {
+            return kInvalidBlock;
+        }
+        fl = FindLowestBit(flMap);
+        slMap = mSecondLevelBitmap[fl];
+    }
+    sl = FindLowestBit(slMap);
+    return mFreeHeads[fl][sl];
+}
+
+uint32_t CppDirectXRayTracing21::TlsfAllocator::SplitFront(uint32_t block, uint64_t size)
+{
+    // Carve [offset, offset + size) off the front of a used block and return the remainder
+    uint32_t remainder = NewBlock();
+    Block& b = mBlocks[block];
+    Block& r = mBlocks[remainder];
+
+    r.offset = b.offset + size;
+    r.size = b.size - size;
+    r.prevPhysical = block;
+    r.nextPhysical = b.nextPhysical;
+    if (r.nextPhysical != kInvalidBlock)
+    {
+        mBlocks[r.nextPhysical].prevPhysical = remainder;
+    }
+    b.size = size;
+    b.nextPhysical = remainder;
+    return remainder;
+}
+
+uint64_t CppDirectXRayTracing21::TlsfAllocator::GetRequiredCapacity(uint64_t size, uint64_t alignment)
+{
+    // The whole range is one free block, it is found once its class is at least the one searched
+    return RoundUpToClass(std::max<uint64_t>(size, 1) + alignment - 1);
+}
+
+CppDirectXRayTracing21::TlsfAllocator::Allocation CppDirectXRayTracing21::TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    if (size == 0)
+    {
+        size = 1;
+    }
+
+    // Ask for enough room to realign any block we may get back
+    uint64_t searchSize = size + alignment - 1;
+    uint32_t block = FindFree(searchSize);
+    if (block == kInvalidBlock)
+    {
+        return Allocation();
+    }
+    RemoveFree(block);
+
+    // Return the alignment padding to the free lists. The previous physical block of a free block is always used, so no merge is needed
+    uint64_t padding = AlignUp(mBlocks[block].offset, alignment) - mBlocks[block].offset;
+    if (padding > 0)
+    {
+        uint32_t aligned = SplitFront(block, padding);
+        InsertFree(block);
+        block = aligned;
+    }
+
+    // Same for the tail
+    if (mBlocks[block].size > size)
+    {
+        uint32_t tail = SplitFront(block, size);
+        InsertFree(tail);
+    }
+
+    mUsedBytes += mBlocks[block].size;
+    mAllocationCount++;
+
+    Allocation allocation;
+    allocation.offset = mBlocks[block].offset;
+    allocation.size = mBlocks[block].size;
+    allocation.block = block;
+    return allocation;
+}
+
+void CppDirectXRayTracing21::TlsfAllocator::Free(const Allocation& allocation)
+{
+    if (allocation.IsValid() == false)
+    {
+        return;
+    }
+
+    uint32_t block = allocation.block;
+    assert(mBlocks[block].free == false);
+    mUsedBytes -= mBlocks[block].size;
+    mAllocationCount--;
+
+    // Merge with the previous physical neighbour
+    uint32_t prev = mBlocks[block].prevPhysical;
+    if (prev != kInvalidBlock && mBlocks[prev].free)
+    {
+        RemoveFree(prev);
+        mBlocks[prev].size += mBlocks[block].size;
+        mBlocks[prev].nextPhysical = mBlocks[block].nextPhysical;
+        if (mBlocks[prev].nextPhysical != kInvalidBlock)
+        {
+            mBlocks[mBlocks[prev].nextPhysical].prevPhysical = prev;
+        }
+        ReleaseBlock(block);
+        block = prev;
+    }
+
+    // Merge with the next physical neighbour
+    uint32_t next = mBlocks[block].nextPhysical;
+    if (next != kInvalidBlock && mBlocks[next].free)
+    {
+        RemoveFree(next);
+        mBlocks[block].size += mBlocks[next].size;
+        mBlocks[block].nextPhysical = mBlocks[next].nextPhysical;
+        if (mBlocks[block].nextPhysical != kInvalidBlock)
+        {
+            mBlocks[mBlocks[block].nextPhysical].prevPhysical = block;
+        }
+        ReleaseBlock(next);
+    }
+
+    InsertFree(block);
+}
+
+CppDirectXRayTracing21::TlsfAllocator::Stats CppDirectXRayTracing21::TlsfAllocator::GetStats() const
+{
+    Stats stats;
+    stats.capacity = mCapacity;
+    stats.usedBytes = mUsedBytes;
+    stats.freeBytes = mCapacity - mUsedBytes;
+    stats.allocationCount = mAllocationCount;
+
+    for (uint32_t fl = 0; fl < kFirstLevelCount; fl++)
+    {
+        for (uint32_t sl = 0; sl < kSecondLevelCount; sl++)
+        {
+            for (uint32_t block = mFreeHeads[fl][sl]; block != kInvalidBlock; block = mBlocks[block].nextFree)
+            {
+                stats.freeBlockCount++;
+                if (mBlocks[block].size > stats.largestFreeBlock)
+                {
+                    stats.largestFreeBlock = mBlocks[block].size;
+                }
+            }
+        }
+    }
+    return stats;
+}
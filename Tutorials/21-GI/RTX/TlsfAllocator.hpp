@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace CppDirectXRayTracing21
+{
+	// Two-level segregated fit allocator over an abstract address range [0, capacity).
+	// It never touches memory itself, it only hands out offsets, so the same code
+	// manages ID3D12Heap blocks, shared buffers and any fake heap used for testing.
+	class TlsfAllocator
+	{
+	public:
+		static const uint32_t kInvalidBlock = 0xFFFFFFFF;
+
+		struct Allocation
+		{
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			uint32_t block = kInvalidBlock;
+
+			bool IsValid() const { return block != kInvalidBlock; }
+		};
+
+		struct Stats
+		{
+			uint64_t capacity = 0;
+			uint64_t usedBytes = 0;
+			uint64_t freeBytes = 0;
+			uint64_t largestFreeBlock = 0;
+			uint32_t allocationCount = 0;
+			uint32_t freeBlockCount = 0;
+		};
+
+		explicit TlsfAllocator(uint64_t capacity);
+		~TlsfAllocator() = default;
+
+		// Alignment must be a power of two. Returns an invalid allocation when the range is exhausted.
+		Allocation Allocate(uint64_t size, uint64_t alignment = 1);
+		void Free(const Allocation& allocation);
+
+		// The smallest capacity whose empty allocator serves Allocate(size, alignment). The search asks for the alignment slack
+		// and rounds it up to the next class, a range of exactly size bytes isn't enough.
+		static uint64_t GetRequiredCapacity(uint64_t size, uint64_t alignment);
+
+		Stats GetStats() const;
+		uint64_t GetCapacity() const { return mCapacity; }
+		bool IsEmpty() const { return mAllocationCount == 0; }
+
+	private:
+		// 16 linear sub-classes per power of two, sizes below 16 get an exact class each.
+		static const uint32_t kSecondLevelLog2 = 4;
+		static const uint32_t kSecondLevelCount = 1 << kSecondLevelLog2;
+		static const uint32_t kFirstLevelCount = 64;
+
+		struct Block
+		{
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			uint32_t prevPhysical = kInvalidBlock;
+			uint32_t nextPhysical = kInvalidBlock;
+			uint32_t prevFree = kInvalidBlock;
+			uint32_t nextFree = kInvalidBlock;
+			bool free = false;
+		};
+
+		static void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+		static uint64_t RoundUpToClass(uint64_t size);
+
+		uint32_t NewBlock();
+		void ReleaseBlock(uint32_t block);
+		void InsertFree(uint32_t block);
+		void RemoveFree(uint32_t block);
+		uint32_t FindFree(uint64_t size);
+		uint32_t SplitFront(uint32_t block, uint64_t size);
+
+		uint64_t mCapacity = 0;
+		uint64_t mUsedBytes = 0;
+		uint32_t mAllocationCount = 0;
+
+		std::vector<Block> mBlocks;
+		std::vector<uint32_t> mUnusedBlocks;
+
+		uint64_t mFirstLevelBitmap = 0;
+		uint32_t mSecondLevelBitmap[kFirstLevelCount] = {};
+		uint32_t mFreeHeads[kFirstLevelCount][kSecondLevelCount];
+	};
+};
@@ -0,0 +1,161 @@
+#include "Test.hpp"
+#include "RTX/DescriptorAllocator.hpp"
+
+using namespace CppDirectXRayTracing21;
+
+namespace
+{
+    // [persistent 8 | dynamic 16 | transient 4 x 3 frames]
+    const uint32_t kPersistentCount = 8;
+    const uint32_t kDynamicCount = 16;
+    const uint32_t kTransientCount = 4;
+    const uint32_t kFrameCount = 3;
+
+    DescriptorAllocator CreateAllocator()
+    {
+        return DescriptorAllocator(kPersistentCount, kDynamicCount, kTransientCount, kFrameCount);
+    }
+}
+
+TEST(DescriptorAllocator, Layout)
+{
+    DescriptorAllocator allocator = CreateAllocator();
+    CHECK_EQUAL(kPersistentCount + kDynamicCount + kTransientCount * kFrameCount, allocator.GetDescriptorCount());
+    CHECK_EQUAL(kFrameCount, allocator.GetFrameCount());
+}
+
+TEST(DescriptorAllocator, PersistentRegion)
+{
+    DescriptorAllocator allocator = CreateAllocator();
+    DescriptorHandle a = allocator.AllocatePersistent(3);
+    DescriptorHandle b = allocator.AllocatePersistent(5);
+    CHECK_EQUAL(0u, a.index);
+    CHECK_EQUAL(3u, b.index);
+    CHECK(a.region == DescriptorRegion::Persistent);
+    CHECK_EQUAL(8u, allocator.GetPersistentUsed());
+
+    // Full, and an empty range is never valid
+    CHECK(allocator.AllocatePersistent(1).IsValid() == false);
+    CHECK(CreateAllocator().AllocatePersistent(0).IsValid() == false);
+    CHECK(CreateAllocator().AllocatePersistent(kPersistentCount + 1).IsValid() == false);
+}
+
+TEST(DescriptorAllocator, DynamicRegion)
+{
+    DescriptorAllocator allocator = CreateAllocator();
+    DescriptorHandle a = allocator.Allocate(4);
+    DescriptorHandle b = allocator.Allocate(4);
+    DescriptorHandle c = allocator.Allocate(8);
+    CHECK_EQUAL(kPersistentCount, a.index);
+    CHECK_EQUAL(kPersistentCount + 4, b.index);
+    CHECK_EQUAL(kPersistentCount + 8, c.index);
+    CHECK(a.region == DescriptorRegion::Dynamic);
+    CHECK_EQUAL(kDynamicCount, allocator.GetDynamicUsed());
+    CHECK(allocator.Allocate(1).IsValid() == false);
+    CHECK(allocator.Allocate(0).IsValid() == false);
+}
+
+TEST(DescriptorAllocator, TransientRegion)
+{
+    DescriptorAllocator allocator = CreateAllocator();
+    uint32_t transientStart = kPersistentCount + kDynamicCount;
+
+    // Every frame has its own slot, the slots are reused in order
+    for (uint32_t frame = 0; frame < kFrameCount * 2; frame++)
+    {
+        allocator.BeginFrame();
+        CHECK_EQUAL(0u, allocator.GetTransientUsed());
+        DescriptorHandle a = allocator.AllocateTransient(1);
+        DescriptorHandle b = allocator.AllocateTransient(3);
+        CHECK_EQUAL(transientStart + (frame % kFrameCount) * kTransientCount, a.index);
+        CHECK_EQUAL(a.index + 1, b.index);
+        CHECK(a.region == DescriptorRegion::Transient);
+        CHECK(allocator.AllocateTransient(1).IsValid() == false);
+        allocator.EndFrame(frame + 1);
+    }
+}
+
+TEST(DescriptorAllocator, TransientFences)
+{
+    DescriptorAllocator allocator = CreateAllocator();
+
+    // A slot reports the fence of the frame that used it last, 0 the first time around
+    for (uint64_t frame = 1; frame <= 6; frame++)
+    {
+        uint64_t fence = allocator.BeginFrame();
+        CHECK_EQUAL((frame > kFrameCount) ? frame - kFrameCount : 0ull, fence);
+        allocator.EndFrame(frame);
+    }
+}
+
+TEST(DescriptorAllocator, DeferredFree)
+{
+    DescriptorAllocator allocator = CreateAllocator();
+    allocator.BeginFrame();
+    DescriptorHandle a = allocator.Allocate(4);
+    DescriptorHandle b = allocator.Allocate(4);
+    allocator.Allocate(8);
+    allocator.EndFrame(1);
+
+    // Freed in frame 2, the range is still reserved while the GPU may read it
+    allocator.BeginFrame();
+    allocator.Free(a);
+    allocator.Free(DescriptorHandle());
+    CHECK(allocator.Allocate(4).IsValid() == false);
+    allocator.EndFrame(2);
+
+    allocator.Retire(1);
+    CHECK(allocator.Allocate(4).IsValid() == false);
+    CHECK_EQUAL(kDynamicCount, allocator.GetDynamicUsed());
+
+    // Frame 2 completed, the range is back
+    allocator.Retire(2);
+    CHECK_EQUAL(kDynamicCount - 4, allocator.GetDynamicUsed());
+    DescriptorHandle reused = allocator.Allocate(4);
+    CHECK_EQUAL(a.index, reused.index);
+    allocator.Free(reused);
+    allocator.Free(b);
+    allocator.EndFrame(3);
+    allocator.Retire(3);
+
+    // a and b were merged, a range of 8 fits where they were
+    DescriptorHandle merged = allocator.Allocate(8);
+    CHECK(merged.IsValid());
+    CHECK_EQUAL(a.index, merged.index);
+}
+
+TEST(DescriptorAllocator, FreeListMerge)
+{
+    DescriptorAllocator allocator(0, 16, 1, 1);
+    DescriptorHandle handles[4];
+    for (DescriptorHandle& handle : handles)
+    {
+        handle = allocator.Allocate(4);
+    }
+
+    // Freed out of order: 1 and 3 alone, then 2 joins both neighbours, then 0
+    allocator.BeginFrame();
+    allocator.Free(handles[1]);
+    allocator.Free(handles[3]);
+    allocator.EndFrame(1);
+    allocator.Retire(1);
+    CHECK(allocator.Allocate(8).IsValid() == false);
+
+    allocator.BeginFrame();
+    allocator.Free(handles[2]);
+    allocator.EndFrame(2);
+    allocator.Retire(2);
+    DescriptorHandle twelve = allocator.Allocate(12);
+    CHECK(twelve.IsValid());
+    CHECK_EQUAL(4u, twelve.index);
+
+    allocator.BeginFrame();
+    allocator.Free(twelve);
+    allocator.Free(handles[0]);
+    allocator.EndFrame(3);
+    allocator.Retire(3);
+    CHECK_EQUAL(0u, allocator.GetDynamicUsed());
+    DescriptorHandle whole = allocator.Allocate(16);
+    CHECK(whole.IsValid());
+    CHECK_EQUAL(0u, whole.index);
+}
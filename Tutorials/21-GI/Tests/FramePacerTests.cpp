@@ -0,0 +1,159 @@
+#include "Test.hpp"
+#include "RTX/FramePacer.hpp"
+#include <deque>
+
+using namespace CppDirectXRayTracing21;
+
+namespace
+{
+    // A GPU queue executing the submitted frames in order, each one takes ticksPerFrame ticks
+    class SimulatedQueue
+    {
+    public:
+        explicit SimulatedQueue(uint32_t ticksPerFrame) : mTicksPerFrame(ticksPerFrame) {}
+
+        uint64_t Signal()
+        {
+            mPending.push_back(++mLastSignaled);
+            return mLastSignaled;
+        }
+
+        void Tick()
+        {
+            if (mPending.empty())
+            {
+                return;
+            }
+            if (++mProgress >= mTicksPerFrame)
+            {
+                mCompleted = mPending.front();
+                mPending.pop_front();
+                mProgress = 0;
+            }
+        }
+
+        // What the CPU does on the fence event: let the GPU run until the value is reached. Returns the ticks waited.
+        uint32_t WaitFor(uint64_t value)
+        {
+            uint32_t ticks = 0;
+            while (mCompleted < value)
+            {
+                Tick();
+                ticks++;
+            }
+            return ticks;
+        }
+
+        uint64_t GetCompletedValue() const { return mCompleted; }
+
+    private:
+        uint32_t mTicksPerFrame;
+        uint32_t mProgress = 0;
+        uint64_t mLastSignaled = 0;
+        uint64_t mCompleted = 0;
+        std::deque<uint64_t> mPending;
+    };
+
+    struct SimulationResult
+    {
+        uint32_t maxPending = 0;
+        uint32_t stalledFrames = 0;
+        uint32_t reusedInFlightSlot = 0;
+    };
+
+    // The CPU records one frame per tick, the queue needs ticksPerFrame ticks to execute one
+    SimulationResult Simulate(uint32_t framesInFlight, uint32_t ticksPerFrame, uint32_t frameCount)
+    {
+        FramePacer pacer(framesInFlight);
+        SimulatedQueue queue(ticksPerFrame);
+        std::vector<uint64_t> slotWork(framesInFlight, 0); // Fence of the work recorded in each slot
+        SimulationResult result;
+
+        for (uint32_t frame = 0; frame < frameCount; frame++)
+        {
+            FrameSlot slot = pacer.BeginFrame();
+            CHECK_EQUAL(frame % framesInFlight, slot.index);
+            CHECK_EQUAL(frame != 0, slot.resetAllocator);
+            CHECK_EQUAL(slotWork[slot.index], slot.waitValue);
+
+            if (queue.WaitFor(slot.waitValue) > 0)
+            {
+                result.stalledFrames++;
+            }
+
+            // The allocator is only reset once the GPU is done with everything recorded into it
+            if (slotWork[slot.index] > queue.GetCompletedValue())
+            {
+                result.reusedInFlightSlot++;
+            }
+
+            slotWork[slot.index] = queue.Signal();
+            pacer.EndFrame(slotWork[slot.index]);
+            CHECK(pacer.GetState() == FramePacerState::Submitted);
+            result.maxPending = std::max(result.maxPending, pacer.GetPendingFrameCount(queue.GetCompletedValue()));
+            queue.Tick();
+        }
+        return result;
+    }
+}
+
+TEST(FramePacer, FirstFrame)
+{
+    FramePacer pacer(2);
+    CHECK(pacer.GetState() == FramePacerState::Loading);
+
+    // The list opened at load time is recorded into, nothing to wait for or reset
+    FrameSlot slot = pacer.BeginFrame();
+    CHECK_EQUAL(0u, slot.index);
+    CHECK_EQUAL(0ull, slot.waitValue);
+    CHECK(slot.resetAllocator == false);
+    CHECK(pacer.GetState() == FramePacerState::Recording);
+
+    pacer.EndFrame(5);
+    CHECK_EQUAL(5ull, pacer.GetLastSubmittedValue());
+    CHECK_EQUAL(1u, pacer.GetPendingFrameCount(4));
+    CHECK_EQUAL(0u, pacer.GetPendingFrameCount(5));
+
+    // The second slot was never used
+    slot = pacer.BeginFrame();
+    CHECK_EQUAL(1u, slot.index);
+    CHECK_EQUAL(0ull, slot.waitValue);
+    CHECK(slot.resetAllocator);
+    pacer.EndFrame(6);
+
+    // The first slot waits for its own frame, not for the last one
+    slot = pacer.BeginFrame();
+    CHECK_EQUAL(0u, slot.index);
+    CHECK_EQUAL(5ull, slot.waitValue);
+    CHECK_EQUAL(2u, pacer.GetPendingFrameCount(4));
+}
+
+TEST(FramePacer, FastGpu)
+{
+    // The GPU keeps up, the CPU never waits and at most one frame is queued
+    for (uint32_t framesInFlight = 1; framesInFlight <= 3; framesInFlight++)
+    {
+        SimulationResult result = Simulate(framesInFlight, 1, 100);
+        CHECK_EQUAL(0u, result.stalledFrames);
+        CHECK_EQUAL(0u, result.reusedInFlightSlot);
+        CHECK_EQUAL(1u, result.maxPending);
+    }
+}
+
+TEST(FramePacer, SlowGpu)
+{
+    // The GPU takes three CPU frames per frame: the queue fills up to the number of frames in flight and the CPU
+    // waits on the slot it's about to reuse
+    for (uint32_t framesInFlight = 1; framesInFlight <= 3; framesInFlight++)
+    {
+        SimulationResult result = Simulate(framesInFlight, 3, 100);
+        CHECK_EQUAL(0u, result.reusedInFlightSlot);
+        CHECK_EQUAL(framesInFlight, result.maxPending);
+        CHECK(result.stalledFrames > 50);
+    }
+
+    // A GPU slower than the CPU stalls it whatever the depth, a single frame in flight stalls it the most
+    SimulationResult result = Simulate(3, 2, 100);
+    CHECK(result.stalledFrames > 0);
+    CHECK(Simulate(1, 2, 100).stalledFrames > result.stalledFrames);
+}
@@ -0,0 +1,103 @@
+#include "Test.hpp"
+#include "RTX/PayloadPacking.hpp"
+#include "RTX/ClosestHitShading.hpp"
+#include <cmath>
+#include <random>
+
+using namespace CppDirectXRayTracing21;
+
+namespace
+{
+    uint32_t MakeRGB9E5(uint32_t r, uint32_t g, uint32_t b, uint32_t exponent)
+    {
+        return r | (g << 9) | (b << 18) | (exponent << 27);
+    }
+}
+
+TEST(PayloadPacking, PayloadSize)
+{
+    CHECK_EQUAL(8u, kMaxPayloadSizeInBytes);
+}
+
+TEST(PayloadPacking, RGB9E5Values)
+{
+    CHECK_EQUAL(0u, PackRGB9E5(glm::vec3(0.0f)) & 0x7FFFFFF);
+    CHECK(UnpackRGB9E5(PackRGB9E5(glm::vec3(0.0f))) == glm::vec3(0.0f));
+
+    // 1.0 is 256 * 2^(16 - 15 - 9)
+    CHECK_EQUAL(MakeRGB9E5(256, 256, 256, 16), PackRGB9E5(glm::vec3(1.0f)));
+    CHECK(UnpackRGB9E5(MakeRGB9E5(256, 128, 0, 16)) == glm::vec3(1.0f, 0.5f, 0.0f));
+
+    // The largest value and clamping
+    CHECK_EQUAL(MakeRGB9E5(511, 511, 511, 31), PackRGB9E5(glm::vec3(kMaxRGB9E5)));
+    CHECK(UnpackRGB9E5(PackRGB9E5(glm::vec3(1e10f, -1.0f, 2.0f * kMaxRGB9E5))) == glm::vec3(kMaxRGB9E5, 0.0f, kMaxRGB9E5));
+
+    // Rounding carries the mantissa over 9 bits, the exponent goes up instead
+    uint32_t packed = PackRGB9E5(glm::vec3(0.9995f, 0.25f, 0.0f));
+    CHECK_EQUAL(16u, packed >> 27);
+    CHECK(UnpackRGB9E5(packed) == glm::vec3(1.0f, 0.25f, 0.0f));
+
+    // Values below the smallest exponent keep their bits in the mantissa
+    CHECK(UnpackRGB9E5(PackRGB9E5(glm::vec3(std::exp2(-20.0f)))) == glm::vec3(std::exp2(-20.0f)));
+}
+
+TEST(PayloadPacking, RGB9E5RoundTrip)
+{
+    // Every representable color with a normalized largest mantissa packs back to the same bits
+    std::mt19937 random(42);
+    for (uint32_t exponent = 0; exponent <= 31; exponent++)
+    {
+        for (uint32_t i = 0; i < 64; i++)
+        {
+            uint32_t packed = MakeRGB9E5(256 + random() % 256, random() % 512, random() % 512, exponent);
+            CHECK_EQUAL(packed, PackRGB9E5(UnpackRGB9E5(packed)));
+        }
+    }
+
+    // Other colors are within half a step of the largest component's mantissa
+    std::uniform_real_distribution<float> logValue(-12.0f, 15.0f);
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        glm::vec3 rgb(std::exp2(logValue(random)), std::exp2(logValue(random)), std::exp2(logValue(random)));
+        glm::vec3 unpacked = UnpackRGB9E5(PackRGB9E5(rgb));
+        float maxComponent = std::max(rgb.x, std::max(rgb.y, rgb.z));
+        for (int c = 0; c < 3; c++)
+        {
+            CHECK(std::abs(unpacked[c] - rgb[c]) <= maxComponent / 512.0f);
+        }
+    }
+}
+
+TEST(PayloadPacking, DepthAndSeed)
+{
+    uint32_t packed = PackDepthAndSeed(3, 0x00ABCDEF);
+    CHECK_EQUAL(3u, UnpackDepth(packed));
+    CHECK_EQUAL(0x00ABCDEFu, UnpackSeed(packed));
+
+    // The top bits of the seed are dropped, the depth saturates
+    packed = PackDepthAndSeed(1000, 0xFFABCDEF);
+    CHECK_EQUAL(kPayloadMaxDepth, UnpackDepth(packed));
+    CHECK_EQUAL(0x00ABCDEFu, UnpackSeed(packed));
+    CHECK_EQUAL(255u, kPayloadMaxDepth);
+
+    for (uint32_t depth = 0; depth <= kPayloadMaxDepth; depth++)
+    {
+        CHECK_EQUAL(depth, UnpackDepth(PackDepthAndSeed(depth, 0xFFFFFFFF)));
+    }
+}
+
+TEST(PayloadPacking, SeedSequence)
+{
+    // The truncated seed produces the same random numbers as the full one
+    std::mt19937 random(7);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        uint32_t fullSeed = random();
+        uint32_t packedSeed = UnpackSeed(PackDepthAndSeed(1, fullSeed));
+        for (uint32_t n = 0; n < 16; n++)
+        {
+            CHECK(NextRand(fullSeed) == NextRand(packedSeed));
+            packedSeed = UnpackSeed(PackDepthAndSeed(1, packedSeed));
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#include "Test.hpp"
+#include "RTX/Profiler.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace CppDirectXRayTracing21;
+
+namespace
+{
+    std::string ReadAll(const std::string& path)
+    {
+        std::ifstream file(path);
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    size_t CountOccurrences(const std::string& s, const std::string& text)
+    {
+        size_t count = 0;
+        for (size_t pos = s.find(text); pos != std::string::npos; pos = s.find(text, pos + text.size()))
+        {
+            count++;
+        }
+        return count;
+    }
+
+    std::string TempFile(const char* name)
+    {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+}
+
+TEST(Profiler, Statistics)
+{
+    Profiler profiler;
+    CHECK_EQUAL(0u, profiler.GetStatistics("frame", ProfileTrack::Cpu).count);
+
+    // 1 to 100 ms, added out of order
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        uint32_t ms = (i * 37) % 100 + 1;
+        profiler.AddSample("frame", ProfileTrack::Cpu, 0.0, ms * 1000.0);
+    }
+
+    ScopeStatistics stats = profiler.GetStatistics("frame", ProfileTrack::Cpu);
+    CHECK_EQUAL(100u, stats.count);
+    CHECK_NEAR(1.0, stats.minMs, 1e-9);
+    CHECK_NEAR(50.5, stats.avgMs, 1e-9);
+
+    // Nearest rank: the 99th of 100 samples
+    CHECK_NEAR(99.0, stats.p99Ms, 1e-9);
+
+    // The tracks are separate scopes
+    CHECK_EQUAL(0u, profiler.GetStatistics("frame", ProfileTrack::Gpu).count);
+
+    // With fewer than 100 samples the p99 is the largest one
+    profiler.AddSample("small", ProfileTrack::Gpu, 0.0, 2000.0);
+    profiler.AddSample("small", ProfileTrack::Gpu, 0.0, 500.0);
+    stats = profiler.GetStatistics("small", ProfileTrack::Gpu);
+    CHECK_NEAR(2.0, stats.p99Ms, 1e-9);
+    CHECK_NEAR(0.5, stats.minMs, 1e-9);
+    CHECK_NEAR(1.25, stats.avgMs, 1e-9);
+}
+
+TEST(Profiler, WindowWrap)
+{
+    Profiler profiler(4);
+    for (uint32_t ms : { 10, 20, 30, 40 })
+    {
+        profiler.AddSample("scope", ProfileTrack::Cpu, 0.0, ms * 1000.0);
+    }
+    CHECK_NEAR(25.0, profiler.GetStatistics("scope", ProfileTrack::Cpu).avgMs, 1e-9);
+
+    // The oldest sample is replaced first
+    profiler.AddSample("scope", ProfileTrack::Cpu, 0.0, 50000.0);
+    ScopeStatistics stats = profiler.GetStatistics("scope", ProfileTrack::Cpu);
+    CHECK_EQUAL(4u, stats.count);
+    CHECK_NEAR(20.0, stats.minMs, 1e-9);
+    CHECK_NEAR(35.0, stats.avgMs, 1e-9);
+    CHECK_NEAR(50.0, stats.p99Ms, 1e-9);
+
+    // A whole window later only the new samples are left
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        profiler.AddSample("scope", ProfileTrack::Cpu, 0.0, 1000.0);
+    }
+    stats = profiler.GetStatistics("scope", ProfileTrack::Cpu);
+    CHECK_NEAR(1.0, stats.minMs, 1e-9);
+    CHECK_NEAR(1.0, stats.p99Ms, 1e-9);
+}
+
+TEST(Profiler, ChromeTrace)
+{
+    Profiler profiler(256, 4);
+    profiler.AddSample("update", ProfileTrack::Cpu, 10.0, 2.5);
+    profiler.AddSample("DispatchRays", ProfileTrack::Gpu, 12.0, 1500.25);
+    std::thread([&profiler] { profiler.AddSample("build \"BLAS\"", ProfileTrack::Cpu, 20.0, 3.0); }).join();
+
+    // Past the cap the trace keeps the oldest events, the statistics keep counting
+    profiler.AddSample("update", ProfileTrack::Cpu, 30.0, 2.5);
+    profiler.AddSample("update", ProfileTrack::Cpu, 40.0, 2.5);
+    CHECK_EQUAL(3u, profiler.GetStatistics("update", ProfileTrack::Cpu).count);
+
+    std::string path = TempFile("21-GI-ProfilerTests.json");
+    CHECK(profiler.WriteChromeTrace(path));
+    std::string trace = ReadAll(path);
+    std::filesystem::remove(path);
+
+    CHECK(trace.compare(0, 40, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n") == 0);
+    CHECK(trace.size() >= 4 && trace.compare(trace.size() - 4, 4, "\n]}\n") == 0);
+    CHECK_EQUAL(size_t(4), CountOccurrences(trace, "\"ph\":\"X\""));
+    CHECK_EQUAL(size_t(3), CountOccurrences(trace, "\"ph\":\"M\""));
+    CHECK(trace.find("\"tid\":1000,\"args\":{\"name\":\"GPU\"}") != std::string::npos);
+    CHECK(trace.find("\"tid\":1,\"args\":{\"name\":\"CPU 1\"}") != std::string::npos);
+    CHECK(trace.find("{\"name\":\"update\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":10.000,\"dur\":2.500}") != std::string::npos);
+    CHECK(trace.find("{\"name\":\"DispatchRays\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":1000,\"ts\":12.000,\"dur\":1500.250}") != std::string::npos);
+    CHECK(trace.find("\"name\":\"build \\\"BLAS\\\"\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":1,") != std::string::npos);
+    CHECK(trace.find("\"ts\":40.000") == std::string::npos);
+}
+
+TEST(Profiler, StatisticsCsv)
+{
+    Profiler profiler;
+    profiler.AddSample("trace", ProfileTrack::Gpu, 0.0, 4000.0);
+    profiler.AddSample("frame", ProfileTrack::Cpu, 0.0, 1000.0);
+    profiler.AddSample("frame", ProfileTrack::Cpu, 0.0, 3000.0);
+
+    std::string path = TempFile("21-GI-ProfilerTests.csv");
+    CHECK(profiler.WriteStatisticsCsv(path));
+    std::string csv = ReadAll(path);
+    std::filesystem::remove(path);
+
+    CHECK_EQUAL(std::string("track,scope,count,min_ms,avg_ms,p99_ms\n"
+                            "cpu,frame,2,1.0000,2.0000,3.0000\n"
+                            "gpu,trace,1,4.0000,4.0000,4.0000\n"), csv);
+
+    CHECK(profiler.WriteStatisticsCsv(TempFile("21-GI-no-such-directory/stats.csv")) == false);
+}
+
+TEST(Profiler, Scope)
+{
+    Profiler profiler;
+    {
+        ProfileScope scope(&profiler, "scope");
+        ProfileScope disabled(nullptr, "disabled");
+    }
+    ScopeStatistics stats = profiler.GetStatistics("scope", ProfileTrack::Cpu);
+    CHECK_EQUAL(1u, stats.count);
+    CHECK(stats.minMs >= 0.0);
+    CHECK_EQUAL(0u, profiler.GetStatistics("disabled", ProfileTrack::Cpu).count);
+
+    // Samples from several threads all land in the window
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&profiler] {
+            for (uint32_t i = 0; i < 50; i++)
+            {
+                profiler.AddSample("worker", ProfileTrack::Cpu, 0.0, 1000.0);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK_EQUAL(200u, profiler.GetStatistics("worker", ProfileTrack::Cpu).count);
+}
@@ -0,0 +1,196 @@
+#include "Test.hpp"
+#include "RTX/ResourceStateTracker.hpp"
+
+using namespace CppDirectXRayTracing21;
+
+namespace
+{
+    // D3D12_RESOURCE_STATES values used by the tutorial
+    const uint32_t kNonPixelShaderResource = 0x40;
+    const uint32_t kPixelShaderResource = 0x80;
+    const uint32_t kCopyDest = 0x400;
+    const uint32_t kCopySource = 0x800;
+
+    bool IsTransition(const ResourceBarrierDesc& barrier, const void* pResource, uint32_t before, uint32_t after)
+    {
+        return barrier.type == ResourceBarrierType::Transition && barrier.pResource == pResource && barrier.stateBefore == before && barrier.stateAfter == after;
+    }
+
+    bool IsUav(const ResourceBarrierDesc& barrier, const void* pResource)
+    {
+        return barrier.type == ResourceBarrierType::Uav && barrier.pResource == pResource;
+    }
+}
+
+TEST(ResourceStateTracker, Merge)
+{
+    int a, b;
+    ResourceStateTracker tracker;
+    tracker.Register(&a, kNonPixelShaderResource);
+    tracker.Register(&b, kCopyDest);
+
+    // Two transitions before the flush become one barrier from the flushed state to the last one
+    tracker.Transition(&a, kCopyDest);
+    tracker.Transition(&b, kCopySource);
+    tracker.Transition(&a, kCopySource);
+    CHECK_EQUAL(kCopySource, tracker.GetState(&a));
+
+    std::vector<ResourceBarrierDesc> barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(2), barriers.size());
+    CHECK(IsTransition(barriers[0], &a, kNonPixelShaderResource, kCopySource));
+    CHECK(IsTransition(barriers[1], &b, kCopyDest, kCopySource));
+    CHECK(tracker.HasPendingBarriers() == false);
+    CHECK(tracker.Flush().empty());
+}
+
+TEST(ResourceStateTracker, Cancel)
+{
+    int a;
+    ResourceStateTracker tracker;
+    tracker.Register(&a, kNonPixelShaderResource);
+
+    // There and back again before the flush: no barrier
+    tracker.Transition(&a, kCopyDest);
+    CHECK(tracker.HasPendingBarriers());
+    tracker.Transition(&a, kNonPixelShaderResource);
+    CHECK(tracker.HasPendingBarriers() == false);
+    CHECK(tracker.Flush().empty());
+    CHECK_EQUAL(kNonPixelShaderResource, tracker.GetState(&a));
+
+    // A cancelled transition doesn't leave a stale entry behind
+    tracker.Transition(&a, kCopyDest);
+    std::vector<ResourceBarrierDesc> barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &a, kNonPixelShaderResource, kCopyDest));
+}
+
+TEST(ResourceStateTracker, CancelRestoresUavHazard)
+{
+    int a;
+    ResourceStateTracker tracker;
+    tracker.Register(&a, kCopySource);
+
+    tracker.UavAccess(&a);
+    std::vector<ResourceBarrierDesc> barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &a, kCopySource, kResourceStateUnorderedAccess));
+
+    // The first dispatch accessed the UAV, a round trip through a read state is cancelled before the flush:
+    // the second dispatch still needs a UAV barrier
+    tracker.Transition(&a, kNonPixelShaderResource);
+    tracker.Transition(&a, kResourceStateUnorderedAccess);
+    tracker.UavAccess(&a);
+    barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsUav(barriers[0], &a));
+
+    // Same with the UAV barrier already pending when the round trip starts
+    tracker.UavAccess(&a);
+    tracker.Transition(&a, kNonPixelShaderResource);
+    tracker.Transition(&a, kResourceStateUnorderedAccess);
+    barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsUav(barriers[0], &a));
+
+    // A transition that is flushed orders the accesses itself
+    tracker.UavAccess(&a);
+    tracker.Transition(&a, kNonPixelShaderResource);
+    barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &a, kResourceStateUnorderedAccess, kNonPixelShaderResource));
+    tracker.UavAccess(&a);
+    barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &a, kNonPixelShaderResource, kResourceStateUnorderedAccess));
+}
+
+TEST(ResourceStateTracker, UavBarriers)
+{
+    int a;
+    ResourceStateTracker tracker;
+    tracker.Register(&a, kResourceStateUnorderedAccess);
+
+    // The first access has nothing to wait for, the next ones wait for the previous one
+    tracker.UavAccess(&a);
+    CHECK(tracker.Flush().empty());
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        tracker.UavAccess(&a);
+        std::vector<ResourceBarrierDesc> barriers = tracker.Flush();
+        CHECK_EQUAL(size_t(1), barriers.size());
+        CHECK(IsUav(barriers[0], &a));
+    }
+
+    // A transition requested in between replaces the UAV barrier
+    tracker.UavAccess(&a);
+    tracker.Transition(&a, kCopySource);
+    std::vector<ResourceBarrierDesc> barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &a, kResourceStateUnorderedAccess, kCopySource));
+}
+
+TEST(ResourceStateTracker, ReadStates)
+{
+    int a, b;
+    ResourceStateTracker tracker;
+
+    // A read state included in the current combination is already there
+    tracker.Register(&a, kNonPixelShaderResource | kPixelShaderResource);
+    tracker.Transition(&a, kNonPixelShaderResource);
+    CHECK(tracker.Flush().empty());
+    CHECK_EQUAL(kNonPixelShaderResource | kPixelShaderResource, tracker.GetState(&a));
+
+    // COMMON isn't a subset of anything
+    tracker.Transition(&a, kResourceStateCommon);
+    std::vector<ResourceBarrierDesc> barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &a, kNonPixelShaderResource | kPixelShaderResource, kResourceStateCommon));
+
+    // A wider read combination needs a barrier, and write states must match exactly
+    tracker.Register(&b, kNonPixelShaderResource);
+    tracker.Transition(&b, kNonPixelShaderResource | kPixelShaderResource);
+    barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &b, kNonPixelShaderResource, kNonPixelShaderResource | kPixelShaderResource));
+
+    tracker.Register(&b, kCopyDest | kCopySource);
+    tracker.Transition(&b, kCopySource);
+    CHECK_EQUAL(size_t(1), tracker.Flush().size());
+    tracker.Transition(&b, kCopySource);
+    CHECK(tracker.Flush().empty());
+}
+
+TEST(ResourceStateTracker, UnregisterWithPending)
+{
+    int a, b;
+    ResourceStateTracker tracker;
+    tracker.Register(&a, kNonPixelShaderResource);
+    tracker.Register(&b, kNonPixelShaderResource);
+    tracker.Transition(&a, kCopyDest);
+    tracker.Transition(&b, kCopyDest);
+    tracker.UavAccess(&a);
+
+    // The released resource's barriers are dropped, the others stay
+    tracker.Unregister(&a);
+    CHECK(tracker.IsRegistered(&a) == false);
+    CHECK_EQUAL(kResourceStateCommon, tracker.GetState(&a));
+    std::vector<ResourceBarrierDesc> barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &b, kNonPixelShaderResource, kCopyDest));
+
+    // A new resource at the same address starts clean
+    tracker.Register(&a, kNonPixelShaderResource);
+    tracker.Transition(&a, kCopyDest);
+    tracker.Unregister(&a);
+    tracker.Register(&a, kCopySource);
+    CHECK(tracker.HasPendingBarriers() == false);
+    tracker.Transition(&a, kCopyDest);
+    barriers = tracker.Flush();
+    CHECK_EQUAL(size_t(1), barriers.size());
+    CHECK(IsTransition(barriers[0], &a, kCopySource, kCopyDest));
+
+    // Unregistering twice or something unknown is harmless
+    tracker.Unregister(&a);
+    tracker.Unregister(&a);
+    CHECK(tracker.Flush().empty());
+}
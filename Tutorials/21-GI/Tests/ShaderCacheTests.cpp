@@ -0,0 +1,198 @@
+#include "Test.hpp"
+#include "RTX/ShaderCache.hpp"
+#include <chrono>
+#include <fstream>
+
+using namespace CppDirectXRayTracing21;
+namespace fs = std::filesystem;
+
+namespace
+{
+    // A fresh directory under the system temp directory, removed with everything in it
+    class TempDirectory
+    {
+    public:
+        TempDirectory()
+        {
+            mPath = fs::temp_directory_path() / ("21-GI-ShaderCache-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+            fs::create_directories(mPath);
+        }
+
+        ~TempDirectory()
+        {
+            std::error_code ec;
+            fs::remove_all(mPath, ec);
+        }
+
+        const fs::path& GetPath() const { return mPath; }
+
+        void Write(const std::string& name, const std::string& content) const
+        {
+            fs::create_directories((mPath / name).parent_path());
+            std::ofstream file(mPath / name, std::ios::binary | std::ios::trunc);
+            file << content;
+        }
+
+    private:
+        fs::path mPath;
+    };
+
+    std::vector<fs::path> EntryFiles(const fs::path& directory)
+    {
+        std::vector<fs::path> files;
+        for (const fs::directory_entry& entry : fs::directory_iterator(directory))
+        {
+            files.push_back(entry.path().filename());
+        }
+        return files;
+    }
+
+    std::string KeyOf(const ShaderCache& cache, const fs::path& sourceFile, const std::wstring& target = L"lib_6_3", const ShaderDefines& defines = {}, const std::string& compilerVersion = "1.7")
+    {
+        ShaderSourceSnapshot source;
+        ShaderCache::ReadSource(sourceFile, source);
+        return cache.ComputeKey(source, target, defines, compilerVersion);
+    }
+}
+
+TEST(ShaderCache, ParseIncludes)
+{
+    TempDirectory dir;
+    dir.Write("Main.hlsl",
+        "#include \"Common.hlsli\"\n"
+        "  #  include <Sub/Payload.hlsli>\n"
+        "// #include \"Commented.hlsli\"\n"
+        "#define FOO 1\n"
+        "#include \"Common.hlsli\"\n");
+    dir.Write("Common.hlsli", "#include \"Sub/Payload.hlsli\"\nfloat3 f;\n");
+    dir.Write("Sub/Payload.hlsli", "#include \"Packing.hlsli\"\n");
+    dir.Write("Sub/Packing.hlsli", "uint pack;\n");
+
+    // Depth first, each file once, includes resolved next to the including file first
+    std::vector<fs::path> files = ShaderCache::CollectIncludes(dir.GetPath() / "Main.hlsl");
+    CHECK_EQUAL(size_t(4), files.size());
+    CHECK(files[0] == (dir.GetPath() / "Main.hlsl").lexically_normal());
+    CHECK(files[1] == (dir.GetPath() / "Common.hlsli").lexically_normal());
+    CHECK(files[2] == (dir.GetPath() / "Sub/Payload.hlsli").lexically_normal());
+    CHECK(files[3] == (dir.GetPath() / "Sub/Packing.hlsli").lexically_normal());
+
+    ShaderSourceSnapshot source;
+    CHECK(ShaderCache::ReadSource(dir.GetPath() / "Main.hlsl", source));
+    const std::string* pPacking = source.Find(dir.GetPath() / "Sub" / ".." / "Sub" / "Packing.hlsli");
+    CHECK(pPacking != nullptr && *pPacking == "uint pack;\n");
+
+    // The C++ side of a shared header isn't part of the shader
+    dir.Write("Shared.hlsli",
+        "#ifndef __SHARED_HLSLI__\n"
+        "#ifdef __cplusplus\n"
+        "#include <cmath>\n"
+        "#if 1\n"
+        "#include \"CppOnly.hpp\"\n"
+        "#endif\n"
+        "#else\n"
+        "#include \"Common.hlsli\"\n"
+        "#endif\n"
+        "#ifndef __cplusplus\n"
+        "#include \"Sub/Packing.hlsli\"\n"
+        "#else\n"
+        "#include <cstdint>\n"
+        "#endif\n"
+        "#endif\n");
+    dir.Write("Uses.hlsl", "#include \"Shared.hlsli\"\n");
+    CHECK(ShaderCache::ReadSource(dir.GetPath() / "Uses.hlsl", source));
+    CHECK_EQUAL(size_t(5), source.files.size());
+    CHECK(source.Find(dir.GetPath() / "Common.hlsli") != nullptr);
+    CHECK(source.Find(dir.GetPath() / "Sub/Packing.hlsli") != nullptr);
+
+    // A missing include makes the snapshot incomplete
+    dir.Write("Broken.hlsl", "#include \"Missing.hlsli\"\n");
+    CHECK(ShaderCache::ReadSource(dir.GetPath() / "Broken.hlsl", source) == false);
+}
+
+TEST(ShaderCache, Key)
+{
+    TempDirectory dir;
+    dir.Write("Main.hlsl", "#include \"Common.hlsli\"\nvoid main() {}\n");
+    dir.Write("Common.hlsli", "float3 f;\n");
+    ShaderCache cache(dir.GetPath() / "Cache");
+    fs::path mainFile = dir.GetPath() / "Main.hlsl";
+
+    std::string key = KeyOf(cache, mainFile);
+    CHECK_EQUAL(size_t(32), key.size());
+    CHECK_EQUAL(key, KeyOf(cache, mainFile));
+
+    CHECK(KeyOf(cache, mainFile, L"lib_6_5") != key);
+    CHECK(KeyOf(cache, mainFile, L"lib_6_3", { { L"USE_SPHERES", L"1" } }) != key);
+    CHECK(KeyOf(cache, mainFile, L"lib_6_3", { { L"USE_SPHERES", L"1" } }) != KeyOf(cache, mainFile, L"lib_6_3", { { L"USE_SPHERES", L"0" } }));
+    CHECK(KeyOf(cache, mainFile, L"lib_6_3", {}, "1.8") != key);
+
+    // Editing an include invalidates the entry
+    dir.Write("Common.hlsli", "float4 f;\n");
+    std::string includeEdited = KeyOf(cache, mainFile);
+    CHECK(includeEdited != key);
+    dir.Write("Main.hlsl", "#include \"Common.hlsli\"\nvoid main() { }\n");
+    CHECK(KeyOf(cache, mainFile) != includeEdited);
+}
+
+TEST(ShaderCache, StoreLoad)
+{
+    TempDirectory dir;
+    ShaderCache cache(dir.GetPath() / "Cache");
+    std::vector<uint8_t> blob(1000);
+    for (size_t i = 0; i < blob.size(); i++)
+    {
+        blob[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    std::vector<uint8_t> loaded;
+    CHECK(cache.Load("0123", loaded) == false);
+    CHECK(cache.Store("", blob.data(), blob.size()) == false);
+
+    CHECK(cache.Store("0123", blob.data(), blob.size()));
+    CHECK(cache.Load("0123", loaded));
+    CHECK(loaded == blob);
+    CHECK_EQUAL(1000ull, cache.GetSize());
+
+    // The blob is renamed into place, no temporary file is left behind
+    std::vector<fs::path> files = EntryFiles(dir.GetPath() / "Cache");
+    CHECK_EQUAL(size_t(1), files.size());
+    CHECK(files[0] == "0123.dxil");
+
+    // Storing the same key again replaces the entry
+    CHECK(cache.Store("0123", blob.data(), 10));
+    CHECK(cache.Load("0123", loaded));
+    CHECK_EQUAL(size_t(10), loaded.size());
+    CHECK_EQUAL(size_t(1), EntryFiles(dir.GetPath() / "Cache").size());
+}
+
+TEST(ShaderCache, Eviction)
+{
+    TempDirectory dir;
+    fs::path cacheDir = dir.GetPath() / "Cache";
+    ShaderCache cache(cacheDir, 250);
+    std::vector<uint8_t> blob(100);
+
+    CHECK(cache.Store("a", blob.data(), blob.size()));
+    CHECK(cache.Store("b", blob.data(), blob.size()));
+
+    // Age both entries, a is older than b, then use a
+    fs::file_time_type now = fs::file_time_type::clock::now();
+    fs::last_write_time(cacheDir / "a.dxil", now - std::chrono::hours(2));
+    fs::last_write_time(cacheDir / "b.dxil", now - std::chrono::hours(1));
+    std::vector<uint8_t> loaded;
+    CHECK(cache.Load("a", loaded));
+
+    // Over the cap, the least recently used entry goes
+    CHECK(cache.Store("c", blob.data(), blob.size()));
+    CHECK(fs::exists(cacheDir / "a.dxil"));
+    CHECK(fs::exists(cacheDir / "b.dxil") == false);
+    CHECK(fs::exists(cacheDir / "c.dxil"));
+    CHECK_EQUAL(200ull, cache.GetSize());
+
+    // Files that aren't entries are neither counted nor evicted
+    dir.Write("Cache/notes.txt", std::string(1000, 'x'));
+    CHECK_EQUAL(200ull, cache.GetSize());
+    CHECK(cache.Store("d", blob.data(), 40));
+    CHECK(fs::exists(cacheDir / "notes.txt"));
+    CHECK_EQUAL(240ull, cache.GetSize());
+}
@@ -0,0 +1,198 @@
+#include "Test.hpp"
+#include "RTX/ShaderTableBuilder.hpp"
+#include <map>
+
+using namespace CppDirectXRayTracing21;
+
+namespace
+{
+    struct TwoHandles
+    {
+        uint64_t a;
+        uint64_t b;
+    };
+
+    struct FiveHandles
+    {
+        uint64_t handles[5];
+    };
+
+    // Every export gets an identifier filled with its own byte
+    class FakeIdentifiers
+    {
+    public:
+        const void* Get(const std::wstring& exportName)
+        {
+            std::vector<uint8_t>& identifier = mIdentifiers[exportName];
+            if (identifier.empty())
+            {
+                identifier.assign(kShaderIdentifierSize, static_cast<uint8_t>(0xA0 + mIdentifiers.size()));
+            }
+            return identifier.data();
+        }
+
+        ShaderTableBuilder::IdentifierCallback Callback()
+        {
+            return [this](const std::wstring& exportName) { return Get(exportName); };
+        }
+
+    private:
+        std::map<std::wstring, std::vector<uint8_t>> mIdentifiers;
+    };
+
+    // rayGen with 8 bytes of arguments, two misses without, two hit groups with 16 bytes
+    void AddDefaultRecords(ShaderTableBuilder& builder)
+    {
+        builder.AddRecord(ShaderTableSection::RayGen, L"rayGen", uint64_t(0x1111));
+        builder.AddRecord(ShaderTableSection::Miss, L"miss");
+        builder.AddRecord(ShaderTableSection::Miss, L"shadowMiss");
+        builder.AddRecord(ShaderTableSection::HitGroup, L"HitGroup", TwoHandles{ 1, 2 });
+        builder.AddRecord(ShaderTableSection::HitGroup, L"SphereHitGroup", TwoHandles{ 3, 4 });
+    }
+}
+
+TEST(ShaderTableBuilder, SectionStrides)
+{
+    ShaderTableBuilder builder;
+    AddDefaultRecords(builder);
+    CHECK(builder.IsLayoutDirty());
+    builder.ComputeLayout();
+    CHECK(builder.IsLayoutDirty() == false);
+
+    // Each section is sized to its own largest record: 32 + 8 and 32 + 16 round up to 64, the misses are bare identifiers
+    const ShaderTableSectionLayout& rayGen = builder.GetSectionLayout(ShaderTableSection::RayGen);
+    const ShaderTableSectionLayout& miss = builder.GetSectionLayout(ShaderTableSection::Miss);
+    const ShaderTableSectionLayout& hit = builder.GetSectionLayout(ShaderTableSection::HitGroup);
+    CHECK_EQUAL(64u, rayGen.stride);
+    CHECK_EQUAL(32u, miss.stride);
+    CHECK_EQUAL(64u, hit.stride);
+    CHECK_EQUAL(2u, miss.recordCount);
+    CHECK_EQUAL(64ull, miss.GetSize());
+
+    // A larger record widens only its own section
+    builder.AddRecord(ShaderTableSection::HitGroup, L"BigHitGroup", FiveHandles{});
+    builder.ComputeLayout();
+    CHECK_EQUAL(96u, builder.GetSectionLayout(ShaderTableSection::HitGroup).stride);
+    CHECK_EQUAL(32u, builder.GetSectionLayout(ShaderTableSection::Miss).stride);
+    CHECK_EQUAL(64u, builder.GetSectionLayout(ShaderTableSection::RayGen).stride);
+    CHECK_EQUAL(builder.GetSectionLayout(ShaderTableSection::HitGroup).offset + 2 * 96, builder.GetRecordOffset(ShaderTableSection::HitGroup, 2));
+}
+
+TEST(ShaderTableBuilder, Alignment)
+{
+    // A single 32 byte miss record leaves the next section to be realigned to 64
+    ShaderTableBuilder builder;
+    builder.AddRecord(ShaderTableSection::RayGen, L"rayGen");
+    builder.AddRecord(ShaderTableSection::Miss, L"miss");
+    builder.AddRecord(ShaderTableSection::HitGroup, L"HitGroup", uint32_t(7));
+    builder.ComputeLayout();
+
+    CHECK_EQUAL(0ull, builder.GetSectionLayout(ShaderTableSection::RayGen).offset);
+    CHECK_EQUAL(64ull, builder.GetSectionLayout(ShaderTableSection::Miss).offset);
+    CHECK_EQUAL(128ull, builder.GetSectionLayout(ShaderTableSection::HitGroup).offset);
+    CHECK_EQUAL(128ull + 64, builder.GetTotalSize());
+
+    for (uint32_t s = 0; s < static_cast<uint32_t>(ShaderTableSection::Count); s++)
+    {
+        const ShaderTableSectionLayout& layout = builder.GetSectionLayout(static_cast<ShaderTableSection>(s));
+        CHECK_EQUAL(0ull, layout.offset % kShaderTableAlignment);
+        CHECK_EQUAL(0u, layout.stride % kShaderRecordAlignment);
+    }
+}
+
+TEST(ShaderTableBuilder, WriteTable)
+{
+    ShaderTableBuilder builder;
+    AddDefaultRecords(builder);
+    builder.ComputeLayout();
+
+    FakeIdentifiers identifiers;
+    std::vector<uint8_t> table(static_cast<size_t>(builder.GetTotalSize()), 0xCD);
+    builder.WriteTable(table.data(), identifiers.Callback());
+
+    // Identifier first, then the arguments, then zeroed padding
+    uint64_t offset = builder.GetRecordOffset(ShaderTableSection::HitGroup, 1);
+    CHECK(memcmp(table.data() + offset, identifiers.Get(L"SphereHitGroup"), kShaderIdentifierSize) == 0);
+    TwoHandles arguments;
+    memcpy(&arguments, table.data() + offset + kShaderIdentifierSize, sizeof(arguments));
+    CHECK_EQUAL(3ull, arguments.a);
+    CHECK_EQUAL(4ull, arguments.b);
+    for (uint32_t i = kShaderIdentifierSize + sizeof(TwoHandles); i < 64; i++)
+    {
+        CHECK_EQUAL(0, int(table[offset + i]));
+    }
+
+    offset = builder.GetRecordOffset(ShaderTableSection::Miss, 1);
+    CHECK(memcmp(table.data() + offset, identifiers.Get(L"shadowMiss"), kShaderIdentifierSize) == 0);
+
+    // Nothing changed since the table was written
+    CHECK(builder.WriteDirtyRecords(table.data(), identifiers.Callback()).empty());
+}
+
+TEST(ShaderTableBuilder, DirtyRecords)
+{
+    ShaderTableBuilder builder;
+    AddDefaultRecords(builder);
+    builder.ComputeLayout();
+    FakeIdentifiers identifiers;
+    std::vector<uint8_t> table(static_cast<size_t>(builder.GetTotalSize()));
+    builder.WriteTable(table.data(), identifiers.Callback());
+
+    // Setting the same values doesn't dirty anything
+    builder.SetLocalRootArguments(ShaderTableSection::HitGroup, 0, TwoHandles{ 1, 2 });
+    builder.SetExportName(ShaderTableSection::HitGroup, 0, L"HitGroup");
+    CHECK(builder.WriteDirtyRecords(table.data(), identifiers.Callback()).empty());
+
+    // One record, one range of the section stride
+    builder.SetLocalRootArguments(ShaderTableSection::HitGroup, 1, TwoHandles{ 5, 6 });
+    std::vector<ShaderTableDirtyRange> ranges = builder.WriteDirtyRecords(table.data(), identifiers.Callback());
+    CHECK_EQUAL(size_t(1), ranges.size());
+    CHECK_EQUAL(builder.GetRecordOffset(ShaderTableSection::HitGroup, 1), ranges[0].offset);
+    CHECK_EQUAL(64ull, ranges[0].size);
+    TwoHandles arguments;
+    memcpy(&arguments, table.data() + ranges[0].offset + kShaderIdentifierSize, sizeof(arguments));
+    CHECK_EQUAL(5ull, arguments.a);
+
+    // Adjacent records are merged into one range
+    builder.SetExportName(ShaderTableSection::HitGroup, 0, L"OtherHitGroup");
+    builder.SetLocalRootArguments(ShaderTableSection::HitGroup, 1, TwoHandles{ 7, 8 });
+    ranges = builder.WriteDirtyRecords(table.data(), identifiers.Callback());
+    CHECK_EQUAL(size_t(1), ranges.size());
+    CHECK_EQUAL(builder.GetSectionLayout(ShaderTableSection::HitGroup).offset, ranges[0].offset);
+    CHECK_EQUAL(128ull, ranges[0].size);
+    CHECK(memcmp(table.data() + ranges[0].offset, identifiers.Get(L"OtherHitGroup"), kShaderIdentifierSize) == 0);
+
+    // The patched table matches a full write
+    std::vector<uint8_t> expected(table.size());
+    ShaderTableBuilder copy = builder;
+    copy.WriteTable(expected.data(), identifiers.Callback());
+    CHECK(memcmp(expected.data(), table.data(), table.size()) == 0);
+
+    // New identifiers: every section is re-written, the padding between sections splits the ranges
+    builder.MarkAllDirty();
+    ranges = builder.WriteDirtyRecords(table.data(), identifiers.Callback());
+    uint64_t total = 0;
+    for (const ShaderTableDirtyRange& range : ranges)
+    {
+        total += range.size;
+    }
+    CHECK_EQUAL(64ull + 64 + 128, total);
+}
+
+TEST(ShaderTableBuilder, LayoutInvalidation)
+{
+    ShaderTableBuilder builder;
+    AddDefaultRecords(builder);
+    builder.ComputeLayout();
+
+    // Arguments that still fit the stride keep the layout
+    builder.SetLocalRootArguments(ShaderTableSection::HitGroup, 0, uint64_t(9));
+    CHECK(builder.IsLayoutDirty() == false);
+
+    // Growing past the stride, or adding a record, needs a new layout
+    builder.SetLocalRootArguments(ShaderTableSection::HitGroup, 0, FiveHandles{});
+    CHECK(builder.IsLayoutDirty());
+    builder.ComputeLayout();
+    builder.AddRecord(ShaderTableSection::Miss, L"thirdMiss");
+    CHECK(builder.IsLayoutDirty());
+}
@@ -0,0 +1,259 @@
+#include "Test.hpp"
+#include "RTX/ClosestHitShading.hpp"
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+using namespace CppDirectXRayTracing21;
+
+namespace
+{
+    struct TracedRay
+    {
+        glm::vec3 origin;
+        glm::vec3 dir;
+        float tMin;
+        float tMax;
+    };
+
+    // Records the rays chs() would trace, shadow rays report visible unless occluded is set
+    struct RecordingTracer
+    {
+        bool occluded = false;
+        glm::vec3 bounce = glm::vec3(0.5f);
+        std::vector<TracedRay> shadowRays;
+        std::vector<TracedRay> indirectRays;
+
+        float ShadowRay(const glm::vec3& origin, const glm::vec3& dir, float tmin, float tmax)
+        {
+            shadowRays.push_back({ origin, dir, tmin, tmax });
+            return occluded ? 0.0f : 1.0f;
+        }
+
+        glm::vec3 IndirectRay(const glm::vec3& origin, const glm::vec3& dir, float tmin, float tmax, uint32_t, uint32_t)
+        {
+            indirectRays.push_back({ origin, dir, tmin, tmax });
+            return bounce;
+        }
+    };
+
+    // A surface facing straight up at the light
+    ShadingInput MakeInput()
+    {
+        ShadingInput in;
+        in.position = glm::vec3(0.0f);
+        in.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        in.viewDir = glm::normalize(glm::vec3(0.0f, 1.0f, 1.0f));
+        in.diffuse = glm::vec3(0.8f, 0.4f, 0.2f);
+        in.specular = glm::vec3(0.04f);
+        in.roughness = 0.5f;
+        in.lightPosition = glm::vec3(0.0f, 10.0f, 0.0f);
+        in.lightIntensity = glm::vec3(1.0f);
+        in.aoSamples = 4;
+        in.maxRecursionDepth = 2.0f;
+        return in;
+    }
+
+    // The SHADING_MODE_* values defined by the shaders
+    std::map<std::string, uint32_t> ReadShaderDefines()
+    {
+        std::map<std::string, uint32_t> values;
+        std::ifstream file(TUTORIAL_DATA_DIR "/Helpers.hlsli");
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream tokens(line);
+            std::string directive, name;
+            uint32_t value;
+            if (tokens >> directive >> name >> value && directive == "#define" && name.compare(0, 13, "SHADING_MODE_") == 0)
+            {
+                values[name] = value;
+            }
+        }
+        return values;
+    }
+}
+
+TEST(ShadingPermutations, SelectShadingMode)
+{
+    CHECK(SelectShadingMode(false, false) == ShadingMode::LambertGI);
+    CHECK(SelectShadingMode(false, true) == ShadingMode::GgxGI);
+    CHECK(SelectShadingMode(true, false) == ShadingMode::AmbientOcclusion);
+    CHECK(SelectShadingMode(true, true) == ShadingMode::AmbientOcclusion);
+}
+
+TEST(ShadingPermutations, MatchesShaders)
+{
+    std::map<std::string, uint32_t> values = ReadShaderDefines();
+    CHECK_EQUAL(size_t(kShadingModeCount), values.size());
+    CHECK_EQUAL(static_cast<uint32_t>(ShadingMode::AmbientOcclusion), values["SHADING_MODE_AO"]);
+    CHECK_EQUAL(static_cast<uint32_t>(ShadingMode::LambertGI), values["SHADING_MODE_LAMBERT_GI"]);
+    CHECK_EQUAL(static_cast<uint32_t>(ShadingMode::GgxGI), values["SHADING_MODE_GGX_GI"]);
+}
+
+TEST(ShadingPermutations, Defines)
+{
+    std::set<std::wstring> names;
+    for (uint32_t m = 0; m < kShadingModeCount; m++)
+    {
+        ShadingMode mode = static_cast<ShadingMode>(m);
+        ShaderDefines defines = GetShadingModeDefines(mode);
+        CHECK_EQUAL(size_t(1), defines.size());
+        CHECK(defines[0].first == L"SHADING_MODE");
+        CHECK(defines[0].second == std::to_wstring(m));
+
+        defines = GetShadingModeDefines(mode, true);
+        CHECK_EQUAL(size_t(2), defines.size());
+        CHECK(defines[1].first == L"INLINE_VISIBILITY" && defines[1].second == L"1");
+
+        names.insert(GetShadingModeName(mode));
+    }
+
+    // The names build the export names, they have to be distinct
+    CHECK_EQUAL(size_t(kShadingModeCount), names.size());
+    CHECK(std::wstring(GetLibraryTarget(false)) == L"lib_6_3");
+    CHECK(std::wstring(GetLibraryTarget(true)) == L"lib_6_5");
+}
+
+TEST(ShadingPermutations, CacheKeys)
+{
+    // Every library of the shaders gets its own cache entry
+    ShaderSourceSnapshot source;
+    CHECK(ShaderCache::ReadSource(TUTORIAL_DATA_DIR "/Shaders.hlsl", source));
+    ShaderCache cache("unused");
+    std::set<std::string> keys;
+    for (uint32_t m = 0; m < kShadingModeCount; m++)
+    {
+        for (bool inlineVisibility : { false, true })
+        {
+            ShadingMode mode = static_cast<ShadingMode>(m);
+            keys.insert(cache.ComputeKey(source, GetLibraryTarget(inlineVisibility), GetShadingModeDefines(mode, inlineVisibility), "1.7"));
+        }
+    }
+    CHECK_EQUAL(size_t(2 * kShadingModeCount), keys.size());
+}
+
+TEST(ClosestHitShading, Random)
+{
+    // Same LCG as nextRand() in Helpers.hlsli
+    uint32_t seed = 0;
+    float value = NextRand(seed);
+    CHECK_EQUAL(1013904223u, seed);
+    CHECK_NEAR(double(1013904223u & 0x00FFFFFF) / double(0x01000000), value, 1e-7);
+
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        value = NextRand(seed);
+        CHECK(value >= 0.0f && value < 1.0f);
+    }
+}
+
+TEST(ClosestHitShading, Sampling)
+{
+    uint32_t seed = 1234;
+    const glm::vec3 normals[] = { glm::vec3(0, 1, 0), glm::vec3(-1, 0, 0), glm::normalize(glm::vec3(-1, 2, 3)) };
+    for (const glm::vec3& normal : normals)
+    {
+        // Like the HLSL, the perpendicular vector is only unit length for axis aligned normals, so are the samples
+        bool axisAligned = glm::length(GetPerpendicularVector(normal)) == 1.0f;
+        CHECK_NEAR(0.0, glm::dot(GetPerpendicularVector(normal), normal), 1e-6);
+        for (uint32_t i = 0; i < 200; i++)
+        {
+            glm::vec3 dir = CosineWeightedHemisphereSample(seed, normal);
+            CHECK(glm::dot(dir, normal) >= 0.0f);
+
+            glm::vec3 h = GetGGXMicrofacet(seed, 0.5f, normal);
+            CHECK(glm::dot(h, normal) >= 0.0f);
+
+            if (axisAligned)
+            {
+                CHECK_NEAR(1.0, glm::length(dir), 1e-5);
+                CHECK_NEAR(1.0, glm::length(h), 1e-5);
+            }
+        }
+    }
+}
+
+TEST(ClosestHitShading, AmbientOcclusion)
+{
+    ShadingInput in = MakeInput();
+    RecordingTracer tracer;
+    uint32_t seed = 7;
+    uint32_t depth = 0;
+    glm::vec3 color = ShadeClosestHit<ShadingMode::AmbientOcclusion>(in, seed, depth, tracer);
+
+    // The light and the AO samples, no bounce
+    CHECK_EQUAL(size_t(1 + in.aoSamples), tracer.shadowRays.size());
+    CHECK_EQUAL(size_t(0), tracer.indirectRays.size());
+    CHECK_EQUAL(0u, depth);
+    CHECK_NEAR(10.0, tracer.shadowRays[0].tMax, 1e-5);
+    CHECK_NEAR(in.diffuse.x / 3.14f, color.x, 1e-5);
+
+    tracer = RecordingTracer();
+    tracer.occluded = true;
+    color = ShadeClosestHit<ShadingMode::AmbientOcclusion>(in, seed, depth, tracer);
+    CHECK_NEAR(0.0, color.x, 1e-6);
+}
+
+TEST(ClosestHitShading, LambertGI)
+{
+    ShadingInput in = MakeInput();
+    RecordingTracer tracer;
+    uint32_t seed = 7;
+    uint32_t depth = 0;
+    glm::vec3 color = ShadeClosestHit<ShadingMode::LambertGI>(in, seed, depth, tracer);
+
+    // One shadow ray, no AO loop, one bounce into the hemisphere
+    CHECK_EQUAL(size_t(1), tracer.shadowRays.size());
+    CHECK_EQUAL(size_t(1), tracer.indirectRays.size());
+    CHECK_EQUAL(1u, depth);
+    CHECK(glm::dot(tracer.indirectRays[0].dir, in.normal) >= 0.0f);
+    CHECK_NEAR(kIndirectTMin, tracer.indirectRays[0].tMin, 1e-7);
+    CHECK_NEAR(kIndirectTMax, tracer.indirectRays[0].tMax, 1e-3);
+    CHECK_NEAR(in.diffuse.y / 3.14f + in.diffuse.y * tracer.bounce.y, color.y, 1e-5);
+
+    // At the recursion limit only the direct light is left
+    tracer = RecordingTracer();
+    depth = 2;
+    color = ShadeClosestHit<ShadingMode::LambertGI>(in, seed, depth, tracer);
+    CHECK_EQUAL(size_t(0), tracer.indirectRays.size());
+    CHECK_EQUAL(2u, depth);
+    CHECK_NEAR(in.diffuse.y / 3.14f, color.y, 1e-5);
+}
+
+TEST(ClosestHitShading, GgxGI)
+{
+    ShadingInput in = MakeInput();
+    RecordingTracer tracer;
+    uint32_t seed = 7;
+    uint32_t depth = 1;
+    glm::vec3 color = ShadeClosestHit<ShadingMode::GgxGI>(in, seed, depth, tracer);
+
+    CHECK_EQUAL(size_t(1), tracer.shadowRays.size());
+    CHECK_EQUAL(size_t(1), tracer.indirectRays.size());
+    CHECK_EQUAL(2u, depth);
+    CHECK(std::isfinite(color.x) && std::isfinite(color.y) && std::isfinite(color.z));
+    CHECK(color.x > 0.0f);
+
+    // The runtime switch runs the same specialization: same rays, same color, same seed
+    for (uint32_t m = 0; m < kShadingModeCount; m++)
+    {
+        ShadingMode mode = static_cast<ShadingMode>(m);
+        RecordingTracer a, b;
+        uint32_t seedA = 99, seedB = 99, depthA = 0, depthB = 0;
+        glm::vec3 colorA = ShadeClosestHit(mode, in, seedA, depthA, a);
+        glm::vec3 colorB;
+        switch (mode)
+        {
+        case ShadingMode::AmbientOcclusion: colorB = ShadeClosestHit<ShadingMode::AmbientOcclusion>(in, seedB, depthB, b); break;
+        case ShadingMode::LambertGI:        colorB = ShadeClosestHit<ShadingMode::LambertGI>(in, seedB, depthB, b); break;
+        default:                            colorB = ShadeClosestHit<ShadingMode::GgxGI>(in, seedB, depthB, b); break;
+        }
+        CHECK(colorA == colorB);
+        CHECK_EQUAL(seedB, seedA);
+        CHECK_EQUAL(depthB, depthA);
+        CHECK_EQUAL(b.shadowRays.size(), a.shadowRays.size());
+        CHECK_EQUAL(b.indirectRays.size(), a.indirectRays.size());
+    }
+}
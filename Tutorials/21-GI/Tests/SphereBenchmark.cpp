@@ -0,0 +1,162 @@
+// Times the sphere generation at tessellation 32 to 2048: the original path growing the vectors with push_back and
+// computing the tangents afterwards with CalculateTangentSpace(), against Sphere::Init(), which sizes the storage once
+// and fills it with GenerateParallel(), serially and on a pool.
+//   21-GI-SphereBenchmark [maxTessellation] [threads]
+#include "Primitives/Sphere.hpp"
+#include "Primitives/TangentSpace.hpp"
+#include "RTX/ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <Externals/GLM/glm/gtc/constants.hpp>
+
+using namespace Primitives;
+
+namespace
+{
+    // Sphere::Init() before the parallel generator. The indices are 32-bit so the large tessellations stay valid,
+    // the original only had 16-bit indices
+    void InitWithPushBack(float diameter, int tessellation, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        int verticalSegments = tessellation;
+        int horizontalSegments = tessellation * 2;
+        float uIncrement = -1.0f / horizontalSegments;
+        float vIncrement = -1.0f / verticalSegments;
+        float radius = diameter / 2.0f;
+        float u = 1.0f;
+        float v = 1.0f;
+
+        for (int i = 0; i < horizontalSegments; i++)
+        {
+            u += uIncrement;
+            Vertex vertex;
+            vertex.position = glm::vec3(0, -1, 0) * radius;
+            vertex.normal = glm::vec3(0, -1, 0);
+            vertex.tangent = glm::vec3(0, 0, 0);
+            vertex.texcoord = glm::vec2(u, v);
+            vertices.push_back(vertex);
+        }
+
+        v = 1.0f;
+        for (int i = 0; i < verticalSegments - 1; i++)
+        {
+            float latitude = (((i + 1) * glm::pi <float>()) / verticalSegments) - glm::pi<float>() / 2.0f;
+            u = 1.0f;
+            v += vIncrement;
+            float dy = glm::sin(latitude);
+            float dxz = glm::cos(latitude);
+            for (int j = 0; j <= horizontalSegments; j++)
+            {
+                float longitude = j * glm::pi <float>() * 2 / horizontalSegments;
+                glm::vec3 normal(glm::sin(longitude) * dxz, dy, glm::cos(longitude) * dxz);
+
+                Vertex vertex;
+                vertex.position = normal * radius;
+                vertex.normal = normal;
+                vertex.tangent = glm::vec3(0, 0, 0);
+                vertex.texcoord = glm::vec2(u, v);
+                vertices.push_back(vertex);
+                u += uIncrement;
+            }
+        }
+
+        v = 0.0f;
+        u = 1.0f;
+        for (int i = 0; i < horizontalSegments; i++)
+        {
+            u += uIncrement;
+            Vertex vertex;
+            vertex.position = glm::vec3(0, 1, 0) * radius;
+            vertex.normal = glm::vec3(0, 1, 0);
+            vertex.tangent = glm::vec3(0, 0, 0);
+            vertex.texcoord = glm::vec2(u, v);
+            vertices.push_back(vertex);
+        }
+
+        for (int i = 0; i < horizontalSegments; i++)
+        {
+            indices.push_back(i);
+            indices.push_back(1 + i + horizontalSegments);
+            indices.push_back(i + horizontalSegments);
+        }
+
+        for (int i = 0; i < verticalSegments - 2; i++)
+        {
+            for (int j = 0; j < horizontalSegments; j++)
+            {
+                int num = horizontalSegments + 1;
+                int i1 = horizontalSegments + (i * num) + j;
+                int i2 = horizontalSegments + (i * num) + j + 1;
+                int i3 = horizontalSegments + ((i + 1) * num) + j;
+                int i4 = i3 + 1;
+
+                indices.push_back(i1);
+                indices.push_back(i2);
+                indices.push_back(i3);
+                indices.push_back(i2);
+                indices.push_back(i4);
+                indices.push_back(i3);
+            }
+        }
+
+        uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+        for (int i = 0; i < horizontalSegments; i++)
+        {
+            indices.push_back(vertexCount - 1 - i);
+            indices.push_back(vertexCount - horizontalSegments - 2 - i);
+            indices.push_back(vertexCount - horizontalSegments - 1 - i);
+        }
+
+        CalculateTangentSpace(vertices.data(), vertices.size(), IndexView(indices));
+    }
+
+    // Best of a few runs, fewer for the large meshes
+    template<typename F>
+    double TimeMs(int tessellation, F&& f)
+    {
+        int runs = std::max(1, 2048 / tessellation);
+        runs = std::min(runs, 16);
+        double bestMs = 1e30;
+        for (int run = 0; run < runs; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            bestMs = std::min(bestMs, ms);
+        }
+        return bestMs;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int maxTessellation = (argc > 1) ? atoi(argv[1]) : 2048;
+    uint32_t threadCount = (argc > 2) ? static_cast<uint32_t>(atoi(argv[2])) : std::max(1u, std::thread::hardware_concurrency());
+    CppDirectXRayTracing21::ThreadPool pool(threadCount);
+
+    printf("%12s %12s %14s %14s %14s %10s\n", "tessellation", "vertices", "push_back ms", "serial ms", "pool ms", "speedup");
+    for (int tessellation = 32; tessellation <= maxTessellation; tessellation *= 2)
+    {
+        double pushBackMs = TimeMs(tessellation, [tessellation]()
+        {
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;
+            InitWithPushBack(1.0f, tessellation, vertices, indices);
+        });
+        double serialMs = TimeMs(tessellation, [tessellation]()
+        {
+            Sphere sphere;
+            sphere.Init(1.0f, tessellation);
+        });
+        double poolMs = TimeMs(tessellation, [tessellation, &pool]()
+        {
+            Sphere sphere;
+            sphere.Init(1.0f, tessellation, false, false, &pool);
+        });
+
+        printf("%12d %12u %14.3f %14.3f %14.3f %9.2fx\n", tessellation, Sphere::GetVertexCount(tessellation), pushBackMs, serialMs, poolMs, pushBackMs / poolMs);
+        fflush(stdout);
+    }
+    return 0;
+}
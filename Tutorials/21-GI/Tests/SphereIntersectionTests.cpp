@@ -0,0 +1,125 @@
+#include "Test.hpp"
+#include "Primitives/SphereIntersection.hpp"
+
+namespace
+{
+    const glm::vec3 kCenter(0.0f, 0.0f, 0.0f);
+    const float kInfinity = 1e30f;
+
+    float Intersect(glm::vec3 origin, glm::vec3 direction, float radius = 1.0f, float tMin = 0.0f, float tMax = kInfinity)
+    {
+        return Primitives::IntersectSphere(origin, direction, kCenter, radius, tMin, tMax);
+    }
+
+    // Distance of the hit point from the surface, relative to the radius
+    float SurfaceError(glm::vec3 origin, glm::vec3 direction, float radius, float t)
+    {
+        return std::fabs(glm::length(origin + t * direction - kCenter) - radius) / radius;
+    }
+}
+
+TEST(SphereIntersection, HitFromOutside)
+{
+    CHECK_NEAR(4.0, Intersect(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.0f, 0.0f, 1.0f)), 1e-6);
+    CHECK_NEAR(3.0, Intersect(glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 2.0f), 1e-6);
+
+    // Off axis, the near root
+    float t = Intersect(glm::vec3(0.6f, 0.0f, -5.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    CHECK_NEAR(5.0 - 0.8, t, 1e-5);
+}
+
+TEST(SphereIntersection, HitFromInside)
+{
+    // The far side is the only root in front of the ray
+    CHECK_NEAR(1.0, Intersect(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f)), 1e-6);
+    CHECK_NEAR(1.5, Intersect(glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(0.0f, 0.0f, 1.0f)), 1e-6);
+}
+
+TEST(SphereIntersection, UnnormalizedDirection)
+{
+    // t is in units of the direction's length, like an object-space ray of a scaled instance
+    CHECK_NEAR(2.0, Intersect(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.0f, 0.0f, 2.0f)), 1e-6);
+    CHECK_NEAR(8.0, Intersect(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.0f, 0.0f, 0.5f)), 1e-5);
+
+    glm::vec3 direction(0.3f, -0.2f, 4.0f);
+    glm::vec3 origin(-0.1f, 0.2f, -6.0f);
+    float t = Intersect(origin, direction);
+    CHECK(t != Primitives::kSphereMiss);
+    CHECK(SurfaceError(origin, direction, 1.0f, t) < 1e-5f);
+}
+
+TEST(SphereIntersection, IntervalLimits)
+{
+    glm::vec3 origin(0.0f, 0.0f, -5.0f);
+    glm::vec3 direction(0.0f, 0.0f, 1.0f);
+
+    // Both ends of the interval are inclusive
+    CHECK_NEAR(4.0, Intersect(origin, direction, 1.0f, 0.0f, 4.0f), 1e-6);
+    CHECK_NEAR(6.0, Intersect(origin, direction, 1.0f, 6.0f, kInfinity), 1e-6);
+
+    // Near root cut off: the far one. Both cut off: a miss
+    CHECK_EQUAL(Primitives::kSphereMiss, Intersect(origin, direction, 1.0f, 0.0f, 3.9f));
+    CHECK_NEAR(6.0, Intersect(origin, direction, 1.0f, 4.5f, kInfinity), 1e-6);
+    CHECK_EQUAL(Primitives::kSphereMiss, Intersect(origin, direction, 1.0f, 4.5f, 5.5f));
+    CHECK_EQUAL(Primitives::kSphereMiss, Intersect(origin, direction, 1.0f, 6.5f, kInfinity));
+
+    // Sphere behind the ray, or off to the side
+    CHECK_EQUAL(Primitives::kSphereMiss, Intersect(glm::vec3(0.0f, 0.0f, 5.0f), direction));
+    CHECK_EQUAL(Primitives::kSphereMiss, Intersect(glm::vec3(2.0f, 0.0f, -5.0f), direction));
+}
+
+TEST(SphereIntersection, GrazingRay)
+{
+    // Tangent to the sphere, both roots are the touching point
+    CHECK_NEAR(5.0, Intersect(glm::vec3(1.0f, 0.0f, -5.0f), glm::vec3(0.0f, 0.0f, 1.0f)), 1e-5);
+    CHECK_EQUAL(Primitives::kSphereMiss, Intersect(glm::vec3(1.001f, 0.0f, -5.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+
+    // Starting on the surface and tangent to it, q is 0
+    CHECK_NEAR(0.0, Intersect(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)), 1e-6);
+
+    // Just inside the silhouette, the hit stays on the surface
+    glm::vec3 origin(0.9999f, 0.0f, -5.0f);
+    glm::vec3 direction(0.0f, 0.0f, 1.0f);
+    float t = Intersect(origin, direction);
+    CHECK(t != Primitives::kSphereMiss);
+    CHECK(SurfaceError(origin, direction, 1.0f, t) < 1e-4f);
+}
+
+TEST(SphereIntersection, DistantRay)
+{
+    // A small sphere far away, where the textbook formula loses the discriminant to cancellation
+    glm::vec3 origin(0.0f, 0.0f, -1e4f);
+    glm::vec3 direction(0.0f, 0.0f, 1.0f);
+    float radius = 0.01f;
+    float t = Intersect(origin, direction, radius);
+    CHECK_NEAR(1e4 - radius, t, 1e-3);
+
+    glm::vec3 offAxis(0.005f, 0.0f, -1e4f);
+    t = Intersect(offAxis, direction, radius);
+    CHECK(t != Primitives::kSphereMiss);
+    CHECK_NEAR(1e4 - std::sqrt(radius * radius - 0.005 * 0.005), t, 1e-3);
+    CHECK_EQUAL(Primitives::kSphereMiss, Intersect(glm::vec3(0.011f, 0.0f, -1e4f), direction, radius));
+
+    // Unit sphere seen from far away along a diagonal
+    glm::vec3 diagonal = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
+    t = Intersect(-1e5f * diagonal, diagonal);
+    CHECK_NEAR(1e5 - 1.0, t, 1e-2);
+}
+
+TEST(SphereIntersection, Normal)
+{
+    glm::vec3 normal = Primitives::SphereNormal(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f), 2.0f);
+    CHECK_NEAR(0.0, normal.x, 1e-6);
+    CHECK_NEAR(1.0, normal.y, 1e-6);
+    CHECK_NEAR(0.0, normal.z, 1e-6);
+
+    // The normal at the hit of an offset sphere is unit length and faces the ray
+    glm::vec3 center(1.0f, 2.0f, 3.0f);
+    glm::vec3 origin(1.2f, 2.1f, -4.0f);
+    glm::vec3 direction(0.0f, 0.0f, 1.0f);
+    float t = Primitives::IntersectSphere(origin, direction, center, 0.5f, 0.0f, kInfinity);
+    CHECK(t != Primitives::kSphereMiss);
+    glm::vec3 hitNormal = Primitives::SphereNormal(origin + t * direction, center, 0.5f);
+    CHECK_NEAR(1.0, glm::length(hitNormal), 1e-5);
+    CHECK(glm::dot(hitNormal, direction) < 0.0f);
+}
@@ -0,0 +1,168 @@
+#include "Test.hpp"
+#include "RTX/StateObjectGraph.hpp"
+
+using namespace CppDirectXRayTracing21;
+
+namespace
+{
+    bool HasError(const std::vector<std::string>& errors, const std::string& text)
+    {
+        for (const std::string& error : errors)
+        {
+            if (error.find(text) != std::string::npos)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The layout of the tutorial's collection: one library, a triangle and a procedural hit group
+    void AddShaders(StateObjectGraph& graph)
+    {
+        graph.AddLibrary(0, { { L"rayGen", L"" }, { L"miss", L"" }, { L"chs", L"" }, { L"sphereChs", L"" }, { L"sphereIntersection", L"" } });
+        graph.AddHitGroup(L"HitGroup", L"chs");
+        graph.AddHitGroup(L"SphereHitGroup", L"sphereChs", std::wstring(), L"sphereIntersection");
+        graph.AddLocalRootSignature(1, { L"HitGroup", L"SphereHitGroup" });
+        graph.AddShaderConfig(8, 32, { L"rayGen", L"miss", L"chs", L"sphereChs", L"sphereIntersection" });
+    }
+}
+
+TEST(StateObjectGraph, Valid)
+{
+    StateObjectGraph graph(StateObjectGraphType::RaytracingPipeline);
+    AddShaders(graph);
+    graph.SetGlobalRootSignature(2);
+    graph.SetPipelineConfig(kMaxDeclarableRecursionDepth);
+
+    std::vector<std::string> errors;
+    CHECK(graph.Validate(errors));
+    CHECK(errors.empty());
+    CHECK_EQUAL(size_t(7), graph.GetExports().size());
+
+    // Library, 2 hit groups, local root signature and shader config with their associations, global root signature, pipeline config
+    CHECK_EQUAL(9u, graph.GetSubobjectCount());
+    graph.SetAllowStateObjectAdditions(true);
+    CHECK_EQUAL(10u, graph.GetSubobjectCount());
+}
+
+TEST(StateObjectGraph, DuplicateExport)
+{
+    StateObjectGraph graph(StateObjectGraphType::Collection);
+    AddShaders(graph);
+    graph.AddHitGroup(L"miss", L"chs");
+
+    std::vector<std::string> errors;
+    CHECK(graph.Validate(errors) == false);
+    CHECK(HasError(errors, "Export miss is defined more than once"));
+
+    // Renaming a library export clashes the same way
+    StateObjectGraph renamed(StateObjectGraphType::Collection);
+    AddShaders(renamed);
+    renamed.AddLibrary(3, { { L"chs", L"chs2" } });
+    CHECK(renamed.Validate(errors) == false);
+    CHECK(HasError(errors, "Export chs is defined more than once"));
+}
+
+TEST(StateObjectGraph, HitGroupImports)
+{
+    StateObjectGraph graph(StateObjectGraphType::Collection);
+    AddShaders(graph);
+    graph.AddHitGroup(L"ShadowHitGroup", L"shadowChs");
+    graph.AddHitGroup(L"NestedHitGroup", L"HitGroup");
+    graph.AddHitGroup(L"EmptyHitGroup", L"");
+
+    std::vector<std::string> errors;
+    CHECK(graph.Validate(errors) == false);
+    CHECK(HasError(errors, "Hit group ShadowHitGroup imports unknown shader shadowChs"));
+    CHECK(HasError(errors, "Hit group NestedHitGroup imports unknown shader HitGroup"));
+    CHECK(HasError(errors, "Hit group EmptyHitGroup has no shader"));
+    CHECK_EQUAL(size_t(3), errors.size());
+}
+
+TEST(StateObjectGraph, ShaderConfig)
+{
+    // A shader without a shader config
+    StateObjectGraph missing(StateObjectGraphType::Collection);
+    missing.AddLibrary(0, { { L"rayGen", L"" }, { L"miss", L"" } });
+    missing.AddShaderConfig(8, 32, { L"rayGen" });
+    std::vector<std::string> errors;
+    CHECK(missing.Validate(errors) == false);
+    CHECK(HasError(errors, "Shader miss needs exactly one shader config"));
+    CHECK_EQUAL(size_t(1), errors.size());
+
+    // A shader with two, and one associated with an export that doesn't exist
+    StateObjectGraph duplicate(StateObjectGraphType::Collection);
+    duplicate.AddLibrary(0, { { L"rayGen", L"" }, { L"miss", L"" } });
+    duplicate.AddShaderConfig(8, 32, { L"rayGen", L"miss" });
+    duplicate.AddShaderConfig(8, 16, { L"miss", L"shadowMiss" });
+    CHECK(duplicate.Validate(errors) == false);
+    CHECK(HasError(errors, "Shader miss needs exactly one shader config"));
+    CHECK(HasError(errors, "Shader config associated with unknown export shadowMiss"));
+    CHECK(HasError(errors, "Shader rayGen") == false);
+
+    StateObjectGraph attributes(StateObjectGraphType::Collection);
+    attributes.AddLibrary(0, { { L"rayGen", L"" } });
+    attributes.AddShaderConfig(kMaxAttributeSizeInBytes + 4, 32, { L"rayGen" });
+    CHECK(attributes.Validate(errors) == false);
+    CHECK(HasError(errors, "Shader config attributes are larger than 32 bytes"));
+}
+
+TEST(StateObjectGraph, LocalRootSignature)
+{
+    StateObjectGraph graph(StateObjectGraphType::Collection);
+    AddShaders(graph);
+    graph.AddLocalRootSignature(3, { L"HitGroup", L"NoSuchHitGroup" });
+
+    std::vector<std::string> errors;
+    CHECK(graph.Validate(errors) == false);
+    CHECK(HasError(errors, "Export HitGroup has more than one local root signature"));
+    CHECK(HasError(errors, "Local root signature associated with unknown export NoSuchHitGroup"));
+    CHECK_EQUAL(size_t(2), errors.size());
+}
+
+TEST(StateObjectGraph, RecursionDepth)
+{
+    StateObjectGraph graph(StateObjectGraphType::RaytracingPipeline);
+    AddShaders(graph);
+    std::vector<std::string> errors;
+
+    // A pipeline defining shaders needs the config
+    CHECK(graph.Validate(errors) == false);
+    CHECK(HasError(errors, "A ray-tracing pipeline needs a pipeline config"));
+
+    graph.SetPipelineConfig(kMaxDeclarableRecursionDepth + 1);
+    CHECK(graph.Validate(errors) == false);
+    CHECK(HasError(errors, "Max trace recursion depth is larger than 31"));
+
+    graph.SetPipelineConfig(1);
+    CHECK(graph.Validate(errors));
+}
+
+TEST(StateObjectGraph, Collections)
+{
+    // A pipeline made of a collection: hit groups can import its shaders and no pipeline config is needed
+    StateObjectGraph pipeline(StateObjectGraphType::RaytracingPipeline);
+    pipeline.AddCollection(0, { L"rayGen", L"miss", L"chs", L"HitGroup" });
+    pipeline.AddHitGroup(L"OtherHitGroup", L"chs");
+    std::vector<std::string> errors;
+    CHECK(pipeline.Validate(errors));
+    CHECK_EQUAL(size_t(5), pipeline.GetExports().size());
+    CHECK_EQUAL(2u, pipeline.GetSubobjectCount());
+
+    // Hit groups can't import other hit groups
+    StateObjectGraph wrapped(StateObjectGraphType::RaytracingPipeline);
+    wrapped.AddCollection(0, { L"chs" });
+    wrapped.AddHitGroup(L"HitGroup", L"chs");
+    wrapped.AddHitGroup(L"WrappedHitGroup", L"HitGroup");
+    CHECK(wrapped.Validate(errors) == false);
+    CHECK(HasError(errors, "Hit group WrappedHitGroup imports unknown shader HitGroup"));
+
+    // Collections can't be nested
+    StateObjectGraph nested(StateObjectGraphType::Collection);
+    AddShaders(nested);
+    nested.AddCollection(1, { L"shadowMiss" });
+    CHECK(nested.Validate(errors) == false);
+    CHECK(HasError(errors, "A collection can't contain another collection"));
+    CHECK_EQUAL(size_t(1), errors.size());
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Tests
+{
+	// Registered by TEST() before main() runs. The cases of a suite run together, every suite is one ctest test.
+	struct TestCase
+	{
+		const char* suite;
+		const char* name;
+		void (*pFunction)();
+	};
+
+	std::vector<TestCase>& GetTestCases();
+	void ReportFailure(const char* file, int line, const std::string& message);
+
+	struct TestRegistrar
+	{
+		TestRegistrar(const char* suite, const char* name, void (*pFunction)())
+		{
+			GetTestCases().push_back({ suite, name, pFunction });
+		}
+	};
+
+	template<typename T>
+	std::string ToString(const T& value)
+	{
+		std::ostringstream stream;
+		stream << value;
+		return stream.str();
+	}
+};
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static Tests::TestRegistrar suite##_##name##_registrar(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+// A failed check is reported and the case goes on, the run fails at the end
+#define CHECK(condition) \
+	do { if (!(condition)) Tests::ReportFailure(__FILE__, __LINE__, #condition); } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+	do { \
+		auto checkExpected = (expected); \
+		auto checkActual = (actual); \
+		if (!(checkExpected == checkActual)) \
+			Tests::ReportFailure(__FILE__, __LINE__, std::string(#actual) + " is " + Tests::ToString(checkActual) + ", expected " + Tests::ToString(checkExpected)); \
+	} while (0)
+
+#define CHECK_NEAR(expected, actual, tolerance) \
+	do { \
+		double checkExpected = (expected); \
+		double checkActual = (actual); \
+		if (!(std::fabs(checkExpected - checkActual) <= (tolerance))) \
+			Tests::ReportFailure(__FILE__, __LINE__, std::string(#actual) + " is " + Tests::ToString(checkActual) + ", expected " + Tests::ToString(checkExpected)); \
+	} while (0)
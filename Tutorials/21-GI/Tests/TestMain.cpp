@@ -0,0 +1,46 @@
+#include "Test.hpp"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    int gFailures = 0;
+}
+
+std::vector<Tests::TestCase>& Tests::GetTestCases()
+{
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+void Tests::ReportFailure(const char* file, int line, const std::string& message)
+{
+    printf("%s(%d): %s\n", file, line, message.c_str());
+    gFailures++;
+}
+
+// 21-GI-Tests [suite]. Runs every case of the suite, or all of them. Fails if a check failed or nothing ran
+int main(int argc, char** argv)
+{
+    const char* pSuite = (argc > 1) ? argv[1] : nullptr;
+    int run = 0;
+    for (const Tests::TestCase& testCase : Tests::GetTestCases())
+    {
+        if (pSuite && strcmp(pSuite, testCase.suite) != 0)
+        {
+            continue;
+        }
+
+        int failures = gFailures;
+        testCase.pFunction();
+        printf("[%s] %s.%s\n", (gFailures == failures) ? "  OK  " : "FAILED", testCase.suite, testCase.name);
+        run++;
+    }
+
+    if (run == 0)
+    {
+        printf("No test case in suite %s\n", pSuite ? pSuite : "");
+        return 1;
+    }
+    return (gFailures == 0) ? 0 : 1;
+}
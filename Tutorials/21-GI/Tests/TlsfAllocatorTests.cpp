@@ -0,0 +1,216 @@
+#include "Test.hpp"
+#include "RTX/TlsfAllocator.hpp"
+#include <random>
+
+using CppDirectXRayTracing21::TlsfAllocator;
+
+namespace
+{
+    // Fake heap: the owner of every byte, so overlapping allocations are caught
+    class FakeHeap
+    {
+    public:
+        explicit FakeHeap(uint64_t capacity) : mOwners(static_cast<size_t>(capacity), 0) {}
+
+        bool Claim(const TlsfAllocator::Allocation& allocation, uint32_t owner)
+        {
+            for (uint64_t i = allocation.offset; i < allocation.offset + allocation.size; i++)
+            {
+                if (i >= mOwners.size() || mOwners[i] != 0)
+                {
+                    return false;
+                }
+                mOwners[i] = owner;
+            }
+            return true;
+        }
+
+        void Release(const TlsfAllocator::Allocation& allocation)
+        {
+            for (uint64_t i = allocation.offset; i < allocation.offset + allocation.size; i++)
+            {
+                mOwners[i] = 0;
+            }
+        }
+
+    private:
+        std::vector<uint32_t> mOwners;
+    };
+}
+
+TEST(TlsfAllocator, SplitAndMerge)
+{
+    TlsfAllocator allocator(1024);
+    TlsfAllocator::Allocation a = allocator.Allocate(100);
+    TlsfAllocator::Allocation b = allocator.Allocate(100);
+    TlsfAllocator::Allocation c = allocator.Allocate(100);
+    CHECK(a.IsValid() && b.IsValid() && c.IsValid());
+    CHECK_EQUAL(100ull, a.size);
+
+    TlsfAllocator::Stats stats = allocator.GetStats();
+    CHECK_EQUAL(3u, stats.allocationCount);
+    CHECK_EQUAL(300ull, stats.usedBytes);
+    CHECK_EQUAL(724ull, stats.freeBytes);
+    CHECK_EQUAL(1u, stats.freeBlockCount);
+
+    // A hole between two used blocks stays on its own
+    allocator.Free(b);
+    stats = allocator.GetStats();
+    CHECK_EQUAL(2u, stats.freeBlockCount);
+    CHECK_EQUAL(724ull, stats.largestFreeBlock);
+
+    // Merged with the next neighbour
+    allocator.Free(a);
+    stats = allocator.GetStats();
+    CHECK_EQUAL(2u, stats.freeBlockCount);
+    CHECK_EQUAL(724ull, stats.largestFreeBlock);
+
+    // The hole is reused before the tail is split
+    TlsfAllocator::Allocation d = allocator.Allocate(200);
+    CHECK(d.IsValid());
+    CHECK_EQUAL(0ull, d.offset);
+    allocator.Free(d);
+
+    // Merged with both neighbours, the range is whole again
+    allocator.Free(c);
+    stats = allocator.GetStats();
+    CHECK(allocator.IsEmpty());
+    CHECK_EQUAL(1u, stats.freeBlockCount);
+    CHECK_EQUAL(1024ull, stats.largestFreeBlock);
+    CHECK_EQUAL(0ull, stats.usedBytes);
+}
+
+TEST(TlsfAllocator, Alignment)
+{
+    const uint64_t kCapacity = 1 << 20;
+    TlsfAllocator allocator(kCapacity);
+    FakeHeap heap(kCapacity);
+    std::vector<TlsfAllocator::Allocation> allocations;
+
+    // An odd size first, every later offset has to be realigned
+    allocations.push_back(allocator.Allocate(3));
+    uint32_t owner = 1;
+    CHECK(heap.Claim(allocations.back(), owner++));
+    for (uint64_t alignment : { 4ull, 16ull, 256ull, 4096ull, 65536ull })
+    {
+        for (uint64_t size : { 1ull, 7ull, 100ull, 1000ull })
+        {
+            TlsfAllocator::Allocation allocation = allocator.Allocate(size, alignment);
+            CHECK(allocation.IsValid());
+            CHECK_EQUAL(0ull, allocation.offset % alignment);
+            CHECK_EQUAL(size, allocation.size);
+            CHECK(heap.Claim(allocation, owner++));
+            allocations.push_back(allocation);
+        }
+    }
+
+    // The padding went back to the free lists, nothing leaks once everything is freed
+    for (const TlsfAllocator::Allocation& allocation : allocations)
+    {
+        allocator.Free(allocation);
+    }
+    TlsfAllocator::Stats stats = allocator.GetStats();
+    CHECK(allocator.IsEmpty());
+    CHECK_EQUAL(1u, stats.freeBlockCount);
+    CHECK_EQUAL(kCapacity, stats.largestFreeBlock);
+}
+
+TEST(TlsfAllocator, Exhaustion)
+{
+    TlsfAllocator allocator(256);
+    CHECK(allocator.Allocate(257).IsValid() == false);
+
+    // Fill the range with small blocks until it refuses
+    std::vector<TlsfAllocator::Allocation> allocations;
+    for (;;)
+    {
+        TlsfAllocator::Allocation allocation = allocator.Allocate(16);
+        if (allocation.IsValid() == false)
+        {
+            break;
+        }
+        allocations.push_back(allocation);
+    }
+    CHECK_EQUAL(size_t(16), allocations.size());
+    CHECK_EQUAL(0ull, allocator.GetStats().freeBytes);
+    CHECK(allocator.Allocate(1).IsValid() == false);
+
+    // Freeing an invalid allocation is a no-op, freeing a real one makes room again
+    allocator.Free(TlsfAllocator::Allocation());
+    CHECK_EQUAL(16u, allocator.GetStats().allocationCount);
+    allocator.Free(allocations[5]);
+    TlsfAllocator::Allocation again = allocator.Allocate(16);
+    CHECK(again.IsValid());
+    CHECK_EQUAL(allocations[5].offset, again.offset);
+
+    // An empty allocator has nothing to hand out
+    TlsfAllocator empty(0);
+    CHECK(empty.Allocate(1).IsValid() == false);
+}
+
+TEST(TlsfAllocator, RequiredCapacity)
+{
+    // An empty allocator of the required capacity serves the request, for sizes across many classes
+    for (uint64_t alignment : { 1ull, 4ull, 256ull, 65536ull })
+    {
+        for (uint64_t size = 1; size <= (16ull << 30); size = size * 3 + 1)
+        {
+            uint64_t capacity = TlsfAllocator::GetRequiredCapacity(size, alignment);
+            CHECK(capacity >= size);
+            TlsfAllocator allocator(capacity);
+            TlsfAllocator::Allocation allocation = allocator.Allocate(size, alignment);
+            CHECK(allocation.IsValid());
+            CHECK_EQUAL(0ull, allocation.offset % alignment);
+        }
+    }
+
+    // The search rounds up to the next class, a range of exactly the size isn't always enough
+    const uint64_t kSize = 100ull * 1024 * 1024;
+    CHECK(TlsfAllocator(kSize).Allocate(kSize, 65536).IsValid() == false);
+    CHECK(TlsfAllocator(TlsfAllocator::GetRequiredCapacity(kSize, 65536)).Allocate(kSize, 65536).IsValid());
+    CHECK_EQUAL(15ull, TlsfAllocator::GetRequiredCapacity(15, 1));
+}
+
+TEST(TlsfAllocator, RandomAllocateFree)
+{
+    const uint64_t kCapacity = 1 << 16;
+    TlsfAllocator allocator(kCapacity);
+    FakeHeap heap(kCapacity);
+    std::vector<TlsfAllocator::Allocation> live;
+    std::mt19937 random(1234);
+    uint64_t usedBytes = 0;
+
+    for (uint32_t step = 1; step <= 20000; step++)
+    {
+        if (live.empty() == false && (random() % 2 == 0))
+        {
+            size_t index = random() % live.size();
+            heap.Release(live[index]);
+            usedBytes -= live[index].size;
+            allocator.Free(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+        }
+        else
+        {
+            uint64_t size = 1 + random() % 600;
+            uint64_t alignment = 1ull << (random() % 9);
+            TlsfAllocator::Allocation allocation = allocator.Allocate(size, alignment);
+            if (allocation.IsValid())
+            {
+                CHECK_EQUAL(0ull, allocation.offset % alignment);
+                CHECK(heap.Claim(allocation, step));
+                usedBytes += allocation.size;
+                live.push_back(allocation);
+            }
+        }
+        CHECK_EQUAL(usedBytes, allocator.GetStats().usedBytes);
+    }
+
+    for (const TlsfAllocator::Allocation& allocation : live)
+    {
+        allocator.Free(allocation);
+    }
+    CHECK(allocator.IsEmpty());
+    CHECK_EQUAL(1u, allocator.GetStats().freeBlockCount);
+}